@@ -0,0 +1,317 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../Triangular flower/allocation_counter.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <intrin.h>
+#else
+#include <time.h>
+#endif
+
+// Micro-benchmark harness in the spirit of Google Benchmark: every benchmark is a function that loops
+// while (state.keepRunning()), the iteration count grows until one run takes --min-time, and the results
+// are printed as a table and written as Google Benchmark compatible JSON, so its compare tools work on them.
+
+// Keeps a value alive without the compiler seeing what is done with it
+template <typename T>
+inline void doNotOptimize(const T& value) {
+#if defined(__GNUC__) || defined(__clang__)
+	asm volatile("" : : "r,m"(value) : "memory");
+#else
+	static const volatile void* sink;
+	sink = &value;
+	_ReadWriteBarrier();
+#endif
+}
+
+// Forces pending stores to memory, so writes into a buffer are not optimized away
+inline void clobberMemory() {
+#if defined(__GNUC__) || defined(__clang__)
+	asm volatile("" : : : "memory");
+#else
+	_ReadWriteBarrier();
+#endif
+}
+
+// CPU time of this thread in seconds
+inline double threadCpuSeconds() {
+#ifdef _WIN32
+	FILETIME creation, exit, kernel, user;
+	GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user);
+	ULARGE_INTEGER k, u;
+	k.LowPart = kernel.dwLowDateTime;
+	k.HighPart = kernel.dwHighDateTime;
+	u.LowPart = user.dwLowDateTime;
+	u.HighPart = user.dwHighDateTime;
+	return (k.QuadPart + u.QuadPart) * 1e-7;
+#else
+	timespec now;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+	return now.tv_sec + now.tv_nsec * 1e-9;
+#endif
+}
+
+class BenchmarkState {
+public:
+	explicit BenchmarkState(uint64_t iterations) : iterations(iterations), remaining(iterations) {
+	}
+
+	// The timers and allocation counters start on the first call, setup code before the loop is not measured
+	bool keepRunning() {
+		if (!started) {
+			started = true;
+			allocationsAtStart = allocation_counter::snapshot();
+			cpuAtStart = threadCpuSeconds();
+			realAtStart = std::chrono::steady_clock::now();
+		}
+		if (remaining > 0) {
+			--remaining;
+			return true;
+		}
+		if (!finished) {
+			finished = true;
+			realSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - realAtStart).count();
+			cpuSeconds = threadCpuSeconds() - cpuAtStart;
+			AllocationCounts counts = allocation_counter::snapshot();
+			allocations = counts.allocations - allocationsAtStart.allocations;
+			allocatedBytes = counts.bytes - allocationsAtStart.bytes;
+		}
+		return false;
+	}
+
+	uint64_t maxIterations() const {
+		return iterations;
+	}
+	// Totals over all iterations, reported per second
+	void setBytesProcessed(uint64_t bytes) {
+		bytesProcessed = bytes;
+	}
+	void setItemsProcessed(uint64_t items) {
+		itemsProcessed = items;
+	}
+	void skipWithError(const std::string& message) {
+		error = message;
+		remaining = 0;
+	}
+
+private:
+	friend class BenchmarkRegistry;
+
+	uint64_t iterations, remaining;
+	bool started = false, finished = false;
+	std::chrono::steady_clock::time_point realAtStart;
+	double cpuAtStart = 0.0;
+	AllocationCounts allocationsAtStart = { 0, 0 };
+
+	double realSeconds = 0.0, cpuSeconds = 0.0;
+	uint64_t allocations = 0, allocatedBytes = 0;
+	uint64_t bytesProcessed = 0, itemsProcessed = 0;
+	std::string error;
+};
+
+struct BenchmarkOptions {
+	std::string filter; // substring of the benchmark names to run, empty runs all
+	double minTime = 0.5; // seconds of the measured run
+	std::string jsonPath; // Google Benchmark JSON output, empty writes none
+	std::string executable;
+};
+
+struct BenchmarkResult {
+	std::string name;
+	uint64_t iterations;
+	double realNs, cpuNs; // per iteration
+	double bytesPerSecond, itemsPerSecond;
+	double allocationsPerIteration, allocatedBytesPerIteration;
+	std::string error;
+};
+
+class BenchmarkRegistry {
+public:
+	void add(const std::string& name, std::function<void(BenchmarkState&)> function) {
+		benchmarks.push_back({ name, function });
+	}
+
+	// Returns 1 when a benchmark failed or the JSON could not be written
+	int run(const BenchmarkOptions& options) {
+		std::vector<BenchmarkResult> results;
+		printHeader();
+		for (const Entry& entry : benchmarks) {
+			if (!options.filter.empty() && entry.name.find(options.filter) == std::string::npos) {
+				continue;
+			}
+			results.push_back(measure(entry, options.minTime));
+			printResult(results.back());
+		}
+		int result = 0;
+		for (const BenchmarkResult& benchmark : results) {
+			if (!benchmark.error.empty()) {
+				result = 1;
+			}
+		}
+		if (!options.jsonPath.empty() && !writeJson(options.jsonPath, options.executable, results)) {
+			std::cout << "ERROR::BENCHMARKS::CANNOT_WRITE " << options.jsonPath << std::endl;
+			result = 1;
+		}
+		return result;
+	}
+
+private:
+	struct Entry {
+		std::string name;
+		std::function<void(BenchmarkState&)> function;
+	};
+	std::vector<Entry> benchmarks;
+
+	// Same iteration growth as Google Benchmark: aim 40% past the minimum time, at most 10x per step
+	static BenchmarkResult measure(const Entry& entry, double minTime) {
+		const uint64_t maxIterations = 1000000000;
+		uint64_t iterations = 1;
+		for (;;) {
+			BenchmarkState state(iterations);
+			entry.function(state);
+			if (!state.finished) {
+				// The function returned without finishing its loop
+				while (state.keepRunning()) {
+				}
+			}
+			if (!state.error.empty() || state.realSeconds >= minTime || iterations >= maxIterations) {
+				return makeResult(entry.name, state);
+			}
+			double multiplier = minTime * 1.4 / std::max(state.realSeconds, 1e-9);
+			if (state.realSeconds / minTime <= 0.1) {
+				multiplier = std::min(multiplier, 10.0);
+			}
+			uint64_t next = (uint64_t)(iterations * multiplier);
+			iterations = std::min(maxIterations, std::max(next, iterations + 1));
+		}
+	}
+
+	static BenchmarkResult makeResult(const std::string& name, const BenchmarkState& state) {
+		BenchmarkResult result;
+		result.name = name;
+		result.iterations = state.iterations;
+		double iterations = (double)std::max<uint64_t>(state.iterations, 1);
+		double seconds = std::max(state.realSeconds, 1e-12);
+		result.realNs = state.realSeconds * 1e9 / iterations;
+		result.cpuNs = state.cpuSeconds * 1e9 / iterations;
+		result.bytesPerSecond = state.bytesProcessed / seconds;
+		result.itemsPerSecond = state.itemsProcessed / seconds;
+		result.allocationsPerIteration = state.allocations / iterations;
+		result.allocatedBytesPerIteration = state.allocatedBytes / iterations;
+		result.error = state.error;
+		return result;
+	}
+
+	static std::string formatRate(double perSecond, const char* unit) {
+		const char* prefixes[] = { "", "k", "M", "G", "T" };
+		int prefix = 0;
+		while (perSecond >= 1000.0 && prefix < 4) {
+			perSecond /= 1000.0;
+			++prefix;
+		}
+		std::ostringstream text;
+		text << std::fixed << std::setprecision(prefix ? 2 : 0) << perSecond << prefixes[prefix] << unit;
+		return text.str();
+	}
+
+	static void printHeader() {
+		std::cout << "Run on (" << std::max(1u, std::thread::hardware_concurrency()) << " X CPU s)" << std::endl;
+		std::cout << std::string(118, '-') << std::endl;
+		std::cout << std::left << std::setw(46) << "Benchmark" << std::right << std::setw(14) << "Time" << std::setw(14) << "CPU"
+				  << std::setw(12) << "Iterations" << " UserCounters..." << std::endl;
+		std::cout << std::string(118, '-') << std::endl;
+	}
+
+	static void printResult(const BenchmarkResult& result) {
+		std::cout << std::left << std::setw(46) << result.name << std::right;
+		if (!result.error.empty()) {
+			std::cout << " ERROR OCCURRED: '" << result.error << "'" << std::endl;
+			return;
+		}
+		std::cout << std::fixed << std::setprecision(1) << std::setw(11) << result.realNs << " ns" << std::setw(11) << result.cpuNs << " ns"
+				  << std::setw(12) << result.iterations;
+		if (result.bytesPerSecond > 0.0) {
+			std::cout << " bytes_per_second=" << formatRate(result.bytesPerSecond, "B/s");
+		}
+		if (result.itemsPerSecond > 0.0) {
+			std::cout << " items_per_second=" << formatRate(result.itemsPerSecond, "/s");
+		}
+		std::cout << std::setprecision(2) << " allocs/iter=" << result.allocationsPerIteration
+				  << " alloc_bytes/iter=" << result.allocatedBytesPerIteration << std::defaultfloat << std::endl;
+	}
+
+	static std::string escapeJson(const std::string& text) {
+		std::string escaped;
+		for (char c : text) {
+			if (c == '"' || c == '\\') {
+				escaped += '\\';
+			}
+			escaped += c;
+		}
+		return escaped;
+	}
+
+	static bool writeJson(const std::string& path, const std::string& executable, const std::vector<BenchmarkResult>& results) {
+		std::ofstream file(path);
+		if (!file) {
+			return false;
+		}
+		char date[64];
+		std::time_t now = std::time(nullptr);
+		std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+		file << "{\n  \"context\": {\n";
+		file << "    \"date\": \"" << date << "\",\n";
+		file << "    \"executable\": \"" << escapeJson(executable) << "\",\n";
+		file << "    \"num_cpus\": " << std::max(1u, std::thread::hardware_concurrency()) << ",\n";
+#ifdef NDEBUG
+		file << "    \"library_build_type\": \"release\"\n";
+#else
+		file << "    \"library_build_type\": \"debug\"\n";
+#endif
+		file << "  },\n  \"benchmarks\": [\n";
+		file << std::setprecision(10);
+		for (size_t i = 0; i < results.size(); ++i) {
+			const BenchmarkResult& result = results[i];
+			file << "    {\n";
+			file << "      \"name\": \"" << escapeJson(result.name) << "\",\n";
+			file << "      \"run_name\": \"" << escapeJson(result.name) << "\",\n";
+			file << "      \"run_type\": \"iteration\",\n";
+			if (!result.error.empty()) {
+				file << "      \"error_occurred\": true,\n";
+				file << "      \"error_message\": \"" << escapeJson(result.error) << "\",\n";
+			}
+			file << "      \"iterations\": " << result.iterations << ",\n";
+			file << "      \"real_time\": " << result.realNs << ",\n";
+			file << "      \"cpu_time\": " << result.cpuNs << ",\n";
+			file << "      \"time_unit\": \"ns\",\n";
+			if (result.bytesPerSecond > 0.0) {
+				file << "      \"bytes_per_second\": " << result.bytesPerSecond << ",\n";
+			}
+			if (result.itemsPerSecond > 0.0) {
+				file << "      \"items_per_second\": " << result.itemsPerSecond << ",\n";
+			}
+			file << "      \"allocations_per_iteration\": " << result.allocationsPerIteration << ",\n";
+			file << "      \"allocated_bytes_per_iteration\": " << result.allocatedBytesPerIteration << "\n";
+			file << "    }" << (i + 1 < results.size() ? "," : "") << "\n";
+		}
+		file << "  ]\n}\n";
+		return (bool)file;
+	}
+};
+#endif
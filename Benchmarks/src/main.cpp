@@ -0,0 +1,1575 @@
+#define ALLOCATION_COUNTER_IMPLEMENTATION
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "../../Triangular flower/thread_pool.h"
+#include "../../Triangular flower/software_rasterizer.h"
+#include "../../Triangular flower/flower_geometry.h"
+#include "../../Triangular flower/glsl_translator.h"
+#include "../../Triangular flower/shader_source.h"
+#include "../../Triangular flower/batch_random.h"
+#include "../../Triangular flower/vector_math.h"
+#include "../../Triangular flower/tlsf_allocator.h"
+#include "../../Triangular flower/mipmap.h"
+#include "../../Triangular flower/texture_compression.h"
+#include "../../Triangular flower/ktx2.h"
+#include "../../Triangular flower/sprite_quads.h"
+#include "../../Triangular flower/scene_graph.h"
+#include "../../Triangular flower/ecs.h"
+#include "../../Triangular flower/bvh_culling.h"
+#include "../../Triangular flower/circle_lod.h"
+#include "../../Triangular flower/sdf_font.h"
+#include "../../Triangular flower/scene_file.h"
+#include "../../Triangular flower/shaders/kernels/flower_vertex.h"
+#include "../../Triangular flower/shaders/kernels/circle_fragment.h"
+#include "../../Triangular flower/shaders/kernels/triangle_fragment.h"
+#include "../benchmark.h"
+
+// CPU-only benchmarks and tools, nothing here needs GL or a window.
+//   Benchmarks raster [--threads 1,2,4] [--seconds 0.5]
+//       software rasterizer throughput in Mtris/s and Mpixels/s per thread count
+//   Benchmarks render <output.ppm> [--seed N] [--time T] [--size WxH] [--threads N]
+//       renders the flower with the software rasterizer, --seed and --time match the demo's
+//       --seed and animation clock, so the image can be compared against the GL output
+//   Benchmarks compile-shader <shader.txt> <kernel.h> <StructName>
+//       translates a shader into a SIMD kernel, the kernels in shaders/kernels are made with it
+//   Benchmarks shader [--shaders <dir>] [--count N] [--seconds 0.5]
+//       generated kernels against the scalar interpreter, in millions of invocations per second
+//   Benchmarks compress-texture <input.ppm|tga> <output.ktx2> [--format bc1|bc3|bc7|etc2] [--threads N] [--no-mips]
+//       compresses an image and its mip chain into KTX2 for the demo's --texture
+//   Benchmarks texture-compression [--input <image>] [--threads 1,2,4] [--seconds 0.5]
+//       encoder throughput in Mpixels/s and PSNR of every format per thread count
+//   Benchmarks scene-load [--megabytes 100] [--output <file.scene>]
+//       writes a generated scene file and loads it cold (parsed, the cache written) and warm (from the cache)
+//   Benchmarks micro [--filter <text>] [--json <out.json>] [--min-time 0.5] [--shaders <dir>]
+//       startup and per-frame CPU paths of the demo in ns/op, bytes/s and heap allocations per op,
+//       --json writes Google Benchmark JSON for its compare tools
+
+void printUsage();
+int runRasterBenchmark(int argc, char** argv);
+int runRender(int argc, char** argv);
+int runCompileShader(int argc, char** argv);
+int runShaderBenchmark(int argc, char** argv);
+int runCompressTexture(int argc, char** argv);
+int runTextureCompressionBenchmark(int argc, char** argv);
+int runSceneLoad(int argc, char** argv);
+int runMicroBenchmarks(const char* executable, int argc, char** argv);
+
+int main(int argc, char** argv) {
+	if (argc >= 2 && strcmp(argv[1], "raster") == 0) {
+		return runRasterBenchmark(argc - 2, argv + 2);
+	}
+	if (argc >= 3 && strcmp(argv[1], "render") == 0) {
+		return runRender(argc - 2, argv + 2);
+	}
+	if (argc >= 2 && strcmp(argv[1], "compile-shader") == 0) {
+		return runCompileShader(argc - 2, argv + 2);
+	}
+	if (argc >= 2 && strcmp(argv[1], "shader") == 0) {
+		return runShaderBenchmark(argc - 2, argv + 2);
+	}
+	if (argc >= 4 && strcmp(argv[1], "compress-texture") == 0) {
+		return runCompressTexture(argc - 2, argv + 2);
+	}
+	if (argc >= 2 && strcmp(argv[1], "texture-compression") == 0) {
+		return runTextureCompressionBenchmark(argc - 2, argv + 2);
+	}
+	if (argc >= 2 && strcmp(argv[1], "scene-load") == 0) {
+		return runSceneLoad(argc - 2, argv + 2);
+	}
+	if (argc >= 2 && strcmp(argv[1], "micro") == 0) {
+		return runMicroBenchmarks(argv[0], argc - 2, argv + 2);
+	}
+	printUsage();
+	return 1;
+}
+
+void printUsage() {
+	std::cout << "Usage:" << std::endl;
+	std::cout << "  Benchmarks raster [--threads 1,2,4] [--seconds 0.5]" << std::endl;
+	std::cout << "  Benchmarks render <output.ppm> [--seed N] [--time T] [--size WxH] [--threads N]" << std::endl;
+	std::cout << "  Benchmarks compile-shader <shader.txt> <kernel.h> <StructName>" << std::endl;
+	std::cout << "  Benchmarks shader [--shaders <dir>] [--count N] [--seconds 0.5]" << std::endl;
+	std::cout << "  Benchmarks compress-texture <input.ppm|tga> <output.ktx2> [--format bc1|bc3|bc7|etc2] [--threads N] [--no-mips]" << std::endl;
+	std::cout << "  Benchmarks texture-compression [--input <image>] [--threads 1,2,4] [--seconds 0.5]" << std::endl;
+	std::cout << "  Benchmarks scene-load [--megabytes 100] [--output <file.scene>]" << std::endl;
+	std::cout << "  Benchmarks micro [--filter <text>] [--json <out.json>] [--min-time 0.5] [--shaders <dir>]" << std::endl;
+}
+
+// 1, 2, 4, ... up to the number of hardware threads, which is always included
+std::vector<unsigned int> defaultThreadCounts() {
+	unsigned int hardware = std::max(1u, std::thread::hardware_concurrency());
+	std::vector<unsigned int> counts;
+	for (unsigned int count = 1; count < hardware; count *= 2) {
+		counts.push_back(count);
+	}
+	counts.push_back(hardware);
+	return counts;
+}
+
+std::vector<unsigned int> parseThreadCounts(const char* list) {
+	std::vector<unsigned int> counts;
+	for (const char* p = list; *p;) {
+		char* end;
+		unsigned long count = strtoul(p, &end, 10);
+		if (end == p) {
+			break;
+		}
+		if (count > 0) {
+			counts.push_back((unsigned int)count);
+		}
+		p = *end == ',' ? end + 1 : end;
+	}
+	return counts;
+}
+
+// A frame of the software rasterizer: vertex and index arrays plus the draws that use them
+struct RasterWorkload {
+	std::string name;
+	int width, height;
+	std::vector<float> vertices;
+	std::vector<unsigned int> indices;
+	struct Draw {
+		unsigned int firstIndex, triangleCount;
+	};
+	std::vector<Draw> draws;
+	float gradient[3];
+};
+
+// The flower as the demo draws it: circle first, then the triangle fan
+RasterWorkload makeFlowerWorkload(unsigned int seed, float time, int width, int height) {
+	std::mt19937 gen(seed);
+	std::uniform_real_distribution<> distr(0, 1);
+	FlowerGeometry geometry;
+	generateFlowerGeometry(geometry, gen, distr);
+
+	RasterWorkload workload;
+	workload.name = "flower";
+	workload.width = width;
+	workload.height = height;
+	// Both shapes go into one vertex array, the triangle's indices are rebased
+	unsigned int circleVertexCount = sizeof(geometry.circleVertices) / sizeof(float) / FLOWER_VERTEX_FLOATS;
+	workload.vertices.assign(geometry.circleVertices, geometry.circleVertices + sizeof(geometry.circleVertices) / sizeof(float));
+	workload.vertices.insert(workload.vertices.end(), geometry.triangleVertices,
+							 geometry.triangleVertices + sizeof(geometry.triangleVertices) / sizeof(float));
+	workload.indices.assign(geometry.circleIndices, geometry.circleIndices + sizeof(geometry.circleIndices) / sizeof(unsigned int));
+	for (unsigned int index : geometry.triangleIndices) {
+		workload.indices.push_back(index + circleVertexCount);
+	}
+	workload.draws.push_back({ 0, sizeof(geometry.circleIndices) / sizeof(unsigned int) / 3 });
+	workload.draws.push_back({ (unsigned int)sizeof(geometry.circleIndices) / sizeof(unsigned int),
+							   sizeof(geometry.triangleIndices) / sizeof(unsigned int) / 3 });
+	// The same gradient main computes from the animation clock
+	computeColorGradient(time, workload.gradient[0], workload.gradient[1], workload.gradient[2]);
+	return workload;
+}
+
+// Random triangles of roughly the given area in pixels, scattered over the whole viewport
+RasterWorkload makeRandomWorkload(const char* name, unsigned int count, float area, int width, int height) {
+	std::mt19937 gen(1);
+	std::uniform_real_distribution<> distr(0, 1);
+
+	RasterWorkload workload;
+	workload.name = name;
+	workload.width = width;
+	workload.height = height;
+	// Sides of about sqrt(2 * area) pixels, converted to NDC
+	float sizeX = sqrt(2.0f * area) * 2.0f / width, sizeY = sqrt(2.0f * area) * 2.0f / height;
+	for (unsigned int i = 0; i < count; ++i) {
+		float centerX = (float)distr(gen) * 2.0f - 1.0f, centerY = (float)distr(gen) * 2.0f - 1.0f;
+		for (int corner = 0; corner < 3; ++corner) {
+			float angle = (float)(distr(gen) * 0.5 + corner) * 2.0944f;
+			float vertex[] = { centerX + cosf(angle) * sizeX, centerY + sinf(angle) * sizeY, 0.0f,
+							   (float)distr(gen), (float)distr(gen), (float)distr(gen) };
+			workload.vertices.insert(workload.vertices.end(), vertex, vertex + FLOWER_VERTEX_FLOATS);
+			workload.indices.push_back(i * 3 + corner);
+		}
+	}
+	workload.draws.push_back({ 0, count });
+	workload.gradient[0] = workload.gradient[1] = workload.gradient[2] = 0.0f;
+	return workload;
+}
+
+void renderWorkload(SoftwareRasterizer& rasterizer, const RasterWorkload& workload) {
+	rasterizer.clear(0.07f, 0.07f, 0.07f, 1.0f);
+	unsigned int vertexCount = (unsigned int)(workload.vertices.size() / FLOWER_VERTEX_FLOATS);
+	for (const RasterWorkload::Draw& draw : workload.draws) {
+		rasterizer.draw(workload.vertices.data(), vertexCount, workload.indices.data() + draw.firstIndex, draw.triangleCount,
+						workload.gradient[0], workload.gradient[1], workload.gradient[2]);
+	}
+	rasterizer.finish();
+}
+
+int runRasterBenchmark(int argc, char** argv) {
+	std::vector<unsigned int> threadCounts = defaultThreadCounts();
+	double seconds = 0.5;
+	for (int i = 0; i < argc; ++i) {
+		if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+			threadCounts = parseThreadCounts(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+			seconds = atof(argv[++i]);
+		}
+		else {
+			std::cout << "WARNING::BENCHMARKS::UNKNOWN_ARGUMENT " << argv[i] << std::endl;
+		}
+	}
+
+	std::vector<RasterWorkload> workloads;
+	workloads.push_back(makeFlowerWorkload(1, 0.0f, 600, 600));
+	workloads.push_back(makeRandomWorkload("small 1080p", 200000, 16.0f, 1920, 1080));
+	workloads.push_back(makeRandomWorkload("medium 1080p", 20000, 400.0f, 1920, 1080));
+	workloads.push_back(makeRandomWorkload("large 1080p", 500, 40000.0f, 1920, 1080));
+
+	std::cout << std::left << std::setw(16) << "workload" << std::right << std::setw(8) << "threads" << std::setw(12) << "frame ms"
+			  << std::setw(12) << "Mtris/s" << std::setw(12) << "Mpixels/s" << std::endl;
+	for (const RasterWorkload& workload : workloads) {
+		for (unsigned int threads : threadCounts) {
+			ThreadPool pool(threads);
+			SoftwareRasterizer rasterizer(pool);
+			rasterizer.resize(workload.width, workload.height);
+			// Warm-up sizes the bins and faults the color buffer in
+			renderWorkload(rasterizer, workload);
+			rasterizer.resetStatistics();
+
+			int frames = 0;
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			double elapsed = 0.0;
+			do {
+				renderWorkload(rasterizer, workload);
+				++frames;
+				elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			} while (elapsed < seconds);
+
+			const SoftwareRasterizer::Stats& stats = rasterizer.statistics();
+			std::cout << std::left << std::setw(16) << workload.name << std::right << std::setw(8) << threads
+					  << std::fixed << std::setprecision(3) << std::setw(12) << elapsed * 1000.0 / frames
+					  << std::setw(12) << stats.triangles / elapsed / 1e6 << std::setw(12) << stats.pixels / elapsed / 1e6
+					  << std::defaultfloat << std::endl;
+		}
+	}
+	return 0;
+}
+
+int runRender(int argc, char** argv) {
+	const char* output = argv[0];
+	unsigned int seed = 1, threads = 0;
+	float time = 0.0f;
+	int width = 600, height = 600;
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+			seed = (unsigned int)strtoul(argv[++i], nullptr, 10);
+		}
+		else if (strcmp(argv[i], "--time") == 0 && i + 1 < argc) {
+			time = (float)atof(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+			if (sscanf(argv[++i], "%dx%d", &width, &height) != 2) {
+				std::cout << "ERROR::BENCHMARKS::BAD_SIZE " << argv[i] << std::endl;
+				return 1;
+			}
+		}
+		else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+			threads = (unsigned int)strtoul(argv[++i], nullptr, 10);
+		}
+		else {
+			std::cout << "WARNING::BENCHMARKS::UNKNOWN_ARGUMENT " << argv[i] << std::endl;
+		}
+	}
+
+	ThreadPool pool(threads);
+	SoftwareRasterizer rasterizer(pool);
+	rasterizer.resize(width, height);
+	renderWorkload(rasterizer, makeFlowerWorkload(seed, time, width, height));
+	return rasterizer.writePpm(output) ? 0 : 1;
+}
+
+// Source name recorded in the generated header: the path from the shaders directory on
+std::string shaderSourceName(const std::string& path) {
+	size_t at = path.rfind("shaders/");
+	if (at == std::string::npos) {
+		at = path.rfind("shaders\\");
+	}
+	std::string name = at == std::string::npos ? path : path.substr(at);
+	std::replace(name.begin(), name.end(), '\\', '/');
+	return name;
+}
+
+bool translateShader(const std::string& path, ShaderProgramIR& program) {
+	std::string source;
+	GlslTranslator translator;
+	return GlslTranslator::loadFile(path.c_str(), source) && translator.translate(source, program);
+}
+
+int runCompileShader(int argc, char** argv) {
+	if (argc != 3) {
+		printUsage();
+		return 1;
+	}
+	ShaderProgramIR program;
+	if (!translateShader(argv[0], program)) {
+		return 1;
+	}
+	std::ofstream file(argv[1], std::ios::binary);
+	if (!file) {
+		std::cout << "ERROR::BENCHMARKS::CANNOT_WRITE " << argv[1] << std::endl;
+		return 1;
+	}
+	generateShaderKernel(program, argv[2], shaderSourceName(argv[0]), file);
+	std::cout << argv[0] << ": " << program.code.size() << " instructions, " << program.inputComponents << " inputs, "
+			  << program.uniformComponents << " uniforms, " << program.outputComponents << " outputs" << std::endl;
+	return 0;
+}
+
+// A generated kernel next to the shader it came from
+struct ShaderKernelEntry {
+	const char* shader;
+	const char* kernel;
+	const char* structName;
+	void (*run)(const float* const*, const float*, float* const*, size_t);
+	int inputs, uniforms, outputs;
+};
+
+// Seconds per call of the function, repeated until the time budget is used up
+template <typename Function>
+double timeCalls(Function function, double seconds) {
+	function();
+	int calls = 0;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	double elapsed = 0.0;
+	do {
+		function();
+		++calls;
+		elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	} while (elapsed < seconds);
+	return elapsed / calls;
+}
+
+int runShaderBenchmark(int argc, char** argv) {
+	std::string directory = "../Triangular flower/shaders";
+	size_t count = 1 << 20;
+	double seconds = 0.5;
+	for (int i = 0; i < argc; ++i) {
+		if (strcmp(argv[i], "--shaders") == 0 && i + 1 < argc) {
+			directory = argv[++i];
+		}
+		else if (strcmp(argv[i], "--count") == 0 && i + 1 < argc) {
+			count = (size_t)strtoull(argv[++i], nullptr, 10);
+		}
+		else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+			seconds = atof(argv[++i]);
+		}
+		else {
+			std::cout << "WARNING::BENCHMARKS::UNKNOWN_ARGUMENT " << argv[i] << std::endl;
+		}
+	}
+
+	const ShaderKernelEntry kernels[] = {
+		{ "3.3.shader.txt", "kernels/flower_vertex.h", "FlowerVertexKernel", &FlowerVertexKernel::run,
+		  FlowerVertexKernel::INPUTS, FlowerVertexKernel::UNIFORMS, FlowerVertexKernel::OUTPUTS },
+		{ "3.3.shader_circle.txt", "kernels/circle_fragment.h", "CircleFragmentKernel", &CircleFragmentKernel::run,
+		  CircleFragmentKernel::INPUTS, CircleFragmentKernel::UNIFORMS, CircleFragmentKernel::OUTPUTS },
+		{ "3.3.shader_triangle.txt", "kernels/triangle_fragment.h", "TriangleFragmentKernel", &TriangleFragmentKernel::run,
+		  TriangleFragmentKernel::INPUTS, TriangleFragmentKernel::UNIFORMS, TriangleFragmentKernel::OUTPUTS },
+	};
+
+	int result = 0;
+	std::cout << std::left << std::setw(26) << "shader" << std::right << std::setw(16) << "interpreter" << std::setw(12) << "kernel"
+			  << std::setw(10) << "speedup" << std::setw(12) << "max error" << "   (Minvocations/s)" << std::endl;
+	for (const ShaderKernelEntry& entry : kernels) {
+		std::string shaderPath = directory + "/" + entry.shader;
+		ShaderProgramIR program;
+		if (!translateShader(shaderPath, program)) {
+			result = 1;
+			continue;
+		}
+		if (program.inputComponents != entry.inputs || program.uniformComponents != entry.uniforms || program.outputComponents != entry.outputs) {
+			std::cout << "ERROR::BENCHMARKS::KERNEL_INTERFACE_CHANGED " << entry.kernel << ", run compile-shader again" << std::endl;
+			result = 1;
+			continue;
+		}
+		// A kernel that no longer matches its shader is reported, the numbers would be meaningless
+		std::ostringstream regenerated;
+		generateShaderKernel(program, entry.structName, shaderSourceName(shaderPath), regenerated);
+		std::string committed;
+		std::string kernelPath = directory + "/" + entry.kernel;
+		if (GlslTranslator::loadFile(kernelPath.c_str(), committed) && committed != regenerated.str()) {
+			std::cout << "WARNING::BENCHMARKS::STALE_KERNEL " << kernelPath << ", run compile-shader again" << std::endl;
+		}
+
+		std::mt19937 gen(1);
+		std::uniform_real_distribution<float> distr(-1.0f, 1.0f);
+		std::vector<std::vector<float> > inputs(entry.inputs, std::vector<float>(count));
+		std::vector<std::vector<float> > expected(entry.outputs, std::vector<float>(count)), actual(expected);
+		std::vector<float> uniforms(entry.uniforms + 1);
+		for (std::vector<float>& stream : inputs) {
+			for (float& value : stream) {
+				value = distr(gen);
+			}
+		}
+		for (float& value : uniforms) {
+			value = distr(gen);
+		}
+		std::vector<const float*> inputPointers;
+		std::vector<float*> expectedPointers, actualPointers;
+		for (std::vector<float>& stream : inputs) {
+			inputPointers.push_back(stream.data());
+		}
+		for (int c = 0; c < entry.outputs; ++c) {
+			expectedPointers.push_back(expected[c].data());
+			actualPointers.push_back(actual[c].data());
+		}
+
+		ShaderInterpreter interpreter(program);
+		double interpreterTime = timeCalls([&] {
+			interpreter.run(inputPointers.data(), uniforms.data(), expectedPointers.data(), count);
+		}, seconds);
+		double kernelTime = timeCalls([&] {
+			entry.run(inputPointers.data(), uniforms.data(), actualPointers.data(), count);
+		}, seconds);
+
+		float maxError = 0.0f;
+		for (int c = 0; c < entry.outputs; ++c) {
+			for (size_t i = 0; i < count; ++i) {
+				maxError = std::max(maxError, std::fabs(expected[c][i] - actual[c][i]));
+			}
+		}
+		std::cout << std::left << std::setw(26) << entry.shader << std::right << std::fixed << std::setprecision(1)
+				  << std::setw(16) << count / interpreterTime / 1e6 << std::setw(12) << count / kernelTime / 1e6
+				  << std::setw(9) << interpreterTime / kernelTime << "x" << std::setprecision(6) << std::setw(12) << maxError
+				  << std::defaultfloat << std::endl;
+		if (maxError > 1e-5f) {
+			std::cout << "ERROR::BENCHMARKS::KERNEL_MISMATCH " << entry.kernel << std::endl;
+			result = 1;
+		}
+	}
+	return result;
+}
+
+bool loadImageFile(const char* path, Image& image) {
+	std::vector<unsigned char> bytes;
+	if (!readFileBytes(path, bytes)) {
+		std::cout << "ERROR::BENCHMARKS::CANNOT_READ " << path << std::endl;
+		return false;
+	}
+	const char* error = nullptr;
+	if (!decodeImage(bytes.data(), bytes.size(), image, error)) {
+		std::cout << "ERROR::BENCHMARKS::CANNOT_DECODE " << path << ": " << error << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// Smooth gradients, fine detail, noise and hard edges, with an alpha ramp, so no format gets an easy image
+Image makeCompressionTestImage(int size) {
+	Image image;
+	image.width = image.height = size;
+	image.rgba.resize((size_t)size * size * 4);
+	std::mt19937 gen(1);
+	std::uniform_int_distribution<int> noise(-12, 12);
+	for (int y = 0; y < size; ++y) {
+		for (int x = 0; x < size; ++x) {
+			float u = (float)x / size, v = (float)y / size;
+			float detail = std::sin(u * 90.0f) * std::sin(v * 70.0f);
+			bool edge = ((x / 37) + (y / 53)) % 5 == 0;
+			unsigned char* p = image.rgba.data() + ((size_t)y * size + x) * 4;
+			p[0] = (unsigned char)texture_compression::clampByte((int)(255.0f * u + 30.0f * detail) + noise(gen));
+			p[1] = (unsigned char)texture_compression::clampByte((int)(edge ? 230.0f : 255.0f * v * (1.0f - u)) + noise(gen));
+			p[2] = (unsigned char)texture_compression::clampByte((int)(128.0f + 100.0f * std::sin((u + v) * 6.0f)) + noise(gen));
+			p[3] = (unsigned char)texture_compression::clampByte((int)(255.0f * (0.5f + 0.5f * std::cos(u * 9.0f + v * 4.0f))));
+		}
+	}
+	return image;
+}
+
+double compressionPsnr(const Image& image, const std::vector<unsigned char>& blocks, BlockFormat format) {
+	std::vector<unsigned char> decoded(image.rgba.size());
+	decompressImage(blocks.data(), image.width, image.height, format, decoded.data());
+	return psnr(image.rgba.data(), decoded.data(), (size_t)image.width * image.height, blockFormatInfo(format).alpha ? 4 : 3);
+}
+
+int runCompressTexture(int argc, char** argv) {
+	const char* inputPath = argv[0];
+	const char* outputPath = argv[1];
+	BlockFormat format = BlockFormat::BC7;
+	unsigned int threads = 0;
+	bool mips = true;
+	for (int i = 2; i < argc; ++i) {
+		if (strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+			if (!parseBlockFormat(argv[++i], format)) {
+				std::cout << "ERROR::BENCHMARKS::UNKNOWN_FORMAT " << argv[i] << std::endl;
+				return 1;
+			}
+		}
+		else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+			threads = (unsigned int)strtoul(argv[++i], nullptr, 10);
+		}
+		else if (strcmp(argv[i], "--no-mips") == 0) {
+			mips = false;
+		}
+		else {
+			std::cout << "WARNING::BENCHMARKS::UNKNOWN_ARGUMENT " << argv[i] << std::endl;
+		}
+	}
+	Image image;
+	if (!loadImageFile(inputPath, image)) {
+		return 1;
+	}
+	MipChain chain;
+	buildMipChain(image, chain);
+	int levelCount = mips ? chain.levels : 1;
+
+	ThreadPool pool(threads);
+	std::vector<std::vector<unsigned char> > levels(levelCount);
+	const unsigned char* levelPointers[ktx2::MAX_LEVELS];
+	size_t levelBytes[ktx2::MAX_LEVELS];
+	size_t pixels = 0;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int i = 0; i < levelCount; ++i) {
+		levels[i].resize(compressedSize(format, chain.width[i], chain.height[i]));
+		compressImage(chain.level(i), chain.width[i], chain.height[i], format, levels[i].data(), &pool);
+		levelPointers[i] = levels[i].data();
+		levelBytes[i] = levels[i].size();
+		pixels += (size_t)chain.width[i] * chain.height[i];
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	if (!writeKtx2(outputPath, format, image.width, image.height, levelCount, levelPointers, levelBytes)) {
+		std::cout << "ERROR::BENCHMARKS::CANNOT_WRITE " << outputPath << std::endl;
+		return 1;
+	}
+	std::cout << outputPath << ": " << blockFormatInfo(format).name << " " << image.width << "x" << image.height << ", "
+			  << levelCount << " levels, " << std::fixed << std::setprecision(1) << pixels / seconds / 1e6 << " Mpixels/s on "
+			  << pool.threadCount() << " threads, PSNR " << std::setprecision(2) << compressionPsnr(image, levels[0], format) << " dB"
+			  << std::defaultfloat << std::endl;
+	return 0;
+}
+
+int runTextureCompressionBenchmark(int argc, char** argv) {
+	std::vector<unsigned int> threadCounts = defaultThreadCounts();
+	double seconds = 0.5;
+	Image image;
+	for (int i = 0; i < argc; ++i) {
+		if (strcmp(argv[i], "--input") == 0 && i + 1 < argc) {
+			if (!loadImageFile(argv[++i], image)) {
+				return 1;
+			}
+		}
+		else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+			threadCounts = parseThreadCounts(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+			seconds = atof(argv[++i]);
+		}
+		else {
+			std::cout << "WARNING::BENCHMARKS::UNKNOWN_ARGUMENT " << argv[i] << std::endl;
+		}
+	}
+	if (image.rgba.empty()) {
+		image = makeCompressionTestImage(1024);
+	}
+	size_t pixels = (size_t)image.width * image.height;
+	std::cout << image.width << "x" << image.height << " image, PSNR over RGB (BC1, ETC2) or RGBA (BC3, BC7)" << std::endl;
+	std::cout << std::left << std::setw(8) << "format" << std::right << std::setw(10) << "threads" << std::setw(14) << "Mpixels/s"
+			  << std::setw(12) << "PSNR dB" << std::endl;
+	for (int f = 0; f < 4; ++f) {
+		BlockFormat format = (BlockFormat)f;
+		std::vector<unsigned char> blocks(compressedSize(format, image.width, image.height));
+		for (unsigned int threads : threadCounts) {
+			ThreadPool pool(threads);
+			double time = timeCalls([&] {
+				compressImage(image.rgba.data(), image.width, image.height, format, blocks.data(), &pool);
+			}, seconds);
+			std::cout << std::left << std::setw(8) << blockFormatInfo(format).name << std::right << std::setw(10) << threads
+					  << std::fixed << std::setprecision(1) << std::setw(14) << pixels / time / 1e6 << std::setprecision(2)
+					  << std::setw(12) << compressionPsnr(image, blocks, format) << std::defaultfloat << std::endl;
+		}
+	}
+	return 0;
+}
+
+// A scene of about the given size: the flower's shapes, a large mesh for half of the bytes and a field of
+// flowers for the rest
+std::string makeBenchScene(size_t bytes) {
+	std::mt19937 gen(1);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	std::string text = "# Generated by Benchmarks\n"
+					   "shader circle shaders/3.3.shader.txt shaders/3.3.shader_circle.txt\n"
+					   "shader triangle shaders/3.3.shader.txt shaders/3.3.shader_triangle.txt\n"
+					   "mesh circle circle 3 1\n0 0 0 1 1 1\n0 1 0 1 0 0\n1 0 0 0 1 0\n0 1 2\n"
+					   "mesh triangle triangle 3 1\n0 0 0 1 1 1\n0.5 1 0 1 0 0\n1 0.5 0 0 1 0\n0 1 2\n";
+	text.reserve(bytes + 256);
+	char line[160];
+	// About 60 bytes per vertex, 12 per triangle
+	uint32_t vertexCount = (uint32_t)(bytes / 2 / 72), triangleCount = vertexCount;
+	text += "mesh field circle " + std::to_string(vertexCount) + " " + std::to_string(triangleCount) + "\n";
+	for (uint32_t v = 0; v < vertexCount; ++v) {
+		int length = snprintf(line, sizeof(line), "%.6f %.6f %.6f %.5f %.5f %.5f\n", unit(gen), unit(gen), unit(gen),
+							  0.5f + 0.5f * unit(gen), 0.5f + 0.5f * unit(gen), 0.5f + 0.5f * unit(gen));
+		text.append(line, length);
+	}
+	for (uint32_t t = 0; t < triangleCount; ++t) {
+		int length = snprintf(line, sizeof(line), "%u %u %u\n", (unsigned int)(gen() % vertexCount), (unsigned int)(gen() % vertexCount),
+							  (unsigned int)(gen() % vertexCount));
+		text.append(line, length);
+	}
+	text += "animate sway 0.15 1\nanimate pulse 0.1 2\nanimate spin 1 0.5\n";
+	while (text.size() < bytes) {
+		int length = snprintf(line, sizeof(line), "flower %.6f %.6f 0 %.6f %.4f\n", unit(gen), unit(gen), 0.01f + 0.01f * unit(gen),
+							  3.0f * unit(gen));
+		text.append(line, length);
+	}
+	return text;
+}
+
+int runSceneLoad(int argc, char** argv) {
+	double megabytes = 100.0;
+	std::string path = "scene_benchmark.scene";
+	for (int i = 0; i < argc; ++i) {
+		if (strcmp(argv[i], "--megabytes") == 0 && i + 1 < argc) {
+			megabytes = atof(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+			path = argv[++i];
+		}
+		else {
+			std::cout << "WARNING::BENCHMARKS::UNKNOWN_ARGUMENT " << argv[i] << std::endl;
+		}
+	}
+	std::string cachePath = path + ".cache";
+	{
+		std::string text = makeBenchScene((size_t)(megabytes * 1024 * 1024));
+		std::ofstream file(path, std::ios::binary);
+		file.write(text.data(), (std::streamsize)text.size());
+		if (!file) {
+			std::cout << "ERROR::BENCHMARKS::SCENE_NOT_WRITTEN " << path << std::endl;
+			return 1;
+		}
+	}
+	remove(cachePath.c_str());
+	auto timeLoad = [&](bool& fromCache, SceneDescription& scene) {
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		bool loaded = loadSceneFile(path.c_str(), cachePath.c_str(), scene, &fromCache);
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		return loaded ? seconds : -1.0;
+	};
+	SceneDescription cold, warm;
+	bool coldFromCache, warmFromCache;
+	double coldTime = timeLoad(coldFromCache, cold);
+	double warmTime = timeLoad(warmFromCache, warm);
+	if (coldTime < 0.0 || warmTime < 0.0 || coldFromCache || !warmFromCache) {
+		std::cout << "ERROR::BENCHMARKS::SCENE_LOAD_FAILED " << path << std::endl;
+		return 1;
+	}
+	MappedFile source, cache;
+	source.open(path.c_str());
+	cache.open(cachePath.c_str());
+	std::cout << std::fixed << std::setprecision(1) << source.size() / 1048576.0 << " MB scene, " << cache.size() / 1048576.0
+			  << " MB cache: " << cold.meshes.size() << " meshes, " << cold.vertices.size() / FLOWER_VERTEX_FLOATS << " vertices, "
+			  << cold.flowers.size() << " flowers" << std::endl;
+	std::cout << std::left << std::setw(8) << "load" << std::right << std::setw(10) << "ms" << std::setw(12) << "MB/s" << std::endl;
+	std::cout << std::left << std::setw(8) << "cold" << std::right << std::setw(10) << coldTime * 1e3 << std::setw(12)
+			  << source.size() / coldTime / 1048576.0 << std::endl;
+	std::cout << std::left << std::setw(8) << "warm" << std::right << std::setw(10) << warmTime * 1e3 << std::setw(12)
+			  << source.size() / warmTime / 1048576.0 << std::defaultfloat << std::endl;
+	bool same = cold.vertices == warm.vertices && cold.indices == warm.indices && cold.strings == warm.strings &&
+				cold.flowers.size() == warm.flowers.size() && memcmp(cold.flowers.data(), warm.flowers.data(), cold.flowers.size() * sizeof(SceneFlower)) == 0;
+	if (!same) {
+		std::cout << "ERROR::BENCHMARKS::CACHE_DIFFERS_FROM_PARSE" << std::endl;
+		return 1;
+	}
+	return 0;
+}
+
+// Shader files as the Shader constructor reads them, the file size counts as the bytes processed
+void addShaderSourceBenchmarks(BenchmarkRegistry& registry, const std::string& directory) {
+	const char* files[] = { "3.3.shader.txt", "3.3.shader_circle.txt", "3.3.shader_triangle.txt" };
+	for (const char* file : files) {
+		std::string path = directory + "/" + file;
+		registry.add(std::string("BM_ShaderSourceLoad/") + file, [path](BenchmarkState& state) {
+			std::string code;
+			if (!readShaderSource(path.c_str(), code)) {
+				state.skipWithError("cannot read " + path);
+			}
+			while (state.keepRunning()) {
+				readShaderSource(path.c_str(), code);
+				doNotOptimize(code);
+			}
+			state.setBytesProcessed(state.maxIterations() * code.size());
+		});
+	}
+}
+
+// Vertex colors with std::uniform_real_distribution<> over std::mt19937, as main seeds them
+void addGeometryBenchmarks(BenchmarkRegistry& registry) {
+	registry.add("BM_FlowerGeometry", [](BenchmarkState& state) {
+		std::mt19937 gen(1);
+		std::uniform_real_distribution<> distr(0, 1);
+		FlowerGeometry geometry;
+		while (state.keepRunning()) {
+			generateFlowerGeometry(geometry, gen, distr);
+			doNotOptimize(geometry);
+		}
+		state.setBytesProcessed(state.maxIterations() * sizeof(geometry));
+	});
+
+	const unsigned int colorCounts[] = { 9, 65536 };
+	for (unsigned int count : colorCounts) {
+		registry.add("BM_RandomColorFill/" + std::to_string(count), [count](BenchmarkState& state) {
+			std::mt19937 gen(1);
+			std::uniform_real_distribution<> distr(0, 1);
+			std::vector<float> colors(3 * count);
+			while (state.keepRunning()) {
+				fillRandomColors(colors.data(), count, gen, distr);
+				clobberMemory();
+			}
+			state.setBytesProcessed(state.maxIterations() * colors.size() * sizeof(float));
+			state.setItemsProcessed(state.maxIterations() * count);
+		});
+	}
+}
+
+// Vertex colors of a large interleaved buffer: the mt19937 path main uses against BatchRandom,
+// bytes are the color floats written
+void addRandomBenchmarks(BenchmarkRegistry& registry) {
+	const unsigned int count = 1 << 20;
+	const uint64_t bytes = (uint64_t)count * 3 * sizeof(float);
+	registry.add("BM_Mt19937Colors/" + std::to_string(count), [count, bytes](BenchmarkState& state) {
+		std::mt19937 gen(1);
+		std::uniform_real_distribution<> distr(0, 1);
+		std::vector<float> vertices(FLOWER_VERTEX_FLOATS * count);
+		while (state.keepRunning()) {
+			for (unsigned int v = 0; v < count; ++v) {
+				float* color = vertices.data() + FLOWER_VERTEX_FLOATS * v + 3;
+				color[0] = (float)distr(gen);
+				color[1] = (float)distr(gen);
+				color[2] = (float)distr(gen);
+			}
+			clobberMemory();
+		}
+		state.setBytesProcessed(state.maxIterations() * bytes);
+	});
+	registry.add("BM_BatchRandomColors/" + std::to_string(count), [count, bytes](BenchmarkState& state) {
+		BatchRandom random(1);
+		std::vector<float> vertices(FLOWER_VERTEX_FLOATS * count);
+		while (state.keepRunning()) {
+			random.fillAttribute(vertices.data() + 3, count, 3, FLOWER_VERTEX_FLOATS);
+			clobberMemory();
+		}
+		state.setBytesProcessed(state.maxIterations() * bytes);
+	});
+	registry.add("BM_BatchRandomColorsParallel/" + std::to_string(count), [count, bytes](BenchmarkState& state) {
+		ThreadPool pool;
+		BatchRandom random(1);
+		std::vector<float> vertices(FLOWER_VERTEX_FLOATS * count);
+		while (state.keepRunning()) {
+			fillAttributeParallel(pool, random, vertices.data() + 3, count, 3, FLOWER_VERTEX_FLOATS);
+			clobberMemory();
+		}
+		state.setBytesProcessed(state.maxIterations() * bytes);
+	});
+	registry.add("BM_BatchRandomFill/" + std::to_string(count), [count, bytes](BenchmarkState& state) {
+		BatchRandom random(1);
+		std::vector<float> colors(3 * count);
+		while (state.keepRunning()) {
+			random.fill(colors.data(), colors.size());
+			clobberMemory();
+		}
+		state.setBytesProcessed(state.maxIterations() * bytes);
+	});
+}
+
+// Position and color arrays into the interleaved VBO layout, bytes are the interleaved output
+void addInterleaveBenchmarks(BenchmarkRegistry& registry) {
+	const unsigned int vertexCounts[] = { 9, 1 << 20 };
+	for (unsigned int count : vertexCounts) {
+		registry.add("BM_InterleaveVertices/" + std::to_string(count), [count](BenchmarkState& state) {
+			std::vector<float> positions(3 * count, 0.5f), colors(3 * count, 0.25f), vertices(FLOWER_VERTEX_FLOATS * count);
+			while (state.keepRunning()) {
+				interleaveVertices(positions.data(), colors.data(), count, vertices.data());
+				clobberMemory();
+			}
+			state.setBytesProcessed(state.maxIterations() * vertices.size() * sizeof(float));
+			state.setItemsProcessed(state.maxIterations() * count);
+		});
+	}
+}
+
+void addIndexBenchmarks(BenchmarkRegistry& registry) {
+	const unsigned int counts[] = { 8, 65536 };
+	for (unsigned int count : counts) {
+		registry.add("BM_FanIndices/" + std::to_string(count), [count](BenchmarkState& state) {
+			std::vector<unsigned int> indices(3 * count);
+			while (state.keepRunning()) {
+				generateFanIndices(count, indices.data());
+				clobberMemory();
+			}
+			state.setBytesProcessed(state.maxIterations() * indices.size() * sizeof(unsigned int));
+			state.setItemsProcessed(state.maxIterations() * count);
+		});
+		registry.add("BM_PetalIndices/" + std::to_string(count / 2), [count](BenchmarkState& state) {
+			std::vector<unsigned int> indices(3 * (count / 2));
+			while (state.keepRunning()) {
+				generatePetalIndices(count / 2, indices.data());
+				clobberMemory();
+			}
+			state.setBytesProcessed(state.maxIterations() * indices.size() * sizeof(unsigned int));
+			state.setItemsProcessed(state.maxIterations() * (count / 2));
+		});
+	}
+}
+
+// A camera and instance transform for the batch kernels, points spread around the origin
+Mat4 makeTransformBenchmarkMatrix() {
+	return Mat4::perspective(1.0f, 16.0f / 9.0f, 0.1f, 100.0f) * Mat4::lookAt(Vec3(0.0f, 2.0f, 8.0f), Vec3(0.0f, 0.0f, 0.0f), Vec3(0.0f, 1.0f, 0.0f)) *
+		   Mat4::compose(Vec3(0.5f, 0.0f, -1.0f), Quat::axisAngle(Vec3(0.0f, 1.0f, 0.0f), 0.6f), Vec3(1.0f, 2.0f, 1.0f));
+}
+
+// Points to clip space: the kernels against a plain row-by-column loop, bytes are 12 in and 16 out per point.
+// Each kernel checks its result against the loop before it is timed.
+void addTransformBenchmarks(BenchmarkRegistry& registry, size_t count) {
+	const uint64_t bytes = count * (3 + 4) * sizeof(float);
+	struct Points {
+		std::vector<float> aos, x, y, z;
+		Points(size_t count) : aos(3 * count), x(count), y(count), z(count) {
+			BatchRandom random(1);
+			random.fill(aos.data(), aos.size());
+			for (size_t i = 0; i < count; ++i) {
+				x[i] = aos[3 * i] = aos[3 * i] * 10.0f - 5.0f;
+				y[i] = aos[3 * i + 1] = aos[3 * i + 1] * 10.0f - 5.0f;
+				z[i] = aos[3 * i + 2] = aos[3 * i + 2] * 10.0f - 5.0f;
+			}
+		}
+	};
+	// Element (r, c) of the matrix, the way a first version would write it
+	auto naive = [](const Mat4& m, const float* points, size_t count, float* out) {
+		for (size_t i = 0; i < count; ++i) {
+			const float p[4] = { points[3 * i], points[3 * i + 1], points[3 * i + 2], 1.0f };
+			for (int r = 0; r < 4; ++r) {
+				float sum = 0.0f;
+				for (int c = 0; c < 4; ++c) {
+					sum += m.at(r, c) * p[c];
+				}
+				out[4 * i + r] = sum;
+			}
+		}
+	};
+	auto maxError = [](const std::vector<float>& expected, const float* actual, size_t stride, int component) {
+		float error = 0.0f;
+		for (size_t i = 0; i < expected.size() / 4; ++i) {
+			error = std::max(error, std::fabs(expected[4 * i + component] - actual[i * stride]));
+		}
+		return error;
+	};
+
+	registry.add("BM_TransformNaive/" + std::to_string(count), [=](BenchmarkState& state) {
+		Points points(count);
+		Mat4 m = makeTransformBenchmarkMatrix();
+		std::vector<float> out(4 * count);
+		while (state.keepRunning()) {
+			naive(m, points.aos.data(), count, out.data());
+			clobberMemory();
+		}
+		state.setBytesProcessed(state.maxIterations() * bytes);
+		state.setItemsProcessed(state.maxIterations() * count);
+	});
+	registry.add("BM_TransformAoS/" + std::to_string(count), [=](BenchmarkState& state) {
+		Points points(count);
+		Mat4 m = makeTransformBenchmarkMatrix();
+		std::vector<float> expected(4 * count);
+		std::vector<Vec4> out(count);
+		naive(m, points.aos.data(), count, expected.data());
+		transformPointsAoS(m, points.aos.data(), 3, count, out.data());
+		for (int c = 0; c < 4; ++c) {
+			if (maxError(expected, &out[0].x + c, 4, c) > 1e-4f) {
+				state.skipWithError("AoS kernel differs from the naive loop");
+			}
+		}
+		while (state.keepRunning()) {
+			transformPointsAoS(m, points.aos.data(), 3, count, out.data());
+			clobberMemory();
+		}
+		state.setBytesProcessed(state.maxIterations() * bytes);
+		state.setItemsProcessed(state.maxIterations() * count);
+	});
+	registry.add("BM_TransformSoA/" + std::to_string(count), [=](BenchmarkState& state) {
+		Points points(count);
+		Mat4 m = makeTransformBenchmarkMatrix();
+		std::vector<float> expected(4 * count);
+		std::vector<std::vector<float> > out(4, std::vector<float>(count));
+		naive(m, points.aos.data(), count, expected.data());
+		transformPointsSoA(m, points.x.data(), points.y.data(), points.z.data(), count, out[0].data(), out[1].data(), out[2].data(), out[3].data());
+		for (int c = 0; c < 4; ++c) {
+			if (maxError(expected, out[c].data(), 1, c) > 1e-4f) {
+				state.skipWithError("SoA kernel differs from the naive loop");
+			}
+		}
+		while (state.keepRunning()) {
+			transformPointsSoA(m, points.x.data(), points.y.data(), points.z.data(), count, out[0].data(), out[1].data(), out[2].data(), out[3].data());
+			clobberMemory();
+		}
+		state.setBytesProcessed(state.maxIterations() * bytes);
+		state.setItemsProcessed(state.maxIterations() * count);
+	});
+}
+
+void addMatrixBenchmarks(BenchmarkRegistry& registry) {
+	registry.add("BM_Mat4Multiply", [](BenchmarkState& state) {
+		Mat4 a = makeTransformBenchmarkMatrix(), b = Mat4::rotation(Quat::axisAngle(Vec3(1.0f, 0.0f, 0.0f), 0.01f));
+		while (state.keepRunning()) {
+			a = a * b;
+			doNotOptimize(a);
+		}
+		state.setItemsProcessed(state.maxIterations());
+	});
+}
+
+// GPU buffer sub-allocation bookkeeping (GpuBufferAllocator's pages) on a 64 MB range: a set of
+// 1024 live allocations of 256 B to 64 KB where every iteration replaces one of them, optionally
+// followed by one compaction step as the per-frame defragmentation does
+void addTlsfBenchmarks(BenchmarkRegistry& registry) {
+	for (int compact = 0; compact < 2; ++compact) {
+		registry.add(compact ? "BM_TlsfChurnCompact" : "BM_TlsfChurn", [compact](BenchmarkState& state) {
+			const unsigned int LIVE = 1024, SIZES = 4096;
+			TlsfAllocator ranges(64 << 20, 256);
+			std::mt19937 gen(1);
+			std::vector<uint64_t> sizes(SIZES);
+			for (uint64_t& size : sizes) {
+				size = 256 + gen() % (64 * 1024);
+			}
+			std::vector<uint32_t> live(LIVE);
+			for (unsigned int i = 0; i < LIVE; ++i) {
+				live[i] = ranges.allocate(sizes[i]);
+			}
+			unsigned int next = 0;
+			TlsfAllocator::Move move;
+			while (state.keepRunning()) {
+				uint32_t& slot = live[gen() % LIVE];
+				ranges.free(slot);
+				slot = ranges.allocate(sizes[next++ % SIZES]);
+				if (compact) {
+					ranges.compactStep(move);
+				}
+				doNotOptimize(slot);
+			}
+			if (std::find(live.begin(), live.end(), TlsfAllocator::INVALID) != live.end()) {
+				state.skipWithError("allocation failed");
+			}
+			state.setItemsProcessed(state.maxIterations());
+		});
+	}
+}
+
+// Texture worker work: decoding an in-memory PPM and the mip chain box filter against a plain loop,
+// bytes are the source RGBA pixels
+void addTextureBenchmarks(BenchmarkRegistry& registry) {
+	const int SIZE = 2048;
+	const uint64_t bytes = (uint64_t)SIZE * SIZE * 4;
+	registry.add("BM_DecodePpm/" + std::to_string(SIZE), [=](BenchmarkState& state) {
+		std::string header = "P6\n" + std::to_string(SIZE) + " " + std::to_string(SIZE) + "\n255\n";
+		std::vector<unsigned char> file(header.begin(), header.end());
+		file.resize(header.size() + (size_t)SIZE * SIZE * 3, 128);
+		Image image;
+		while (state.keepRunning()) {
+			const char* error = nullptr;
+			if (!decodeImage(file.data(), file.size(), image, error)) {
+				state.skipWithError(error);
+			}
+			doNotOptimize(image.rgba.data());
+		}
+		state.setBytesProcessed(state.maxIterations() * bytes);
+	});
+	// Random pixels, so every channel sum and rounding case shows up in the comparison
+	auto makeImage = [SIZE]() {
+		Image image;
+		image.width = image.height = SIZE;
+		image.rgba.resize((size_t)SIZE * SIZE * 4);
+		std::mt19937 gen(1);
+		for (unsigned char& value : image.rgba) {
+			value = (unsigned char)gen();
+		}
+		return image;
+	};
+	registry.add("BM_DownsampleBoxNaive/" + std::to_string(SIZE), [=](BenchmarkState& state) {
+		Image image = makeImage();
+		std::vector<unsigned char> half((size_t)SIZE * SIZE);
+		const int outSize = SIZE / 2;
+		while (state.keepRunning()) {
+			for (int y = 0; y < outSize; ++y) {
+				for (int x = 0; x < outSize; ++x) {
+					for (int c = 0; c < 4; ++c) {
+						const unsigned char* p = image.rgba.data() + ((size_t)(2 * y) * SIZE + 2 * x) * 4 + c;
+						half[((size_t)y * outSize + x) * 4 + c] = (unsigned char)((p[0] + p[4] + p[SIZE * 4] + p[SIZE * 4 + 4] + 2) >> 2);
+					}
+				}
+			}
+			clobberMemory();
+		}
+		state.setBytesProcessed(state.maxIterations() * bytes);
+	});
+	registry.add("BM_DownsampleBox/" + std::to_string(SIZE), [=](BenchmarkState& state) {
+		Image image = makeImage();
+		std::vector<unsigned char> half((size_t)SIZE * SIZE), expected((size_t)SIZE * SIZE);
+		const int outSize = SIZE / 2;
+		for (int y = 0; y < outSize; ++y) {
+			for (int x = 0; x < outSize * 4; ++x) {
+				const unsigned char* p = image.rgba.data() + (size_t)(2 * y) * SIZE * 4 + (x / 4) * 8 + x % 4;
+				expected[(size_t)y * outSize * 4 + x] = (unsigned char)((p[0] + p[4] + p[SIZE * 4] + p[SIZE * 4 + 4] + 2) >> 2);
+			}
+		}
+		while (state.keepRunning()) {
+			downsampleBox(image.rgba.data(), SIZE, SIZE, half.data());
+			clobberMemory();
+		}
+		if (!std::equal(half.begin(), half.begin() + (size_t)outSize * outSize * 4, expected.begin())) {
+			state.skipWithError("differs from the plain loop");
+		}
+		state.setBytesProcessed(state.maxIterations() * bytes);
+	});
+	registry.add("BM_BuildMipChain/" + std::to_string(SIZE), [=](BenchmarkState& state) {
+		Image image = makeImage();
+		MipChain chain;
+		while (state.keepRunning()) {
+			buildMipChain(image, chain);
+			doNotOptimize(chain.pixels.data());
+		}
+		state.setBytesProcessed(state.maxIterations() * bytes);
+	});
+}
+
+// The offline compressor on one thread, bytes are the source RGBA pixels
+void addTextureCompressionBenchmarks(BenchmarkRegistry& registry) {
+	const int SIZE = 256;
+	const char* names[] = { "BC1", "BC3", "BC7", "ETC2" };
+	for (int f = 0; f < 4; ++f) {
+		BlockFormat format = (BlockFormat)f;
+		registry.add(std::string("BM_Compress") + names[f] + "/" + std::to_string(SIZE), [=](BenchmarkState& state) {
+			Image image = makeCompressionTestImage(SIZE);
+			std::vector<unsigned char> blocks(compressedSize(format, SIZE, SIZE));
+			while (state.keepRunning()) {
+				compressImage(image.rgba.data(), SIZE, SIZE, format, blocks.data());
+				clobberMemory();
+			}
+			state.setBytesProcessed(state.maxIterations() * image.rgba.size());
+		});
+	}
+}
+
+// The sprite batcher's CPU side: writing 100k quads into draw-call sized vertex ranges, a new range when one is
+// full or the texture changes. Items are quads, items_per_second / 1000 is quads per millisecond.
+void addSpriteBenchmarks(BenchmarkRegistry& registry) {
+	const unsigned int QUADS = 100000, QUADS_PER_DRAW = 16384;
+	registry.add("BM_SpriteQuads/" + std::to_string(QUADS), [=](BenchmarkState& state) {
+		struct Quad {
+			float x, y, size;
+			uint32_t color;
+			int texture;
+		};
+		std::vector<Quad> quads(QUADS);
+		std::mt19937 gen(1);
+		std::uniform_real_distribution<float> distr(0.0f, 1.0f);
+		for (unsigned int i = 0; i < QUADS; ++i) {
+			quads[i] = { distr(gen) * 800.0f, distr(gen) * 600.0f, 2.0f + distr(gen) * 14.0f,
+						 packSpriteColor(distr(gen), distr(gen), distr(gen), 0.8f), i < QUADS / 2 ? 0 : 1 };
+		}
+		std::vector<SpriteVertex> range(QUADS_PER_DRAW * 4);
+		while (state.keepRunning()) {
+			unsigned int pending = 0, draws = 0;
+			int texture = quads[0].texture;
+			for (const Quad& quad : quads) {
+				if (quad.texture != texture || pending == QUADS_PER_DRAW) {
+					texture = quad.texture;
+					pending = 0;
+					++draws;
+				}
+				writeSpriteQuad(range.data() + 4 * pending, quad.x, quad.y, quad.size, quad.size, quad.color, 0.0f, 0.0f, 1.0f, 1.0f);
+				++pending;
+			}
+			doNotOptimize(draws);
+			clobberMemory();
+		}
+		state.setItemsProcessed(state.maxIterations() * QUADS);
+	});
+}
+
+// World matrix update of a 1M node hierarchy (8 children per node, 7 levels) with 1% of the nodes
+// moved per frame and with all of them moved, on one thread and on the pool. Items are nodes.
+void addSceneGraphBenchmarks(BenchmarkRegistry& registry) {
+	const uint32_t NODES = 1 << 20, CHILDREN = 8;
+	const unsigned int dirtyPercents[] = { 1, 100 };
+	for (unsigned int percent : dirtyPercents) {
+		for (int parallel = 0; parallel < 2; ++parallel) {
+			std::string name = std::string(parallel ? "BM_SceneGraphUpdateParallel/" : "BM_SceneGraphUpdate/") +
+				std::to_string(NODES) + "/dirty" + std::to_string(percent);
+			registry.add(name, [=](BenchmarkState& state) {
+				SceneGraph graph;
+				graph.reserve(NODES);
+				graph.create();
+				for (uint32_t i = 1; i < NODES; ++i) {
+					graph.create((i - 1) / CHILDREN, Vec3(0.1f, 0.0f, 0.0f), Quat::axisAngle(Vec3(0.0f, 0.0f, 1.0f), 0.01f * (float)(i % 97)));
+				}
+				std::unique_ptr<ThreadPool> pool(parallel ? new ThreadPool() : nullptr);
+				graph.update(pool.get());
+				std::vector<SceneGraph::NodeId> moved;
+				std::mt19937 gen(1);
+				std::uniform_int_distribution<uint32_t> node(0, NODES - 1);
+				for (uint32_t i = 0; i < NODES / 100 * percent && percent < 100; ++i) {
+					moved.push_back(node(gen));
+				}
+				float angle = 0.0f;
+				while (state.keepRunning()) {
+					angle += 0.001f;
+					Quat rotation = Quat::axisAngle(Vec3(0.0f, 0.0f, 1.0f), angle);
+					if (percent == 100) {
+						graph.setRotation(0, rotation);
+					}
+					for (SceneGraph::NodeId id : moved) {
+						graph.setRotation(id, rotation);
+					}
+					graph.update(pool.get());
+					doNotOptimize(graph.lastUpdatedCount());
+					clobberMemory();
+				}
+				state.setItemsProcessed(state.maxIterations() * NODES);
+			});
+		}
+	}
+}
+
+// Entities with transform, animation, mesh and material data. Integrating positions streams 36 bytes
+// per entity (position read and written, velocity read). Two plain arrays are the bound the chunks should
+// come close to, the AoS version drags every entity's whole struct through the cache for the same work.
+struct BenchPosition {
+	Vec3 value;
+};
+struct BenchVelocity {
+	Vec3 value;
+};
+struct BenchRotation {
+	Quat value;
+};
+struct BenchSpin {
+	float radiansPerSecond;
+};
+struct BenchWorld {
+	Mat4 value;
+};
+struct BenchMesh {
+	uint32_t vertexArray, indexCount;
+};
+struct BenchMaterial {
+	uint32_t program, texture;
+};
+
+void addEcsBenchmarks(BenchmarkRegistry& registry) {
+	const size_t COUNT = 1 << 20;
+	const uint64_t INTEGRATE_BYTES = 3 * sizeof(Vec3);
+	const float DT = 1.0f / 60.0f;
+	auto populate = [](World& world) {
+		for (size_t i = 0; i < COUNT; ++i) {
+			float f = (float)i;
+			world.create(BenchPosition{ Vec3(f, 0.0f, 0.0f) }, BenchVelocity{ Vec3(0.0f, 1.0f, 0.0f) }, BenchRotation{ Quat() },
+						 BenchSpin{ 0.001f * (float)(i % 1000) }, BenchWorld{ Mat4() }, BenchMesh{ 1, 36 }, BenchMaterial{ 1, 0 });
+		}
+	};
+	auto integrate = [DT](size_t count, BenchPosition* positions, BenchVelocity* velocities) {
+		for (size_t i = 0; i < count; ++i) {
+			positions[i].value = positions[i].value + velocities[i].value * DT;
+		}
+	};
+	const std::string suffix = "/" + std::to_string(COUNT);
+	registry.add("BM_EcsIntegrate" + suffix, [=](BenchmarkState& state) {
+		World world;
+		populate(world);
+		while (state.keepRunning()) {
+			world.each<BenchPosition, BenchVelocity>(integrate);
+			clobberMemory();
+		}
+		state.setBytesProcessed(state.maxIterations() * COUNT * INTEGRATE_BYTES);
+	});
+	registry.add("BM_EcsIntegrateParallel" + suffix, [=](BenchmarkState& state) {
+		World world;
+		populate(world);
+		ThreadPool pool;
+		std::vector<ChunkView> chunks;
+		while (state.keepRunning()) {
+			world.parallelEach<BenchPosition, BenchVelocity>(pool, chunks, integrate);
+			clobberMemory();
+		}
+		state.setBytesProcessed(state.maxIterations() * COUNT * INTEGRATE_BYTES);
+	});
+	registry.add("BM_AosIntegrate" + suffix, [=](BenchmarkState& state) {
+		struct Renderable {
+			BenchPosition position;
+			BenchVelocity velocity;
+			BenchRotation rotation;
+			BenchSpin spin;
+			BenchWorld world;
+			BenchMesh mesh;
+			BenchMaterial material;
+		};
+		std::vector<Renderable> renderables(COUNT);
+		while (state.keepRunning()) {
+			for (Renderable& renderable : renderables) {
+				renderable.position.value = renderable.position.value + renderable.velocity.value * DT;
+			}
+			clobberMemory();
+		}
+		state.setBytesProcessed(state.maxIterations() * COUNT * INTEGRATE_BYTES);
+	});
+	registry.add("BM_ArraysIntegrate" + suffix, [=](BenchmarkState& state) {
+		std::vector<BenchPosition> positions(COUNT);
+		std::vector<BenchVelocity> velocities(COUNT, BenchVelocity{ Vec3(0.0f, 1.0f, 0.0f) });
+		while (state.keepRunning()) {
+			integrate(COUNT, positions.data(), velocities.data());
+			clobberMemory();
+		}
+		state.setBytesProcessed(state.maxIterations() * COUNT * INTEGRATE_BYTES);
+	});
+	// Integration and spin share a stage, the world matrices wait for both; items are entities
+	registry.add("BM_EcsSystemsParallel" + suffix, [=](BenchmarkState& state) {
+		World world;
+		populate(world);
+		ThreadPool pool;
+		SystemScheduler systems;
+		systems.add("integrate", ecs::componentMask<BenchVelocity>(), ecs::componentMask<BenchPosition>(), [=](const ChunkView& chunk) {
+			integrate(chunk.size(), chunk.get<BenchPosition>(), chunk.get<BenchVelocity>());
+		});
+		systems.add("spin", ecs::componentMask<BenchSpin>(), ecs::componentMask<BenchRotation>(), [DT](const ChunkView& chunk) {
+			BenchRotation* rotations = chunk.get<BenchRotation>();
+			const BenchSpin* spins = chunk.get<BenchSpin>();
+			for (uint32_t i = 0; i < chunk.size(); ++i) {
+				rotations[i].value = Quat::axisAngle(Vec3(0.0f, 0.0f, 1.0f), spins[i].radiansPerSecond * DT) * rotations[i].value;
+			}
+		});
+		systems.add("world", ecs::componentMask<BenchPosition, BenchRotation>(), ecs::componentMask<BenchWorld>(), [](const ChunkView& chunk) {
+			const BenchPosition* positions = chunk.get<BenchPosition>();
+			const BenchRotation* rotations = chunk.get<BenchRotation>();
+			BenchWorld* worlds = chunk.get<BenchWorld>();
+			for (uint32_t i = 0; i < chunk.size(); ++i) {
+				worlds[i].value = Mat4::compose(positions[i].value, rotations[i].value, Vec3(1.0f, 1.0f, 1.0f));
+			}
+		});
+		while (state.keepRunning()) {
+			systems.run(world, &pool);
+			clobberMemory();
+		}
+		state.setItemsProcessed(state.maxIterations() * COUNT);
+	});
+}
+
+// The render loop's uniform work for both shapes: the gradient and the std::string the
+// setFloat3("colorGradient", ...) call constructs for its const std::string& parameter
+// Small random boxes filling a cube (or a square for the 2D views). The camera looks into the cube from
+// its middle, so about a sixth of the instances are visible and the frustum cuts through many subtrees.
+std::vector<Aabb> makeBenchBoxes(uint32_t count, bool flat, uint32_t seed) {
+	std::mt19937 gen(seed);
+	std::uniform_real_distribution<float> position(-100.0f, 100.0f), size(0.05f, 0.5f);
+	std::vector<Aabb> boxes(count);
+	for (Aabb& box : boxes) {
+		Vec3 center(position(gen), position(gen), flat ? 0.0f : position(gen));
+		Vec3 extent(size(gen), size(gen), flat ? 0.0f : size(gen));
+		box = { center - extent, center + extent };
+	}
+	return boxes;
+}
+
+void addBvhBenchmarks(BenchmarkRegistry& registry) {
+	const uint32_t INSTANCES = 1 << 20;
+	for (int view = 0; view < 2; ++view) {
+		for (int parallel = 0; parallel < 2; ++parallel) {
+			std::string name = std::string(view ? "BM_BvhCullRect" : "BM_BvhCullFrustum") + (parallel ? "Parallel/" : "/") +
+				std::to_string(INSTANCES);
+			registry.add(name, [=](BenchmarkState& state) {
+				std::vector<Aabb> boxes = makeBenchBoxes(INSTANCES, view == 1, 1);
+				InstanceBvh bvh;
+				bvh.build(boxes.data(), INSTANCES);
+				std::unique_ptr<ThreadPool> pool(parallel ? new ThreadPool() : nullptr);
+				CullVolume volume = view ? CullVolume::rectangle(-30.0f, -40.0f, 50.0f, 10.0f)
+					: CullVolume::frustum(Mat4::perspective(1.0f, 16.0f / 9.0f, 0.1f, 300.0f) *
+										  Mat4::lookAt(Vec3(), Vec3(0.3f, 0.2f, -1.0f), Vec3(0.0f, 1.0f, 0.0f)));
+				std::vector<uint32_t> visible(INSTANCES);
+				uint32_t count = 0;
+				while (state.keepRunning()) {
+					count = bvh.cull(volume, visible.data(), pool.get());
+					doNotOptimize(count);
+					clobberMemory();
+				}
+				state.setItemsProcessed(state.maxIterations() * INSTANCES);
+			});
+		}
+	}
+	// Every box moves a little each frame, then the tree is refit with the default rebuild budget.
+	// The parallel runs skip with an error if the refit tree then culls differently from testing every box.
+	const uint32_t refitCounts[] = { 100000, INSTANCES };
+	for (uint32_t count : refitCounts) {
+		for (int parallel = 0; parallel < 2; ++parallel) {
+			registry.add(std::string(parallel ? "BM_BvhRefitParallel/" : "BM_BvhRefit/") + std::to_string(count), [=](BenchmarkState& state) {
+				std::vector<Aabb> boxes = makeBenchBoxes(count, false, 1);
+				std::vector<Vec3> velocities(count);
+				std::mt19937 gen(2);
+				std::uniform_real_distribution<float> speed(-0.2f, 0.2f);
+				for (Vec3& velocity : velocities) {
+					velocity = Vec3(speed(gen), speed(gen), speed(gen));
+				}
+				InstanceBvh bvh;
+				bvh.build(boxes.data(), count);
+				std::unique_ptr<ThreadPool> pool(parallel ? new ThreadPool() : nullptr);
+				while (state.keepRunning()) {
+					for (uint32_t i = 0; i < count; ++i) {
+						boxes[i].min = boxes[i].min + velocities[i];
+						boxes[i].max = boxes[i].max + velocities[i];
+					}
+					bvh.refit(boxes.data(), InstanceBvh::DEFAULT_REBUILD_BUDGET, pool.get());
+					doNotOptimize(bvh.lastRebuiltCount());
+					clobberMemory();
+				}
+				state.setItemsProcessed(state.maxIterations() * count);
+				if (parallel) {
+					// After a large move refit without rebuilding, stale bounds anywhere in the tree would cull
+					// whole subtrees wrongly. The reference tests every box, summing like the tree's classify().
+					for (Aabb& box : boxes) {
+						box = { box.min + Vec3(60.0f, 0.0f, 0.0f), box.max + Vec3(60.0f, 0.0f, 0.0f) };
+					}
+					bvh.refit(boxes.data(), 0, pool.get());
+					CullVolume volume = CullVolume::frustum(Mat4::perspective(1.0f, 16.0f / 9.0f, 0.1f, 300.0f) *
+															Mat4::lookAt(Vec3(), Vec3(0.3f, 0.2f, -1.0f), Vec3(0.0f, 1.0f, 0.0f)));
+					std::vector<uint32_t> visible(count), expected;
+					visible.resize(bvh.cull(volume, visible.data(), pool.get()));
+					std::sort(visible.begin(), visible.end());
+					for (uint32_t i = 0; i < count; ++i) {
+						const Aabb& box = boxes[i];
+						bool in = true;
+						for (int p = 0; p < volume.planeCount && in; ++p) {
+							const Vec4& plane = volume.planes[p];
+							in = plane.x * (plane.x >= 0.0f ? box.max.x : box.min.x) + plane.y * (plane.y >= 0.0f ? box.max.y : box.min.y) +
+								(plane.z * (plane.z >= 0.0f ? box.max.z : box.min.z) + plane.w) >= 0.0f;
+						}
+						if (in) {
+							expected.push_back(i);
+						}
+					}
+					if (visible != expected) {
+						state.skipWithError("refit tree culls differently from testing every box");
+					}
+				}
+			});
+		}
+	}
+	// The brute force the tree competes with: every box against every plane
+	registry.add("BM_LinearCullFrustum/" + std::to_string(INSTANCES), [=](BenchmarkState& state) {
+		std::vector<Aabb> boxes = makeBenchBoxes(INSTANCES, false, 1);
+		CullVolume volume = CullVolume::frustum(Mat4::perspective(1.0f, 16.0f / 9.0f, 0.1f, 300.0f) *
+												Mat4::lookAt(Vec3(), Vec3(0.3f, 0.2f, -1.0f), Vec3(0.0f, 1.0f, 0.0f)));
+		std::vector<uint32_t> visible(INSTANCES);
+		uint32_t count = 0;
+		while (state.keepRunning()) {
+			count = 0;
+			for (uint32_t i = 0; i < INSTANCES; ++i) {
+				const Aabb& box = boxes[i];
+				bool in = true;
+				for (int p = 0; p < volume.planeCount && in; ++p) {
+					const Vec4& plane = volume.planes[p];
+					in = plane.x * (plane.x >= 0.0f ? box.max.x : box.min.x) + plane.y * (plane.y >= 0.0f ? box.max.y : box.min.y) +
+						plane.z * (plane.z >= 0.0f ? box.max.z : box.min.z) + plane.w >= 0.0f;
+				}
+				visible[count] = i;
+				count += in;
+			}
+			doNotOptimize(count);
+			clobberMemory();
+		}
+		state.setItemsProcessed(state.maxIterations() * INSTANCES);
+	});
+}
+
+// The per-frame level pick for a field of circles between 1 px and full screen
+void addCircleLodBenchmarks(BenchmarkRegistry& registry) {
+	const uint32_t CIRCLES = 1 << 20;
+	registry.add("BM_CircleLodSelect/" + std::to_string(CIRCLES), [=](BenchmarkState& state) {
+		std::mt19937 gen(1);
+		std::uniform_real_distribution<float> scale(-9.0f, 0.0f);
+		std::vector<Mat4> models(CIRCLES);
+		for (Mat4& model : models) {
+			model = Mat4::compose(Vec3(), Quat(), Vec3(1.0f, 1.0f, 1.0f) * std::exp2(scale(gen)));
+		}
+		std::vector<int> levels(CIRCLES, 0);
+		CircleLodSelector selector(0.5f);
+		uint64_t triangles = 0;
+		while (state.keepRunning()) {
+			triangles = 0;
+			for (uint32_t i = 0; i < CIRCLES; ++i) {
+				levels[i] = selector.select(projectedCircleRadius(models[i], 300.0f, 300.0f), levels[i]);
+				triangles += CircleLodMeshes::segments(levels[i]);
+			}
+			doNotOptimize(triangles);
+			clobberMemory();
+		}
+		state.setItemsProcessed(state.maxIterations() * CIRCLES);
+	});
+}
+
+// The stats HUD: building the font atlas at startup, and a frame's text formatted and laid out
+void addHudBenchmarks(BenchmarkRegistry& registry) {
+	registry.add("BM_SdfFontAtlas", [](BenchmarkState& state) {
+		SdfFontAtlas atlas;
+		while (state.keepRunning()) {
+			buildSdfFontAtlas(atlas);
+			doNotOptimize(atlas.texels.data());
+			clobberMemory();
+		}
+		state.setBytesProcessed(state.maxIterations() * (uint64_t)atlas.texels.size());
+	});
+	registry.add("BM_HudLayout", [](BenchmarkState& state) {
+		SdfFontAtlas atlas;
+		buildSdfFontAtlas(atlas);
+		std::vector<SpriteVertex> vertices(4 * 256);
+		double frameMs = 16.6;
+		unsigned int draws = 1024, quads = 0;
+		while (state.keepRunning()) {
+			char line[96];
+			quads = 0;
+			snprintf(line, sizeof(line), "FRAME %.2f MS  CPU %.2f MS", frameMs, frameMs * 0.5);
+			quads += layoutSdfText(vertices.data() + 4 * quads, 256 - quads, atlas, 8.0f, 592.0f, 14.0f, 0xffffffffu, line);
+			snprintf(line, sizeof(line), "DRAWS %u  UNIFORMS %u", draws, draws + 2);
+			quads += layoutSdfText(vertices.data() + 4 * quads, 256 - quads, atlas, 8.0f, 574.0f, 14.0f, 0xffffffffu, line);
+			snprintf(line, sizeof(line), "GPU MEMORY %.1f / %.1f KB", 1234.5, 4096.0);
+			quads += layoutSdfText(vertices.data() + 4 * quads, 256 - quads, atlas, 8.0f, 556.0f, 14.0f, 0xffffffffu, line);
+			frameMs += 0.01;
+			doNotOptimize(vertices.data());
+			clobberMemory();
+		}
+		state.setItemsProcessed(state.maxIterations() * quads);
+	});
+}
+
+// Scene loading of a 4 MB scene in memory: the tokenizing parser, and the hash that keys its cache
+void addSceneFileBenchmarks(BenchmarkRegistry& registry) {
+	std::shared_ptr<std::string> text = std::make_shared<std::string>(makeBenchScene(4 << 20));
+	registry.add("BM_SceneParse", [text](BenchmarkState& state) {
+		SceneDescription scene;
+		std::string error;
+		while (state.keepRunning()) {
+			if (!parseSceneText(text->data(), text->size(), scene, error)) {
+				state.skipWithError(error);
+			}
+			doNotOptimize(scene.vertices.data());
+		}
+		state.setBytesProcessed(state.maxIterations() * text->size());
+	});
+	// Numbers against strtof before they are timed: leading zeros, digits past the 19 the mantissa keeps,
+	// exponents out of the exact range
+	registry.add("BM_SceneParseFloat", [](BenchmarkState& state) {
+		static const char* const NUMBERS[] = {
+			"0", "-0.5", "+3.25", ".5", "7.", "1e-3", "2.5E+4", "0.0000000000000000001234", "0.00000000000000000000000000001",
+			"0000000000000000000005", "000000000000000000000.000000000000000000000123456789", "123456789012345678901234567890",
+			"0.123456789012345678901234567890", "3.4028234e38", "1.17549435e-38", "1e-45", "1e-50", "9007199254740993",
+		};
+		BatchRandom random(1);
+		std::vector<std::string> numbers(NUMBERS, NUMBERS + sizeof(NUMBERS) / sizeof(NUMBERS[0]));
+		char text[32];
+		for (int i = 0; i < 4096; ++i) {
+			float value[2];
+			random.fill(value, 2);
+			snprintf(text, sizeof(text), "%.9g", (value[0] - 0.5f) * std::pow(10.0f, value[1] * 20.0f - 10.0f));
+			numbers.push_back(text);
+		}
+		for (const std::string& number : numbers) {
+			float parsed = -1.0f;
+			const unsigned char* p = (const unsigned char*)number.data();
+			if (!scene_text::parseFloat(p, p + number.size(), parsed) || parsed != strtof(number.c_str(), nullptr)) {
+				state.skipWithError("parseFloat differs from strtof on " + number);
+				break;
+			}
+		}
+		while (state.keepRunning()) {
+			for (const std::string& number : numbers) {
+				float parsed;
+				const unsigned char* p = (const unsigned char*)number.data();
+				scene_text::parseFloat(p, p + number.size(), parsed);
+				doNotOptimize(parsed);
+			}
+		}
+		state.setItemsProcessed(state.maxIterations() * numbers.size());
+	});
+	registry.add("BM_SceneHash", [text](BenchmarkState& state) {
+		while (state.keepRunning()) {
+			uint64_t hash = hashSceneBytes((const unsigned char*)text->data(), text->size());
+			doNotOptimize(hash);
+		}
+		state.setBytesProcessed(state.maxIterations() * text->size());
+	});
+}
+
+void addUniformBenchmarks(BenchmarkRegistry& registry) {
+	registry.add("BM_FrameUniforms", [](BenchmarkState& state) {
+		float time = 0.0f, gradient[3];
+		while (state.keepRunning()) {
+			for (int i = 0; i < 2; ++i) {
+				computeColorGradient(time, gradient[0], gradient[1], gradient[2]);
+				std::string name("colorGradient");
+				doNotOptimize(name);
+				doNotOptimize(gradient);
+			}
+			time += 1.0f / 60.0f;
+		}
+		state.setItemsProcessed(state.maxIterations());
+	});
+}
+
+int runMicroBenchmarks(const char* executable, int argc, char** argv) {
+	BenchmarkOptions options;
+	options.executable = executable;
+	std::string directory = "../Triangular flower/shaders";
+	for (int i = 0; i < argc; ++i) {
+		if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+			options.filter = argv[++i];
+		}
+		else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+			options.jsonPath = argv[++i];
+		}
+		else if (strcmp(argv[i], "--min-time") == 0 && i + 1 < argc) {
+			options.minTime = atof(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--shaders") == 0 && i + 1 < argc) {
+			directory = argv[++i];
+		}
+		else {
+			std::cout << "WARNING::BENCHMARKS::UNKNOWN_ARGUMENT " << argv[i] << std::endl;
+		}
+	}
+
+	BenchmarkRegistry registry;
+	addShaderSourceBenchmarks(registry, directory);
+	addGeometryBenchmarks(registry);
+	addRandomBenchmarks(registry);
+	addInterleaveBenchmarks(registry);
+	addIndexBenchmarks(registry);
+	addUniformBenchmarks(registry);
+	// Cache resident, then memory bound
+	addTransformBenchmarks(registry, 4096);
+	addTransformBenchmarks(registry, 1 << 20);
+	addMatrixBenchmarks(registry);
+	addTlsfBenchmarks(registry);
+	addTextureBenchmarks(registry);
+	addTextureCompressionBenchmarks(registry);
+	addSpriteBenchmarks(registry);
+	addSceneGraphBenchmarks(registry);
+	addEcsBenchmarks(registry);
+	addBvhBenchmarks(registry);
+	addCircleLodBenchmarks(registry);
+	addHudBenchmarks(registry);
+	addSceneFileBenchmarks(registry);
+	return registry.run(options);
+}
@@ -1,10 +1,20 @@
+#include <chrono>
 #include <iostream>
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <random>
+#include <vector>
+#include "../../Triangular flower/input_events.h"
+#include "../../Triangular flower/options.h"
+#include "../../Triangular flower/gpu_timer.h"
+#include "../../Triangular flower/profiler.h"
+#include "../../Triangular flower/frame_capture.h"
+#include "../../Triangular flower/sprite_batch.h"
 
 void framebufferSizeCallback(GLFWwindow* window, int width, int height);
-void processInput(GLFWwindow* window);
+void processInput(GLFWwindow* window, EventQueue& events, FrameScheduler& scheduler);
+unsigned int createProgram(const char* vertexSource, const char* fragmentSource);
+unsigned int createSpriteTexture(const unsigned char* rgba, int width, int height);
 
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
@@ -22,12 +32,57 @@ const char* fragmentShaderSource = "#version 330 core\n"
 "	FragColor = vec4(1.0f, 0.5f, 0.2f, 1.0f);\n"
 "}\0";
 
+// Sprites are placed in pixels, screenSize maps them to normalized device coordinates
+const char* spriteVertexShaderSource = "#version 330 core\n"
+"layout (location = 0) in vec2 aPos;\n"
+"layout (location = 1) in vec2 aTexCoord;\n"
+"layout (location = 2) in vec4 aColor;\n"
+"uniform vec2 screenSize;\n"
+"out vec2 texCoord;\n"
+"out vec4 color;\n"
+"void main() {\n"
+"	gl_Position = vec4(aPos / screenSize * 2.0 - 1.0, 0.0, 1.0);\n"
+"	texCoord = aTexCoord;\n"
+"	color = aColor;\n"
+"}\0";
+
+const char* spriteFragmentShaderSource = "#version 330 core\n"
+"in vec2 texCoord;\n"
+"in vec4 color;\n"
+"uniform sampler2D spriteTexture;\n"
+"out vec4 FragColor;\n"
+"void main() {\n"
+"	FragColor = texture(spriteTexture, texCoord) * color;\n"
+"}\0";
+
+// A quad of the sprite overlay, texture indexes the overlay's textures
+struct SpriteInstance {
+	float x, y, size;
+	uint32_t color;
+	int texture;
+};
+
 // Generating random double in range
 std::random_device rd; // obtain a random number from hardware
 std::mt19937 gen(rd()); // seed the generator
 std::uniform_real_distribution<> distr(0, 1); // define the range
 
-int main() {
+// Left mouse button keeps the background flashing with random colors while held
+bool MOUSE_BUTTON_LEFT_PRESSED = false;
+
+int main(int argc, char** argv) {
+	// The rectangle is static, so by default frames are only drawn when something changes
+	Options defaults;
+	defaults.onDemand = true;
+	Options options = parseOptions(argc, argv, defaults);
+	if (options.seed != 0) {
+		gen.seed(options.seed);
+	}
+	if (options.tracePath || options.traceBinaryPath) {
+		PROFILER_START(options.tracePath, options.traceBinaryPath);
+		PROFILE_THREAD_NAME("main");
+	}
+
 	glfwInit();
 
 	// Using openGL version 3.3
@@ -55,52 +110,29 @@ int main() {
 		return -2;
 	}
 
+	// Input is delivered by the GLFW callbacks into the event queue
+	EventQueue events;
+	events.attach(window);
 	glfwSetFramebufferSizeCallback(window, framebufferSizeCallback);
+	FrameScheduler scheduler(options.onDemand, options.idleTimeout);
 
-	// CREATING SHADERS
-	// Vertex Shader
-	unsigned int vertexShader = glCreateShader(GL_VERTEX_SHADER);
-	glShaderSource(vertexShader, 1, &vertexShaderSource, NULL);
-	glCompileShader(vertexShader);
-
-	// Checking if shader compilation went fine
-	int success;
-	char infoLog[LOG_SIZE];
-
-	glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success);
-	if (!success) {
-		glGetShaderInfoLog(vertexShader, LOG_SIZE, NULL, infoLog);
-		std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
+	// GPU time per pass, read back a few frames later so it never stalls
+	GpuTimer gpuTimer;
+	if (options.gpuTimingsPath) {
+		gpuTimer.init();
 	}
 
-	// Fragment Shader
-	unsigned int fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-	glShaderSource(fragmentShader, 1, &fragmentShaderSource, NULL);
-	glCompileShader(fragmentShader);
-
-	// Checking if shader compilation went fine
-	glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success);
-	if (!success) {
-		glGetShaderInfoLog(fragmentShader, LOG_SIZE, NULL, infoLog);
-		std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
-	}
-
-	// Linking the created shaders into one program (aka pipline ?)
-	unsigned int shaderProgram = glCreateProgram();
-	glAttachShader(shaderProgram, vertexShader);
-	glAttachShader(shaderProgram, fragmentShader);
-	glLinkProgram(shaderProgram);
-
-	// Checking if linking shaders into program went fine
-	glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
-	if (!success) {
-		glGetProgramInfoLog(shaderProgram, LOG_SIZE, NULL, infoLog);
-		std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+	// Frames are read back through a ring of pixel pack buffers, a few frames late
+	FrameCapture capture;
+	if (options.capturePath) {
+		int width, height;
+		glfwGetFramebufferSize(window, &width, &height);
+		capture.open(options.capturePath, options.capturePipe, width, height, options.captureFps,
+					 options.captureRgb ? CaptureFormat::RGB : CaptureFormat::Y4M);
 	}
 
-	// Deleting the shader objects since we don't need them anymore
-	glDeleteShader(vertexShader);
-	glDeleteShader(fragmentShader);
+	// CREATING SHADERS
+	unsigned int shaderProgram = createProgram(vertexShaderSource, fragmentShaderSource);
 
 	// DRAWING AN OBJECT
 	// Triangle vertices in Screen Normalized Coordinates (each axis, x, y and z, lies in the range (-1, 1))
@@ -161,18 +193,70 @@ int main() {
 	// We also use binding functions to specify which BAO, EBO or VAO we are using right now.
 	// For different VBO data we need to use separate VAOs (for ex., we bind one VAO for vertex data and a second one for the colors).
 
+	// SPRITE OVERLAY
+	// Random quads in two textures, grouped by texture so the batcher only flushes when it runs out of room or switches
+	SpriteBatch spriteBatch;
+	unsigned int spriteProgram = 0, spriteTextures[2] = { 0, 0 };
+	int screenSizeLocation = -1;
+	std::vector<SpriteInstance> sprites;
+	double spriteSeconds = 0.0;
+	unsigned int spriteFrames = 0;
+	if (options.spriteCount > 0) {
+		spriteBatch.init();
+		spriteProgram = createProgram(spriteVertexShaderSource, spriteFragmentShaderSource);
+		screenSizeLocation = glGetUniformLocation(spriteProgram, "screenSize");
+		glUseProgram(spriteProgram);
+		glUniform1i(glGetUniformLocation(spriteProgram, "spriteTexture"), 0);
+		const unsigned char white[4] = { 255, 255, 255, 255 };
+		unsigned char checker[8 * 8 * 4];
+		for (int i = 0; i < 8 * 8; ++i) {
+			unsigned char value = ((i % 8) + (i / 8)) % 2 ? 255 : 96;
+			checker[4 * i] = checker[4 * i + 1] = checker[4 * i + 2] = value;
+			checker[4 * i + 3] = 255;
+		}
+		spriteTextures[0] = createSpriteTexture(white, 1, 1);
+		spriteTextures[1] = createSpriteTexture(checker, 8, 8);
+		sprites.resize(options.spriteCount);
+		for (unsigned int i = 0; i < options.spriteCount; ++i) {
+			SpriteInstance& sprite = sprites[i];
+			sprite.x = (float)distr(gen) * SCR_WIDTH;
+			sprite.y = (float)distr(gen) * SCR_HEIGHT;
+			sprite.size = 2.0f + (float)distr(gen) * 14.0f;
+			sprite.color = packSpriteColor((float)distr(gen), (float)distr(gen), (float)distr(gen), 0.8f);
+			sprite.texture = i < options.spriteCount / 2 ? 0 : 1;
+		}
+	}
+
 	// RENDER LOOP
 	// Initial background color
 	glClearColor(0.07f, 0.07f, 0.07f, 1.0f);
-	glClear(GL_COLOR_BUFFER_BIT);
 	glPolygonMode(GL_FRONT_AND_BACK, GL_LINE); // Wireframe mode
 	//glPolygonMode(GL_FRONT_AND_BACK, GL_FILL); // Default mode
 
 	while (!glfwWindowShouldClose(window)) {
+		// glfw: poll IO events (keys pressed/released, mouse moved etc.),
+		// in on-demand mode this sleeps until something happens
+		{
+			PROFILE_ZONE("waitEvents");
+			scheduler.waitEvents();
+		}
+
 		// INPUT
-		processInput(window);
+		processInput(window, events, scheduler);
+		if (!scheduler.needsFrame()) {
+			continue;
+		}
 
 		// RENDER
+		PROFILE_ZONE("frame");
+		gpuTimer.beginFrame();
+		if (MOUSE_BUTTON_LEFT_PRESSED) {
+			glClearColor((float)distr(gen), (float)distr(gen), (float)distr(gen), 1.0f);
+		}
+		gpuTimer.beginZone("clear");
+		glClear(GL_COLOR_BUFFER_BIT);
+		gpuTimer.endZone();
+
 		// Draw our first triangle
 		// Activating the program object to render it
 		glUseProgram(shaderProgram);
@@ -183,38 +267,171 @@ int main() {
 		//glBindVertexArray(0); // no need to unbind it every time
 		
 		//args: drawing mode, how many, indices type, offset in EBO
-		glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+		{
+			PROFILE_ZONE("draw");
+			gpuTimer.beginZone("rectangle");
+			glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+			gpuTimer.endZone();
+		}
+
+		if (!sprites.empty()) {
+			PROFILE_ZONE("sprites");
+			gpuTimer.beginZone("sprites");
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			int width, height;
+			glfwGetFramebufferSize(window, &width, &height);
+			glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+			glEnable(GL_BLEND);
+			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+			glUseProgram(spriteProgram);
+			glUniform2f(screenSizeLocation, (float)width, (float)height);
+			spriteBatch.begin(spriteProgram, spriteTextures[0]);
+			for (const SpriteInstance& sprite : sprites) {
+				spriteBatch.setTexture(spriteTextures[sprite.texture]);
+				spriteBatch.draw(sprite.x, sprite.y, sprite.size, sprite.size, sprite.color);
+			}
+			spriteBatch.end();
+			glDisable(GL_BLEND);
+			glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+			spriteSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			++spriteFrames;
+			gpuTimer.endZone();
+		}
+		gpuTimer.endFrame();
+
+		{
+			PROFILE_ZONE("capture");
+			capture.captureFrame();
+		}
+
+		// glfw: swap buffers
+		{
+			PROFILE_ZONE("glfwSwapBuffers");
+			glfwSwapBuffers(window);
+		}
+		scheduler.frameRendered();
+	}
 
-		// glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
-		glfwSwapBuffers(window);
-		glfwPollEvents();
+	capture.close();
+	if (spriteFrames > 0) {
+		std::cout << "Sprites: " << spriteBatch.quads() << " quads in " << spriteBatch.drawCalls() << " draw calls per frame, "
+				  << spriteBatch.quads() * spriteFrames / (spriteSeconds * 1000.0) << " quads/ms submitted, "
+				  << spriteBatch.orphans() << " vertex buffer orphans" << std::endl;
+	}
+	if (gpuTimer.isEnabled()) {
+		gpuTimer.writeReport(std::cout);
+		gpuTimer.writeCsv(options.gpuTimingsPath);
+		gpuTimer.destroy();
 	}
 
 	// Optional: de-allocate all resources once they're outlived their purpouse
 	glDeleteVertexArrays(1, &vertexArrayObject);
 	glDeleteBuffers(1, &vertexBufferObject);
 	glDeleteProgram(shaderProgram);
+	if (options.spriteCount > 0) {
+		spriteBatch.destroy();
+		glDeleteTextures(2, spriteTextures);
+		glDeleteProgram(spriteProgram);
+	}
+
+	PROFILER_STOP();
 
 	// GLFW: terminate, clearing all previously allocated GLFW resources
 	glfwTerminate();
 	return 0;
 }
 
+// Only queues the size, the viewport is set where the events are processed, like the other input
 void framebufferSizeCallback(GLFWwindow* window, int width, int height) {
-	glViewport(0, 0, width, height);
+	EventQueue::fromWindow(window)->push(InputEventType::Resize, 0, 0, 0, width, height);
 }
 
-void processInput(GLFWwindow* window) {
-	if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS) {
-		glfwSetWindowShouldClose(window, true);
+void processInput(GLFWwindow* window, EventQueue& events, FrameScheduler& scheduler) {
+	PROFILE_FUNCTION();
+	InputEvent event;
+	while (events.poll(event)) {
+		switch (event.type) {
+		case InputEventType::Key:
+			if (event.code == GLFW_KEY_ESCAPE && event.action == GLFW_PRESS) {
+				glfwSetWindowShouldClose(window, true);
+			}
+			break;
+		case InputEventType::MouseButton:
+			if (event.code == GLFW_MOUSE_BUTTON_LEFT) {
+				MOUSE_BUTTON_LEFT_PRESSED = event.action == GLFW_PRESS;
+				// A new random background every frame while the button is held
+				scheduler.setAnimating(MOUSE_BUTTON_LEFT_PRESSED);
+				scheduler.invalidate();
+			}
+			break;
+		case InputEventType::Resize:
+			glViewport(0, 0, (int)event.x, (int)event.y);
+			scheduler.invalidate();
+			break;
+		case InputEventType::Refresh:
+			scheduler.invalidate();
+			break;
+		default:
+			break;
+		}
 	}
+}
 
-	if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS) {
-		glClearColor((float)distr(gen), (float)distr(gen), (float)distr(gen), 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT);
+// Compiles and links a vertex and fragment shader, failures are reported and leave an unusable program
+unsigned int createProgram(const char* vertexSource, const char* fragmentSource) {
+	// Vertex Shader
+	unsigned int vertexShader = glCreateShader(GL_VERTEX_SHADER);
+	glShaderSource(vertexShader, 1, &vertexSource, NULL);
+	glCompileShader(vertexShader);
+
+	// Checking if shader compilation went fine
+	int success;
+	char infoLog[LOG_SIZE];
+
+	glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success);
+	if (!success) {
+		glGetShaderInfoLog(vertexShader, LOG_SIZE, NULL, infoLog);
+		std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
 	}
-	
-	if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_RELEASE) {
-		glClear(GL_COLOR_BUFFER_BIT);
+
+	// Fragment Shader
+	unsigned int fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+	glShaderSource(fragmentShader, 1, &fragmentSource, NULL);
+	glCompileShader(fragmentShader);
+
+	// Checking if shader compilation went fine
+	glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success);
+	if (!success) {
+		glGetShaderInfoLog(fragmentShader, LOG_SIZE, NULL, infoLog);
+		std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
+	}
+
+	// Linking the created shaders into one program (aka pipline ?)
+	unsigned int shaderProgram = glCreateProgram();
+	glAttachShader(shaderProgram, vertexShader);
+	glAttachShader(shaderProgram, fragmentShader);
+	glLinkProgram(shaderProgram);
+
+	// Checking if linking shaders into program went fine
+	glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
+	if (!success) {
+		glGetProgramInfoLog(shaderProgram, LOG_SIZE, NULL, infoLog);
+		std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
 	}
-}
\ No newline at end of file
+
+	// Deleting the shader objects since we don't need them anymore
+	glDeleteShader(vertexShader);
+	glDeleteShader(fragmentShader);
+	return shaderProgram;
+}
+
+unsigned int createSpriteTexture(const unsigned char* rgba, int width, int height) {
+	unsigned int texture;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, rgba);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	return texture;
+}
@@ -0,0 +1,176 @@
+#ifndef ALLOCATION_COUNTER_H
+#define ALLOCATION_COUNTER_H
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+// Counts heap allocations made through the global operator new. The counting operators are only
+// defined in the one translation unit that includes this header after
+// #define ALLOCATION_COUNTER_IMPLEMENTATION, everywhere else the counters just read zero.
+struct AllocationCounts {
+	uint64_t allocations;
+	uint64_t bytes;
+};
+
+namespace allocation_counter {
+	// Function-local statics are constant-initialized, so allocations made before main are counted too
+	inline std::atomic<uint64_t>& allocations() {
+		static std::atomic<uint64_t> value(0);
+		return value;
+	}
+	inline std::atomic<uint64_t>& bytes() {
+		static std::atomic<uint64_t> value(0);
+		return value;
+	}
+	// Allocations made inside AllocationExemption scopes or on exempt threads
+	inline std::atomic<uint64_t>& exemptAllocations() {
+		static std::atomic<uint64_t> value(0);
+		return value;
+	}
+	inline std::atomic<uint64_t>& exemptBytes() {
+		static std::atomic<uint64_t> value(0);
+		return value;
+	}
+	// Set on threads whose allocations are never frame work (asset loading workers)
+	inline bool& threadExempt() {
+		static thread_local bool exempt = false;
+		return exempt;
+	}
+	inline void exemptCurrentThread() {
+		threadExempt() = true;
+	}
+	inline AllocationCounts snapshot() {
+		AllocationCounts counts = { allocations().load(std::memory_order_relaxed), bytes().load(std::memory_order_relaxed) };
+		return counts;
+	}
+	inline void* allocate(std::size_t size) {
+		allocations().fetch_add(1, std::memory_order_relaxed);
+		bytes().fetch_add(size, std::memory_order_relaxed);
+		if (threadExempt()) {
+			exemptAllocations().fetch_add(1, std::memory_order_relaxed);
+			exemptBytes().fetch_add(size, std::memory_order_relaxed);
+		}
+		return std::malloc(size ? size : 1);
+	}
+}
+
+// Allocations the calling thread makes while one of these is alive do not count against
+// FrameAllocationCheck. Meant for diagnostics that allocate on purpose (image readback, report files).
+class AllocationExemption {
+public:
+	AllocationExemption() : wasExempt(allocation_counter::threadExempt()) {
+		allocation_counter::threadExempt() = true;
+	}
+	~AllocationExemption() {
+		allocation_counter::threadExempt() = wasExempt;
+	}
+
+	AllocationExemption(const AllocationExemption&) = delete;
+	AllocationExemption& operator=(const AllocationExemption&) = delete;
+
+private:
+	bool wasExempt;
+};
+
+// Heap allocations between two frame boundaries, from every thread that is not exempt. Once the loop
+// has warmed up (containers have reached their working size, lazily created state exists) a frame
+// that still allocates is reported, and asserted in debug builds.
+class FrameAllocationCheck {
+public:
+	explicit FrameAllocationCheck(unsigned int warmupFrames = 10) : warmupFrames(warmupFrames) {
+		last = counted();
+	}
+
+	// Call once per frame, right after glfwSwapBuffers
+	void frameBoundary() {
+		AllocationCounts now = counted();
+		uint64_t allocations = now.allocations - last.allocations, bytes = now.bytes - last.bytes;
+		last = now;
+		++frame;
+		if (frame <= warmupEnd) {
+			return;
+		}
+		++steadyFrames;
+		if (allocations > 0) {
+			++allocatingFrames;
+			std::cout << "ERROR::ALLOCATION::HEAP_ALLOCATIONS_IN_FRAME frame " << frame << ": " << allocations << " allocations, "
+					  << bytes << " bytes" << std::endl;
+			assert(allocations == 0 && "steady-state frame allocated from the heap");
+		}
+	}
+
+	// Starts another warm-up, for changes that legitimately allocate (resize, capture start, ...)
+	void restartWarmup() {
+		warmupEnd = frame + warmupFrames;
+	}
+
+	unsigned long long checkedFrames() const {
+		return steadyFrames;
+	}
+	unsigned long long failedFrames() const {
+		return allocatingFrames;
+	}
+
+private:
+	unsigned int warmupFrames;
+	unsigned long long frame = 0, warmupEnd = warmupFrames;
+	unsigned long long steadyFrames = 0, allocatingFrames = 0;
+	AllocationCounts last;
+
+	// Everything allocated so far minus the exempted allocations
+	static AllocationCounts counted() {
+		AllocationCounts counts = allocation_counter::snapshot();
+		counts.allocations -= allocation_counter::exemptAllocations().load(std::memory_order_relaxed);
+		counts.bytes -= allocation_counter::exemptBytes().load(std::memory_order_relaxed);
+		return counts;
+	}
+};
+
+#ifdef ALLOCATION_COUNTER_IMPLEMENTATION
+// Kept out of line: GCC warns about free() on operator new memory once both are inlined into one caller
+#ifdef _MSC_VER
+#define ALLOCATION_COUNTER_NOINLINE __declspec(noinline)
+#else
+#define ALLOCATION_COUNTER_NOINLINE __attribute__((noinline))
+#endif
+void* operator new(std::size_t size) {
+	void* pointer = allocation_counter::allocate(size);
+	if (!pointer) {
+		throw std::bad_alloc();
+	}
+	return pointer;
+}
+void* operator new[](std::size_t size) {
+	return operator new(size);
+}
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+	return allocation_counter::allocate(size);
+}
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+	return allocation_counter::allocate(size);
+}
+ALLOCATION_COUNTER_NOINLINE void operator delete(void* pointer) noexcept {
+	std::free(pointer);
+}
+ALLOCATION_COUNTER_NOINLINE void operator delete[](void* pointer) noexcept {
+	std::free(pointer);
+}
+ALLOCATION_COUNTER_NOINLINE void operator delete(void* pointer, std::size_t) noexcept {
+	std::free(pointer);
+}
+ALLOCATION_COUNTER_NOINLINE void operator delete[](void* pointer, std::size_t) noexcept {
+	std::free(pointer);
+}
+ALLOCATION_COUNTER_NOINLINE void operator delete(void* pointer, const std::nothrow_t&) noexcept {
+	std::free(pointer);
+}
+ALLOCATION_COUNTER_NOINLINE void operator delete[](void* pointer, const std::nothrow_t&) noexcept {
+	std::free(pointer);
+}
+#undef ALLOCATION_COUNTER_NOINLINE
+#endif
+#endif
@@ -0,0 +1,216 @@
+#ifndef BATCH_RANDOM_H
+#define BATCH_RANDOM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "thread_pool.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define BATCH_RANDOM_USE_SSE2
+#endif
+
+// Four xoshiro256++ generators stepped side by side, two per SSE2 register. Every step gives four
+// 64-bit outputs, each split into two floats in [0, 1) from its upper 24 bits, so a step fills 8 floats.
+// The scalar fallback produces the same sequence. Unlike (float)distr(gen) the result never rounds up to 1.
+// Lane i starts 2^128 steps after lane i - 1 (xoshiro's jump), split() hands out streams 2^192 steps
+// apart (the long jump), so no two lanes of any split stream ever overlap.
+class BatchRandom {
+public:
+	static const int LANES = 4;
+	static const int BLOCK = 2 * LANES; // floats per step
+
+	explicit BatchRandom(uint64_t seed) {
+		static const uint64_t jump[4] = { 0x180ec6d33cfd0abaull, 0xd5a61266f0c9392cull, 0xa9582618e03fc9aaull, 0x39abdc4529b1661cull };
+		// splitmix64 turns any seed, 0 included, into a usable state
+		uint64_t x = seed;
+		for (int k = 0; k < 4; ++k) {
+			x += 0x9e3779b97f4a7c15ull;
+			uint64_t z = x;
+			z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+			z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+			state[k][0] = z ^ (z >> 31);
+		}
+		for (int lane = 1; lane < LANES; ++lane) {
+			for (int k = 0; k < 4; ++k) {
+				state[k][lane] = state[k][lane - 1];
+			}
+			jumpLane(lane, jump);
+		}
+	}
+
+	// Independent stream for another thread or another buffer; this generator moves on past it
+	BatchRandom split() {
+		static const uint64_t longJump[4] = { 0x76e15d3efefdcbbfull, 0xc5004e441c522fb3ull, 0x77710069854ee241ull, 0x39109bb02acbe635ull };
+		BatchRandom stream = *this;
+		for (int lane = 0; lane < LANES; ++lane) {
+			jumpLane(lane, longJump);
+		}
+		return stream;
+	}
+
+	// count floats, value i goes to destination[i * stride]. Every call starts a fresh step, so the values
+	// only depend on the seed and the sequence of counts, not on the stride.
+	void fill(float* destination, size_t count, size_t stride = 1) {
+		fillAttribute(destination, count, 1, stride);
+	}
+
+	// A vertex attribute of an interleaved buffer: components (1 to 4) floats per vertex, vertices stride floats apart
+	void fillAttribute(float* vertices, size_t vertexCount, unsigned int components, size_t stride) {
+		size_t total = vertexCount * components;
+		if (stride == components) {
+			// Contiguous: whole steps go straight to the buffer
+			size_t whole = total - total % BLOCK;
+			generate(vertices, whole / BLOCK);
+			if (whole < total) {
+				float block[BLOCK];
+				generate(block, 1);
+				for (size_t i = whole; i < total; ++i) {
+					vertices[i] = block[i - whole];
+				}
+			}
+			return;
+		}
+		// Strided: a run of whole steps into a local block, then copied out vertex by vertex
+		float block[BLOCK * 32];
+		size_t chunkVertices = BLOCK * (32 / components);
+		for (size_t first = 0; first < vertexCount; first += chunkVertices) {
+			size_t n = vertexCount - first < chunkVertices ? vertexCount - first : chunkVertices;
+			generate(block, (n * components + BLOCK - 1) / BLOCK);
+			float* vertex = vertices + first * stride;
+			// Fixed component counts let the copy unroll
+			switch (components) {
+			case 1: scatter<1>(block, n, vertex, stride); break;
+			case 2: scatter<2>(block, n, vertex, stride); break;
+			case 3: scatter<3>(block, n, vertex, stride); break;
+			default: scatter<4>(block, n, vertex, stride); break;
+			}
+		}
+	}
+
+private:
+	// state[k][lane]: word k of the lane's xoshiro256++ state
+	uint64_t state[4][LANES];
+
+	template <unsigned int Components>
+	static void scatter(const float* source, size_t vertexCount, float* vertex, size_t stride) {
+		for (size_t i = 0; i < vertexCount; ++i, vertex += stride, source += Components) {
+			for (unsigned int c = 0; c < Components; ++c) {
+				vertex[c] = source[c];
+			}
+		}
+	}
+
+	static uint64_t rotl(uint64_t x, int k) {
+		return (x << k) | (x >> (64 - k));
+	}
+
+	static uint64_t nextLane(uint64_t* s) {
+		uint64_t result = rotl(s[0] + s[3], 23) + s[0];
+		uint64_t t = s[1] << 17;
+		s[2] ^= s[0];
+		s[3] ^= s[1];
+		s[1] ^= s[2];
+		s[0] ^= s[3];
+		s[2] ^= t;
+		s[3] = rotl(s[3], 45);
+		return result;
+	}
+
+	void jumpLane(int lane, const uint64_t* polynomial) {
+		uint64_t s[4] = { state[0][lane], state[1][lane], state[2][lane], state[3][lane] };
+		uint64_t jumped[4] = { 0, 0, 0, 0 };
+		for (int i = 0; i < 4; ++i) {
+			for (int b = 0; b < 64; ++b) {
+				if (polynomial[i] & (1ull << b)) {
+					for (int k = 0; k < 4; ++k) {
+						jumped[k] ^= s[k];
+					}
+				}
+				nextLane(s);
+			}
+		}
+		for (int k = 0; k < 4; ++k) {
+			state[k][lane] = jumped[k];
+		}
+	}
+
+#ifdef BATCH_RANDOM_USE_SSE2
+	static __m128i rotl2(__m128i x, int k) {
+		return _mm_or_si128(_mm_slli_epi64(x, k), _mm_srli_epi64(x, 64 - k));
+	}
+
+	// Upper 24 bits of each 32-bit half, scaled by 2^-24
+	static __m128 toUnitFloats(__m128i x) {
+		return _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(x, 8)), _mm_set1_ps(1.0f / 16777216.0f));
+	}
+
+	void generate(float* out, size_t steps) {
+		__m128i s0a = _mm_loadu_si128((const __m128i*)&state[0][0]), s0b = _mm_loadu_si128((const __m128i*)&state[0][2]);
+		__m128i s1a = _mm_loadu_si128((const __m128i*)&state[1][0]), s1b = _mm_loadu_si128((const __m128i*)&state[1][2]);
+		__m128i s2a = _mm_loadu_si128((const __m128i*)&state[2][0]), s2b = _mm_loadu_si128((const __m128i*)&state[2][2]);
+		__m128i s3a = _mm_loadu_si128((const __m128i*)&state[3][0]), s3b = _mm_loadu_si128((const __m128i*)&state[3][2]);
+		for (size_t i = 0; i < steps; ++i, out += BLOCK) {
+			__m128i ra = _mm_add_epi64(rotl2(_mm_add_epi64(s0a, s3a), 23), s0a);
+			__m128i rb = _mm_add_epi64(rotl2(_mm_add_epi64(s0b, s3b), 23), s0b);
+			__m128i ta = _mm_slli_epi64(s1a, 17), tb = _mm_slli_epi64(s1b, 17);
+			s2a = _mm_xor_si128(s2a, s0a);
+			s2b = _mm_xor_si128(s2b, s0b);
+			s3a = _mm_xor_si128(s3a, s1a);
+			s3b = _mm_xor_si128(s3b, s1b);
+			s1a = _mm_xor_si128(s1a, s2a);
+			s1b = _mm_xor_si128(s1b, s2b);
+			s0a = _mm_xor_si128(s0a, s3a);
+			s0b = _mm_xor_si128(s0b, s3b);
+			s2a = _mm_xor_si128(s2a, ta);
+			s2b = _mm_xor_si128(s2b, tb);
+			s3a = rotl2(s3a, 45);
+			s3b = rotl2(s3b, 45);
+			_mm_storeu_ps(out, toUnitFloats(ra));
+			_mm_storeu_ps(out + 4, toUnitFloats(rb));
+		}
+		_mm_storeu_si128((__m128i*)&state[0][0], s0a);
+		_mm_storeu_si128((__m128i*)&state[0][2], s0b);
+		_mm_storeu_si128((__m128i*)&state[1][0], s1a);
+		_mm_storeu_si128((__m128i*)&state[1][2], s1b);
+		_mm_storeu_si128((__m128i*)&state[2][0], s2a);
+		_mm_storeu_si128((__m128i*)&state[2][2], s2b);
+		_mm_storeu_si128((__m128i*)&state[3][0], s3a);
+		_mm_storeu_si128((__m128i*)&state[3][2], s3b);
+	}
+#else
+	void generate(float* out, size_t steps) {
+		for (size_t i = 0; i < steps; ++i, out += BLOCK) {
+			for (int lane = 0; lane < LANES; ++lane) {
+				uint64_t s[4] = { state[0][lane], state[1][lane], state[2][lane], state[3][lane] };
+				uint64_t result = nextLane(s);
+				for (int k = 0; k < 4; ++k) {
+					state[k][lane] = s[k];
+				}
+				out[2 * lane] = (float)((uint32_t)result >> 8) * (1.0f / 16777216.0f);
+				out[2 * lane + 1] = (float)((uint32_t)(result >> 32) >> 8) * (1.0f / 16777216.0f);
+			}
+		}
+	}
+#endif
+};
+
+// Fills an attribute of a large buffer from several threads. The buffer is cut into fixed chunks, each with
+// its own split() stream, so the values depend on the seed only and not on how many threads the pool has.
+inline void fillAttributeParallel(ThreadPool& pool, BatchRandom& random, float* vertices, size_t vertexCount,
+								  unsigned int components, size_t stride) {
+	const size_t CHUNK_VERTICES = 1 << 16;
+	size_t chunkCount = (vertexCount + CHUNK_VERTICES - 1) / CHUNK_VERTICES;
+	std::vector<BatchRandom> streams;
+	streams.reserve(chunkCount);
+	for (size_t i = 0; i < chunkCount; ++i) {
+		streams.push_back(random.split());
+	}
+	pool.parallelFor((unsigned int)chunkCount, [&](unsigned int chunk, unsigned int) {
+		size_t first = chunk * CHUNK_VERTICES;
+		size_t count = vertexCount - first < CHUNK_VERTICES ? vertexCount - first : CHUNK_VERTICES;
+		streams[chunk].fillAttribute(vertices + first * stride, count, components, stride);
+	});
+}
+#endif
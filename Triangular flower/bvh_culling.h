@@ -0,0 +1,568 @@
+#ifndef BVH_CULLING_H
+#define BVH_CULLING_H
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <vector>
+#include "thread_pool.h"
+#include "vector_math.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define BVH_USE_SSE2
+#endif
+
+struct Aabb {
+	Vec3 min, max;
+};
+
+// Bounds of a box after an affine transform (the corners' bounds, without visiting the corners)
+inline Aabb transformAabb(const Mat4& m, const Aabb& box) {
+	Vec3 center = (box.min + box.max) * 0.5f, extent = (box.max - box.min) * 0.5f;
+	Vec4 c = m * Vec4(center, 1.0f);
+	Vec3 e(std::fabs(m.at(0, 0)) * extent.x + std::fabs(m.at(0, 1)) * extent.y + std::fabs(m.at(0, 2)) * extent.z,
+		   std::fabs(m.at(1, 0)) * extent.x + std::fabs(m.at(1, 1)) * extent.y + std::fabs(m.at(1, 2)) * extent.z,
+		   std::fabs(m.at(2, 0)) * extent.x + std::fabs(m.at(2, 1)) * extent.y + std::fabs(m.at(2, 2)) * extent.z);
+	return { c.xyz() - e, c.xyz() + e };
+}
+
+// Planes a box must be on the positive side of: a x + b y + c z + d >= 0
+struct CullVolume {
+	Vec4 planes[6];
+	int planeCount = 0;
+
+	// The six clip planes of a view-projection matrix, in the space the matrix maps from
+	static CullVolume frustum(const Mat4& viewProjection) {
+		CullVolume volume;
+		Vec4 rows[4];
+		for (int r = 0; r < 4; ++r) {
+			rows[r] = Vec4(viewProjection.at(r, 0), viewProjection.at(r, 1), viewProjection.at(r, 2), viewProjection.at(r, 3));
+		}
+		for (int axis = 0; axis < 3; ++axis) {
+			volume.planes[volume.planeCount++] = rows[3] + rows[axis];
+			volume.planes[volume.planeCount++] = rows[3] - rows[axis];
+		}
+		return volume;
+	}
+
+	// A 2D viewport rectangle, z is ignored
+	static CullVolume rectangle(float minX, float minY, float maxX, float maxY) {
+		CullVolume volume;
+		volume.planes[0] = Vec4(1.0f, 0.0f, 0.0f, -minX);
+		volume.planes[1] = Vec4(-1.0f, 0.0f, 0.0f, maxX);
+		volume.planes[2] = Vec4(0.0f, 1.0f, 0.0f, -minY);
+		volume.planes[3] = Vec4(0.0f, -1.0f, 0.0f, maxY);
+		volume.planeCount = 4;
+		return volume;
+	}
+};
+
+// Bounding volume hierarchy over instance boxes for culling, 4 boxes per node tested in one go.
+// Every node holds its children's boxes as a 4-wide SoA packet, and so does every leaf for its (up to) 4
+// instances, so one SSE pass per plane classifies 4 boxes as outside, intersecting or inside. Fully
+// inside subtrees are emitted without visiting them: the instances are stored in leaf order, so a
+// subtree's instances are one contiguous run.
+// The tree is built top down by median splits whose sizes depend only on the instance count, which lets
+// a subtree be rebuilt in place. refit() moves the boxes every frame and rebuilds the subtrees whose
+// surface area grew the most since they were built, within a per-frame budget. Like cull(), it can split
+// the work below TASK_DEPTH across a thread pool, the few nodes above are refit after them on the caller.
+class InstanceBvh {
+public:
+	// Refit rebuilds a subtree once its area is this many times the area it was built with
+	static constexpr float REBUILD_RATIO = 2.0f;
+	static const uint32_t DEFAULT_REBUILD_BUDGET = 16384;
+	// Subtrees this deep become the parallel tasks of cull() and refit()
+	static const int TASK_DEPTH = 3;
+
+	InstanceBvh() : task([this](unsigned int taskIndex, unsigned int) {
+		runTask(tasks[taskIndex]);
+	}), refitTask([this](unsigned int taskIndex, unsigned int) {
+		refitSubtree(refitTasks[taskIndex]);
+	}) {}
+
+	InstanceBvh(const InstanceBvh&) = delete;
+	InstanceBvh& operator=(const InstanceBvh&) = delete;
+
+	void build(const Aabb* bounds, uint32_t count) {
+		instanceCount = count;
+		order.resize(count);
+		for (uint32_t i = 0; i < count; ++i) {
+			order[i] = i;
+		}
+		leaves.resize((count + 3) / 4);
+		nodes.clear();
+		rebuilding = false;
+		buildNode(bounds, 0, count);
+		// Rebuilds keep the shape, so the split of refit() holds until the next build
+		refitTasks.clear();
+		topNodes.clear();
+		collectRefitTasks(0, 0);
+	}
+
+	// The instance boxes moved (same count as the build). Leaves take the new boxes, nodes are refit
+	// bottom up, then the most degraded subtrees are rebuilt until rebuildBudget instances were sorted.
+	// With a pool the subtrees below TASK_DEPTH are refit in parallel, the rebuilds stay on the caller.
+	void refit(const Aabb* bounds, uint32_t rebuildBudget = DEFAULT_REBUILD_BUDGET, ThreadPool* pool = nullptr) {
+		rebuiltCount = 0;
+		if (nodes.empty()) {
+			return;
+		}
+		refitBounds = bounds;
+		if (pool && refitTasks.size() > 1) {
+			pool->parallelFor((unsigned int)refitTasks.size(), refitTask);
+		}
+		else {
+			for (unsigned int i = 0; i < refitTasks.size(); ++i) {
+				refitTask(i, 0);
+			}
+		}
+		// Parents after their children: topNodes is in preorder, and its leaves are not in any task
+		for (size_t i = topNodes.size(); i-- > 0;) {
+			const Node& node = nodes[topNodes[i]];
+			for (int k = 0; k < node.childCount; ++k) {
+				if (node.children[k] < 0) {
+					fillLeaf(bounds, (uint32_t)~node.children[k]);
+				}
+			}
+			refitNode(topNodes[i]);
+		}
+		// Descends only into degraded nodes, the topmost that fit the budget are rebuilt
+		uint32_t stack[128];
+		int top = 0;
+		stack[top++] = 0;
+		while (top > 0) {
+			const Node& node = nodes[stack[--top]];
+			uint32_t n = stack[top];
+			if (!(node.area > REBUILD_RATIO * node.buildArea)) {
+				continue;
+			}
+			uint32_t begin = node.firstLeaf[0] * 4, end = std::min(node.firstLeaf[node.childCount] * 4, instanceCount);
+			if (end - begin <= rebuildBudget - rebuiltCount) {
+				rebuildSubtree(bounds, n, begin, end);
+				rebuiltCount += end - begin;
+				continue;
+			}
+			for (int k = node.childCount - 1; k >= 0 && top < 124; --k) {
+				if (node.children[k] >= 0) {
+					stack[top++] = (uint32_t)node.children[k];
+				}
+			}
+		}
+	}
+
+	// Writes the ids of the instances whose boxes touch the volume to visible (room for size() ids),
+	// in leaf order, and returns their count
+	uint32_t cull(const CullVolume& volume, uint32_t* visible, ThreadPool* pool = nullptr) {
+		if (nodes.empty()) {
+			return 0;
+		}
+		prepare(volume);
+		output = visible;
+		tasks.clear();
+		collectTasks(0, 0);
+		if (pool && tasks.size() > 1) {
+			pool->parallelFor((unsigned int)tasks.size(), task);
+		}
+		else {
+			for (unsigned int i = 0; i < tasks.size(); ++i) {
+				task(i, 0);
+			}
+		}
+		// Every task wrote at the start of its own instance range, close the gaps
+		uint32_t count = 0;
+		for (const Task& t : tasks) {
+			if (t.first != count && t.count > 0) {
+				memmove(visible + count, visible + t.first, t.count * sizeof(uint32_t));
+			}
+			count += t.count;
+		}
+		return count;
+	}
+
+	uint32_t size() const {
+		return instanceCount;
+	}
+	size_t nodeCount() const {
+		return nodes.size();
+	}
+	// Instances the last refit() rebuilt
+	uint32_t lastRebuiltCount() const {
+		return rebuiltCount;
+	}
+
+private:
+	// Boxes of 4 children or instances, lanes without one never pass a test
+	struct alignas(16) Bounds4 {
+		float minX[4], minY[4], minZ[4];
+		float maxX[4], maxY[4], maxZ[4];
+	};
+	struct Node {
+		Bounds4 bounds;
+		int32_t children[4];   // >= 0 a node, < 0 the leaf ~child
+		uint32_t firstLeaf[5]; // child k has the leaves [firstLeaf[k], firstLeaf[k + 1])
+		int childCount;
+		float area, buildArea; // surface area of all children, now and when built
+	};
+	// A subtree of refit(): its nodes and leaves are contiguous, as the tree is in preorder
+	struct RefitTask {
+		uint32_t firstNode, endNode;
+		uint32_t firstLeaf, endLeaf;
+	};
+	enum class TaskType { Inside, Leaf, Node };
+	struct Task {
+		TaskType type;
+		int32_t ref;
+		uint32_t first, end; // instance range, the task writes its ids from visible + first
+		uint32_t count;
+	};
+
+	std::vector<Node> nodes;      // preorder, children after their parent
+	std::vector<Bounds4> leaves;  // leaf i has the instances order[4i, 4i + 4)
+	std::vector<uint32_t> order;  // instance ids in leaf order
+	uint32_t instanceCount = 0;
+	uint32_t rebuiltCount = 0;
+	bool rebuilding = false;
+	uint32_t nextNode = 0;
+
+	// Per-cull state the tasks read
+	float planes[6][4];
+	bool positive[6][3]; // normal component >= 0, picks the box corner farthest along the normal
+	int planeCount = 0;
+	uint32_t* output = nullptr;
+	std::vector<Task> tasks;
+	std::function<void(unsigned int, unsigned int)> task;
+
+	// Split of refit(), made by build()
+	std::vector<RefitTask> refitTasks;
+	std::vector<uint32_t> topNodes; // the nodes above TASK_DEPTH, preorder
+	const Aabb* refitBounds = nullptr;
+	std::function<void(unsigned int, unsigned int)> refitTask;
+
+	static void setLane(Bounds4& b, int lane, const Aabb& box) {
+		b.minX[lane] = box.min.x;
+		b.minY[lane] = box.min.y;
+		b.minZ[lane] = box.min.z;
+		b.maxX[lane] = box.max.x;
+		b.maxY[lane] = box.max.y;
+		b.maxZ[lane] = box.max.z;
+	}
+	// Large finite values rather than infinities, 0 * inf would make NaN distances
+	static void clearLane(Bounds4& b, int lane) {
+		b.minX[lane] = b.minY[lane] = b.minZ[lane] = FLT_MAX;
+		b.maxX[lane] = b.maxY[lane] = b.maxZ[lane] = -FLT_MAX;
+	}
+	static Aabb merge(const Bounds4& b, int lanes) {
+		Aabb box = { Vec3(FLT_MAX, FLT_MAX, FLT_MAX), Vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX) };
+		for (int k = 0; k < lanes; ++k) {
+			box.min = Vec3(std::min(box.min.x, b.minX[k]), std::min(box.min.y, b.minY[k]), std::min(box.min.z, b.minZ[k]));
+			box.max = Vec3(std::max(box.max.x, b.maxX[k]), std::max(box.max.y, b.maxY[k]), std::max(box.max.z, b.maxZ[k]));
+		}
+		return box;
+	}
+	static float surfaceArea(const Aabb& box) {
+		Vec3 d = box.max - box.min;
+		return d.x < 0.0f ? 0.0f : 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+	}
+	static Vec3 centroid(const Aabb& box) {
+		return (box.min + box.max) * 0.5f;
+	}
+
+	void fillLeaf(const Aabb* bounds, uint32_t leaf) {
+		Bounds4& b = leaves[leaf];
+		for (int k = 0; k < 4; ++k) {
+			uint32_t at = 4 * leaf + k;
+			if (at < instanceCount) {
+				setLane(b, k, bounds[order[at]]);
+			}
+			else {
+				clearLane(b, k);
+			}
+		}
+	}
+
+	Aabb childBounds(int32_t child) const {
+		return child < 0 ? merge(leaves[~child], 4) : merge(nodes[child].bounds, nodes[child].childCount);
+	}
+
+	void refitNode(uint32_t n) {
+		Node& node = nodes[n];
+		for (int k = 0; k < node.childCount; ++k) {
+			setLane(node.bounds, k, childBounds(node.children[k]));
+		}
+		node.area = surfaceArea(merge(node.bounds, node.childCount));
+	}
+
+	void refitSubtree(const RefitTask& t) {
+		for (uint32_t leaf = t.firstLeaf; leaf < t.endLeaf; ++leaf) {
+			fillLeaf(refitBounds, leaf);
+		}
+		for (uint32_t n = t.endNode; n-- > t.firstNode;) {
+			refitNode(n);
+		}
+	}
+
+	// One past the last node of the subtree at n, the subtree of its last node child ends there too
+	uint32_t subtreeEnd(uint32_t n) const {
+		const Node& node = nodes[n];
+		for (int k = node.childCount - 1; k >= 0; --k) {
+			if (node.children[k] >= 0) {
+				return subtreeEnd((uint32_t)node.children[k]);
+			}
+		}
+		return n + 1;
+	}
+
+	void collectRefitTasks(uint32_t n, int depth) {
+		const Node& node = nodes[n];
+		if (depth == TASK_DEPTH) {
+			refitTasks.push_back({ n, subtreeEnd(n), node.firstLeaf[0], node.firstLeaf[node.childCount] });
+			return;
+		}
+		topNodes.push_back(n);
+		for (int k = 0; k < node.childCount; ++k) {
+			if (node.children[k] >= 0) {
+				collectRefitTasks((uint32_t)node.children[k], depth + 1);
+			}
+		}
+	}
+
+	// Sorts order[begin, end) so the first `split` instances are the ones with the smallest centroids
+	// along the longest axis of the range's centroid bounds
+	void partition(const Aabb* bounds, uint32_t begin, uint32_t end, uint32_t split) {
+		if (split <= begin || split >= end) {
+			return;
+		}
+		Vec3 low(FLT_MAX, FLT_MAX, FLT_MAX), high(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		for (uint32_t i = begin; i < end; ++i) {
+			Vec3 c = centroid(bounds[order[i]]);
+			low = Vec3(std::min(low.x, c.x), std::min(low.y, c.y), std::min(low.z, c.z));
+			high = Vec3(std::max(high.x, c.x), std::max(high.y, c.y), std::max(high.z, c.z));
+		}
+		Vec3 d = high - low;
+		int axis = d.x >= d.y && d.x >= d.z ? 0 : d.y >= d.z ? 1 : 2;
+		std::nth_element(order.begin() + begin, order.begin() + split, order.begin() + end, [bounds, axis](uint32_t a, uint32_t b) {
+			const Aabb& x = bounds[a];
+			const Aabb& y = bounds[b];
+			return (&x.min.x)[axis] + (&x.max.x)[axis] < (&y.min.x)[axis] + (&y.max.x)[axis];
+		});
+	}
+
+	uint32_t allocateNode() {
+		if (rebuilding) {
+			return nextNode++;
+		}
+		nodes.emplace_back();
+		return (uint32_t)nodes.size() - 1;
+	}
+
+	// The packets (groups of 4 instances) of a range go to up to 4 children as evenly as halving allows,
+	// so the shape of the tree only depends on the count and every leaf but the very last is full
+	uint32_t buildNode(const Aabb* bounds, uint32_t begin, uint32_t end) {
+		uint32_t n = allocateNode();
+		uint32_t packets = (end - begin + 3) / 4;
+		uint32_t leftPackets = (packets + 1) / 2, rightPackets = packets - leftPackets;
+		uint32_t quarterPackets[4] = { (leftPackets + 1) / 2, leftPackets / 2, (rightPackets + 1) / 2, rightPackets / 2 };
+		uint32_t middle = std::min(begin + 4 * leftPackets, end);
+		partition(bounds, begin, end, middle);
+		uint32_t bounds4[5] = { begin, std::min(begin + 4 * quarterPackets[0], middle), middle, 0, end };
+		bounds4[3] = std::min(middle + 4 * quarterPackets[2], end);
+		partition(bounds, begin, middle, bounds4[1]);
+		partition(bounds, middle, end, bounds4[3]);
+
+		int childCount = 0;
+		int32_t children[4];
+		uint32_t firstLeaf[5];
+		for (int q = 0; q < 4; ++q) {
+			if (quarterPackets[q] == 0) {
+				continue;
+			}
+			firstLeaf[childCount] = bounds4[q] / 4;
+			if (quarterPackets[q] == 1) {
+				fillLeaf(bounds, bounds4[q] / 4);
+				children[childCount++] = ~(int32_t)(bounds4[q] / 4);
+			}
+			else {
+				children[childCount++] = (int32_t)buildNode(bounds, bounds4[q], bounds4[q + 1]);
+			}
+		}
+		firstLeaf[childCount] = (end + 3) / 4;
+
+		Node& node = nodes[n];
+		node.childCount = childCount;
+		for (int k = 0; k < 4; ++k) {
+			node.children[k] = k < childCount ? children[k] : 0;
+			if (k >= childCount) {
+				clearLane(node.bounds, k);
+			}
+		}
+		memcpy(node.firstLeaf, firstLeaf, sizeof(uint32_t) * (childCount + 1));
+		refitNode(n);
+		node.buildArea = node.area;
+		return n;
+	}
+
+	// Same count, same shape: the subtree's nodes and leaves are rewritten where they are
+	void rebuildSubtree(const Aabb* bounds, uint32_t n, uint32_t begin, uint32_t end) {
+		rebuilding = true;
+		nextNode = n;
+		buildNode(bounds, begin, end);
+		rebuilding = false;
+	}
+
+	void prepare(const CullVolume& volume) {
+		planeCount = volume.planeCount;
+		for (int p = 0; p < planeCount; ++p) {
+			const Vec4& plane = volume.planes[p];
+			planes[p][0] = plane.x;
+			planes[p][1] = plane.y;
+			planes[p][2] = plane.z;
+			planes[p][3] = plane.w;
+			positive[p][0] = plane.x >= 0.0f;
+			positive[p][1] = plane.y >= 0.0f;
+			positive[p][2] = plane.z >= 0.0f;
+		}
+	}
+
+	// Bit k of visible: box k touches the volume, of inside: it is entirely in it
+	void classify(const Bounds4& b, int& visible, int& inside) const {
+#ifdef BVH_USE_SSE2
+		__m128 outsideMask = _mm_setzero_ps(), partialMask = _mm_setzero_ps(), zero = _mm_setzero_ps();
+		for (int p = 0; p < planeCount; ++p) {
+			const float* plane = planes[p];
+			// Farthest corner along the normal decides outside, the nearest one inside
+			__m128 farX = _mm_load_ps(positive[p][0] ? b.maxX : b.minX), nearX = _mm_load_ps(positive[p][0] ? b.minX : b.maxX);
+			__m128 farY = _mm_load_ps(positive[p][1] ? b.maxY : b.minY), nearY = _mm_load_ps(positive[p][1] ? b.minY : b.maxY);
+			__m128 farZ = _mm_load_ps(positive[p][2] ? b.maxZ : b.minZ), nearZ = _mm_load_ps(positive[p][2] ? b.minZ : b.maxZ);
+			__m128 a = _mm_set1_ps(plane[0]), bb = _mm_set1_ps(plane[1]), c = _mm_set1_ps(plane[2]), d = _mm_set1_ps(plane[3]);
+			__m128 farDistance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a, farX), _mm_mul_ps(bb, farY)), _mm_add_ps(_mm_mul_ps(c, farZ), d));
+			__m128 nearDistance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a, nearX), _mm_mul_ps(bb, nearY)), _mm_add_ps(_mm_mul_ps(c, nearZ), d));
+			outsideMask = _mm_or_ps(outsideMask, _mm_cmplt_ps(farDistance, zero));
+			partialMask = _mm_or_ps(partialMask, _mm_cmplt_ps(nearDistance, zero));
+		}
+		int outside = _mm_movemask_ps(outsideMask);
+		visible = ~outside & 15;
+		inside = ~(outside | _mm_movemask_ps(partialMask)) & 15;
+#else
+		visible = inside = 0;
+		for (int k = 0; k < 4; ++k) {
+			bool out = false, partial = false;
+			for (int p = 0; p < planeCount; ++p) {
+				const float* plane = planes[p];
+				float farDistance = plane[0] * (positive[p][0] ? b.maxX[k] : b.minX[k]) + plane[1] * (positive[p][1] ? b.maxY[k] : b.minY[k]) +
+									(plane[2] * (positive[p][2] ? b.maxZ[k] : b.minZ[k]) + plane[3]);
+				float nearDistance = plane[0] * (positive[p][0] ? b.minX[k] : b.maxX[k]) + plane[1] * (positive[p][1] ? b.minY[k] : b.maxY[k]) +
+									 (plane[2] * (positive[p][2] ? b.minZ[k] : b.maxZ[k]) + plane[3]);
+				out = out || farDistance < 0.0f;
+				partial = partial || nearDistance < 0.0f;
+			}
+			visible |= !out << k;
+			inside |= (!out && !partial) << k;
+		}
+#endif
+	}
+
+	uint32_t emitRange(uint32_t* out, uint32_t firstLeaf, uint32_t endLeaf) const {
+		uint32_t begin = firstLeaf * 4, end = std::min(endLeaf * 4, instanceCount);
+		memcpy(out, order.data() + begin, (end - begin) * sizeof(uint32_t));
+		return end - begin;
+	}
+
+	uint32_t emitLeaf(uint32_t* out, uint32_t leaf) const {
+		int visible, inside;
+		classify(leaves[leaf], visible, inside);
+		uint32_t count = 0;
+		for (int k = 0; k < 4; ++k) {
+			if (visible >> k & 1) {
+				out[count++] = order[4 * leaf + k];
+			}
+		}
+		return count;
+	}
+
+	uint32_t emitNode(uint32_t* out, uint32_t root) const {
+		uint32_t count = 0;
+		uint32_t stack[128];
+		int top = 0;
+		stack[top++] = root;
+		while (top > 0) {
+			const Node& node = nodes[stack[--top]];
+			int visible, inside;
+			classify(node.bounds, visible, inside);
+			// Children pushed last to first come off the stack in leaf order
+			for (int k = node.childCount - 1; k >= 0; --k) {
+				if (!(visible >> k & 1)) {
+					continue;
+				}
+				int32_t child = node.children[k];
+				if (inside >> k & 1 || child >= 0) {
+					// Ranges and leaves are written when they come off the stack, encoded after the nodes
+					stack[top++] = inside >> k & 1 ? 0x80000000u | (uint32_t)k << 28 | (uint32_t)(&node - nodes.data())
+												  : (uint32_t)child;
+				}
+				else {
+					stack[top++] = 0x40000000u | (uint32_t)~child;
+				}
+			}
+			while (top > 0 && stack[top - 1] & 0xC0000000u) {
+				uint32_t entry = stack[--top];
+				if (entry & 0x80000000u) {
+					const Node& parent = nodes[entry & 0x0FFFFFFFu];
+					int k = entry >> 28 & 3;
+					count += emitRange(out + count, parent.firstLeaf[k], parent.firstLeaf[k + 1]);
+				}
+				else {
+					count += emitLeaf(out + count, entry & 0x3FFFFFFFu);
+				}
+			}
+		}
+		return count;
+	}
+
+	void runTask(Task& t) {
+		uint32_t* out = output + t.first;
+		switch (t.type) {
+		case TaskType::Inside:
+			t.count = t.end - t.first;
+			memcpy(out, order.data() + t.first, t.count * sizeof(uint32_t));
+			break;
+		case TaskType::Leaf:
+			t.count = emitLeaf(out, (uint32_t)t.ref);
+			break;
+		case TaskType::Node:
+			t.count = emitNode(out, (uint32_t)t.ref);
+			break;
+		}
+	}
+
+	// The top levels on the calling thread, what is below TASK_DEPTH becomes one task per subtree
+	void collectTasks(uint32_t n, int depth) {
+		const Node& node = nodes[n];
+		if (depth == TASK_DEPTH) {
+			tasks.push_back({ TaskType::Node, (int32_t)n, node.firstLeaf[0] * 4, 0, 0 });
+			return;
+		}
+		int visible, inside;
+		classify(node.bounds, visible, inside);
+		for (int k = 0; k < node.childCount; ++k) {
+			if (!(visible >> k & 1)) {
+				continue;
+			}
+			uint32_t first = node.firstLeaf[k] * 4, end = std::min(node.firstLeaf[k + 1] * 4, instanceCount);
+			int32_t child = node.children[k];
+			if (inside >> k & 1) {
+				tasks.push_back({ TaskType::Inside, child, first, end, 0 });
+			}
+			else if (child < 0) {
+				tasks.push_back({ TaskType::Leaf, ~child, first, end, 0 });
+			}
+			else {
+				collectTasks((uint32_t)child, depth + 1);
+			}
+		}
+	}
+};
+#endif
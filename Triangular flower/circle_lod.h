@@ -0,0 +1,123 @@
+#ifndef CIRCLE_LOD_H
+#define CIRCLE_LOD_H
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "flower_geometry.h"
+#include "vector_math.h"
+
+// The circle at several segment counts, every level twice the segments of the one before. All levels
+// share one vertex and one index array: the indices already point at their level's vertices, so a level
+// is just a range of the index array. The rim colors are interpolated around the circle from the
+// 8-segment shape, which the level with 8 segments reproduces.
+struct CircleLodMeshes {
+	static const int LEVELS = 7;
+	static const unsigned int MIN_SEGMENTS = 4; // level 0, MIN_SEGMENTS << (LEVELS - 1) at the top
+
+	std::vector<float> vertices; // FLOWER_VERTEX_FLOATS layout, a center then the rim for every level
+	std::vector<unsigned int> indices;
+	uint32_t firstIndex[LEVELS];
+	uint32_t indexCount[LEVELS];
+	float radius = 1.0f; // of the source circle's rim, every level keeps it
+
+	static unsigned int segments(int level) {
+		return MIN_SEGMENTS << level;
+	}
+};
+
+// circleVertices: the 9 vertices of FlowerGeometry::circleVertices, center first, the rim clockwise from
+// the top. The levels are centered on the center vertex with the rim vertices' average distance from it.
+inline void generateCircleLods(const float* circleVertices, CircleLodMeshes& lods) {
+	const double PI = 3.14159265358979323846;
+	const unsigned int RIM = 8;
+	lods.vertices.clear();
+	lods.indices.clear();
+	double radius = 0.0;
+	for (unsigned int k = 0; k < RIM; ++k) {
+		const float* rim = circleVertices + FLOWER_VERTEX_FLOATS * (1 + k);
+		radius += std::sqrt((double)(rim[0] - circleVertices[0]) * (rim[0] - circleVertices[0]) +
+							(double)(rim[1] - circleVertices[1]) * (rim[1] - circleVertices[1]));
+	}
+	lods.radius = (float)(radius / RIM);
+	for (int level = 0; level < CircleLodMeshes::LEVELS; ++level) {
+		unsigned int segments = CircleLodMeshes::segments(level);
+		unsigned int center = (unsigned int)(lods.vertices.size() / FLOWER_VERTEX_FLOATS);
+		lods.vertices.insert(lods.vertices.end(), circleVertices, circleVertices + FLOWER_VERTEX_FLOATS);
+		for (unsigned int j = 0; j < segments; ++j) {
+			// Where the vertex falls between the original rim vertices
+			double along = (double)j * RIM / segments;
+			unsigned int k = (unsigned int)along;
+			float t = (float)(along - k);
+			const float* from = circleVertices + FLOWER_VERTEX_FLOATS * (1 + k);
+			const float* to = circleVertices + FLOWER_VERTEX_FLOATS * (1 + (k + 1) % RIM);
+			double angle = 0.5 * PI - 2.0 * PI * j / segments;
+			float vertex[FLOWER_VERTEX_FLOATS] = { circleVertices[0] + lods.radius * (float)std::cos(angle),
+												   circleVertices[1] + lods.radius * (float)std::sin(angle), circleVertices[2] };
+			for (unsigned int c = 3; c < FLOWER_VERTEX_FLOATS; ++c) {
+				vertex[c] = from[c] + (to[c] - from[c]) * t;
+			}
+			lods.vertices.insert(lods.vertices.end(), vertex, vertex + FLOWER_VERTEX_FLOATS);
+		}
+		lods.firstIndex[level] = (uint32_t)lods.indices.size();
+		lods.indexCount[level] = 3 * segments;
+		lods.indices.resize(lods.indices.size() + 3 * segments);
+		unsigned int* fan = lods.indices.data() + lods.firstIndex[level];
+		generateFanIndices(segments, fan);
+		for (unsigned int i = 0; i < 3 * segments; ++i) {
+			fan[i] += center;
+		}
+	}
+}
+
+// Radius in pixels of the unit circle drawn with this model matrix, the larger axis of an ellipse.
+// halfWidth and halfHeight are half the viewport in pixels. Scale it by CircleLodMeshes::radius for the
+// mesh's circle.
+inline float projectedCircleRadius(const Mat4& model, float halfWidth, float halfHeight) {
+	float w = std::fabs(model.columns[3].w);
+	float x = length(Vec2(model.columns[0].x * halfWidth, model.columns[0].y * halfHeight));
+	float y = length(Vec2(model.columns[1].x * halfWidth, model.columns[1].y * halfHeight));
+	return (x > y ? x : y) / (w > 0.0f ? w : 1.0f);
+}
+
+// Picks the level whose chords stay within a tolerance of the true circle. A chord over n segments
+// misses the circle by at most r (1 - cos(pi / n)), so every level can serve circles up to a radius
+// that is worked out once per tolerance. A circle only moves to a coarser level once it is clearly
+// inside that level's range, so a radius hovering around a boundary does not flip between levels
+// every frame.
+class CircleLodSelector {
+public:
+	// A coarser level is taken once the radius is this much below its limit
+	static constexpr float HYSTERESIS = 0.8f;
+
+	explicit CircleLodSelector(float tolerancePixels = 0.5f) {
+		setTolerance(tolerancePixels);
+	}
+
+	void setTolerance(float tolerancePixels) {
+		const double PI = 3.14159265358979323846;
+		for (int level = 0; level < CircleLodMeshes::LEVELS; ++level) {
+			double sagitta = 1.0 - std::cos(PI / CircleLodMeshes::segments(level));
+			maxRadius[level] = (float)(tolerancePixels / sagitta);
+		}
+	}
+
+	// The finest level is the answer for anything larger than its limit. Counting the limits below the
+	// radius instead of searching keeps the random sizes of a field from mispredicting branches.
+	int select(float radiusPixels, int current) const {
+		int level = 0;
+		for (int l = 0; l < CircleLodMeshes::LEVELS - 1; ++l) {
+			level += radiusPixels > maxRadius[l];
+		}
+		bool keep = level < current && radiusPixels > HYSTERESIS * maxRadius[current > 0 ? current - 1 : 0];
+		return keep ? current : level;
+	}
+
+	float levelMaxRadius(int level) const {
+		return maxRadius[level];
+	}
+
+private:
+	float maxRadius[CircleLodMeshes::LEVELS];
+};
+#endif
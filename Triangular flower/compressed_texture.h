@@ -0,0 +1,131 @@
+#ifndef COMPRESSED_TEXTURE_H
+#define COMPRESSED_TEXTURE_H
+
+#include <glad/glad.h>
+
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include "ktx2.h"
+#include "mapped_file.h"
+#include "texture_compression.h"
+
+// Extension and GL 4.2/4.3 formats missing from the 3.3 core loader
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_RGBA_BPTC_UNORM
+#define GL_COMPRESSED_RGBA_BPTC_UNORM 0x8E8C
+#endif
+#ifndef GL_COMPRESSED_RGB8_ETC2
+#define GL_COMPRESSED_RGB8_ETC2 0x9274
+#endif
+
+namespace compressed_texture {
+	inline GLenum glFormat(BlockFormat format) {
+		switch (format) {
+		case BlockFormat::BC1: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+		case BlockFormat::BC3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+		case BlockFormat::BC7: return GL_COMPRESSED_RGBA_BPTC_UNORM;
+		case BlockFormat::ETC2: return GL_COMPRESSED_RGB8_ETC2;
+		}
+		return 0;
+	}
+
+	// The extension that adds a format to a GL 3.3 context
+	inline const char* extension(GLenum format) {
+		switch (format) {
+		case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+		case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT: return "GL_EXT_texture_compression_s3tc";
+		case GL_COMPRESSED_RGBA_BPTC_UNORM: return "GL_ARB_texture_compression_bptc";
+		case GL_COMPRESSED_RGB8_ETC2: return "GL_ARB_ES3_compatibility";
+		}
+		return "";
+	}
+
+	// Listed as a compressed format or, since drivers leave some out of that list, its extension is there
+	inline bool formatSupported(GLenum format) {
+		GLint extensions = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &extensions);
+		for (GLint i = 0; i < extensions; ++i) {
+			const char* name = (const char*)glGetStringi(GL_EXTENSIONS, (GLuint)i);
+			if (name && strcmp(name, extension(format)) == 0) {
+				return true;
+			}
+		}
+		GLint count = 0;
+		glGetIntegerv(GL_NUM_COMPRESSED_TEXTURE_FORMATS, &count);
+		std::vector<GLint> formats((size_t)count);
+		if (count > 0) {
+			glGetIntegerv(GL_COMPRESSED_TEXTURE_FORMATS, formats.data());
+		}
+		for (GLint supported : formats) {
+			if ((GLenum)supported == format) {
+				return true;
+			}
+		}
+		return false;
+	}
+}
+
+// Creates a texture with every level of a KTX2 file. The file is memory mapped and the blocks go to
+// glCompressedTexImage2D as they are, so the CPU never touches the payload. Formats the driver does not
+// list are decoded to RGBA8 on the CPU instead. Returns 0 on failure, uploadedBytes gets the bytes handed to GL.
+inline unsigned int loadCompressedTexture(const char* path, size_t* uploadedBytes = nullptr) {
+	MappedFile file;
+	if (!file.open(path)) {
+		std::cout << "ERROR::TEXTURE::FILE_NOT_SUCCESFULLY_READ " << path << std::endl;
+		return 0;
+	}
+	Ktx2Texture ktx;
+	const char* error = nullptr;
+	if (!parseKtx2(file.data(), file.size(), ktx, error)) {
+		std::cout << "ERROR::TEXTURE::DECODE_FAILED " << path << ": " << error << std::endl;
+		return 0;
+	}
+	if (ktx.topDown) {
+		std::cout << "WARNING::TEXTURE::TOP_DOWN_ROWS " << path << " is shown upside down" << std::endl;
+	}
+	GLenum format = compressed_texture::glFormat(ktx.format);
+	bool native = compressed_texture::formatSupported(format);
+	if (!native) {
+		std::cout << "WARNING::TEXTURE::COMPRESSED_FORMAT_NOT_SUPPORTED " << blockFormatInfo(ktx.format).name
+				  << ", decoding " << path << " on the CPU" << std::endl;
+	}
+
+	unsigned int texture = 0;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	std::vector<unsigned char> decoded;
+	size_t bytes = 0;
+	for (int level = 0; level < ktx.levelCount; ++level) {
+		int width = ktx.width >> level ? ktx.width >> level : 1, height = ktx.height >> level ? ktx.height >> level : 1;
+		if (native) {
+			glCompressedTexImage2D(GL_TEXTURE_2D, level, format, width, height, 0, (GLsizei)ktx.levelBytes[level], ktx.levels[level]);
+			bytes += ktx.levelBytes[level];
+			continue;
+		}
+		decoded.resize((size_t)width * height * 4);
+		if (!decompressImage(ktx.levels[level], width, height, ktx.format, decoded.data()) && level == 0) {
+			std::cout << "WARNING::TEXTURE::UNSUPPORTED_BLOCK_MODE " << path << " has blocks the CPU decoder leaves black" << std::endl;
+		}
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, decoded.data());
+		bytes += decoded.size();
+	}
+	if (uploadedBytes) {
+		*uploadedBytes = bytes;
+	}
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, ktx.levelCount - 1);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, ktx.levelCount > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	return texture;
+}
+#endif
@@ -0,0 +1,111 @@
+#ifndef FLOWER_GEOMETRY_H
+#define FLOWER_GEOMETRY_H
+
+#include <cmath>
+
+// Vertex layout of the flower: position (x, y, z) followed by color (r, g, b)
+const unsigned int FLOWER_VERTEX_FLOATS = 6;
+
+// Vertices and indices of both shapes, in the order configureVAOsAndVBOs uploads them
+struct FlowerGeometry {
+	float triangleVertices[9 * FLOWER_VERTEX_FLOATS];
+	unsigned int triangleIndices[4 * 3];
+	float circleVertices[9 * FLOWER_VERTEX_FLOATS];
+	unsigned int circleIndices[8 * 3];
+};
+
+// Triangle fan around vertex 0: 0, 1, 2 / 0, 2, 3 / ... / 0, segments, 1
+inline void generateFanIndices(unsigned int segments, unsigned int* indices) {
+	for (unsigned int i = 0; i < segments; ++i) {
+		indices[3 * i] = 0;
+		indices[3 * i + 1] = 1 + i;
+		indices[3 * i + 2] = 1 + (i + 1) % segments;
+	}
+}
+
+// Separate petals sharing the center vertex 0: 0, 1, 2 / 0, 3, 4 / ...
+inline void generatePetalIndices(unsigned int petals, unsigned int* indices) {
+	for (unsigned int i = 0; i < petals; ++i) {
+		indices[3 * i] = 0;
+		indices[3 * i + 1] = 1 + 2 * i;
+		indices[3 * i + 2] = 2 + 2 * i;
+	}
+}
+
+// One random color per vertex, drawn red, green, blue in vertex order
+template <typename Generator, typename Distribution>
+void fillRandomColors(float* colors, unsigned int vertexCount, Generator& gen, Distribution& distr) {
+	for (unsigned int i = 0; i < 3 * vertexCount; ++i) {
+		colors[i] = (float)distr(gen);
+	}
+}
+
+// Packs separate position and color arrays into the interleaved FLOWER_VERTEX_FLOATS layout
+inline void interleaveVertices(const float* positions, const float* colors, unsigned int vertexCount, float* vertices) {
+	for (unsigned int i = 0; i < vertexCount; ++i) {
+		float* vertex = vertices + FLOWER_VERTEX_FLOATS * i;
+		vertex[0] = positions[3 * i];
+		vertex[1] = positions[3 * i + 1];
+		vertex[2] = positions[3 * i + 2];
+		vertex[3] = colors[3 * i];
+		vertex[4] = colors[3 * i + 1];
+		vertex[5] = colors[3 * i + 2];
+	}
+}
+
+// Per-frame color shift the shaders add to the vertex colors
+inline void computeColorGradient(float time, float& r, float& g, float& b) {
+	r = sin(time) / 4;
+	g = cos(time) / 4;
+	b = -sin(time) / 4;
+}
+
+// Fills the shapes with random vertex colors. The colors are drawn in the same order as the
+// original arrays in main, so a fixed seed gives the same image on the GL and the CPU path.
+template <typename Generator, typename Distribution>
+void generateFlowerGeometry(FlowerGeometry& geometry, Generator& gen, Distribution& distr) {
+	const float c = (float)cos(0.78539816339744830962); // cos(pi / 4) == sin(pi / 4)
+
+	const float trianglePositions[] = {
+		 0.0f,  0.0f, 0.0f,
+
+		 0.5f,  1.0f, 0.0f,
+		 1.0f,  0.5f, 0.0f,
+
+		 1.0f, -0.5f, 0.0f,
+		 0.5f, -1.0f, 0.0f,
+
+		-0.5f, -1.0f, 0.0f,
+		-1.0f, -0.5f, 0.0f,
+
+		-1.0f,  0.5f, 0.0f,
+		-0.5f,  1.0f, 0.0f,
+	};
+
+	const float circlePositions[] = {
+		 0.0f,  0.0f, 0.0f,
+
+		 0.0f,  1.0f, 0.0f,
+		 c,     c,    0.0f,
+
+		 1.0f,  0.0f, 0.0f,
+		 c,    -c,    0.0f,
+
+		 0.0f, -1.0f, 0.0f,
+		-c,    -c,    0.0f,
+
+		-1.0f,  0.0f, 0.0f,
+		-c,     c,    0.0f,
+	};
+
+	const unsigned int vertexCount = sizeof(trianglePositions) / sizeof(float) / 3;
+	float triangleColors[3 * vertexCount], circleColors[3 * vertexCount];
+	fillRandomColors(triangleColors, vertexCount, gen, distr);
+	fillRandomColors(circleColors, vertexCount, gen, distr);
+
+	interleaveVertices(trianglePositions, triangleColors, vertexCount, geometry.triangleVertices);
+	interleaveVertices(circlePositions, circleColors, vertexCount, geometry.circleVertices);
+	generatePetalIndices(4, geometry.triangleIndices);
+	generateFanIndices(8, geometry.circleIndices);
+}
+#endif
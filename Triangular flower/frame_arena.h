@@ -0,0 +1,153 @@
+#ifndef FRAME_ARENA_H
+#define FRAME_ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+// Bump allocator for data that lives for one frame: draw lists, scratch arrays, temporary strings.
+// allocate() only moves an offset forward and reset(), called once the frame is swapped, frees
+// everything at once. A frame that needs more than the capacity gets the rest from the heap, and
+// the next reset grows the arena to that frame's high-water mark, so a steady state stays off the heap.
+class FrameArena {
+public:
+	explicit FrameArena(size_t capacity = 64 * 1024) {
+		grow(capacity);
+	}
+	~FrameArena() {
+		releaseOverflow();
+		std::free(memory);
+	}
+
+	FrameArena(const FrameArena&) = delete;
+	FrameArena& operator=(const FrameArena&) = delete;
+
+	// alignment must be a power of two
+	void* allocate(size_t size, size_t alignment = alignof(std::max_align_t)) {
+		size_t offset = (used + alignment - 1) & ~(alignment - 1);
+		if (offset + size <= capacityBytes) {
+			used = offset + size;
+			return memory + offset;
+		}
+		return allocateOverflow(size, alignment);
+	}
+
+	template <typename T>
+	T* allocateArray(size_t count) {
+		return static_cast<T*>(allocate(count * sizeof(T), alignof(T)));
+	}
+
+	// Zero-terminated copy of the first length characters
+	const char* copyString(const char* text, size_t length) {
+		char* copy = allocateArray<char>(length + 1);
+		memcpy(copy, text, length);
+		copy[length] = '\0';
+		return copy;
+	}
+
+	// Frees everything handed out since the last reset. Nothing allocated from the arena may be used afterwards.
+	void reset() {
+		size_t frameBytes = used + overflowBytes;
+		if (frameBytes > highWaterBytes) {
+			highWaterBytes = frameBytes;
+		}
+		if (!overflow.empty()) {
+			releaseOverflow();
+			// Room for the whole frame plus some headroom, the blocks are the ones the overflow took
+			size_t capacity = frameBytes + frameBytes / 2;
+			std::cout << "WARNING::FRAME_ARENA::OVERFLOW frame used " << frameBytes << " bytes, growing to " << capacity << std::endl;
+			grow(capacity);
+		}
+		used = 0;
+		overflowBytes = 0;
+	}
+
+	size_t capacity() const {
+		return capacityBytes;
+	}
+	size_t bytesUsed() const {
+		return used + overflowBytes;
+	}
+	size_t highWater() const {
+		return highWaterBytes;
+	}
+	unsigned int overflowCount() const {
+		return overflows;
+	}
+
+private:
+	char* memory = nullptr;
+	size_t capacityBytes = 0, used = 0;
+	size_t highWaterBytes = 0, overflowBytes = 0;
+	unsigned int overflows = 0;
+	std::vector<void*> overflow; // heap blocks of this frame, freed at reset
+
+	void grow(size_t capacity) {
+		std::free(memory);
+		memory = static_cast<char*>(std::malloc(capacity));
+		if (!memory) {
+			throw std::bad_alloc();
+		}
+		capacityBytes = capacity;
+	}
+
+	void* allocateOverflow(size_t size, size_t alignment) {
+		char* block = static_cast<char*>(std::malloc(size + alignment));
+		if (!block) {
+			throw std::bad_alloc();
+		}
+		overflow.push_back(block);
+		overflowBytes += size + alignment;
+		++overflows;
+		return reinterpret_cast<void*>((reinterpret_cast<uintptr_t>(block) + alignment - 1) & ~(uintptr_t)(alignment - 1));
+	}
+
+	void releaseOverflow() {
+		for (void* block : overflow) {
+			std::free(block);
+		}
+		overflow.clear();
+	}
+};
+
+// STL allocator on a FrameArena. deallocate() does nothing, the memory comes back at reset(), so a
+// container must be gone (or never touched again) by then. Growing containers leave their old blocks
+// behind until the reset; reserve() the expected size when it is known.
+template <typename T>
+class FrameAllocator {
+public:
+	typedef T value_type;
+
+	explicit FrameAllocator(FrameArena& arena) : arena(&arena) {
+	}
+	template <typename U>
+	FrameAllocator(const FrameAllocator<U>& other) : arena(other.arena) {
+	}
+
+	T* allocate(size_t count) {
+		return arena->allocateArray<T>(count);
+	}
+	void deallocate(T*, size_t) {
+	}
+
+	FrameArena* arena;
+};
+
+template <typename T, typename U>
+inline bool operator==(const FrameAllocator<T>& a, const FrameAllocator<U>& b) {
+	return a.arena == b.arena;
+}
+template <typename T, typename U>
+inline bool operator!=(const FrameAllocator<T>& a, const FrameAllocator<U>& b) {
+	return a.arena != b.arena;
+}
+
+template <typename T>
+using FrameVector = std::vector<T, FrameAllocator<T>>;
+typedef std::basic_string<char, std::char_traits<char>, FrameAllocator<char>> FrameString;
+#endif
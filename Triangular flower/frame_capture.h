@@ -0,0 +1,351 @@
+#ifndef FRAME_CAPTURE_H
+#define FRAME_CAPTURE_H
+
+#include <glad/glad.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define CAPTURE_USE_SSE2
+#if defined(_MSC_VER) || defined(__SSSE3__)
+#include <tmmintrin.h>
+#define CAPTURE_USE_SSSE3
+#endif
+#endif
+
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+#define CAPTURE_PIPE_MODE "wb"
+#else
+#define CAPTURE_PIPE_MODE "w"
+#endif
+
+enum class CaptureFormat {
+	Y4M, // YUV4MPEG2 with 4:2:0 JPEG range chroma, playable and accepted by every encoder
+	RGB, // headerless rgb24 frames (ffmpeg -f rawvideo -pix_fmt rgb24 -s WxH)
+};
+
+// Pixel conversions used by the capture, rows are flipped since GL stores them bottom to top.
+namespace capture_convert {
+	// RGBA -> RGB
+	inline void rgbaToRgb(const unsigned char* rgba, int width, int height, unsigned char* rgb) {
+		for (int y = 0; y < height; ++y) {
+			const unsigned char* src = rgba + (size_t)(height - 1 - y) * width * 4;
+			unsigned char* dst = rgb + (size_t)y * width * 3;
+			int x = 0;
+#ifdef CAPTURE_USE_SSSE3
+			// 16 RGBA bytes -> 12 RGB bytes, stores 16 so the last 4 pixels of a row go through the scalar path
+			const __m128i shuffle = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+			for (; x + 5 < width; x += 4) {
+				__m128i pixels = _mm_loadu_si128((const __m128i*)(src + x * 4));
+				_mm_storeu_si128((__m128i*)(dst + x * 3), _mm_shuffle_epi8(pixels, shuffle));
+			}
+#endif
+			for (; x < width; ++x) {
+				dst[x * 3 + 0] = src[x * 4 + 0];
+				dst[x * 3 + 1] = src[x * 4 + 1];
+				dst[x * 3 + 2] = src[x * 4 + 2];
+			}
+		}
+	}
+
+	// Full range BT.601 (JFIF) in 8.8 fixed point
+	inline unsigned char lumaScalar(int r, int g, int b) {
+		return (unsigned char)((77 * r + 150 * g + 29 * b + 128) >> 8);
+	}
+
+	// RGBA -> planar YUV 4:2:0, width and height have to be even
+	inline void rgbaToYuv420(const unsigned char* rgba, int width, int height, unsigned char* yuv) {
+		unsigned char* planeY = yuv;
+		unsigned char* planeU = yuv + (size_t)width * height;
+		unsigned char* planeV = planeU + (size_t)(width / 2) * (height / 2);
+		for (int y = 0; y < height; y += 2) {
+			const unsigned char* row0 = rgba + (size_t)(height - 1 - y) * width * 4;
+			const unsigned char* row1 = row0 - (size_t)width * 4;
+			unsigned char* y0 = planeY + (size_t)y * width;
+			unsigned char* y1 = y0 + width;
+			unsigned char* u = planeU + (size_t)(y / 2) * (width / 2);
+			unsigned char* v = planeV + (size_t)(y / 2) * (width / 2);
+			int x = 0;
+#ifdef CAPTURE_USE_SSE2
+			const __m128i zero = _mm_setzero_si128();
+			const __m128i lumaWeights = _mm_setr_epi16(77, 150, 29, 0, 77, 150, 29, 0);
+			const __m128i uWeights = _mm_setr_epi16(-43, -85, 128, 0, -43, -85, 128, 0);
+			const __m128i vWeights = _mm_setr_epi16(128, -107, -21, 0, 128, -107, -21, 0);
+			const __m128i round = _mm_set1_epi32(128);
+			const __m128i chromaRound = _mm_set1_epi32(128 * 256 * 4 + 512);
+			// 4 pixels of two rows per step: 8 luma samples, 2 U and 2 V samples
+			for (; x + 4 <= width; x += 4) {
+				__m128i top = _mm_loadu_si128((const __m128i*)(row0 + x * 4));
+				__m128i bottom = _mm_loadu_si128((const __m128i*)(row1 + x * 4));
+				__m128i topLo = _mm_unpacklo_epi8(top, zero), topHi = _mm_unpackhi_epi8(top, zero);
+				__m128i bottomLo = _mm_unpacklo_epi8(bottom, zero), bottomHi = _mm_unpackhi_epi8(bottom, zero);
+
+				// madd gives r*wr + g*wg and b*wb + a*0 per pixel, adding the neighbours finishes the dot product
+				__m128i l0 = _mm_madd_epi16(topLo, lumaWeights), l1 = _mm_madd_epi16(topHi, lumaWeights);
+				__m128i l2 = _mm_madd_epi16(bottomLo, lumaWeights), l3 = _mm_madd_epi16(bottomHi, lumaWeights);
+				__m128i lumaTop = _mm_add_epi32(_mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(l0), _mm_castsi128_ps(l1), _MM_SHUFFLE(2, 0, 2, 0))),
+												_mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(l0), _mm_castsi128_ps(l1), _MM_SHUFFLE(3, 1, 3, 1))));
+				__m128i lumaBottom = _mm_add_epi32(_mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(l2), _mm_castsi128_ps(l3), _MM_SHUFFLE(2, 0, 2, 0))),
+												   _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(l2), _mm_castsi128_ps(l3), _MM_SHUFFLE(3, 1, 3, 1))));
+				lumaTop = _mm_srai_epi32(_mm_add_epi32(lumaTop, round), 8);
+				lumaBottom = _mm_srai_epi32(_mm_add_epi32(lumaBottom, round), 8);
+				__m128i luma = _mm_packus_epi16(_mm_packs_epi32(lumaTop, lumaBottom), zero);
+				uint32_t lumaTopBytes = (uint32_t)_mm_cvtsi128_si32(luma);
+				uint32_t lumaBottomBytes = (uint32_t)_mm_cvtsi128_si32(_mm_srli_si128(luma, 4));
+				memcpy(y0 + x, &lumaTopBytes, 4);
+				memcpy(y1 + x, &lumaBottomBytes, 4);
+
+				// Sum of each 2x2 block: lo half = pixels 0,1, hi half = pixels 2,3
+				__m128i sumLo = _mm_add_epi16(topLo, bottomLo), sumHi = _mm_add_epi16(topHi, bottomHi);
+				__m128i blocks = _mm_add_epi16(_mm_unpacklo_epi64(sumLo, sumHi), _mm_unpackhi_epi64(sumLo, sumHi));
+				__m128i us = _mm_madd_epi16(blocks, uWeights), vs = _mm_madd_epi16(blocks, vWeights);
+				us = _mm_add_epi32(us, _mm_shuffle_epi32(us, _MM_SHUFFLE(2, 3, 0, 1)));
+				vs = _mm_add_epi32(vs, _mm_shuffle_epi32(vs, _MM_SHUFFLE(2, 3, 0, 1)));
+				us = _mm_srai_epi32(_mm_add_epi32(us, chromaRound), 10);
+				vs = _mm_srai_epi32(_mm_add_epi32(vs, chromaRound), 10);
+				__m128i chroma = _mm_packus_epi16(_mm_packs_epi32(us, vs), zero);
+				u[x / 2] = (unsigned char)_mm_extract_epi16(chroma, 0);
+				u[x / 2 + 1] = (unsigned char)(_mm_extract_epi16(chroma, 1) >> 8);
+				v[x / 2] = (unsigned char)_mm_extract_epi16(chroma, 2);
+				v[x / 2 + 1] = (unsigned char)(_mm_extract_epi16(chroma, 3) >> 8);
+			}
+#endif
+			for (; x < width; x += 2) {
+				const unsigned char* p[4] = { row0 + x * 4, row0 + x * 4 + 4, row1 + x * 4, row1 + x * 4 + 4 };
+				y0[x] = lumaScalar(p[0][0], p[0][1], p[0][2]);
+				y0[x + 1] = lumaScalar(p[1][0], p[1][1], p[1][2]);
+				y1[x] = lumaScalar(p[2][0], p[2][1], p[2][2]);
+				y1[x + 1] = lumaScalar(p[3][0], p[3][1], p[3][2]);
+				int r = p[0][0] + p[1][0] + p[2][0] + p[3][0];
+				int g = p[0][1] + p[1][1] + p[2][1] + p[3][1];
+				int b = p[0][2] + p[1][2] + p[2][2] + p[3][2];
+				int cu = (-43 * r - 85 * g + 128 * b + 128 * 256 * 4 + 512) >> 10;
+				int cv = (128 * r - 107 * g - 21 * b + 128 * 256 * 4 + 512) >> 10;
+				u[x / 2] = (unsigned char)(cu < 0 ? 0 : cu > 255 ? 255 : cu);
+				v[x / 2] = (unsigned char)(cv < 0 ? 0 : cv > 255 ? 255 : cv);
+			}
+		}
+	}
+}
+
+// Captures rendered frames without stalling the pipeline.
+// Every frame is read with glReadPixels into one pixel pack buffer of a ring and fenced. The buffer is
+// mapped in a later frame once its fence has signaled (waiting only if the GPU is a whole ring behind),
+// converted straight out of the mapping and handed to a writer thread, which owns the (possibly
+// blocking) file or pipe output.
+class FrameCapture {
+public:
+	static const unsigned int RING_SIZE = 4;
+	static const unsigned int MAX_QUEUED = 8; // converted frames waiting for the writer
+
+	~FrameCapture() {
+		close();
+	}
+
+	// Opens a file, or a pipe to an external encoder when `isPipe` is set (e.g. "ffmpeg -i - out.mp4").
+	// Needs a current GL context; the captured area is fixed to width x height from the lower left corner.
+	bool open(const char* target, bool isPipe, int width, int height, int fps, CaptureFormat format) {
+		if (format == CaptureFormat::Y4M) {
+			// 4:2:0 needs even dimensions
+			width &= ~1;
+			height &= ~1;
+		}
+		this->width = width;
+		this->height = height;
+		this->format = format;
+		this->isPipe = isPipe;
+		output = isPipe ? popen(target, CAPTURE_PIPE_MODE) : fopen(target, "wb");
+		if (!output) {
+			std::cout << "ERROR::CAPTURE::OUTPUT_NOT_SUCCESFULLY_OPENED " << target << std::endl;
+			return false;
+		}
+		if (format == CaptureFormat::Y4M) {
+			fprintf(output, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", width, height, fps);
+		}
+
+		glGenBuffers(RING_SIZE, buffers);
+		for (unsigned int i = 0; i < RING_SIZE; ++i) {
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, buffers[i]);
+			glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)width * height * 4, NULL, GL_STREAM_READ);
+			fences[i] = 0;
+		}
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		head = 0;
+		count = 0;
+		// Every frame that can be in flight (queued, being written, being converted) is allocated
+		// here, so capturing does not touch the heap once it runs
+		freeFrames.clear();
+		for (unsigned int i = 0; i < MAX_QUEUED + 2; ++i) {
+			freeFrames.push_back(std::vector<unsigned char>(frameBytes()));
+		}
+		queueHead = 0;
+		queueCount = 0;
+		running = true;
+		writer = std::thread(&FrameCapture::writeLoop, this);
+		return true;
+	}
+
+	bool isOpen() const {
+		return running;
+	}
+
+	// Call after the frame is rendered, before swapping buffers
+	void captureFrame() {
+		if (!running) {
+			return;
+		}
+		if (count == RING_SIZE) {
+			// All buffers in flight: take the oldest, waiting only if the GPU is a whole ring behind
+			retire(true);
+		}
+		unsigned int slot = (head + count) % RING_SIZE;
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, buffers[slot]);
+		glPixelStorei(GL_PACK_ALIGNMENT, 4);
+		glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, (void*)0);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		++count;
+		++capturedFrames;
+		// Retire every buffer that is already done
+		while (count > 0 && retire(false)) {
+		}
+	}
+
+	// Drains the ring and the writer, closes the output
+	void close() {
+		if (!running) {
+			return;
+		}
+		while (count > 0) {
+			retire(true);
+		}
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			running = false;
+		}
+		queueChanged.notify_all();
+		writer.join();
+		glDeleteBuffers(RING_SIZE, buffers);
+		if (isPipe) {
+			pclose(output);
+		}
+		else {
+			fclose(output);
+		}
+		output = nullptr;
+		std::cout << "Capture: " << capturedFrames << " frames, " << gpuStalls << " waits for the GPU, "
+				  << writerStalls << " waits for the writer" << std::endl;
+	}
+
+private:
+	int width = 0, height = 0;
+	CaptureFormat format = CaptureFormat::Y4M;
+	bool isPipe = false;
+	FILE* output = nullptr;
+
+	unsigned int buffers[RING_SIZE];
+	GLsync fences[RING_SIZE];
+	unsigned int head = 0, count = 0;
+	unsigned long long capturedFrames = 0, gpuStalls = 0, writerStalls = 0;
+
+	// Converted frames travel to the writer thread through a ring and come back through `freeFrames`
+	std::mutex mutex;
+	std::condition_variable queueChanged;
+	std::vector<unsigned char> queuedFrames[MAX_QUEUED];
+	unsigned int queueHead = 0, queueCount = 0;
+	std::vector<std::vector<unsigned char>> freeFrames;
+	bool running = false;
+	std::thread writer;
+
+	size_t frameBytes() const {
+		return format == CaptureFormat::Y4M ? (size_t)width * height * 3 / 2 : (size_t)width * height * 3;
+	}
+
+	// Maps, converts and queues the oldest buffer. Without `wait`, returns false if its fence has not signaled yet.
+	bool retire(bool wait) {
+		unsigned int slot = head;
+		GLenum status = glClientWaitSync(fences[slot], 0, 0);
+		if (status == GL_TIMEOUT_EXPIRED) {
+			if (!wait) {
+				return false;
+			}
+			++gpuStalls;
+			while (glClientWaitSync(fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED) {
+			}
+		}
+		glDeleteSync(fences[slot]);
+		fences[slot] = 0;
+
+		std::vector<unsigned char> frame;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			if (queueCount >= MAX_QUEUED) {
+				++writerStalls;
+				queueChanged.wait(lock, [this] { return queueCount < MAX_QUEUED; });
+			}
+			if (!freeFrames.empty()) {
+				frame.swap(freeFrames.back());
+				freeFrames.pop_back();
+			}
+		}
+		frame.resize(frameBytes());
+
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, buffers[slot]);
+		const unsigned char* pixels = (const unsigned char*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, (GLsizeiptr)width * height * 4, GL_MAP_READ_BIT);
+		if (pixels) {
+			if (format == CaptureFormat::Y4M) {
+				capture_convert::rgbaToYuv420(pixels, width, height, frame.data());
+			}
+			else {
+				capture_convert::rgbaToRgb(pixels, width, height, frame.data());
+			}
+			glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		}
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			queuedFrames[(queueHead + queueCount) % MAX_QUEUED].swap(frame);
+			++queueCount;
+		}
+		queueChanged.notify_all();
+		head = (head + 1) % RING_SIZE;
+		--count;
+		return true;
+	}
+
+	void writeLoop() {
+		std::unique_lock<std::mutex> lock(mutex);
+		while (true) {
+			queueChanged.wait(lock, [this] { return queueCount > 0 || !running; });
+			if (queueCount == 0) {
+				return;
+			}
+			std::vector<unsigned char> frame;
+			frame.swap(queuedFrames[queueHead]);
+			queueHead = (queueHead + 1) % MAX_QUEUED;
+			--queueCount;
+			lock.unlock();
+			queueChanged.notify_all();
+
+			if (format == CaptureFormat::Y4M) {
+				fputs("FRAME\n", output);
+			}
+			fwrite(frame.data(), 1, frame.size(), output);
+
+			lock.lock();
+			freeFrames.push_back(std::move(frame));
+		}
+	}
+};
+#endif
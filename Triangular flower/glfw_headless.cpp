@@ -0,0 +1,480 @@
+// Headless replacement for the GLFW library.
+// Implements the part of the GLFW API the demos use on top of a display-less GL context, so both
+// main.cpp files build and run unchanged on machines without a window system (render farm, CI).
+// The "window" is a framebuffer object of the requested size, the program renders a fixed number
+// of frames into it and then glfwWindowShouldClose returns true.
+//
+// Context backends:
+//   default         EGL with EGL_PLATFORM_SURFACELESS_MESA (Mesa llvmpipe works without a GPU)
+//   HEADLESS_OSMESA OSMesa, for systems that ship Mesa without EGL
+//
+// Build instead of linking glfw3, e.g. from "Triangular flower":
+//   gcc -c src/glad.c -I../Linking/include
+//   g++ -std=c++17 -I../Linking/include src/main.cpp glfw_headless.cpp glad.o -lEGL -ldl -pthread
+// (link -lOSMesa instead of -lEGL when HEADLESS_OSMESA is defined)
+//
+// Verification, each run must exit with 0 (the demos assert steady frames do not allocate):
+//   HEADLESS_FRAMES=300 ./a.out --seed 1 [--single-thread] [--defragment-check]
+//   HEADLESS_FRAMES=40 HEADLESS_FIXED_DT=0.05 HEADLESS_OUTPUT=last.ppm ./a.out --seed 1 [--single-thread]
+//   the REGRESS_* golden check of regression.h
+// The screenshot and the final report are made inside the last frame and exempt from the allocation check.
+//
+// Environment:
+//   HEADLESS_FRAMES   number of frames to render before closing (default 100)
+//   HEADLESS_OUTPUT   binary PPM file the last frame is written to
+//   HEADLESS_FIXED_DT makes glfwGetTime deterministic: frame number * this many seconds
+//                     (1/60 by default when REGRESS_DIR is set, real time otherwise)
+//   REGRESS_*         golden-image and frame-budget checks, see regression.h
+//
+// Like GLFW, the event functions belong to the main thread while another thread may own the context
+// and swap. Waiting for events then blocks until that thread has finished a frame.
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+#include "allocation_counter.h"
+#include "regression.h"
+
+#ifdef HEADLESS_OSMESA
+// Declared here instead of including GL/osmesa.h, which drags in GL/gl.h next to glad
+typedef struct osmesa_context* OSMesaContext;
+typedef void (*OSMESAproc)();
+extern "C" {
+	OSMesaContext OSMesaCreateContextAttribs(const int* attribList, OSMesaContext sharelist);
+	GLboolean OSMesaMakeCurrent(OSMesaContext ctx, void* buffer, GLenum type, GLsizei width, GLsizei height);
+	void OSMesaDestroyContext(OSMesaContext ctx);
+	OSMESAproc OSMesaGetProcAddress(const char* funcName);
+}
+#define OSMESA_FORMAT              0x22
+#define OSMESA_RGBA                GL_RGBA
+#define OSMESA_PROFILE             0x33
+#define OSMESA_CORE_PROFILE        0x34
+#define OSMESA_CONTEXT_MAJOR_VERSION 0x36
+#define OSMESA_CONTEXT_MINOR_VERSION 0x37
+#else
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+struct GLFWwindow {
+	int width, height;
+	std::atomic<bool> shouldClose{ false };
+	void* userPointer = nullptr;
+	GLFWframebuffersizefun framebufferSizeCallback = nullptr;
+	GLFWwindowrefreshfun refreshCallback = nullptr;
+	GLFWwindowclosefun closeCallback = nullptr;
+#ifdef HEADLESS_OSMESA
+	OSMesaContext context = nullptr;
+	std::vector<unsigned char> buffer; // OSMesa needs a client side default framebuffer
+#else
+	EGLContext context = EGL_NO_CONTEXT;
+#endif
+	unsigned int framebuffer = 0, colorbuffer = 0, depthbuffer = 0;
+	std::atomic<long long> frame{ 0 };
+};
+
+namespace {
+	struct HeadlessState {
+		int major = 1, minor = 0, profile = GLFW_OPENGL_ANY_PROFILE;
+		long long frames = 100;
+		const char* output = nullptr;
+		std::chrono::steady_clock::time_point start;
+		double timeOffset = 0.0;
+		double fixedDt = 0.0;
+		RegressionHarness regression;
+		bool regressionPassed = true;
+		GLFWwindow* window = nullptr; // the first window, the one that counts the frames
+		// Waiting for events returns once a frame was swapped since the last wait or an empty event
+		// was posted
+		std::mutex waitMutex;
+		std::condition_variable waitCondition;
+		long long waitedFrame = -1;
+		bool emptyEvent = false;
+#ifndef HEADLESS_OSMESA
+		EGLDisplay display = EGL_NO_DISPLAY;
+#endif
+	} state;
+	// Contexts are current per thread, as in GLFW
+	thread_local GLFWwindow* currentWindow = nullptr;
+
+	void writeFrame(GLFWwindow* window, const char* path) {
+		std::vector<unsigned char> pixels((size_t)window->width * window->height * 3);
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		glReadPixels(0, 0, window->width, window->height, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+		FILE* file = fopen(path, "wb");
+		if (!file) {
+			std::cout << "ERROR::HEADLESS::FILE_NOT_SUCCESFULLY_WRITTEN " << path << std::endl;
+			return;
+		}
+		fprintf(file, "P6\n%d %d\n255\n", window->width, window->height);
+		// GL rows go bottom to top
+		for (int y = window->height - 1; y >= 0; --y) {
+			fwrite(&pixels[(size_t)y * window->width * 3], 1, (size_t)window->width * 3, file);
+		}
+		fclose(file);
+	}
+}
+
+extern "C" {
+
+int glfwInit(void) {
+	if (const char* frames = getenv("HEADLESS_FRAMES")) {
+		state.frames = atoll(frames);
+	}
+	state.output = getenv("HEADLESS_OUTPUT");
+	if (const char* dt = getenv("HEADLESS_FIXED_DT")) {
+		state.fixedDt = atof(dt);
+	}
+	else if (getenv("REGRESS_DIR")) {
+		// Goldens need the same animation time every run
+		state.fixedDt = 1.0 / 60.0;
+	}
+	state.regression.configureFromEnvironment(state.frames);
+	state.start = std::chrono::steady_clock::now();
+#ifndef HEADLESS_OSMESA
+	PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+		(PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	if (getPlatformDisplay == nullptr) {
+		std::cout << "ERROR::HEADLESS::EGL_EXT_PLATFORM_BASE_NOT_SUPPORTED" << std::endl;
+		return GLFW_FALSE;
+	}
+	state.display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+	EGLint major, minor;
+	if (state.display == EGL_NO_DISPLAY || !eglInitialize(state.display, &major, &minor)) {
+		std::cout << "ERROR::HEADLESS::EGL_INITIALIZATION_FAILED" << std::endl;
+		return GLFW_FALSE;
+	}
+	eglBindAPI(EGL_OPENGL_API);
+#endif
+	return GLFW_TRUE;
+}
+
+void glfwTerminate(void) {
+	if (!state.regressionPassed) {
+		// glfwTerminate is the last thing the demos do, fail the run here
+		std::exit(1);
+	}
+#ifndef HEADLESS_OSMESA
+	if (state.display != EGL_NO_DISPLAY) {
+		eglTerminate(state.display);
+		state.display = EGL_NO_DISPLAY;
+	}
+#endif
+}
+
+void glfwWindowHint(int hint, int value) {
+	if (hint == GLFW_CONTEXT_VERSION_MAJOR) {
+		state.major = value;
+	}
+	else if (hint == GLFW_CONTEXT_VERSION_MINOR) {
+		state.minor = value;
+	}
+	else if (hint == GLFW_OPENGL_PROFILE) {
+		state.profile = value;
+	}
+}
+
+GLFWwindow* glfwCreateWindow(int width, int height, const char* title, GLFWmonitor* monitor, GLFWwindow* share) {
+	GLFWwindow* previous = currentWindow;
+	GLFWwindow* window = new GLFWwindow();
+	window->width = width;
+	window->height = height;
+
+#ifdef HEADLESS_OSMESA
+	const int attributes[] = {
+		OSMESA_FORMAT, OSMESA_RGBA,
+		OSMESA_PROFILE, OSMESA_CORE_PROFILE,
+		OSMESA_CONTEXT_MAJOR_VERSION, state.major,
+		OSMESA_CONTEXT_MINOR_VERSION, state.minor,
+		0
+	};
+	window->context = OSMesaCreateContextAttribs(attributes, share ? share->context : nullptr);
+	if (window->context == nullptr) {
+		delete window;
+		return nullptr;
+	}
+	window->buffer.resize((size_t)width * height * 4);
+	OSMesaMakeCurrent(window->context, window->buffer.data(), GL_UNSIGNED_BYTE, width, height);
+	gladLoadGLLoader((GLADloadproc)OSMesaGetProcAddress);
+#else
+	const EGLint configAttributes[] = {
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_NONE
+	};
+	// Surfaceless displays may expose no configs at all, a context without one
+	// (EGL_KHR_no_config_context) is all we need since rendering goes into a framebuffer object
+	EGLConfig config = EGL_NO_CONFIG_KHR;
+	EGLint configCount = 0;
+	if (!eglChooseConfig(state.display, configAttributes, &config, 1, &configCount) || configCount == 0) {
+		config = EGL_NO_CONFIG_KHR;
+	}
+	const EGLint contextAttributes[] = {
+		EGL_CONTEXT_MAJOR_VERSION, state.major,
+		EGL_CONTEXT_MINOR_VERSION, state.minor,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, state.profile == GLFW_OPENGL_COMPAT_PROFILE ?
+			EGL_CONTEXT_OPENGL_COMPATIBILITY_PROFILE_BIT : EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+	window->context = eglCreateContext(state.display, config, share ? share->context : EGL_NO_CONTEXT, contextAttributes);
+	if (window->context == EGL_NO_CONTEXT) {
+		delete window;
+		return nullptr;
+	}
+	// Needs EGL_KHR_surfaceless_context, which every Mesa driver has
+	eglMakeCurrent(state.display, EGL_NO_SURFACE, EGL_NO_SURFACE, window->context);
+	gladLoadGLLoader((GLADloadproc)eglGetProcAddress);
+#endif
+
+	// The offscreen "window": color and depth/stencil renderbuffers of the requested size
+	glGenFramebuffers(1, &window->framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, window->framebuffer);
+	glGenRenderbuffers(1, &window->colorbuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, window->colorbuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, window->colorbuffer);
+	glGenRenderbuffers(1, &window->depthbuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, window->depthbuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, window->depthbuffer);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		std::cout << "ERROR::HEADLESS::FRAMEBUFFER_INCOMPLETE" << std::endl;
+	}
+	glViewport(0, 0, width, height);
+	// Later windows, like a loader's hidden one for a shared context, are not rendered or checked
+	if (state.window == nullptr) {
+		state.window = window;
+		state.regression.beginFrame();
+		std::cout << "Headless " << title << ": " << width << "x" << height << ", " << state.frames << " frames on "
+				  << glGetString(GL_RENDERER) << std::endl;
+	}
+	// As in GLFW, creating a window leaves the calling thread's context current
+	glfwMakeContextCurrent(previous);
+	return window;
+}
+
+void glfwDestroyWindow(GLFWwindow* window) {
+	if (window == nullptr) {
+		return;
+	}
+#ifdef HEADLESS_OSMESA
+	OSMesaDestroyContext(window->context);
+#else
+	if (currentWindow == window) {
+		eglMakeCurrent(state.display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	}
+	eglDestroyContext(state.display, window->context);
+#endif
+	if (currentWindow == window) {
+		currentWindow = nullptr;
+	}
+	if (state.window == window) {
+		state.window = nullptr;
+	}
+	delete window;
+}
+
+void glfwMakeContextCurrent(GLFWwindow* window) {
+	currentWindow = window;
+	if (window == nullptr) {
+#ifndef HEADLESS_OSMESA
+		eglMakeCurrent(state.display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+#endif
+		return;
+	}
+#ifdef HEADLESS_OSMESA
+	OSMesaMakeCurrent(window->context, window->buffer.data(), GL_UNSIGNED_BYTE, window->width, window->height);
+#else
+	eglMakeCurrent(state.display, EGL_NO_SURFACE, EGL_NO_SURFACE, window->context);
+#endif
+	glBindFramebuffer(GL_FRAMEBUFFER, window->framebuffer);
+}
+
+GLFWwindow* glfwGetCurrentContext(void) {
+	return currentWindow;
+}
+
+GLFWglproc glfwGetProcAddress(const char* procname) {
+#ifdef HEADLESS_OSMESA
+	return (GLFWglproc)OSMesaGetProcAddress(procname);
+#else
+	return (GLFWglproc)eglGetProcAddress(procname);
+#endif
+}
+
+int glfwExtensionSupported(const char* extension) {
+	GLint count = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+	for (GLint i = 0; i < count; ++i) {
+		if (strcmp((const char*)glGetStringi(GL_EXTENSIONS, i), extension) == 0) {
+			return GLFW_TRUE;
+		}
+	}
+	return GLFW_FALSE;
+}
+
+void glfwSwapInterval(int interval) {
+}
+
+void glfwSwapBuffers(GLFWwindow* window) {
+	++window->frame;
+	state.regression.endFrame(window->frame, window->width, window->height);
+	if (window->frame >= state.frames) {
+		// The screenshot and the report are not frame work, the demo's allocation check skips them
+		AllocationExemption exemption;
+		if (state.output) {
+			writeFrame(window, state.output);
+		}
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - state.start).count();
+		std::cout << "Headless: " << window->frame << " frames in " << seconds << " s ("
+				  << window->frame / seconds << " fps)" << std::endl;
+		window->shouldClose = true;
+		state.regressionPassed = state.regression.finish();
+	}
+	glFlush();
+	{
+		std::lock_guard<std::mutex> lock(state.waitMutex);
+	}
+	state.waitCondition.notify_all();
+	state.regression.beginFrame();
+}
+
+int glfwWindowShouldClose(GLFWwindow* window) {
+	return window->shouldClose ? GLFW_TRUE : GLFW_FALSE;
+}
+
+void glfwSetWindowShouldClose(GLFWwindow* window, int value) {
+	window->shouldClose = value != 0;
+}
+
+void glfwGetFramebufferSize(GLFWwindow* window, int* width, int* height) {
+	if (width) {
+		*width = window->width;
+	}
+	if (height) {
+		*height = window->height;
+	}
+}
+
+void glfwGetWindowSize(GLFWwindow* window, int* width, int* height) {
+	glfwGetFramebufferSize(window, width, height);
+}
+
+void glfwSetWindowUserPointer(GLFWwindow* window, void* pointer) {
+	window->userPointer = pointer;
+}
+
+void* glfwGetWindowUserPointer(GLFWwindow* window) {
+	return window->userPointer;
+}
+
+// There is no user, so there is no input either
+void glfwPollEvents(void) {
+}
+
+// Nothing ever happens to an offscreen framebuffer. To keep on-demand loops producing their fixed
+// number of frames, waiting reports the window as damaged. It only blocks while no frame was swapped
+// since the last wait, which happens when another thread draws, so the event thread does not spin.
+void glfwWaitEventsTimeout(double timeout) {
+	GLFWwindow* window = state.window;
+	if (window == nullptr) {
+		return;
+	}
+	{
+		std::unique_lock<std::mutex> lock(state.waitMutex);
+		state.waitCondition.wait_for(lock, std::chrono::duration<double>(timeout), [window] {
+			return window->frame != state.waitedFrame || state.emptyEvent || window->shouldClose;
+		});
+		state.waitedFrame = window->frame;
+		state.emptyEvent = false;
+	}
+	if (window->refreshCallback) {
+		window->refreshCallback(window);
+	}
+}
+
+void glfwWaitEvents(void) {
+	glfwWaitEventsTimeout(0.1);
+}
+
+void glfwPostEmptyEvent(void) {
+	{
+		std::lock_guard<std::mutex> lock(state.waitMutex);
+		state.emptyEvent = true;
+	}
+	state.waitCondition.notify_all();
+}
+
+int glfwGetKey(GLFWwindow* window, int key) {
+	return GLFW_RELEASE;
+}
+
+int glfwGetMouseButton(GLFWwindow* window, int button) {
+	return GLFW_RELEASE;
+}
+
+void glfwGetCursorPos(GLFWwindow* window, double* x, double* y) {
+	if (x) {
+		*x = 0.0;
+	}
+	if (y) {
+		*y = 0.0;
+	}
+}
+
+double glfwGetTime(void) {
+	if (state.fixedDt > 0.0) {
+		long long frame = state.window ? state.window->frame.load() : 0;
+		return frame * state.fixedDt + state.timeOffset;
+	}
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - state.start).count() + state.timeOffset;
+}
+
+void glfwSetTime(double time) {
+	state.timeOffset = time - (glfwGetTime() - state.timeOffset);
+}
+
+GLFWframebuffersizefun glfwSetFramebufferSizeCallback(GLFWwindow* window, GLFWframebuffersizefun callback) {
+	GLFWframebuffersizefun previous = window->framebufferSizeCallback;
+	window->framebufferSizeCallback = callback;
+	return previous;
+}
+
+GLFWwindowrefreshfun glfwSetWindowRefreshCallback(GLFWwindow* window, GLFWwindowrefreshfun callback) {
+	GLFWwindowrefreshfun previous = window->refreshCallback;
+	window->refreshCallback = callback;
+	return previous;
+}
+
+GLFWwindowclosefun glfwSetWindowCloseCallback(GLFWwindow* window, GLFWwindowclosefun callback) {
+	GLFWwindowclosefun previous = window->closeCallback;
+	window->closeCallback = callback;
+	return previous;
+}
+
+GLFWkeyfun glfwSetKeyCallback(GLFWwindow* window, GLFWkeyfun callback) {
+	return nullptr;
+}
+
+GLFWmousebuttonfun glfwSetMouseButtonCallback(GLFWwindow* window, GLFWmousebuttonfun callback) {
+	return nullptr;
+}
+
+GLFWcursorposfun glfwSetCursorPosCallback(GLFWwindow* window, GLFWcursorposfun callback) {
+	return nullptr;
+}
+
+GLFWscrollfun glfwSetScrollCallback(GLFWwindow* window, GLFWscrollfun callback) {
+	return nullptr;
+}
+
+}
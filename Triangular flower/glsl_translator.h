@@ -0,0 +1,1021 @@
+#ifndef GLSL_TRANSLATOR_H
+#define GLSL_TRANSLATOR_H
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Translator for the GLSL 3.30 subset of shaders/*.txt into straight-line code over scalar registers,
+// which runs through ShaderInterpreter or is written out by generateShaderKernel as a C++ kernel that
+// processes SHADER_LANES invocations at a time (see shader_lanes.h).
+//
+// Supported: in, out and uniform declarations of float, vec2, vec3, vec4 and mat4 (layout(location = N) orders the
+// inputs), gl_Position, local declarations, assignments (=, +=, -=, *=, /=) to variables and swizzles,
+// + - * /, unary minus, constructors, swizzles, mat4 columns (m[1]), matrix products and the built-ins abs,
+// min, max, clamp, mix, step, smoothstep, floor, fract, sqrt, pow, sin, cos, dot, length and normalize.
+// A mat4 takes 16 components, column after column, like glUniformMatrix4fv without transposing.
+// Not supported: control flow, other matrix types, integers, samplers and user functions.
+
+enum class ShaderOp { Input, Uniform, Constant, Add, Sub, Mul, Div, Neg, Min, Max, Abs, Sqrt, Floor, Step, Sin, Cos, Pow };
+
+struct ShaderInstruction {
+	ShaderOp op;
+	int a, b; // operand registers, the stream component for Input and the uniform component for Uniform
+	float value; // Constant
+};
+
+struct ShaderVariable {
+	std::string name;
+	int components;
+	int firstComponent; // into the flattened input streams, uniform array or output streams
+};
+
+// A translated shader in SSA form: instruction i writes register i
+struct ShaderProgramIR {
+	std::vector<ShaderInstruction> code;
+	std::vector<ShaderVariable> inputs, uniforms, outputs;
+	int inputComponents = 0, uniformComponents = 0, outputComponents = 0;
+	std::vector<int> outputRegisters; // one per output component
+};
+
+// The arithmetic of every operation, shared by the interpreter and constant folding
+inline float evaluateShaderOp(ShaderOp op, float a, float b) {
+	switch (op) {
+	case ShaderOp::Add: return a + b;
+	case ShaderOp::Sub: return a - b;
+	case ShaderOp::Mul: return a * b;
+	case ShaderOp::Div: return a / b;
+	case ShaderOp::Neg: return -a;
+	case ShaderOp::Min: return a < b ? a : b;
+	case ShaderOp::Max: return a > b ? a : b;
+	case ShaderOp::Abs: return std::fabs(a);
+	case ShaderOp::Sqrt: return std::sqrt(a);
+	case ShaderOp::Floor: return std::floor(a);
+	case ShaderOp::Step: return b >= a ? 1.0f : 0.0f;
+	case ShaderOp::Sin: return std::sin(a);
+	case ShaderOp::Cos: return std::cos(a);
+	case ShaderOp::Pow: return std::pow(a, b);
+	default: return 0.0f;
+	}
+}
+
+class GlslTranslator {
+public:
+	// Translates the shader source, anything outside the subset is reported on std::cout and returns false
+	bool translate(const std::string& source, ShaderProgramIR& result) {
+		program = ShaderProgramIR();
+		variables.clear();
+		constants.clear();
+		expressions.clear();
+		tokens.clear();
+		position = 0;
+		failed = false;
+		writesPosition = false;
+		std::vector<Declaration> inputs, uniforms, outputs;
+
+		tokenize(source);
+		while (!failed && peek().kind != TokenKind::End) {
+			int location = -1;
+			if (accept("layout")) {
+				expect("(");
+				expect("location");
+				expect("=");
+				location = (int)number();
+				expect(")");
+			}
+			if (accept("precision")) {
+				while (!failed && peek().kind != TokenKind::End && !accept(";")) {
+					next();
+				}
+			}
+			else if (peek().text == "in" || peek().text == "out" || peek().text == "uniform") {
+				std::string qualifier = next().text;
+				Declaration declaration;
+				declaration.components = type();
+				declaration.name = identifier();
+				declaration.location = location;
+				expect(";");
+				(qualifier == "in" ? inputs : qualifier == "out" ? outputs : uniforms).push_back(declaration);
+			}
+			else if (accept("void")) {
+				expect("main");
+				expect("(");
+				expect(")");
+				expect("{");
+				declareStreams(inputs, uniforms, outputs);
+				while (!failed && !accept("}")) {
+					statement();
+				}
+			}
+			else {
+				error("unexpected '" + peek().text + "' at file scope");
+			}
+		}
+		if (failed) {
+			return false;
+		}
+		collectOutputs(outputs);
+		removeDeadCode();
+		result = program;
+		return true;
+	}
+
+	static bool loadFile(const char* path, std::string& source) {
+		std::ifstream file(path, std::ios::binary);
+		if (!file) {
+			std::cout << "ERROR::TRANSLATOR::FILE_NOT_SUCCESFULLY_READ " << path << std::endl;
+			return false;
+		}
+		std::stringstream stream;
+		stream << file.rdbuf();
+		source = stream.str();
+		return true;
+	}
+
+private:
+	enum class TokenKind { Identifier, Number, Symbol, End };
+	struct Token {
+		TokenKind kind;
+		std::string text;
+		int line;
+	};
+	struct Declaration {
+		std::string name;
+		int components;
+		int location;
+	};
+	// An expression: up to 4 component registers, 16 for a mat4
+	struct Value {
+		int size = 0;
+		int reg[16] = { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 };
+	};
+
+	ShaderProgramIR program;
+	std::map<std::string, Value> variables;
+	std::map<unsigned int, int> constants; // float bits -> register
+	std::map<std::vector<int>, int> expressions; // (op, a, b) -> register, shares repeated subexpressions
+	std::vector<Token> tokens;
+	size_t position = 0;
+	bool failed = false;
+	bool writesPosition = false;
+
+	// Lexing
+
+	void tokenize(const std::string& source) {
+		int line = 1;
+		size_t i = 0;
+		while (i < source.size()) {
+			char c = source[i];
+			if (c == '\n') {
+				++line;
+				++i;
+			}
+			else if (isspace((unsigned char)c)) {
+				++i;
+			}
+			else if (c == '#') {
+				// #version and other preprocessor lines
+				while (i < source.size() && source[i] != '\n') {
+					++i;
+				}
+			}
+			else if (source.compare(i, 2, "//") == 0) {
+				while (i < source.size() && source[i] != '\n') {
+					++i;
+				}
+			}
+			else if (source.compare(i, 2, "/*") == 0) {
+				size_t end = source.find("*/", i + 2);
+				end = end == std::string::npos ? source.size() : end + 2;
+				line += (int)std::count(source.begin() + i, source.begin() + end, '\n');
+				i = end;
+			}
+			else if (isalpha((unsigned char)c) || c == '_') {
+				size_t start = i;
+				while (i < source.size() && (isalnum((unsigned char)source[i]) || source[i] == '_')) {
+					++i;
+				}
+				tokens.push_back({ TokenKind::Identifier, source.substr(start, i - start), line });
+			}
+			else if (isdigit((unsigned char)c) || (c == '.' && i + 1 < source.size() && isdigit((unsigned char)source[i + 1]))) {
+				size_t start = i;
+				while (i < source.size() && (isdigit((unsigned char)source[i]) || source[i] == '.')) {
+					++i;
+				}
+				if (i < source.size() && (source[i] == 'e' || source[i] == 'E')) {
+					++i;
+					if (i < source.size() && (source[i] == '+' || source[i] == '-')) {
+						++i;
+					}
+					while (i < source.size() && isdigit((unsigned char)source[i])) {
+						++i;
+					}
+				}
+				tokens.push_back({ TokenKind::Number, source.substr(start, i - start), line });
+				if (i < source.size() && (source[i] == 'f' || source[i] == 'F')) {
+					++i;
+				}
+			}
+			else {
+				static const char* const pairs[] = { "+=", "-=", "*=", "/=", "==", "!=", "<=", ">=", "&&", "||", "++", "--" };
+				std::string text(1, c);
+				for (const char* pair : pairs) {
+					if (source.compare(i, 2, pair) == 0) {
+						text = pair;
+					}
+				}
+				tokens.push_back({ TokenKind::Symbol, text, line });
+				i += text.size();
+			}
+		}
+		tokens.push_back({ TokenKind::End, "end of file", line });
+	}
+
+	const Token& peek() const {
+		return tokens[position];
+	}
+
+	const Token& next() {
+		const Token& token = tokens[position];
+		if (token.kind != TokenKind::End) {
+			++position;
+		}
+		return token;
+	}
+
+	bool accept(const char* text) {
+		if (!failed && peek().kind != TokenKind::End && peek().text == text) {
+			++position;
+			return true;
+		}
+		return false;
+	}
+
+	void expect(const char* text) {
+		if (!accept(text)) {
+			error(std::string("expected '") + text + "' but found '" + peek().text + "'");
+		}
+	}
+
+	std::string identifier() {
+		if (peek().kind != TokenKind::Identifier) {
+			error("expected a name but found '" + peek().text + "'");
+			return std::string();
+		}
+		return next().text;
+	}
+
+	double number() {
+		if (peek().kind != TokenKind::Number) {
+			error("expected a number but found '" + peek().text + "'");
+			return 0.0;
+		}
+		return atof(next().text.c_str());
+	}
+
+	void error(const std::string& message) {
+		if (!failed) {
+			std::cout << "ERROR::TRANSLATOR::UNSUPPORTED line " << peek().line << ": " << message << std::endl;
+		}
+		failed = true;
+	}
+
+	static int typeComponents(const std::string& name) {
+		if (name == "float") {
+			return 1;
+		}
+		if (name == "vec2" || name == "vec3" || name == "vec4") {
+			return name[3] - '0';
+		}
+		if (name == "mat4") {
+			return 16;
+		}
+		return 0;
+	}
+
+	int type() {
+		int components = typeComponents(peek().text);
+		if (components == 0) {
+			error("unsupported type '" + peek().text + "'");
+			return 1;
+		}
+		next();
+		return components;
+	}
+
+	// Code emission
+
+	int emit(ShaderOp op, int a, int b = -1, float value = 0.0f) {
+		if (op == ShaderOp::Constant) {
+			unsigned int bits;
+			memcpy(&bits, &value, sizeof(bits));
+			std::map<unsigned int, int>::iterator found = constants.find(bits);
+			if (found != constants.end()) {
+				return found->second;
+			}
+			program.code.push_back({ op, -1, -1, value });
+			return constants[bits] = (int)program.code.size() - 1;
+		}
+		bool unary = op == ShaderOp::Neg || op == ShaderOp::Abs || op == ShaderOp::Sqrt || op == ShaderOp::Floor ||
+					 op == ShaderOp::Sin || op == ShaderOp::Cos;
+		if (op != ShaderOp::Input && op != ShaderOp::Uniform && isConstant(a) && (unary || isConstant(b))) {
+			return emit(ShaderOp::Constant, -1, -1, evaluateShaderOp(op, program.code[a].value, unary ? 0.0f : program.code[b].value));
+		}
+		// x * 1 and x + 0, as in m * vec4(p, 1.0)
+		if ((op == ShaderOp::Mul && isConstant(b, 1.0f)) || (op == ShaderOp::Add && isConstant(b, 0.0f))) {
+			return a;
+		}
+		if ((op == ShaderOp::Mul && isConstant(a, 1.0f)) || (op == ShaderOp::Add && isConstant(a, 0.0f))) {
+			return b;
+		}
+		std::vector<int> key = { (int)op, a, unary ? -1 : b };
+		std::map<std::vector<int>, int>::iterator found = expressions.find(key);
+		if (found != expressions.end()) {
+			return found->second;
+		}
+		program.code.push_back({ op, a, unary ? -1 : b, 0.0f });
+		return expressions[key] = (int)program.code.size() - 1;
+	}
+
+	bool isConstant(int reg) const {
+		return reg >= 0 && program.code[reg].op == ShaderOp::Constant;
+	}
+
+	bool isConstant(int reg, float value) const {
+		return isConstant(reg) && program.code[reg].value == value;
+	}
+
+	Value constant(float value, int size = 1) {
+		Value result;
+		result.size = size;
+		for (int i = 0; i < size; ++i) {
+			result.reg[i] = emit(ShaderOp::Constant, -1, -1, value);
+		}
+		return result;
+	}
+
+	// Component-wise operation, a scalar operand is broadcast to the other's size
+	Value binary(ShaderOp op, const Value& a, const Value& b) {
+		if (a.size != b.size && a.size != 1 && b.size != 1) {
+			error("operands of different sizes");
+			return a;
+		}
+		Value result;
+		result.size = std::max(a.size, b.size);
+		for (int i = 0; i < result.size; ++i) {
+			result.reg[i] = emit(op, a.reg[a.size == 1 ? 0 : i], b.reg[b.size == 1 ? 0 : i]);
+		}
+		return result;
+	}
+
+	static bool isMatrix(const Value& value) {
+		return value.size == 16;
+	}
+
+	static Value column(const Value& matrix, int index) {
+		Value result;
+		result.size = 4;
+		for (int i = 0; i < 4; ++i) {
+			result.reg[i] = matrix.reg[4 * index + i];
+		}
+		return result;
+	}
+
+	static Value component(const Value& vector, int index) {
+		Value result;
+		result.size = 1;
+		result.reg[0] = vector.reg[index];
+		return result;
+	}
+
+	// * of GLSL: linear algebra products with a mat4 operand, component-wise otherwise
+	Value multiply(const Value& a, const Value& b) {
+		if (isMatrix(a) && isMatrix(b)) {
+			Value result;
+			result.size = 16;
+			for (int c = 0; c < 4; ++c) {
+				Value product = multiply(a, column(b, c));
+				for (int i = 0; i < 4; ++i) {
+					result.reg[4 * c + i] = product.reg[i];
+				}
+			}
+			return result;
+		}
+		if (isMatrix(a) && b.size == 4) {
+			Value sum = binary(ShaderOp::Mul, column(a, 0), component(b, 0));
+			for (int c = 1; c < 4; ++c) {
+				sum = binary(ShaderOp::Add, sum, binary(ShaderOp::Mul, column(a, c), component(b, c)));
+			}
+			return sum;
+		}
+		if (a.size == 4 && isMatrix(b)) {
+			Value result;
+			result.size = 4;
+			for (int c = 0; c < 4; ++c) {
+				result.reg[c] = dot(a, column(b, c)).reg[0];
+			}
+			return result;
+		}
+		if ((isMatrix(a) || isMatrix(b)) && a.size != 1 && b.size != 1) {
+			error("a mat4 multiplies a vec4, a mat4 or a scalar");
+			return a;
+		}
+		return binary(ShaderOp::Mul, a, b);
+	}
+
+	Value unary(ShaderOp op, const Value& a) {
+		Value result;
+		result.size = a.size;
+		for (int i = 0; i < a.size; ++i) {
+			result.reg[i] = emit(op, a.reg[i]);
+		}
+		return result;
+	}
+
+	// Inputs and uniforms read their components up front, unused ones are removed at the end
+	void declareStreams(std::vector<Declaration>& inputs, const std::vector<Declaration>& uniforms, const std::vector<Declaration>& outputs) {
+		std::stable_sort(inputs.begin(), inputs.end(), [](const Declaration& a, const Declaration& b) {
+			return (unsigned int)a.location < (unsigned int)b.location;
+		});
+		for (const Declaration& input : inputs) {
+			program.inputs.push_back({ input.name, input.components, program.inputComponents });
+			Value value;
+			value.size = input.components;
+			for (int i = 0; i < input.components; ++i) {
+				value.reg[i] = emit(ShaderOp::Input, program.inputComponents++);
+			}
+			variables[input.name] = value;
+		}
+		for (const Declaration& uniform : uniforms) {
+			program.uniforms.push_back({ uniform.name, uniform.components, program.uniformComponents });
+			Value value;
+			value.size = uniform.components;
+			for (int i = 0; i < uniform.components; ++i) {
+				value.reg[i] = emit(ShaderOp::Uniform, program.uniformComponents++);
+			}
+			variables[uniform.name] = value;
+		}
+		// Outputs start as zero, GLSL leaves unwritten outputs undefined
+		variables["gl_Position"] = constant(0.0f, 4);
+		for (const Declaration& output : outputs) {
+			variables[output.name] = constant(0.0f, output.components);
+		}
+	}
+
+	void collectOutputs(const std::vector<Declaration>& outputs) {
+		std::vector<Declaration> written;
+		if (writesPosition) {
+			written.push_back({ "gl_Position", 4, -1 });
+		}
+		written.insert(written.end(), outputs.begin(), outputs.end());
+		for (const Declaration& output : written) {
+			program.outputs.push_back({ output.name, output.components, program.outputComponents });
+			const Value& value = variables[output.name];
+			for (int i = 0; i < output.components; ++i) {
+				program.outputRegisters.push_back(value.reg[i]);
+			}
+			program.outputComponents += output.components;
+		}
+	}
+
+	// Drops instructions no output depends on and renumbers the registers
+	void removeDeadCode() {
+		std::vector<bool> live(program.code.size(), false);
+		for (int reg : program.outputRegisters) {
+			live[reg] = true;
+		}
+		for (int i = (int)program.code.size() - 1; i >= 0; --i) {
+			const ShaderInstruction& instruction = program.code[i];
+			if (live[i] && instruction.op != ShaderOp::Input && instruction.op != ShaderOp::Uniform) {
+				if (instruction.a >= 0) {
+					live[instruction.a] = true;
+				}
+				if (instruction.b >= 0) {
+					live[instruction.b] = true;
+				}
+			}
+		}
+		std::vector<int> renumbered(program.code.size(), -1);
+		std::vector<ShaderInstruction> code;
+		for (size_t i = 0; i < program.code.size(); ++i) {
+			if (!live[i]) {
+				continue;
+			}
+			ShaderInstruction instruction = program.code[i];
+			if (instruction.op != ShaderOp::Input && instruction.op != ShaderOp::Uniform) {
+				instruction.a = instruction.a >= 0 ? renumbered[instruction.a] : -1;
+				instruction.b = instruction.b >= 0 ? renumbered[instruction.b] : -1;
+			}
+			renumbered[i] = (int)code.size();
+			code.push_back(instruction);
+		}
+		program.code = code;
+		for (int& reg : program.outputRegisters) {
+			reg = renumbered[reg];
+		}
+	}
+
+	// Statements
+
+	void statement() {
+		if (accept(";")) {
+			return;
+		}
+		if (typeComponents(peek().text) != 0) {
+			int components = type();
+			std::string name = identifier();
+			Value value = constant(0.0f, components);
+			if (accept("=")) {
+				value = expression();
+				if (value.size != components && value.size != 1) {
+					error("cannot initialize " + std::to_string(components) + " components from " + std::to_string(value.size));
+				}
+				value = convert(value, components);
+			}
+			expect(";");
+			variables[name] = value;
+			return;
+		}
+
+		std::string name = identifier();
+		if (failed) {
+			return;
+		}
+		std::map<std::string, Value>::iterator variable = variables.find(name);
+		if (variable == variables.end()) {
+			// mat3 m; or if (...) and the like
+			if (peek().kind == TokenKind::Identifier) {
+				error("unsupported type '" + name + "'");
+			}
+			else if (peek().text == "(" || peek().text == "{") {
+				error("unsupported statement '" + name + "'");
+			}
+			else {
+				error("unknown variable '" + name + "'");
+			}
+			return;
+		}
+		int selection[16] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 };
+		int selected = variable->second.size;
+		if (accept(".")) {
+			selected = swizzle(identifier(), variable->second.size, selection);
+		}
+		std::string assignment = next().text;
+		if (assignment != "=" && assignment != "+=" && assignment != "-=" && assignment != "*=" && assignment != "/=") {
+			error("expected an assignment but found '" + assignment + "'");
+			return;
+		}
+		Value value = expression();
+		expect(";");
+		if (failed) {
+			return;
+		}
+
+		Value current;
+		current.size = selected;
+		for (int i = 0; i < selected; ++i) {
+			current.reg[i] = variable->second.reg[selection[i]];
+		}
+		if (assignment != "=") {
+			ShaderOp op = assignment == "+=" ? ShaderOp::Add : assignment == "-=" ? ShaderOp::Sub :
+						  assignment == "*=" ? ShaderOp::Mul : ShaderOp::Div;
+			value = op == ShaderOp::Mul ? multiply(current, value) : binary(op, current, value);
+		}
+		if (value.size == 1 && selected > 1) {
+			value = convert(value, selected);
+		}
+		if (value.size != selected) {
+			error("assigning " + std::to_string(value.size) + " components to " + std::to_string(selected));
+			return;
+		}
+		for (int i = 0; i < selected; ++i) {
+			variable->second.reg[selection[i]] = value.reg[i];
+		}
+		if (name == "gl_Position") {
+			writesPosition = true;
+		}
+	}
+
+	// Fills selection with the component indices of a swizzle and returns how many there are
+	int swizzle(const std::string& text, int size, int* selection) {
+		static const char* const sets[] = { "xyzw", "rgba", "stpq" };
+		if (text.empty() || text.size() > 4 || size > 4) {
+			error("bad swizzle '" + text + "'");
+			return 1;
+		}
+		for (size_t i = 0; i < text.size(); ++i) {
+			int component = -1;
+			for (const char* set : sets) {
+				const char* found = strchr(set, text[i]);
+				if (found && *found) {
+					component = (int)(found - set);
+				}
+			}
+			if (component < 0 || component >= size) {
+				error("bad swizzle '" + text + "'");
+				return 1;
+			}
+			selection[i] = component;
+		}
+		return (int)text.size();
+	}
+
+	// Expressions
+
+	Value expression() {
+		Value value = term();
+		for (;;) {
+			if (accept("+")) {
+				value = binary(ShaderOp::Add, value, term());
+			}
+			else if (accept("-")) {
+				value = binary(ShaderOp::Sub, value, term());
+			}
+			else {
+				return value;
+			}
+		}
+	}
+
+	Value term() {
+		Value value = unaryExpression();
+		for (;;) {
+			if (accept("*")) {
+				value = multiply(value, unaryExpression());
+			}
+			else if (accept("/")) {
+				value = binary(ShaderOp::Div, value, unaryExpression());
+			}
+			else {
+				return value;
+			}
+		}
+	}
+
+	Value unaryExpression() {
+		if (accept("-")) {
+			return unary(ShaderOp::Neg, unaryExpression());
+		}
+		if (accept("+")) {
+			return unaryExpression();
+		}
+		Value value = primary();
+		while (!failed && accept("[")) {
+			int index = (int)number();
+			expect("]");
+			if (!isMatrix(value) || index < 0 || index > 3) {
+				error("only the columns 0 to 3 of a mat4 can be indexed");
+				return value;
+			}
+			value = column(value, index);
+		}
+		while (!failed && accept(".")) {
+			int selection[4] = { 0, 0, 0, 0 };
+			int selected = swizzle(identifier(), value.size, selection);
+			Value swizzled;
+			swizzled.size = selected;
+			for (int i = 0; i < selected; ++i) {
+				swizzled.reg[i] = value.reg[selection[i]];
+			}
+			value = swizzled;
+		}
+		return value;
+	}
+
+	Value primary() {
+		if (failed) {
+			return constant(0.0f);
+		}
+		if (peek().kind == TokenKind::Number) {
+			return constant((float)number());
+		}
+		if (accept("(")) {
+			Value value = expression();
+			expect(")");
+			return value;
+		}
+		std::string name = identifier();
+		if (failed) {
+			return constant(0.0f);
+		}
+		if (accept("(")) {
+			std::vector<Value> arguments;
+			if (!accept(")")) {
+				do {
+					arguments.push_back(expression());
+				} while (accept(","));
+				expect(")");
+			}
+			return call(name, arguments);
+		}
+		std::map<std::string, Value>::iterator variable = variables.find(name);
+		if (variable == variables.end()) {
+			error("unknown variable '" + name + "'");
+			return constant(0.0f);
+		}
+		return variable->second;
+	}
+
+	// Broadcasts a scalar or truncates a vector to the given size
+	Value convert(const Value& value, int size) {
+		if (value.size == size) {
+			return value;
+		}
+		Value result;
+		result.size = size;
+		if (value.size == 1) {
+			for (int i = 0; i < size; ++i) {
+				result.reg[i] = value.reg[0];
+			}
+		}
+		else if (value.size > size) {
+			for (int i = 0; i < size; ++i) {
+				result.reg[i] = value.reg[i];
+			}
+		}
+		else {
+			error("cannot initialize " + std::to_string(size) + " components from " + std::to_string(value.size));
+		}
+		return result;
+	}
+
+	bool checkArguments(const std::string& name, const std::vector<Value>& arguments, size_t count) {
+		if (arguments.size() != count) {
+			error(name + " takes " + std::to_string(count) + " arguments");
+			return false;
+		}
+		return true;
+	}
+
+	Value call(const std::string& name, const std::vector<Value>& arguments) {
+		int components = typeComponents(name);
+		if (components != 0) {
+			// Constructor: one scalar is broadcast, otherwise the components are concatenated
+			Value result;
+			result.size = components;
+			if (components == 16 && arguments.size() == 1 && arguments[0].size == 1) {
+				// mat4(s) puts s on the diagonal
+				Value zero = constant(0.0f);
+				for (int i = 0; i < 16; ++i) {
+					result.reg[i] = i % 5 == 0 ? arguments[0].reg[0] : zero.reg[0];
+				}
+				return result;
+			}
+			if (arguments.size() == 1) {
+				return convert(arguments[0], components);
+			}
+			int filled = 0;
+			for (const Value& argument : arguments) {
+				for (int i = 0; i < argument.size; ++i) {
+					if (filled == components) {
+						error("too many components for " + name);
+						return result;
+					}
+					result.reg[filled++] = argument.reg[i];
+				}
+			}
+			if (filled != components) {
+				error("too few components for " + name);
+			}
+			return result;
+		}
+
+		static const struct {
+			const char* name;
+			ShaderOp op;
+		} unaryBuiltins[] = { { "abs", ShaderOp::Abs }, { "sqrt", ShaderOp::Sqrt }, { "floor", ShaderOp::Floor },
+							  { "sin", ShaderOp::Sin }, { "cos", ShaderOp::Cos } };
+		for (const auto& builtin : unaryBuiltins) {
+			if (name == builtin.name) {
+				return checkArguments(name, arguments, 1) ? unary(builtin.op, arguments[0]) : constant(0.0f);
+			}
+		}
+		static const struct {
+			const char* name;
+			ShaderOp op;
+		} binaryBuiltins[] = { { "min", ShaderOp::Min }, { "max", ShaderOp::Max }, { "pow", ShaderOp::Pow }, { "step", ShaderOp::Step } };
+		for (const auto& builtin : binaryBuiltins) {
+			if (name == builtin.name) {
+				return checkArguments(name, arguments, 2) ? binary(builtin.op, arguments[0], arguments[1]) : constant(0.0f);
+			}
+		}
+
+		if (name == "fract" && checkArguments(name, arguments, 1)) {
+			return binary(ShaderOp::Sub, arguments[0], unary(ShaderOp::Floor, arguments[0]));
+		}
+		if (name == "clamp" && checkArguments(name, arguments, 3)) {
+			return binary(ShaderOp::Min, binary(ShaderOp::Max, arguments[0], arguments[1]), arguments[2]);
+		}
+		if (name == "mix" && checkArguments(name, arguments, 3)) {
+			const Value& a = arguments[0];
+			return binary(ShaderOp::Add, a, binary(ShaderOp::Mul, binary(ShaderOp::Sub, arguments[1], a), arguments[2]));
+		}
+		if (name == "smoothstep" && checkArguments(name, arguments, 3)) {
+			Value t = binary(ShaderOp::Div, binary(ShaderOp::Sub, arguments[2], arguments[0]), binary(ShaderOp::Sub, arguments[1], arguments[0]));
+			t = binary(ShaderOp::Min, binary(ShaderOp::Max, t, constant(0.0f)), constant(1.0f));
+			Value shape = binary(ShaderOp::Sub, constant(3.0f), binary(ShaderOp::Mul, constant(2.0f), t));
+			return binary(ShaderOp::Mul, binary(ShaderOp::Mul, t, t), shape);
+		}
+		if (name == "dot" && checkArguments(name, arguments, 2)) {
+			return dot(arguments[0], arguments[1]);
+		}
+		if (name == "length" && checkArguments(name, arguments, 1)) {
+			return unary(ShaderOp::Sqrt, dot(arguments[0], arguments[0]));
+		}
+		if (name == "normalize" && checkArguments(name, arguments, 1)) {
+			return binary(ShaderOp::Div, arguments[0], unary(ShaderOp::Sqrt, dot(arguments[0], arguments[0])));
+		}
+		if (!failed) {
+			error("unsupported function '" + name + "'");
+		}
+		return constant(0.0f);
+	}
+
+	Value dot(const Value& a, const Value& b) {
+		if (a.size != b.size) {
+			error("dot of different sizes");
+			return constant(0.0f);
+		}
+		Value sum;
+		sum.size = 1;
+		sum.reg[0] = emit(ShaderOp::Mul, a.reg[0], b.reg[0]);
+		for (int i = 1; i < a.size; ++i) {
+			sum.reg[0] = emit(ShaderOp::Add, sum.reg[0], emit(ShaderOp::Mul, a.reg[i], b.reg[i]));
+		}
+		return sum;
+	}
+};
+
+// Runs a translated shader one invocation at a time, the reference for the generated kernels.
+// Streams are structure of arrays: inputs[c][i] is component c of invocation i, outputs likewise.
+class ShaderInterpreter {
+public:
+	explicit ShaderInterpreter(const ShaderProgramIR& program) : program(program), registers(program.code.size()) {
+	}
+
+	void run(const float* const* inputs, const float* uniforms, float* const* outputs, size_t count) {
+		const ShaderInstruction* code = program.code.data();
+		size_t length = program.code.size();
+		for (size_t i = 0; i < count; ++i) {
+			for (size_t r = 0; r < length; ++r) {
+				const ShaderInstruction& instruction = code[r];
+				switch (instruction.op) {
+				case ShaderOp::Input: registers[r] = inputs[instruction.a][i]; break;
+				case ShaderOp::Uniform: registers[r] = uniforms[instruction.a]; break;
+				case ShaderOp::Constant: registers[r] = instruction.value; break;
+				default:
+					registers[r] = evaluateShaderOp(instruction.op, registers[instruction.a], instruction.b >= 0 ? registers[instruction.b] : 0.0f);
+				}
+			}
+			for (int c = 0; c < program.outputComponents; ++c) {
+				outputs[c][i] = registers[program.outputRegisters[c]];
+			}
+		}
+	}
+
+private:
+	const ShaderProgramIR& program;
+	std::vector<float> registers;
+};
+
+// Writes a translated shader as a C++ header with a struct of the given name:
+// batch() runs SHADER_LANES invocations on ShaderLanes registers, run() any number of them.
+inline void generateShaderKernel(const ShaderProgramIR& program, const std::string& structName, const std::string& sourceName, std::ostream& out) {
+	static const char* const componentNames = "xyzw";
+	std::string guard;
+	for (char c : structName) {
+		guard += (char)toupper((unsigned char)c);
+	}
+	guard += "_H";
+
+	auto describe = [&](const std::vector<ShaderVariable>& variables) {
+		std::string text;
+		for (const ShaderVariable& variable : variables) {
+			std::string components = variable.components == 16 ? "[0-3].xyzw" : "." + std::string(componentNames, variable.components);
+			text += (text.empty() ? "" : ", ") + variable.name + components + " (" +
+					std::to_string(variable.firstComponent) +
+					(variable.components > 1 ? "-" + std::to_string(variable.firstComponent + variable.components - 1) : "") + ")";
+		}
+		return text.empty() ? std::string("none") : text;
+	};
+	auto literal = [](float value) {
+		char text[32];
+		snprintf(text, sizeof(text), "%.9g", value);
+		std::string result = text;
+		if (result.find_first_of(".en") == std::string::npos) {
+			result += ".0";
+		}
+		return result + "f";
+	};
+	auto reg = [](int index) {
+		return "r" + std::to_string(index);
+	};
+
+	bool readsInputs = false, readsUniforms = false;
+	for (const ShaderInstruction& instruction : program.code) {
+		readsInputs |= instruction.op == ShaderOp::Input;
+		readsUniforms |= instruction.op == ShaderOp::Uniform;
+	}
+
+	out << "// Generated from " << sourceName << " by \"Benchmarks compile-shader\", do not edit.\n";
+	out << "#ifndef " << guard << "\n#define " << guard << "\n\n";
+	out << "#include <cstddef>\n#include \"../../shader_lanes.h\"\n\n";
+	out << "// Streams: inputs   " << describe(program.inputs) << "\n";
+	out << "//          uniforms " << describe(program.uniforms) << "\n";
+	out << "//          outputs  " << describe(program.outputs) << "\n";
+	out << "struct " << structName << " {\n";
+	out << "\tstatic const int INPUTS = " << program.inputComponents << ";\n";
+	out << "\tstatic const int UNIFORMS = " << program.uniformComponents << ";\n";
+	out << "\tstatic const int OUTPUTS = " << program.outputComponents << ";\n\n";
+
+	out << "\t// SHADER_LANES invocations starting at index i\n";
+	out << "\tstatic void batch(const float* const* inputs, const float* uniforms, float* const* outputs, size_t i) {\n";
+	if (!readsInputs) {
+		out << "\t\t(void)inputs;\n";
+	}
+	if (!readsUniforms) {
+		out << "\t\t(void)uniforms;\n";
+	}
+	static const struct {
+		ShaderOp op;
+		const char* format; // %a and %b are replaced by the operand registers
+	} formats[] = {
+		{ ShaderOp::Add, "%a + %b" }, { ShaderOp::Sub, "%a - %b" }, { ShaderOp::Mul, "%a * %b" }, { ShaderOp::Div, "%a / %b" },
+		{ ShaderOp::Neg, "-%a" }, { ShaderOp::Min, "lanes::min(%a, %b)" }, { ShaderOp::Max, "lanes::max(%a, %b)" },
+		{ ShaderOp::Abs, "lanes::abs(%a)" }, { ShaderOp::Sqrt, "lanes::sqrt(%a)" }, { ShaderOp::Floor, "lanes::floor(%a)" },
+		{ ShaderOp::Step, "lanes::step(%a, %b)" }, { ShaderOp::Sin, "lanes::sin(%a)" }, { ShaderOp::Cos, "lanes::cos(%a)" },
+		{ ShaderOp::Pow, "lanes::pow(%a, %b)" },
+	};
+	for (size_t r = 0; r < program.code.size(); ++r) {
+		const ShaderInstruction& instruction = program.code[r];
+		out << "\t\t";
+		switch (instruction.op) {
+		case ShaderOp::Input:
+			out << "const ShaderLanes " << reg((int)r) << " = ShaderLanes::load(inputs[" << instruction.a << "] + i);\n";
+			break;
+		case ShaderOp::Uniform:
+			out << "const ShaderLanes " << reg((int)r) << "(uniforms[" << instruction.a << "]);\n";
+			break;
+		case ShaderOp::Constant:
+			out << "const ShaderLanes " << reg((int)r) << "(" << literal(instruction.value) << ");\n";
+			break;
+		default:
+			for (const auto& format : formats) {
+				if (format.op == instruction.op) {
+					std::string text = format.format;
+					size_t at;
+					while ((at = text.find("%a")) != std::string::npos) {
+						text.replace(at, 2, reg(instruction.a));
+					}
+					while ((at = text.find("%b")) != std::string::npos) {
+						text.replace(at, 2, reg(instruction.b));
+					}
+					out << "const ShaderLanes " << reg((int)r) << " = " << text << ";\n";
+				}
+			}
+		}
+	}
+	for (int c = 0; c < program.outputComponents; ++c) {
+		out << "\t\t" << reg(program.outputRegisters[c]) << ".store(outputs[" << c << "] + i);\n";
+	}
+	out << "\t}\n\n";
+
+	out << "\t// count invocations, stream c holds count floats of component c\n";
+	out << "\tstatic void run(const float* const* inputs, const float* uniforms, float* const* outputs, size_t count) {\n";
+	out << "\t\tsize_t i = 0;\n";
+	out << "\t\tfor (; i + SHADER_LANES <= count; i += SHADER_LANES) {\n";
+	out << "\t\t\tbatch(inputs, uniforms, outputs, i);\n";
+	out << "\t\t}\n";
+	out << "\t\tif (i == count) {\n\t\t\treturn;\n\t\t}\n";
+	out << "\t\t// The last partial batch goes through padded copies of the streams\n";
+	out << "\t\tfloat in[INPUTS + 1][SHADER_LANES] = {}, out[OUTPUTS + 1][SHADER_LANES];\n";
+	out << "\t\tconst float* inPointers[INPUTS + 1];\n";
+	out << "\t\tfloat* outPointers[OUTPUTS + 1];\n";
+	out << "\t\tfor (int c = 0; c < INPUTS; ++c) {\n";
+	out << "\t\t\tfor (size_t k = i; k < count; ++k) {\n";
+	out << "\t\t\t\tin[c][k - i] = inputs[c][k];\n";
+	out << "\t\t\t}\n";
+	out << "\t\t\tinPointers[c] = in[c];\n";
+	out << "\t\t}\n";
+	out << "\t\tfor (int c = 0; c < OUTPUTS; ++c) {\n";
+	out << "\t\t\toutPointers[c] = out[c];\n";
+	out << "\t\t}\n";
+	out << "\t\tbatch(inPointers, uniforms, outPointers, 0);\n";
+	out << "\t\tfor (int c = 0; c < OUTPUTS; ++c) {\n";
+	out << "\t\t\tfor (size_t k = i; k < count; ++k) {\n";
+	out << "\t\t\t\toutputs[c][k] = out[c][k - i];\n";
+	out << "\t\t\t}\n";
+	out << "\t\t}\n";
+	out << "\t}\n";
+	out << "};\n#endif\n";
+}
+#endif
@@ -0,0 +1,430 @@
+#ifndef GPU_BUFFER_ALLOCATOR_H
+#define GPU_BUFFER_ALLOCATOR_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+#include "tlsf_allocator.h"
+#include "profiler.h"
+
+enum class GpuBufferCategory {
+	Geometry,
+	Index,
+};
+const int GPU_BUFFER_CATEGORIES = 2;
+
+// Where an allocation currently lives. Offsets change when defragment() moves it.
+struct GpuRange {
+	unsigned int buffer;
+	GLintptr offset;
+	GLsizeiptr size;
+};
+
+// Carves vertex and index ranges out of a few large buffer objects ("pages") instead of one
+// glBufferData per mesh. Every page is managed by a TlsfAllocator, all offsets are aligned to
+// GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT so any range can be bound to any target.
+// defragment(), called once per frame, does a bounded amount of work: it first empties the last page into
+// the free space of the others, then slides the allocations of a fragmented page towards its start, with
+// glCopyBufferSubData on the GPU. Emptied pages are released, so the footprint follows what is in use.
+// Moved allocations are reported through the relocation callback, whoever holds their offsets
+// (vertex array objects, draw commands) has to pick up the new range.
+class GpuBufferAllocator {
+public:
+	static const uint32_t INVALID = 0xFFFFFFFFu;
+	typedef std::function<void(uint32_t allocation, const GpuRange& range)> RelocationCallback;
+
+	struct CategoryStats {
+		uint64_t bytesInUse;
+		uint64_t peakBytes;
+		uint32_t allocations;
+	};
+
+	explicit GpuBufferAllocator(GLsizeiptr pageSize = 4 << 20) : pageSize(pageSize) {}
+
+	// Needs a current GL context
+	void init() {
+		GLint alignment = 0;
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+		granularity = 16;
+		while (granularity < (uint64_t)alignment) {
+			granularity <<= 1;
+		}
+		for (CategoryStats& stats : categories) {
+			stats = { 0, 0, 0 };
+		}
+		pages.reserve(8);
+		allocations.reserve(64);
+		unusedIds.reserve(64);
+	}
+
+	void destroy() {
+		for (Page& page : pages) {
+			if (page.buffer) {
+				glDeleteBuffers(1, &page.buffer);
+				page.buffer = 0;
+			}
+		}
+		if (scratch) {
+			glDeleteBuffers(1, &scratch);
+			scratch = 0;
+			scratchSize = 0;
+		}
+		pages.clear();
+		allocations.clear();
+		unusedIds.clear();
+		reserved = 0;
+	}
+
+	// Returns INVALID if the GL buffer could not be created. data may be null.
+	uint32_t allocate(GpuBufferCategory category, GLsizeiptr size, const void* data = nullptr) {
+		uint32_t id;
+		if (!unusedIds.empty()) {
+			id = unusedIds.back();
+			unusedIds.pop_back();
+		}
+		else {
+			id = (uint32_t)allocations.size();
+			allocations.push_back(Allocation());
+		}
+		// The id goes into the block's tag, it finds the allocation again when compaction moves the block
+		uint32_t page = INVALID, block = TlsfAllocator::INVALID;
+		for (uint32_t i = 0; i < pages.size() && block == TlsfAllocator::INVALID; ++i) {
+			if (pages[i].buffer) {
+				page = i;
+				block = pages[i].ranges.allocate(size, id);
+			}
+		}
+		if (block == TlsfAllocator::INVALID) {
+			page = newPage((uint64_t)size);
+			if (page == INVALID) {
+				unusedIds.push_back(id);
+				return INVALID;
+			}
+			block = pages[page].ranges.allocate(size, id);
+		}
+		Allocation& allocation = allocations[id];
+		allocation.page = page;
+		allocation.block = block;
+		allocation.category = category;
+		allocation.live = true;
+
+		CategoryStats& stats = categories[(int)category];
+		stats.bytesInUse += pages[page].ranges.size(block);
+		stats.peakBytes = std::max(stats.peakBytes, stats.bytesInUse);
+		++stats.allocations;
+
+		if (data) {
+			upload(id, data, size);
+		}
+		return id;
+	}
+
+	void free(uint32_t id) {
+		Allocation& allocation = allocations[id];
+		Page& page = pages[allocation.page];
+		CategoryStats& stats = categories[(int)allocation.category];
+		stats.bytesInUse -= page.ranges.size(allocation.block);
+		--stats.allocations;
+		page.ranges.free(allocation.block);
+		allocation.live = false;
+		unusedIds.push_back(id);
+	}
+
+	GpuRange range(uint32_t id) const {
+		const Allocation& allocation = allocations[id];
+		const Page& page = pages[allocation.page];
+		return { page.buffer, (GLintptr)page.ranges.offset(allocation.block), (GLsizeiptr)page.ranges.size(allocation.block) };
+	}
+
+	// glBufferSubData into the allocation, offset is relative to its start
+	void upload(uint32_t id, const void* data, GLsizeiptr size, GLintptr offset = 0) {
+		GpuRange target = range(id);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, target.buffer);
+		glBufferSubData(GL_COPY_WRITE_BUFFER, target.offset + offset, size, data);
+	}
+
+	void setRelocationCallback(RelocationCallback callback) {
+		onRelocated = callback;
+	}
+
+	// Pages whose fragmentation goes above this get compacted until they are packed again
+	void setCompactionThreshold(double fragmentation) {
+		compactionThreshold = fragmentation;
+	}
+
+	// Moves allocations until byteBudget bytes were copied, at least one allocation per call if there is work
+	void defragment(uint64_t byteBudget) {
+		uint64_t moved = 0;
+		while (moved < byteBudget) {
+			uint64_t budget = moved == 0 ? UINT64_MAX : byteBudget - moved;
+			uint64_t step = evacuateStep(budget);
+			if (step == 0) {
+				step = compactStep(budget);
+			}
+			if (step == 0) {
+				break;
+			}
+			moved += step;
+		}
+		releaseEmptyPages();
+	}
+
+	const CategoryStats& category(GpuBufferCategory category) const {
+		return categories[(int)category];
+	}
+	// GPU memory held by the pages and the copy scratch buffer
+	uint64_t reservedBytes() const {
+		return reserved;
+	}
+	uint64_t peakReservedBytes() const {
+		return peakReserved;
+	}
+	uint64_t usedBytes() const {
+		uint64_t used = 0;
+		for (const Page& page : pages) {
+			used += page.ranges.usedBytes();
+		}
+		return used;
+	}
+	// Free space not in the largest free block of its page, over all free space
+	double fragmentation() const {
+		uint64_t total = 0, largest = 0;
+		for (const Page& page : pages) {
+			total += page.ranges.freeBytes();
+			largest += page.ranges.largestFreeBlock();
+		}
+		return total == 0 ? 0.0 : 1.0 - (double)largest / (double)total;
+	}
+	uint32_t pageCount() const {
+		uint32_t count = 0;
+		for (const Page& page : pages) {
+			count += page.buffer != 0;
+		}
+		return count;
+	}
+	uint64_t bytesMoved() const {
+		return totalMoved;
+	}
+	uint64_t relocations() const {
+		return relocationCount;
+	}
+
+	// One sample per counter track in the CPU profiler trace
+	void publishCounters() const {
+		PROFILE_COUNTER("gpu memory reserved", reservedBytes());
+		PROFILE_COUNTER("gpu memory geometry", categories[(int)GpuBufferCategory::Geometry].bytesInUse);
+		PROFILE_COUNTER("gpu memory index", categories[(int)GpuBufferCategory::Index].bytesInUse);
+		PROFILE_COUNTER("gpu memory fragmentation %", fragmentation() * 100.0);
+		PROFILE_COUNTER("gpu memory moved", totalMoved);
+	}
+
+	void writeReport(std::ostream& out) const {
+		const char* names[GPU_BUFFER_CATEGORIES] = { "geometry", "index" };
+		out << "GPU buffers (" << pageCount() << " pages, " << reservedBytes() << " bytes reserved, peak "
+			<< peakReservedBytes() << ", " << usedBytes() << " in use)" << std::endl;
+		out << std::left << std::setw(20) << "category" << std::right
+			<< std::setw(12) << "allocations" << std::setw(14) << "bytes" << std::setw(14) << "peak" << std::endl;
+		for (int i = 0; i < GPU_BUFFER_CATEGORIES; ++i) {
+			out << std::left << std::setw(20) << names[i] << std::right << std::setw(12) << categories[i].allocations
+				<< std::setw(14) << categories[i].bytesInUse << std::setw(14) << categories[i].peakBytes << std::endl;
+		}
+		out << std::fixed << std::setprecision(1) << "fragmentation " << fragmentation() * 100.0 << "%, "
+			<< relocationCount << " relocations, " << totalMoved << " bytes moved" << std::defaultfloat << std::endl;
+	}
+
+private:
+	struct Page {
+		unsigned int buffer = 0;
+		TlsfAllocator ranges;
+		bool compacting = false;
+	};
+	struct Allocation {
+		uint32_t page = INVALID, block = INVALID;
+		GpuBufferCategory category = GpuBufferCategory::Geometry;
+		bool live = false;
+	};
+
+	GLsizeiptr pageSize;
+	uint64_t granularity = 16;
+	std::vector<Page> pages; // released pages keep their slot with buffer 0
+	std::vector<Allocation> allocations;
+	std::vector<uint32_t> unusedIds;
+	CategoryStats categories[GPU_BUFFER_CATEGORIES] = {};
+	RelocationCallback onRelocated;
+	double compactionThreshold = 0.25;
+	unsigned int scratch = 0; // copies within one page go through it when the ranges overlap
+	uint64_t scratchSize = 0;
+	uint64_t reserved = 0, peakReserved = 0;
+	uint64_t totalMoved = 0, relocationCount = 0;
+
+	uint32_t newPage(uint64_t minimumSize) {
+		uint64_t size = std::max((uint64_t)pageSize, (minimumSize + granularity - 1) & ~(granularity - 1));
+		uint32_t slot = 0;
+		while (slot < pages.size() && pages[slot].buffer) {
+			++slot;
+		}
+		if (slot == pages.size()) {
+			pages.push_back(Page());
+		}
+		Page& page = pages[slot];
+		glGenBuffers(1, &page.buffer);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, page.buffer);
+		glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)size, nullptr, GL_STATIC_DRAW);
+		if (glGetError() == GL_OUT_OF_MEMORY) {
+			std::cout << "ERROR::GPU_BUFFER_ALLOCATOR::OUT_OF_MEMORY page of " << size << " bytes" << std::endl;
+			glDeleteBuffers(1, &page.buffer);
+			page.buffer = 0;
+			return INVALID;
+		}
+		page.ranges.reset(size, granularity);
+		page.compacting = false;
+		addReserved(size);
+		return slot;
+	}
+
+	void addReserved(uint64_t bytes) {
+		reserved += bytes;
+		peakReserved = std::max(peakReserved, reserved);
+	}
+
+	// Moves one allocation of the last page into an earlier one, if all of the last page fits there
+	uint64_t evacuateStep(uint64_t budget) {
+		uint32_t last = INVALID;
+		uint64_t roomBefore = 0;
+		for (uint32_t i = 0; i < pages.size(); ++i) {
+			if (pages[i].buffer) {
+				if (last != INVALID) {
+					roomBefore += pages[last].ranges.freeBytes();
+				}
+				last = i;
+			}
+		}
+		if (last == INVALID || roomBefore == 0 || pages[last].ranges.isEmpty() || pages[last].ranges.usedBytes() > roomBefore) {
+			return 0;
+		}
+		for (uint32_t id = 0; id < allocations.size(); ++id) {
+			Allocation& allocation = allocations[id];
+			if (!allocation.live || allocation.page != last) {
+				continue;
+			}
+			uint64_t size = pages[last].ranges.size(allocation.block);
+			if (size > budget) {
+				return 0;
+			}
+			for (uint32_t i = 0; i < last; ++i) {
+				if (!pages[i].buffer) {
+					continue;
+				}
+				uint32_t block = pages[i].ranges.allocate(size, id);
+				if (block == TlsfAllocator::INVALID) {
+					continue;
+				}
+				glBindBuffer(GL_COPY_READ_BUFFER, pages[last].buffer);
+				glBindBuffer(GL_COPY_WRITE_BUFFER, pages[i].buffer);
+				glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, (GLintptr)pages[last].ranges.offset(allocation.block),
+									(GLintptr)pages[i].ranges.offset(block), (GLsizeiptr)size);
+				pages[last].ranges.free(allocation.block);
+				allocation.page = i;
+				allocation.block = block;
+				relocated(id, size);
+				return size;
+			}
+			// Too large for any single hole, compaction has to make room first
+			return 0;
+		}
+		return 0;
+	}
+
+	// One compaction step on the most fragmented page
+	uint64_t compactStep(uint64_t budget) {
+		Page* target = nullptr;
+		double worst = 0.0;
+		for (Page& page : pages) {
+			if (!page.buffer) {
+				continue;
+			}
+			double fragmentation = page.ranges.fragmentation();
+			if (fragmentation > compactionThreshold) {
+				page.compacting = true;
+			}
+			if (page.compacting && (target == nullptr || fragmentation > worst)) {
+				target = &page;
+				worst = fragmentation;
+			}
+		}
+		if (target == nullptr) {
+			return 0;
+		}
+		TlsfAllocator::Move move;
+		if (!target->ranges.nextCompaction(move)) {
+			target->compacting = false;
+			return 0;
+		}
+		if (move.size > budget) {
+			return 0;
+		}
+		target->ranges.compactStep(move);
+		if (move.to + move.size > move.from) {
+			// Overlapping source and destination are not allowed within one buffer
+			ensureScratch(move.size);
+			glBindBuffer(GL_COPY_READ_BUFFER, target->buffer);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, scratch);
+			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, (GLintptr)move.from, 0, (GLsizeiptr)move.size);
+			glBindBuffer(GL_COPY_READ_BUFFER, scratch);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, target->buffer);
+			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, (GLintptr)move.to, (GLsizeiptr)move.size);
+		}
+		else {
+			glBindBuffer(GL_COPY_READ_BUFFER, target->buffer);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, target->buffer);
+			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, (GLintptr)move.from, (GLintptr)move.to, (GLsizeiptr)move.size);
+		}
+		relocated(move.tag, move.size);
+		return move.size;
+	}
+
+	void ensureScratch(uint64_t size) {
+		if (size <= scratchSize) {
+			return;
+		}
+		if (!scratch) {
+			glGenBuffers(1, &scratch);
+		}
+		glBindBuffer(GL_COPY_WRITE_BUFFER, scratch);
+		glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)size, nullptr, GL_DYNAMIC_COPY);
+		reserved -= scratchSize;
+		addReserved(size);
+		scratchSize = size;
+	}
+
+	void relocated(uint32_t id, uint64_t size) {
+		totalMoved += size;
+		++relocationCount;
+		if (onRelocated) {
+			onRelocated(id, range(id));
+		}
+	}
+
+	// Empty pages go back to the driver, the first one stays for the next allocations
+	void releaseEmptyPages() {
+		bool first = true;
+		for (Page& page : pages) {
+			if (!page.buffer) {
+				continue;
+			}
+			if (!first && page.ranges.isEmpty()) {
+				glDeleteBuffers(1, &page.buffer);
+				page.buffer = 0;
+				reserved -= page.ranges.capacityBytes();
+				page.ranges.reset(0, granularity);
+			}
+			first = false;
+		}
+	}
+};
+#endif
@@ -0,0 +1,348 @@
+#ifndef GPU_CULLING_H
+#define GPU_CULLING_H
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "bvh_culling.h"
+#include "shader_source.h"
+#include "vector_math.h"
+
+// GL 4.3 names the 3.3 loader does not know
+#ifndef GL_COMPUTE_SHADER
+#define GL_COMPUTE_SHADER 0x91B9
+#endif
+#ifndef GL_SHADER_STORAGE_BUFFER
+#define GL_SHADER_STORAGE_BUFFER 0x90D2
+#endif
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+#ifndef GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT
+#define GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT 0x00000001
+#endif
+#ifndef GL_COMMAND_BARRIER_BIT
+#define GL_COMMAND_BARRIER_BIT 0x00000040
+#endif
+#ifndef GL_BUFFER_UPDATE_BARRIER_BIT
+#define GL_BUFFER_UPDATE_BARRIER_BIT 0x00000200
+#endif
+
+// The layout glMultiDrawElementsIndirect reads
+struct IndirectCommand {
+	uint32_t count;
+	uint32_t instanceCount;
+	uint32_t firstIndex;
+	int32_t baseVertex;
+	uint32_t baseInstance;
+};
+
+// An instance as the culling shader reads it (std430)
+struct CullInstance {
+	Mat4 model;
+	uint32_t command;
+	uint32_t padding[3];
+};
+static_assert(sizeof(CullInstance) == 80, "CullInstance must match the std430 layout of the culling shader");
+
+// What the compute pass does, on the CPU: every instance whose moved box touches the volume is appended
+// to its command's range of visible, which starts at the command's baseInstance. The instance counts of
+// commands must be 0 on entry.
+inline void cullIndirectCpu(const CullInstance* instances, uint32_t count, const Aabb* commandBounds, const CullVolume& volume,
+							IndirectCommand* commands, Mat4* visible) {
+	for (uint32_t i = 0; i < count; ++i) {
+		const CullInstance& instance = instances[i];
+		Aabb box = transformAabb(instance.model, commandBounds[instance.command]);
+		Vec3 center = (box.min + box.max) * 0.5f, extent = (box.max - box.min) * 0.5f;
+		bool inside = true;
+		for (int p = 0; p < volume.planeCount && inside; ++p) {
+			const Vec4& plane = volume.planes[p];
+			inside = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w +
+				std::fabs(plane.x) * extent.x + std::fabs(plane.y) * extent.y + std::fabs(plane.z) * extent.z >= 0.0f;
+		}
+		if (inside) {
+			IndirectCommand& command = commands[instance.command];
+			visible[command.baseInstance + command.instanceCount++] = instance.model;
+		}
+	}
+}
+
+// Culls instances and writes the draw commands for them on the GPU.
+// A compute shader tests every instance's box against the view and appends the survivors' model matrices
+// to their command's range of one instance buffer, counting them in the command with an atomic. The
+// commands stay on the GPU and are drawn with glMultiDrawElementsIndirect, the CPU never sees the
+// counts. The model matrix reaches the vertex shader as four instanced attributes; baseInstance points
+// each command at its range.
+// Without GL 4.3 (compute shaders and indirect draws), the same commands and instance buffer are made
+// on the CPU and drawn one instanced draw per command, with the attributes pointed at the range.
+// The 4.3 entry points are loaded here, the GL loader only covers 3.3.
+class IndirectCuller {
+public:
+	static const unsigned int GROUP_SIZE = 64;
+	// Vertex attribute locations of the model matrix columns
+	static const unsigned int MODEL_LOCATION = 2;
+
+	IndirectCuller() = default;
+	IndirectCuller(const IndirectCuller&) = delete;
+	IndirectCuller& operator=(const IndirectCuller&) = delete;
+
+	// Needs a current GL context. Returns whether the compute path is used, the CPU path works on any context.
+	bool init(GLADloadproc load, const char* computeShaderPath) {
+		glGenBuffers(1, &visibleBuffer);
+		GLint major = 0, minor = 0;
+		glGetIntegerv(GL_MAJOR_VERSION, &major);
+		glGetIntegerv(GL_MINOR_VERSION, &minor);
+		if (major < 4 || (major == 4 && minor < 3)) {
+			std::cout << "WARNING::GPU_CULLING::NEEDS_GL_4_3 culling on the CPU" << std::endl;
+			return false;
+		}
+		dispatchCompute = (DispatchComputeProc)load("glDispatchCompute");
+		memoryBarrier = (MemoryBarrierProc)load("glMemoryBarrier");
+		multiDrawElementsIndirect = (MultiDrawElementsIndirectProc)load("glMultiDrawElementsIndirect");
+		if (!dispatchCompute || !memoryBarrier || !multiDrawElementsIndirect) {
+			std::cout << "WARNING::GPU_CULLING::ENTRY_POINTS_MISSING culling on the CPU" << std::endl;
+			return false;
+		}
+		program = compileComputeProgram(computeShaderPath);
+		if (!program) {
+			return false;
+		}
+		planesLocation = glGetUniformLocation(program, "planes");
+		planeCountLocation = glGetUniformLocation(program, "planeCount");
+		instanceCountLocation = glGetUniformLocation(program, "instanceCount");
+		glGenBuffers(1, &instanceBuffer);
+		glGenBuffers(1, &commandBuffer);
+		glGenBuffers(1, &boundsBuffer);
+		useCompute = true;
+		return true;
+	}
+
+	void destroy() {
+		glDeleteBuffers(1, &visibleBuffer);
+		if (useCompute) {
+			glDeleteBuffers(1, &instanceBuffer);
+			glDeleteBuffers(1, &commandBuffer);
+			glDeleteBuffers(1, &boundsBuffer);
+			glDeleteProgram(program);
+		}
+		visibleBuffer = instanceBuffer = commandBuffer = boundsBuffer = program = 0;
+		useCompute = false;
+	}
+
+	bool usesCompute() const {
+		return useCompute;
+	}
+
+	// Adds the model matrix attributes, read from the instance buffer, to a vertex array. Needed again
+	// when the vertex array is set up again.
+	void bindInstanceAttributes(unsigned int vertexArray) {
+		glBindVertexArray(vertexArray);
+		glBindBuffer(GL_ARRAY_BUFFER, visibleBuffer);
+		for (unsigned int c = 0; c < 4; ++c) {
+			glVertexAttribPointer(MODEL_LOCATION + c, 4, GL_FLOAT, GL_FALSE, sizeof(Mat4), (void*)(c * sizeof(Vec4)));
+			glVertexAttribDivisor(MODEL_LOCATION + c, 1);
+			glEnableVertexAttribArray(MODEL_LOCATION + c);
+		}
+		glBindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	// commands: count and firstIndex of every command, instances pick them by index. commandBounds: the
+	// mesh box of every command, before the model matrix.
+	void cull(const CullInstance* instances, uint32_t count, const IndirectCommand* commands, const Aabb* commandBounds,
+			  uint32_t commandCount, const CullVolume& volume) {
+		// Every command gets room for all of its instances, in command order
+		pendingCommands.assign(commands, commands + commandCount);
+		for (IndirectCommand& command : pendingCommands) {
+			command.instanceCount = 0;
+			command.baseVertex = 0;
+			command.baseInstance = 0;
+		}
+		for (uint32_t i = 0; i < count; ++i) {
+			++pendingCommands[instances[i].command].baseInstance;
+		}
+		uint32_t first = 0;
+		for (IndirectCommand& command : pendingCommands) {
+			uint32_t room = command.baseInstance;
+			command.baseInstance = first;
+			first += room;
+		}
+		reserveVisible(count);
+		lastInstanceCount = count;
+		if (!useCompute) {
+			cpuVisible.resize(count);
+			cullIndirectCpu(instances, count, commandBounds, volume, pendingCommands.data(), cpuVisible.data());
+			glBindBuffer(GL_ARRAY_BUFFER, visibleBuffer);
+			glBufferSubData(GL_ARRAY_BUFFER, 0, (GLsizeiptr)(count * sizeof(Mat4)), cpuVisible.data());
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+			return;
+		}
+
+		boundsData.resize(2 * commandCount);
+		for (uint32_t c = 0; c < commandCount; ++c) {
+			boundsData[2 * c] = Vec4(commandBounds[c].min, 1.0f);
+			boundsData[2 * c + 1] = Vec4(commandBounds[c].max, 1.0f);
+		}
+		upload(instanceBuffer, instanceCapacity, instances, count * sizeof(CullInstance));
+		upload(commandBuffer, commandCapacity, pendingCommands.data(), commandCount * sizeof(IndirectCommand));
+		upload(boundsBuffer, boundsCapacity, boundsData.data(), boundsData.size() * sizeof(Vec4));
+		if (count == 0) {
+			return;
+		}
+		glUseProgram(program);
+		glUniform4fv(planesLocation, volume.planeCount, &volume.planes[0].x);
+		glUniform1i(planeCountLocation, volume.planeCount);
+		glUniform1ui(instanceCountLocation, count);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, instanceBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, commandBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, boundsBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, visibleBuffer);
+		dispatchCompute((count + GROUP_SIZE - 1) / GROUP_SIZE, 1, 1);
+		// The draws read the counts as commands and the matrices as attributes
+		memoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+		glUseProgram(0);
+	}
+
+	// Draws commands [first, first + count) of the last cull() with the bound program and vertex array,
+	// which must have the instance attributes. Returns the number of draw calls made.
+	unsigned int draw(uint32_t first, uint32_t count) {
+		if (useCompute) {
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+			multiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (const void*)(first * sizeof(IndirectCommand)), (GLsizei)count, 0);
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+			return 1;
+		}
+		unsigned int drawCalls = 0;
+		glBindBuffer(GL_ARRAY_BUFFER, visibleBuffer);
+		for (uint32_t c = first; c < first + count; ++c) {
+			const IndirectCommand& command = pendingCommands[c];
+			if (command.instanceCount == 0) {
+				continue;
+			}
+			for (unsigned int column = 0; column < 4; ++column) {
+				glVertexAttribPointer(MODEL_LOCATION + column, 4, GL_FLOAT, GL_FALSE, sizeof(Mat4),
+									  (void*)(command.baseInstance * sizeof(Mat4) + column * sizeof(Vec4)));
+			}
+			glDrawElementsInstanced(GL_TRIANGLES, (GLsizei)command.count, GL_UNSIGNED_INT,
+									(void*)(command.firstIndex * sizeof(unsigned int)), (GLsizei)command.instanceCount);
+			++drawCalls;
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		return drawCalls;
+	}
+
+	// Reads the compute pass's counts back (a stall, for testing) and compares them with the CPU's for
+	// the same input. Reports a mismatch and returns false.
+	bool verify(const CullInstance* instances, const Aabb* commandBounds, const CullVolume& volume) {
+		if (!useCompute) {
+			return true;
+		}
+		size_t commandCount = pendingCommands.size();
+		gpuCommands.resize(commandCount);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, commandBuffer);
+		glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, (GLsizeiptr)(commandCount * sizeof(IndirectCommand)), gpuCommands.data());
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+		referenceCommands = pendingCommands;
+		cpuVisible.resize(lastInstanceCount);
+		cullIndirectCpu(instances, lastInstanceCount, commandBounds, volume, referenceCommands.data(), cpuVisible.data());
+		for (size_t c = 0; c < commandCount; ++c) {
+			if (gpuCommands[c].instanceCount != referenceCommands[c].instanceCount) {
+				std::cout << "ERROR::GPU_CULLING::COUNT_MISMATCH command " << c << ": " << gpuCommands[c].instanceCount
+						  << " on the GPU, " << referenceCommands[c].instanceCount << " on the CPU" << std::endl;
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Instances drawn by the last cull(), known on the CPU path only
+	uint32_t cpuVisibleCount() const {
+		uint32_t visible = 0;
+		for (const IndirectCommand& command : pendingCommands) {
+			visible += command.instanceCount;
+		}
+		return visible;
+	}
+
+private:
+	typedef void (APIENTRYP DispatchComputeProc)(GLuint groupsX, GLuint groupsY, GLuint groupsZ);
+	typedef void (APIENTRYP MemoryBarrierProc)(GLbitfield barriers);
+	typedef void (APIENTRYP MultiDrawElementsIndirectProc)(GLenum mode, GLenum type, const void* indirect, GLsizei drawCount, GLsizei stride);
+
+	DispatchComputeProc dispatchCompute = nullptr;
+	MemoryBarrierProc memoryBarrier = nullptr;
+	MultiDrawElementsIndirectProc multiDrawElementsIndirect = nullptr;
+	bool useCompute = false;
+	unsigned int program = 0;
+	int planesLocation = -1, planeCountLocation = -1, instanceCountLocation = -1;
+	// Bytes the buffers have room for, they only grow
+	unsigned int instanceBuffer = 0, commandBuffer = 0, boundsBuffer = 0, visibleBuffer = 0;
+	size_t instanceCapacity = 0, commandCapacity = 0, boundsCapacity = 0, visibleCapacity = 0;
+	uint32_t lastInstanceCount = 0;
+	// Kept between frames so culling does not allocate
+	std::vector<IndirectCommand> pendingCommands, gpuCommands, referenceCommands;
+	std::vector<Vec4> boundsData;
+	std::vector<Mat4> cpuVisible;
+
+	static unsigned int compileComputeProgram(const char* path) {
+		std::string code;
+		if (!readShaderSource(path, code)) {
+			std::cout << "ERROR::GPU_CULLING::FILE_NOT_SUCCESFULLY_READ " << path << std::endl;
+			return 0;
+		}
+		const char* source = code.c_str();
+		int success;
+		char infoLog[512];
+		unsigned int shader = glCreateShader(GL_COMPUTE_SHADER);
+		glShaderSource(shader, 1, &source, NULL);
+		glCompileShader(shader);
+		glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+		if (!success) {
+			glGetShaderInfoLog(shader, 512, NULL, infoLog);
+			std::cout << "ERROR::GPU_CULLING::COMPILATION_FAILED\n" << infoLog << std::endl;
+			glDeleteShader(shader);
+			return 0;
+		}
+		unsigned int id = glCreateProgram();
+		glAttachShader(id, shader);
+		glLinkProgram(id);
+		glDeleteShader(shader);
+		glGetProgramiv(id, GL_LINK_STATUS, &success);
+		if (!success) {
+			glGetProgramInfoLog(id, 512, NULL, infoLog);
+			std::cout << "ERROR::GPU_CULLING::LINKING_FAILED\n" << infoLog << std::endl;
+			glDeleteProgram(id);
+			return 0;
+		}
+		return id;
+	}
+
+	// Replaces the storage when it is too small, otherwise writes into it
+	static void upload(unsigned int buffer, size_t& capacity, const void* data, size_t bytes) {
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+		if (bytes > capacity) {
+			capacity = bytes + bytes / 2;
+			glBufferData(GL_SHADER_STORAGE_BUFFER, (GLsizeiptr)capacity, nullptr, GL_DYNAMIC_DRAW);
+		}
+		if (bytes > 0) {
+			glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, (GLsizeiptr)bytes, data);
+		}
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	}
+
+	void reserveVisible(uint32_t count) {
+		size_t bytes = (size_t)count * sizeof(Mat4);
+		if (bytes <= visibleCapacity) {
+			return;
+		}
+		visibleCapacity = bytes + bytes / 2;
+		glBindBuffer(GL_ARRAY_BUFFER, visibleBuffer);
+		glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)visibleCapacity, nullptr, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+};
+#endif
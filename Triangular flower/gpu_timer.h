@@ -0,0 +1,313 @@
+#ifndef GPU_TIMER_H
+#define GPU_TIMER_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+// Measures GPU time of named zones with timer queries.
+// Every frame gets its own set of query objects out of a ring of `frameLatency` frames. Results of
+// a frame are read back only after GL_QUERY_RESULT_AVAILABLE is set, so measuring never waits for the GPU.
+// If a frame is still not finished when its slot comes around again, its results are dropped.
+// The frames of the first trip around the ring are read back as warm-up and left out of the statistics.
+// Zones use GL_TIMESTAMP pairs and can be nested, the whole frame is measured with GL_TIME_ELAPSED.
+class GpuTimer {
+public:
+	static const unsigned int MAX_ZONES = 32;  // zones per frame
+	static const unsigned int HISTORY = 1024;  // samples kept per zone for the statistics
+	static const int COLUMN_WIDTH = 11;        // report columns, without the space in front
+
+	GpuTimer(unsigned int frameLatency = 4) : slots(frameLatency < 2 ? 2 : frameLatency) {}
+
+	// Creates the query objects, needs a current GL context
+	void init() {
+		for (FrameSlot& slot : slots) {
+			glGenQueries(1, &slot.frameQuery);
+			glGenQueries(MAX_ZONES, slot.startQueries);
+			glGenQueries(MAX_ZONES, slot.endQueries);
+		}
+		if (zones.empty()) {
+			zoneId("frame");
+		}
+		enabled = true;
+	}
+
+	void destroy() {
+		if (!enabled) {
+			return;
+		}
+		for (FrameSlot& slot : slots) {
+			glDeleteQueries(1, &slot.frameQuery);
+			glDeleteQueries(MAX_ZONES, slot.startQueries);
+			glDeleteQueries(MAX_ZONES, slot.endQueries);
+		}
+		enabled = false;
+	}
+
+	bool isEnabled() const {
+		return enabled;
+	}
+
+	void beginFrame() {
+		if (!enabled) {
+			return;
+		}
+		collect();
+		current = (current + 1) % slots.size();
+		FrameSlot& slot = slots[current];
+		if (slot.pending) {
+			// The GPU is more than `frameLatency` frames behind, waiting for it would stall
+			slot.pending = false;
+			++droppedFrames;
+		}
+		slot.zoneCount = 0;
+		depth = 0;
+		overflowDepth = 0;
+		glBeginQuery(GL_TIME_ELAPSED, slot.frameQuery);
+	}
+
+	void endFrame() {
+		if (!enabled) {
+			return;
+		}
+		while (depth > 0 || overflowDepth > 0) {
+			endZone();
+		}
+		glEndQuery(GL_TIME_ELAPSED);
+		slots[current].pending = true;
+	}
+
+	// `name` has to outlive the timer, string literals are expected
+	void beginZone(const char* name) {
+		if (!enabled) {
+			return;
+		}
+		FrameSlot& slot = slots[current];
+		// Zones nested inside one over the limit are over it too, so the overflow closes first
+		if (overflowDepth > 0 || slot.zoneCount == MAX_ZONES || depth == MAX_ZONES) {
+			++overflowedZones;
+			++overflowDepth;
+			return;
+		}
+		unsigned int index = slot.zoneCount++;
+		slot.zoneIds[index] = zoneId(name);
+		glQueryCounter(slot.startQueries[index], GL_TIMESTAMP);
+		openZones[depth++] = (int)index;
+	}
+
+	void endZone() {
+		if (!enabled) {
+			return;
+		}
+		if (overflowDepth > 0) {
+			--overflowDepth;
+			return;
+		}
+		if (depth == 0) {
+			return;
+		}
+		glQueryCounter(slots[current].endQueries[openZones[--depth]], GL_TIMESTAMP);
+	}
+
+	// Zones begun and not yet ended this frame, the ones over the limit included
+	unsigned int openZoneCount() const {
+		return depth + overflowDepth;
+	}
+	unsigned long long overflowCount() const {
+		return overflowedZones;
+	}
+
+	// Summary table: one line per zone with average and percentiles of the kept samples in milliseconds
+	void writeReport(std::ostream& out) {
+		collect();
+		out << "GPU timings (" << collectedFrames << " frames, " << warmupFrames << " warm-up frames skipped, "
+			<< droppedFrames << " dropped, " << overflowedZones << " zones over the limit)" << std::endl;
+		// Every column starts with a space, so even values wider than the column stay apart
+		out << std::left << std::setw(20) << "zone" << std::right;
+		const char* headers[] = { "samples", "avg ms", "min", "p50", "p95", "p99", "max" };
+		for (const char* header : headers) {
+			out << ' ' << std::setw(COLUMN_WIDTH) << header;
+		}
+		out << std::endl << std::fixed << std::setprecision(4);
+		for (ZoneStats& zone : zones) {
+			Summary s = summarize(zone);
+			out << std::left << std::setw(20) << zone.name << std::right << ' ' << std::setw(COLUMN_WIDTH) << zone.count;
+			double values[] = { s.average, s.min, s.p50, s.p95, s.p99, s.max };
+			for (double value : values) {
+				out << ' ' << std::setw(COLUMN_WIDTH) << value;
+			}
+			out << std::endl;
+		}
+		out << std::defaultfloat;
+	}
+
+	bool writeCsv(const char* path) {
+		collect();
+		std::ofstream file(path);
+		if (!file) {
+			std::cout << "ERROR::GPU_TIMER::FILE_NOT_SUCCESFULLY_WRITTEN " << path << std::endl;
+			return false;
+		}
+		file << "zone,samples,avg_ms,min_ms,p50_ms,p95_ms,p99_ms,max_ms\n";
+		for (ZoneStats& zone : zones) {
+			Summary s = summarize(zone);
+			file << zone.name << ',' << zone.count << ',' << s.average << ',' << s.min << ',' << s.p50 << ','
+				 << s.p95 << ',' << s.p99 << ',' << s.max << '\n';
+		}
+		return true;
+	}
+
+	// Average over all samples of the zone in milliseconds, 0 if there are none yet
+	double averageMs(const char* name) const {
+		for (const ZoneStats& zone : zones) {
+			if (strcmp(zone.name, name) == 0 && zone.count > 0) {
+				return zone.totalMs / zone.count;
+			}
+		}
+		return 0.0;
+	}
+
+private:
+	struct FrameSlot {
+		unsigned int frameQuery = 0;
+		unsigned int startQueries[MAX_ZONES];
+		unsigned int endQueries[MAX_ZONES];
+		int zoneIds[MAX_ZONES];
+		unsigned int zoneCount = 0;
+		bool pending = false;
+	};
+
+	struct ZoneStats {
+		const char* name;
+		std::vector<float> samples; // ring of the last HISTORY samples
+		unsigned int next = 0;
+		unsigned long long count = 0;
+		double totalMs = 0.0;
+	};
+
+	struct Summary {
+		double average = 0.0, min = 0.0, p50 = 0.0, p95 = 0.0, p99 = 0.0, max = 0.0;
+	};
+
+	std::vector<FrameSlot> slots;
+	std::vector<ZoneStats> zones; // zones[0] is the whole frame
+	unsigned int current = 0;
+	int openZones[MAX_ZONES];
+	unsigned int depth = 0;
+	unsigned int overflowDepth = 0; // open zones that did not fit, nested inside the ones in openZones
+	bool enabled = false;
+	unsigned long long collectedFrames = 0, droppedFrames = 0, overflowedZones = 0;
+	unsigned long long warmupFrames = 0; // read back but left out of the statistics
+
+	int zoneId(const char* name) {
+		for (unsigned int i = 0; i < zones.size(); ++i) {
+			if (zones[i].name == name || strcmp(zones[i].name, name) == 0) {
+				return (int)i;
+			}
+		}
+		ZoneStats zone;
+		zone.name = name;
+		zones.push_back(zone);
+		// Reserved in place, a copied vector does not keep its capacity
+		zones.back().samples.reserve(HISTORY);
+		return (int)zones.size() - 1;
+	}
+
+	void addSample(int id, double ms) {
+		ZoneStats& zone = zones[id];
+		if (zone.samples.size() < HISTORY) {
+			zone.samples.push_back((float)ms);
+		}
+		else {
+			zone.samples[zone.next] = (float)ms;
+			zone.next = (zone.next + 1) % HISTORY;
+		}
+		++zone.count;
+		zone.totalMs += ms;
+	}
+
+	static bool available(unsigned int query) {
+		int ready = 0;
+		glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &ready);
+		return ready != 0;
+	}
+
+	// Reads back every finished frame, oldest first, without waiting for unfinished ones
+	void collect() {
+		if (!enabled) {
+			return;
+		}
+		for (unsigned int n = 1; n <= slots.size(); ++n) {
+			FrameSlot& slot = slots[(current + n) % slots.size()];
+			if (!slot.pending) {
+				continue;
+			}
+			bool ready = available(slot.frameQuery);
+			for (unsigned int i = 0; ready && i < slot.zoneCount; ++i) {
+				ready = available(slot.startQueries[i]) && available(slot.endQueries[i]);
+			}
+			if (!ready) {
+				// Frames finish in order, the newer ones are not ready either
+				break;
+			}
+			slot.pending = false;
+			if (warmupFrames < slots.size()) {
+				// The first trip around the ring is not measured: some drivers (llvmpipe among them)
+				// return a timestamp instead of a duration for the first elapsed-time query
+				++warmupFrames;
+				continue;
+			}
+			GLuint64 elapsed, start, end;
+			glGetQueryObjectui64v(slot.frameQuery, GL_QUERY_RESULT, &elapsed);
+			addSample(0, elapsed / 1.0e6);
+			for (unsigned int i = 0; i < slot.zoneCount; ++i) {
+				glGetQueryObjectui64v(slot.startQueries[i], GL_QUERY_RESULT, &start);
+				glGetQueryObjectui64v(slot.endQueries[i], GL_QUERY_RESULT, &end);
+				addSample(slot.zoneIds[i], end > start ? (end - start) / 1.0e6 : 0.0);
+			}
+			++collectedFrames;
+		}
+	}
+
+	static Summary summarize(const ZoneStats& zone) {
+		Summary s;
+		if (zone.samples.empty()) {
+			return s;
+		}
+		std::vector<float> sorted(zone.samples);
+		std::sort(sorted.begin(), sorted.end());
+		size_t last = sorted.size() - 1;
+		double sum = 0.0;
+		for (float sample : sorted) {
+			sum += sample;
+		}
+		s.average = sum / sorted.size();
+		s.min = sorted.front();
+		s.p50 = sorted[last * 50 / 100];
+		s.p95 = sorted[last * 95 / 100];
+		s.p99 = sorted[last * 99 / 100];
+		s.max = sorted.back();
+		return s;
+	}
+};
+
+// Measures the GPU time of the enclosing scope
+class GpuZone {
+public:
+	GpuZone(GpuTimer& timer, const char* name) : timer(timer) {
+		timer.beginZone(name);
+	}
+	~GpuZone() {
+		timer.endZone();
+	}
+	GpuZone(const GpuZone&) = delete;
+	GpuZone& operator=(const GpuZone&) = delete;
+private:
+	GpuTimer& timer;
+};
+#endif
@@ -0,0 +1,201 @@
+#ifndef IMAGE_FILE_H
+#define IMAGE_FILE_H
+
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+// 8-bit RGBA pixels, rows from bottom to top (the order glTexImage2D expects)
+struct Image {
+	int width = 0;
+	int height = 0;
+	std::vector<unsigned char> rgba;
+};
+
+inline bool readFileBytes(const char* path, std::vector<unsigned char>& bytes) {
+	FILE* file = fopen(path, "rb");
+	if (!file) {
+		return false;
+	}
+	bytes.clear();
+	unsigned char chunk[64 * 1024];
+	size_t n;
+	while ((n = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+		bytes.insert(bytes.end(), chunk, chunk + n);
+	}
+	bool ok = !ferror(file);
+	fclose(file);
+	return ok;
+}
+
+namespace image_file {
+	const int MAX_DIMENSION = 16384;
+
+	inline void flipRows(Image& image) {
+		size_t rowBytes = (size_t)image.width * 4;
+		for (int y = 0; y < image.height / 2; ++y) {
+			unsigned char* a = image.rgba.data() + y * rowBytes;
+			unsigned char* b = image.rgba.data() + (image.height - 1 - y) * rowBytes;
+			for (size_t i = 0; i < rowBytes; ++i) {
+				unsigned char t = a[i];
+				a[i] = b[i];
+				b[i] = t;
+			}
+		}
+	}
+
+	// Binary PPM (P6, RGB) and PGM (P5, gray), 8 bits per sample
+	inline bool decodePnm(const unsigned char* data, size_t size, Image& image, const char*& error) {
+		size_t at = 2;
+		int fields[3];
+		for (int& field : fields) {
+			// Whitespace and # comments between the header fields
+			while (at < size && (data[at] == ' ' || data[at] == '\t' || data[at] == '\r' || data[at] == '\n' || data[at] == '#')) {
+				if (data[at] == '#') {
+					while (at < size && data[at] != '\n') {
+						++at;
+					}
+				}
+				else {
+					++at;
+				}
+			}
+			field = 0;
+			size_t start = at;
+			while (at < size && data[at] >= '0' && data[at] <= '9' && field <= MAX_DIMENSION) {
+				field = field * 10 + (data[at++] - '0');
+			}
+			if (at == start) {
+				error = "bad PNM header";
+				return false;
+			}
+		}
+		++at; // the single whitespace before the samples
+		int channels = data[1] == '6' ? 3 : 1;
+		if (fields[0] <= 0 || fields[1] <= 0 || fields[0] > MAX_DIMENSION || fields[1] > MAX_DIMENSION || fields[2] != 255) {
+			error = "unsupported PNM size or maximum value";
+			return false;
+		}
+		size_t pixels = (size_t)fields[0] * fields[1];
+		if (at > size || size - at < pixels * channels) {
+			error = "truncated PNM";
+			return false;
+		}
+		image.width = fields[0];
+		image.height = fields[1];
+		image.rgba.resize(pixels * 4);
+		const unsigned char* source = data + at;
+		// The file starts with the top row
+		for (int y = image.height - 1; y >= 0; --y) {
+			unsigned char* out = image.rgba.data() + (size_t)y * image.width * 4;
+			if (channels == 3) {
+				for (int x = 0; x < image.width; ++x, out += 4, source += 3) {
+					out[0] = source[0];
+					out[1] = source[1];
+					out[2] = source[2];
+					out[3] = 255;
+				}
+			}
+			else {
+				for (int x = 0; x < image.width; ++x, out += 4, ++source) {
+					out[0] = out[1] = out[2] = source[0];
+					out[3] = 255;
+				}
+			}
+		}
+		return true;
+	}
+
+	// TGA types 2/10 (true color, 24 or 32 bit) and 3/11 (8 bit gray), 10 and 11 run-length encoded
+	inline bool decodeTga(const unsigned char* data, size_t size, Image& image, const char*& error) {
+		if (size < 18) {
+			error = "truncated TGA header";
+			return false;
+		}
+		int idLength = data[0], colorMapType = data[1], type = data[2];
+		int width = data[12] | data[13] << 8, height = data[14] | data[15] << 8;
+		int bits = data[16], descriptor = data[17];
+		bool rle = type == 10 || type == 11, gray = type == 3 || type == 11;
+		if (colorMapType != 0 || !(type == 2 || type == 3 || type == 10 || type == 11)) {
+			error = "unsupported TGA type";
+			return false;
+		}
+		if (gray ? bits != 8 : bits != 24 && bits != 32) {
+			error = "unsupported TGA pixel depth";
+			return false;
+		}
+		if (width <= 0 || height <= 0 || width > MAX_DIMENSION || height > MAX_DIMENSION) {
+			error = "unsupported TGA size";
+			return false;
+		}
+		int bytesPerPixel = bits / 8;
+		size_t pixels = (size_t)width * height;
+		size_t at = 18 + idLength;
+		image.width = width;
+		image.height = height;
+		image.rgba.resize(pixels * 4);
+		unsigned char* out = image.rgba.data();
+		size_t written = 0;
+		while (written < pixels) {
+			// A packet repeats one pixel (RLE) or lists count pixels; raw images are a single long raw packet
+			size_t count = pixels - written;
+			bool repeat = false;
+			if (rle) {
+				if (at >= size) {
+					break;
+				}
+				repeat = (data[at] & 0x80) != 0;
+				count = (data[at] & 0x7F) + 1;
+				++at;
+				if (count > pixels - written) {
+					error = "TGA run past the end of the image";
+					return false;
+				}
+			}
+			size_t needed = (repeat ? 1 : count) * bytesPerPixel;
+			if (at > size || size - at < needed) {
+				break;
+			}
+			for (size_t i = 0; i < count; ++i, out += 4) {
+				const unsigned char* p = data + at + (repeat ? 0 : i * bytesPerPixel);
+				if (gray) {
+					out[0] = out[1] = out[2] = p[0];
+					out[3] = 255;
+				}
+				else {
+					// Stored as BGR(A)
+					out[0] = p[2];
+					out[1] = p[1];
+					out[2] = p[0];
+					out[3] = bytesPerPixel == 4 ? p[3] : 255;
+				}
+			}
+			at += needed;
+			written += count;
+		}
+		if (written < pixels) {
+			error = "truncated TGA";
+			return false;
+		}
+		if (descriptor & 0x20) {
+			// Top-left origin
+			flipRows(image);
+		}
+		return true;
+	}
+}
+
+// Picks the decoder from the file signature. On failure error names the reason.
+inline bool decodeImage(const unsigned char* data, size_t size, Image& image, const char*& error) {
+	if (size >= 2 && data[0] == 'P' && (data[1] == '5' || data[1] == '6')) {
+		return image_file::decodePnm(data, size, image, error);
+	}
+	// TGA has no signature, its header is checked field by field
+	if (size >= 18 && data[1] == 0 && (data[2] == 2 || data[2] == 3 || data[2] == 10 || data[2] == 11)) {
+		return image_file::decodeTga(data, size, image, error);
+	}
+	error = "unknown image format (PPM, PGM and TGA are supported)";
+	return false;
+}
+#endif
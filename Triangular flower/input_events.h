@@ -0,0 +1,262 @@
+#ifndef INPUT_EVENTS_H
+#define INPUT_EVENTS_H
+
+#include <GLFW/glfw3.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+enum class InputEventType {
+	Key,         // code = key, action = GLFW_PRESS/GLFW_RELEASE/GLFW_REPEAT
+	MouseButton, // code = button, action = GLFW_PRESS/GLFW_RELEASE
+	CursorMove,  // x, y = cursor position in screen coordinates
+	Scroll,      // x, y = scroll offsets
+	Resize,      // x, y = new framebuffer size in pixels
+	Refresh,     // window contents were damaged and have to be redrawn
+	Close,       // user asked to close the window
+};
+
+struct InputEvent {
+	InputEventType type;
+	int code;
+	int action;
+	int mods;
+	double x, y;
+};
+
+// Fixed size queue filled by the GLFW callbacks and drained once per frame by processInput.
+// GLFW calls the callbacks from inside glfwPollEvents/glfwWaitEvents* on the main thread, the frames
+// may be drawn on a render thread. It is a lock-free single-producer single-consumer ring: only the
+// producer moves the tail and only the consumer moves the head, both count up and wrap around.
+// Cursor moves do not fill the ring: the position goes into one slot that the producer overwrites, and
+// the ring only holds a marker for it until the consumer takes it. No other event is ever dropped, when
+// the ring is full they go to an overflow list under a lock until the consumer has caught up.
+class EventQueue {
+public:
+	static const unsigned int CAPACITY = 256; // a power of two, so the counters can wrap
+
+	// Installs the input callbacks on the window and registers this queue as its user pointer
+	void attach(GLFWwindow* window) {
+		glfwSetWindowUserPointer(window, this);
+		glfwSetKeyCallback(window, keyCallback);
+		glfwSetMouseButtonCallback(window, mouseButtonCallback);
+		glfwSetCursorPosCallback(window, cursorPosCallback);
+		glfwSetScrollCallback(window, scrollCallback);
+		glfwSetWindowRefreshCallback(window, refreshCallback);
+		glfwSetWindowCloseCallback(window, closeCallback);
+	}
+
+	static EventQueue* fromWindow(GLFWwindow* window) {
+		return static_cast<EventQueue*>(glfwGetWindowUserPointer(window));
+	}
+
+	// Producer side
+	void push(const InputEvent& event) {
+		if (event.type == InputEventType::CursorMove) {
+			// Seqlock: the consumer retries while the count is odd or has changed under it
+			cursorSequence.fetch_add(1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+			cursorX.store(event.x, std::memory_order_relaxed);
+			cursorY.store(event.y, std::memory_order_relaxed);
+			cursorSequence.fetch_add(1, std::memory_order_release);
+			if (cursorQueued.exchange(true, std::memory_order_acq_rel)) {
+				// The queued move will read the latest position
+				return;
+			}
+		}
+		unsigned int t = tail.load(std::memory_order_relaxed);
+		if (overflowing.load(std::memory_order_acquire) || t - head.load(std::memory_order_acquire) == CAPACITY) {
+			std::lock_guard<std::mutex> lock(overflowMutex);
+			// Rechecked under the lock, the consumer clears it there once the list is drained
+			if (overflowing.load(std::memory_order_relaxed) || t - head.load(std::memory_order_acquire) == CAPACITY) {
+				overflow.push_back(event);
+				overflowing.store(true, std::memory_order_seq_cst);
+				wakeConsumer();
+				return;
+			}
+		}
+		events[t % CAPACITY] = event;
+		// Sequentially consistent with the consumer's sleeping flag: either the consumer sees the event
+		// before it sleeps, or this sees it sleeping and wakes it
+		tail.store(t + 1, std::memory_order_seq_cst);
+		wakeConsumer();
+	}
+
+	// Consumer side. The ring's events come first, the overflow's after them.
+	bool poll(InputEvent& event) {
+		unsigned int h = head.load(std::memory_order_relaxed);
+		if (h != tail.load(std::memory_order_acquire)) {
+			event = events[h % CAPACITY];
+			head.store(h + 1, std::memory_order_release);
+		}
+		else if (!pollOverflow(event)) {
+			return false;
+		}
+		if (event.type == InputEventType::CursorMove) {
+			// Cleared first, a move after it queues another marker rather than being lost
+			cursorQueued.store(false, std::memory_order_seq_cst);
+			readCursor(event.x, event.y);
+		}
+		return true;
+	}
+
+	bool empty() const {
+		return head.load(std::memory_order_relaxed) == tail.load(std::memory_order_seq_cst) &&
+			   !overflowing.load(std::memory_order_seq_cst);
+	}
+
+	// Consumer side: sleeps until an event arrives or the timeout has passed
+	void wait(double timeoutSeconds) {
+		std::unique_lock<std::mutex> lock(wakeMutex);
+		sleeping.store(true, std::memory_order_seq_cst);
+		wakeup.wait_for(lock, std::chrono::duration<double>(timeoutSeconds), [this] {
+			return !empty();
+		});
+		sleeping.store(false, std::memory_order_relaxed);
+	}
+
+	// Convenience for posting events that do not come from the window callbacks
+	void push(InputEventType type, int code = 0, int action = 0, int mods = 0, double x = 0.0, double y = 0.0) {
+		InputEvent event = { type, code, action, mods, x, y };
+		push(event);
+	}
+
+private:
+	InputEvent events[CAPACITY];
+	std::atomic<unsigned int> head{ 0 };
+	std::atomic<unsigned int> tail{ 0 };
+	// Only taken to sleep and to wake a sleeping consumer, never to push or poll
+	std::mutex wakeMutex;
+	std::condition_variable wakeup;
+	std::atomic<bool> sleeping{ false };
+	// The latest cursor position and whether a marker for it is in the queue
+	std::atomic<unsigned int> cursorSequence{ 0 };
+	std::atomic<double> cursorX{ 0.0 }, cursorY{ 0.0 };
+	std::atomic<bool> cursorQueued{ false };
+	// Events that came while the ring was full, in order, from overflowHead on
+	std::mutex overflowMutex;
+	std::vector<InputEvent> overflow;
+	size_t overflowHead = 0;
+	std::atomic<bool> overflowing{ false };
+
+	void wakeConsumer() {
+		if (sleeping.load(std::memory_order_seq_cst)) {
+			std::lock_guard<std::mutex> lock(wakeMutex);
+			wakeup.notify_one();
+		}
+	}
+
+	void readCursor(double& x, double& y) const {
+		for (;;) {
+			unsigned int sequence = cursorSequence.load(std::memory_order_acquire);
+			x = cursorX.load(std::memory_order_relaxed);
+			y = cursorY.load(std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if ((sequence & 1) == 0 && cursorSequence.load(std::memory_order_relaxed) == sequence) {
+				return;
+			}
+		}
+	}
+
+	// Only once the ring is empty, so the overflow's events stay behind the ring's
+	bool pollOverflow(InputEvent& event) {
+		if (!overflowing.load(std::memory_order_acquire)) {
+			return false;
+		}
+		std::lock_guard<std::mutex> lock(overflowMutex);
+		if (overflowHead == overflow.size()) {
+			return false;
+		}
+		event = overflow[overflowHead++];
+		if (overflowHead == overflow.size()) {
+			// Drained: the producer goes back to the ring, which is empty
+			overflow.clear();
+			overflowHead = 0;
+			overflowing.store(false, std::memory_order_seq_cst);
+		}
+		return true;
+	}
+
+	static void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+		fromWindow(window)->push(InputEventType::Key, key, action, mods);
+	}
+
+	static void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods) {
+		fromWindow(window)->push(InputEventType::MouseButton, button, action, mods);
+	}
+
+	static void cursorPosCallback(GLFWwindow* window, double x, double y) {
+		fromWindow(window)->push(InputEventType::CursorMove, 0, 0, 0, x, y);
+	}
+
+	static void scrollCallback(GLFWwindow* window, double x, double y) {
+		fromWindow(window)->push(InputEventType::Scroll, 0, 0, 0, x, y);
+	}
+
+	static void refreshCallback(GLFWwindow* window) {
+		fromWindow(window)->push(InputEventType::Refresh);
+	}
+
+	static void closeCallback(GLFWwindow* window) {
+		fromWindow(window)->push(InputEventType::Close);
+	}
+};
+
+// Decides when the render loop has to produce a frame.
+// In continuous mode every iteration renders. In on-demand mode the loop sleeps in
+// glfwWaitEventsTimeout until an event arrives, and renders only if the frame was
+// invalidated or an animation is running, so a static scene costs (almost) nothing.
+class FrameScheduler {
+public:
+	FrameScheduler(bool onDemand, double idleTimeout) : onDemand(onDemand), idleTimeout(idleTimeout) {}
+
+	// Pumps the GLFW events, blocking only if there is nothing to draw
+	void waitEvents() {
+		if (!onDemand || dirty || animating) {
+			glfwPollEvents();
+		}
+		else {
+			glfwWaitEventsTimeout(idleTimeout);
+		}
+	}
+
+	// The same for a render thread, while the main thread pumps the events into the queue
+	void waitEvents(EventQueue& events) {
+		if (onDemand && !dirty && !animating) {
+			events.wait(idleTimeout);
+		}
+	}
+
+	// Marks the current frame as outdated
+	void invalidate() {
+		dirty = true;
+	}
+
+	// While animating, every loop iteration renders a new frame
+	void setAnimating(bool value) {
+		animating = value;
+	}
+
+	bool isAnimating() const {
+		return animating;
+	}
+
+	bool needsFrame() const {
+		return !onDemand || dirty || animating;
+	}
+
+	// Called after glfwSwapBuffers
+	void frameRendered() {
+		dirty = false;
+	}
+
+private:
+	bool onDemand;
+	double idleTimeout;
+	bool dirty = true; // the first frame always has to be drawn
+	bool animating = false;
+};
+#endif
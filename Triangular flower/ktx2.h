@@ -0,0 +1,236 @@
+#ifndef KTX2_H
+#define KTX2_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include "texture_compression.h"
+
+// KTX 2.0 container for block compressed 2D textures with mip levels, no supercompression.
+// Rows are stored bottom to top (KTXorientation "ru"), the order glCompressedTexImage2D expects.
+namespace ktx2 {
+	const unsigned char IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+	const size_t HEADER_BYTES = 80; // identifier, header and index
+	const size_t LEVEL_BYTES = 24;
+	const int MAX_LEVELS = 16;
+
+	struct FormatCodes {
+		uint32_t vkFormat;
+		uint32_t colorModel; // data format descriptor color model
+	};
+
+	inline FormatCodes formatCodes(BlockFormat format) {
+		switch (format) {
+		case BlockFormat::BC1: return { 131, 128 };  // VK_FORMAT_BC1_RGB_UNORM_BLOCK, KHR_DF_MODEL_BC1A
+		case BlockFormat::BC3: return { 137, 130 };  // VK_FORMAT_BC3_UNORM_BLOCK, KHR_DF_MODEL_BC3
+		case BlockFormat::BC7: return { 145, 134 };  // VK_FORMAT_BC7_UNORM_BLOCK, KHR_DF_MODEL_BC7
+		case BlockFormat::ETC2: return { 147, 161 }; // VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK, KHR_DF_MODEL_ETC2
+		}
+		return { 0, 0 };
+	}
+
+	inline bool formatFromVk(uint32_t vkFormat, BlockFormat& format) {
+		for (int i = 0; i < 4; ++i) {
+			if (formatCodes((BlockFormat)i).vkFormat == vkFormat) {
+				format = (BlockFormat)i;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	inline void put32(std::vector<unsigned char>& out, uint32_t v) {
+		for (int i = 0; i < 4; ++i) {
+			out.push_back((unsigned char)(v >> (8 * i)));
+		}
+	}
+
+	inline void put64(std::vector<unsigned char>& out, uint64_t v) {
+		put32(out, (uint32_t)v);
+		put32(out, (uint32_t)(v >> 32));
+	}
+
+	inline uint32_t get32(const unsigned char* p) {
+		return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+	}
+
+	inline uint64_t get64(const unsigned char* p) {
+		return (uint64_t)get32(p) | (uint64_t)get32(p + 4) << 32;
+	}
+
+	inline void padTo(std::vector<unsigned char>& out, size_t alignment) {
+		while (out.size() % alignment) {
+			out.push_back(0);
+		}
+	}
+
+	// Basic data format descriptor: one sample per 64 bit plane of the block, alpha first for BC3
+	inline void putDescriptor(std::vector<unsigned char>& out, BlockFormat format) {
+		bool separateAlpha = format == BlockFormat::BC3;
+		uint32_t samples = separateAlpha ? 2 : 1, blockBytes = blockFormatInfo(format).blockBytes;
+		uint32_t blockSize = 24 + 16 * samples;
+		put32(out, 4 + blockSize);
+		put32(out, 0);                 // vendor 0 (Khronos), descriptor type 0 (basic)
+		put32(out, 2 | blockSize << 16); // version 2
+		put32(out, formatCodes(format).colorModel | 1 << 8 | 1 << 16); // BT.709 primaries, linear transfer, straight alpha
+		put32(out, 3 | 3 << 8);        // 4x4x1x1 texels per block
+		put32(out, blockBytes);        // bytes in plane 0
+		put32(out, 0);
+		// Channel ids: color 0 for the BC formats, 2 for ETC2, alpha 15
+		uint32_t colorChannel = format == BlockFormat::ETC2 ? 2 : 0;
+		uint32_t bitLength = separateAlpha ? 64 : blockBytes * 8;
+		for (uint32_t sample = 0; sample < samples; ++sample) {
+			uint32_t channel = separateAlpha && sample == 0 ? 15 : colorChannel;
+			put32(out, sample * 64 | (bitLength - 1) << 16 | channel << 24);
+			put32(out, 0);
+			put32(out, 0);
+			put32(out, 0xFFFFFFFFu);
+		}
+	}
+
+	inline void putKeyValue(std::vector<unsigned char>& out, const char* key, const char* value) {
+		size_t keyBytes = strlen(key) + 1, valueBytes = strlen(value) + 1;
+		put32(out, (uint32_t)(keyBytes + valueBytes));
+		out.insert(out.end(), key, key + keyBytes);
+		out.insert(out.end(), value, value + valueBytes);
+		padTo(out, 4);
+	}
+}
+
+// Writes levels [0, levelCount) of a compressed texture, level i being max(1, width >> i) x max(1, height >> i).
+// As the format asks, the smallest level comes first in the file.
+inline bool writeKtx2(const char* path, BlockFormat format, int width, int height, int levelCount,
+					  const unsigned char* const* levels, const size_t* levelBytes) {
+	if (levelCount < 1 || levelCount > ktx2::MAX_LEVELS) {
+		return false;
+	}
+	std::vector<unsigned char> out(ktx2::IDENTIFIER, ktx2::IDENTIFIER + 12);
+	ktx2::put32(out, ktx2::formatCodes(format).vkFormat);
+	ktx2::put32(out, 1); // typeSize
+	ktx2::put32(out, (uint32_t)width);
+	ktx2::put32(out, (uint32_t)height);
+	ktx2::put32(out, 0); // depth
+	ktx2::put32(out, 0); // layers
+	ktx2::put32(out, 1); // faces
+	ktx2::put32(out, (uint32_t)levelCount);
+	ktx2::put32(out, 0); // supercompression
+
+	std::vector<unsigned char> descriptor, keyValues;
+	ktx2::putDescriptor(descriptor, format);
+	ktx2::putKeyValue(keyValues, "KTXorientation", "ru");
+	ktx2::putKeyValue(keyValues, "KTXwriter", "Triangular flower texture compressor");
+
+	size_t descriptorOffset = ktx2::HEADER_BYTES + ktx2::LEVEL_BYTES * levelCount;
+	size_t keyValueOffset = descriptorOffset + descriptor.size();
+	ktx2::put32(out, (uint32_t)descriptorOffset);
+	ktx2::put32(out, (uint32_t)descriptor.size());
+	ktx2::put32(out, (uint32_t)keyValueOffset);
+	ktx2::put32(out, (uint32_t)keyValues.size());
+	ktx2::put64(out, 0); // supercompression global data
+	ktx2::put64(out, 0);
+
+	// Level data is aligned to the least common multiple of the block size and 4
+	size_t alignment = blockFormatInfo(format).blockBytes;
+	size_t offsets[ktx2::MAX_LEVELS];
+	size_t at = keyValueOffset + keyValues.size();
+	for (int i = levelCount - 1; i >= 0; --i) {
+		at = (at + alignment - 1) / alignment * alignment;
+		offsets[i] = at;
+		at += levelBytes[i];
+	}
+	for (int i = 0; i < levelCount; ++i) {
+		ktx2::put64(out, offsets[i]);
+		ktx2::put64(out, levelBytes[i]);
+		ktx2::put64(out, levelBytes[i]);
+	}
+	out.insert(out.end(), descriptor.begin(), descriptor.end());
+	out.insert(out.end(), keyValues.begin(), keyValues.end());
+
+	FILE* file = fopen(path, "wb");
+	if (!file) {
+		return false;
+	}
+	bool ok = fwrite(out.data(), 1, out.size(), file) == out.size();
+	size_t written = out.size();
+	for (int i = levelCount - 1; i >= 0 && ok; --i) {
+		static const unsigned char zeros[16] = {};
+		ok = fwrite(zeros, 1, offsets[i] - written, file) == offsets[i] - written &&
+			fwrite(levels[i], 1, levelBytes[i], file) == levelBytes[i];
+		written = offsets[i] + levelBytes[i];
+	}
+	return fclose(file) == 0 && ok;
+}
+
+struct Ktx2Texture {
+	BlockFormat format = BlockFormat::BC1;
+	int width = 0;
+	int height = 0;
+	int levelCount = 0;
+	const unsigned char* levels[ktx2::MAX_LEVELS]; // point into the parsed bytes
+	size_t levelBytes[ktx2::MAX_LEVELS];
+	bool topDown = false; // KTXorientation "rd", the default of other writers
+};
+
+// Validates the header and level index of a file written by writeKtx2 (or any 2D, single layer,
+// non-supercompressed KTX2 in one of the four formats). The level pointers point into data.
+inline bool parseKtx2(const unsigned char* data, size_t size, Ktx2Texture& texture, const char*& error) {
+	if (size < ktx2::HEADER_BYTES || memcmp(data, ktx2::IDENTIFIER, 12) != 0) {
+		error = "not a KTX2 file";
+		return false;
+	}
+	if (!ktx2::formatFromVk(ktx2::get32(data + 12), texture.format)) {
+		error = "unsupported vkFormat (BC1 RGB, BC3, BC7 and ETC2 RGB are supported)";
+		return false;
+	}
+	texture.width = (int)ktx2::get32(data + 20);
+	texture.height = (int)ktx2::get32(data + 24);
+	uint32_t depth = ktx2::get32(data + 28), layers = ktx2::get32(data + 32), faces = ktx2::get32(data + 36);
+	uint32_t levelCount = ktx2::get32(data + 40), supercompression = ktx2::get32(data + 44);
+	if (depth != 0 || layers > 1 || faces != 1 || supercompression != 0) {
+		error = "only plain 2D textures are supported";
+		return false;
+	}
+	if (texture.width <= 0 || texture.height <= 0 || texture.width > 16384 || texture.height > 16384) {
+		error = "unsupported texture size";
+		return false;
+	}
+	// 0 levels asks the loader to generate them, which compressed formats cannot do
+	if (levelCount == 0 || levelCount > (uint32_t)ktx2::MAX_LEVELS || size < ktx2::HEADER_BYTES + ktx2::LEVEL_BYTES * levelCount) {
+		error = "bad level count";
+		return false;
+	}
+	texture.levelCount = (int)levelCount;
+	for (int i = 0; i < texture.levelCount; ++i) {
+		const unsigned char* entry = data + ktx2::HEADER_BYTES + ktx2::LEVEL_BYTES * i;
+		uint64_t offset = ktx2::get64(entry), length = ktx2::get64(entry + 8);
+		int levelWidth = texture.width >> i ? texture.width >> i : 1, levelHeight = texture.height >> i ? texture.height >> i : 1;
+		if (offset > size || length > size - offset || length != compressedSize(texture.format, levelWidth, levelHeight)) {
+			error = "level outside the file or of the wrong size";
+			return false;
+		}
+		texture.levels[i] = data + offset;
+		texture.levelBytes[i] = (size_t)length;
+	}
+	// Rows run top to bottom unless the key/value data says otherwise
+	texture.topDown = true;
+	uint32_t keyValueOffset = ktx2::get32(data + 56), keyValueBytes = ktx2::get32(data + 60);
+	if (keyValueOffset <= size && keyValueBytes <= size - keyValueOffset) {
+		const unsigned char* at = data + keyValueOffset;
+		const unsigned char* end = at + keyValueBytes;
+		while (end - at >= 4) {
+			uint32_t length = ktx2::get32(at);
+			if (length > (size_t)(end - at) - 4) {
+				break;
+			}
+			const char* key = (const char*)at + 4;
+			if (length >= 18 && memcmp(key, "KTXorientation", 15) == 0) {
+				texture.topDown = key[16] != 'u';
+			}
+			at += 4 + (length + 3) / 4 * 4;
+		}
+	}
+	return true;
+}
+#endif
@@ -0,0 +1,99 @@
+#ifndef MIPMAP_H
+#define MIPMAP_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "image_file.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define MIPMAP_USE_SSE2
+#endif
+
+// Every level of a texture down to 1x1, stored one after the other
+struct MipChain {
+	static const int MAX_LEVELS = 16;
+
+	int levels = 0;
+	int width[MAX_LEVELS];
+	int height[MAX_LEVELS];
+	size_t offset[MAX_LEVELS]; // into pixels
+	std::vector<unsigned char> pixels;
+
+	const unsigned char* level(int i) const {
+		return pixels.data() + offset[i];
+	}
+	size_t levelBytes(int i) const {
+		return (size_t)width[i] * height[i] * 4;
+	}
+};
+
+// 2x2 box filter of an RGBA8 image into one of max(1, width / 2) x max(1, height / 2), rounded to nearest.
+// An odd last row or column is dropped, a side of 1 is averaged with itself.
+inline void downsampleBox(const unsigned char* source, int width, int height, unsigned char* destination) {
+	int outWidth = width > 1 ? width / 2 : 1, outHeight = height > 1 ? height / 2 : 1;
+	size_t rowBytes = (size_t)width * 4;
+	for (int y = 0; y < outHeight; ++y) {
+		const unsigned char* row0 = source + (size_t)(2 * y) * rowBytes;
+		const unsigned char* row1 = height > 1 ? row0 + rowBytes : row0;
+		unsigned char* out = destination + (size_t)y * outWidth * 4;
+		int x = 0;
+#ifdef MIPMAP_USE_SSE2
+		if (width > 1) {
+			// 8 source pixels of both rows give 4 output pixels
+			const __m128i zero = _mm_setzero_si128(), two = _mm_set1_epi16(2);
+			int end = outWidth - outWidth % 4;
+			for (; x < end; x += 4) {
+				__m128i a0 = _mm_loadu_si128((const __m128i*)(row0 + 8 * x)), a1 = _mm_loadu_si128((const __m128i*)(row0 + 8 * x + 16));
+				__m128i b0 = _mm_loadu_si128((const __m128i*)(row1 + 8 * x)), b1 = _mm_loadu_si128((const __m128i*)(row1 + 8 * x + 16));
+				// Vertical sums, two 16-bit pixels per register
+				__m128i s0 = _mm_add_epi16(_mm_unpacklo_epi8(a0, zero), _mm_unpacklo_epi8(b0, zero));
+				__m128i s1 = _mm_add_epi16(_mm_unpackhi_epi8(a0, zero), _mm_unpackhi_epi8(b0, zero));
+				__m128i s2 = _mm_add_epi16(_mm_unpacklo_epi8(a1, zero), _mm_unpacklo_epi8(b1, zero));
+				__m128i s3 = _mm_add_epi16(_mm_unpackhi_epi8(a1, zero), _mm_unpackhi_epi8(b1, zero));
+				// Horizontal sums: the pixel pair of each register ends up in its low half
+				s0 = _mm_add_epi16(s0, _mm_srli_si128(s0, 8));
+				s1 = _mm_add_epi16(s1, _mm_srli_si128(s1, 8));
+				s2 = _mm_add_epi16(s2, _mm_srli_si128(s2, 8));
+				s3 = _mm_add_epi16(s3, _mm_srli_si128(s3, 8));
+				__m128i lo = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(s0, s1), two), 2);
+				__m128i hi = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(s2, s3), two), 2);
+				_mm_storeu_si128((__m128i*)(out + 4 * x), _mm_packus_epi16(lo, hi));
+			}
+		}
+#endif
+		for (; x < outWidth; ++x) {
+			int x0 = 2 * x, x1 = width > 1 ? x0 + 1 : x0;
+			for (int c = 0; c < 4; ++c) {
+				int sum = row0[4 * x0 + c] + row0[4 * x1 + c] + row1[4 * x0 + c] + row1[4 * x1 + c];
+				out[4 * x + c] = (unsigned char)((sum + 2) >> 2);
+			}
+		}
+	}
+}
+
+inline void buildMipChain(const Image& image, MipChain& chain) {
+	int width = image.width, height = image.height;
+	size_t total = 0;
+	chain.levels = 0;
+	for (;;) {
+		chain.width[chain.levels] = width;
+		chain.height[chain.levels] = height;
+		chain.offset[chain.levels] = total;
+		total += (size_t)width * height * 4;
+		++chain.levels;
+		if ((width == 1 && height == 1) || chain.levels == MipChain::MAX_LEVELS) {
+			break;
+		}
+		width = width > 1 ? width / 2 : 1;
+		height = height > 1 ? height / 2 : 1;
+	}
+	chain.pixels.resize(total);
+	std::copy(image.rgba.begin(), image.rgba.end(), chain.pixels.begin());
+	for (int i = 1; i < chain.levels; ++i) {
+		downsampleBox(chain.level(i - 1), chain.width[i - 1], chain.height[i - 1], chain.pixels.data() + chain.offset[i]);
+	}
+}
+#endif
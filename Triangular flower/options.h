@@ -0,0 +1,147 @@
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include <cstring>
+#include <cstdlib>
+#include <iostream>
+
+// Run-time switches shared by the demos, filled from the command line
+struct Options {
+	// Render only when an event, an animation or an invalidation asks for a frame
+	bool onDemand = false;
+	// How long the on-demand loop may sleep in glfwWaitEventsTimeout (seconds)
+	double idleTimeout = 0.5;
+	// Enables GPU timer queries, per-zone statistics are written to this CSV file at exit
+	const char* gpuTimingsPath = nullptr;
+	// Enables GPU timer queries and nests one zone more than the timer keeps in the first frame, the zones
+	// must all close again
+	bool gpuTimerCheck = false;
+	// Prints the GPU buffer allocator's memory statistics at exit
+	bool gpuMemoryReport = false;
+	// Triangular flower: leaves the meshes behind holes and on a page of their own, the per-frame
+	// defragmentation must move them into one packed page by the end of the run
+	bool defragmentCheck = false;
+	// CPU profiler output, Chrome trace-event JSON and/or the compact binary format
+	const char* tracePath = nullptr;
+	const char* traceBinaryPath = nullptr;
+	// Frame capture: output file, or a command whose stdin receives the frames
+	const char* capturePath = nullptr;
+	bool capturePipe = false;
+	bool captureRgb = false; // raw rgb24 frames instead of Y4M
+	int captureFps = 60;
+	// Streamed in by the texture loader while the loop runs, a .ktx2 file is uploaded at startup
+	const char* texturePath = nullptr;
+	// Triangular flower: streams this many megabytes of buffers in on a loader thread while the loop runs
+	unsigned int streamMegabytes = 0;
+	// Learning openGL: draws this many random quads through the sprite batcher on top of the rectangle
+	unsigned int spriteCount = 0;
+	// Triangular flower: a grid of this many animated flowers, 0 draws the one still flower filling the window
+	unsigned int flowerCount = 0;
+	// Triangular flower: shapes, shaders, flowers and animations from a scene file instead of the generated
+	// ones; the parsed scene is cached next to it in <path>.cache
+	const char* scenePath = nullptr;
+	// Triangular flower: picks the circle's segment count per flower for this chord error in pixels, 0 keeps 8 segments
+	float circleTolerance = 0.0f;
+	// Triangular flower: culls and builds the draw commands in a compute shader (GL 4.3, culled on the CPU
+	// without it); the check reads the GPU's counts back every frame and compares them with the CPU's
+	bool gpuCulling = false;
+	bool gpuCullingCheck = false;
+	// Shows frame time, draw calls, uniform updates and GPU memory on screen, H toggles it
+	bool hud = false;
+	// Triangular flower: draws on a render thread while the main thread pumps the window's events,
+	// --single-thread does both on the main thread
+	bool renderThread = true;
+	// Seeds the random colors for reproducible images, 0 keeps the hardware seed
+	unsigned int seed = 0;
+};
+
+// Parses argv on top of the given defaults, unknown arguments are reported and skipped
+inline Options parseOptions(int argc, char** argv, Options options = Options()) {
+	for (int i = 1; i < argc; ++i) {
+		const char* arg = argv[i];
+		if (strcmp(arg, "--on-demand") == 0) {
+			options.onDemand = true;
+		}
+		else if (strcmp(arg, "--continuous") == 0) {
+			options.onDemand = false;
+		}
+		else if (strcmp(arg, "--idle-timeout") == 0 && i + 1 < argc) {
+			options.idleTimeout = atof(argv[++i]);
+		}
+		else if (strcmp(arg, "--gpu-timings") == 0 && i + 1 < argc) {
+			options.gpuTimingsPath = argv[++i];
+		}
+		else if (strcmp(arg, "--gpu-timer-check") == 0) {
+			options.gpuTimerCheck = true;
+		}
+		else if (strcmp(arg, "--gpu-memory") == 0) {
+			options.gpuMemoryReport = true;
+		}
+		else if (strcmp(arg, "--defragment-check") == 0) {
+			options.defragmentCheck = true;
+		}
+		else if (strcmp(arg, "--trace") == 0 && i + 1 < argc) {
+			options.tracePath = argv[++i];
+		}
+		else if (strcmp(arg, "--trace-binary") == 0 && i + 1 < argc) {
+			options.traceBinaryPath = argv[++i];
+		}
+		else if (strcmp(arg, "--capture") == 0 && i + 1 < argc) {
+			options.capturePath = argv[++i];
+			options.capturePipe = false;
+		}
+		else if (strcmp(arg, "--capture-pipe") == 0 && i + 1 < argc) {
+			options.capturePath = argv[++i];
+			options.capturePipe = true;
+		}
+		else if (strcmp(arg, "--capture-rgb") == 0) {
+			options.captureRgb = true;
+		}
+		else if (strcmp(arg, "--capture-fps") == 0 && i + 1 < argc) {
+			options.captureFps = atoi(argv[++i]);
+		}
+		else if (strcmp(arg, "--texture") == 0 && i + 1 < argc) {
+			options.texturePath = argv[++i];
+		}
+		else if (strcmp(arg, "--stream") == 0 && i + 1 < argc) {
+			options.streamMegabytes = (unsigned int)strtoul(argv[++i], nullptr, 10);
+		}
+		else if (strcmp(arg, "--sprites") == 0 && i + 1 < argc) {
+			options.spriteCount = (unsigned int)strtoul(argv[++i], nullptr, 10);
+		}
+		else if (strcmp(arg, "--flowers") == 0 && i + 1 < argc) {
+			options.flowerCount = (unsigned int)strtoul(argv[++i], nullptr, 10);
+		}
+		else if (strcmp(arg, "--scene") == 0 && i + 1 < argc) {
+			options.scenePath = argv[++i];
+		}
+		else if (strcmp(arg, "--circle-lod") == 0 && i + 1 < argc) {
+			options.circleTolerance = (float)atof(argv[++i]);
+		}
+		else if (strcmp(arg, "--gpu-cull") == 0) {
+			options.gpuCulling = true;
+		}
+		else if (strcmp(arg, "--gpu-cull-check") == 0) {
+			options.gpuCulling = true;
+			options.gpuCullingCheck = true;
+		}
+		else if (strcmp(arg, "--hud") == 0) {
+			options.hud = true;
+		}
+		else if (strcmp(arg, "--single-thread") == 0) {
+			options.renderThread = false;
+		}
+		else if (strcmp(arg, "--seed") == 0 && i + 1 < argc) {
+			options.seed = (unsigned int)strtoul(argv[++i], nullptr, 10);
+		}
+		else {
+			std::cout << "WARNING::OPTIONS::UNKNOWN_ARGUMENT " << arg << std::endl;
+		}
+	}
+	// Regression runs (REGRESS_DIR, see regression.h) compare images, which needs the same colors every run
+	if (options.seed == 0 && getenv("REGRESS_DIR") != nullptr) {
+		options.seed = 1;
+	}
+	return options;
+}
+#endif
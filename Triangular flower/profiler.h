@@ -0,0 +1,419 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+// CPU frame profiler.
+// PROFILE_ZONE("name") measures the enclosing scope. The zone is written at scope exit into a
+// lock-free single-producer/single-consumer ring owned by the calling thread, so recording costs
+// two timestamp reads and one store. A background thread drains the rings and streams the zones to
+// a Chrome trace-event JSON file (open it in Perfetto or chrome://tracing) and/or a compact binary file.
+// PROFILE_COUNTER("name", value) adds a sample to a counter track the same way.
+// Defining DISABLE_PROFILER (done for the Release configurations) compiles every macro out.
+
+#ifdef DISABLE_PROFILER
+
+#define PROFILE_ZONE(name) ((void)0)
+#define PROFILE_FUNCTION() ((void)0)
+#define PROFILE_THREAD_NAME(name) ((void)0)
+#define PROFILE_COUNTER(name, value) ((void)0)
+#define PROFILER_START(jsonPath, binaryPath) ((void)0)
+#define PROFILER_STOP() ((void)0)
+
+#else
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "allocation_counter.h"
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define PROFILER_USE_TSC
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define PROFILER_USE_TSC
+#endif
+
+class Profiler {
+public:
+	// A counter sample is a zone with COUNTER_FLAG set in start and the value in end
+	struct Zone {
+		const char* name;
+		uint64_t start;
+		uint64_t end;
+	};
+	static const uint64_t COUNTER_FLAG = 1ull << 63;
+
+	// Ring buffer written only by its own thread and read only by the flush thread
+	struct ThreadBuffer {
+		static const uint32_t CAPACITY = 1 << 16; // power of two
+
+		Zone zones[CAPACITY];
+		std::atomic<uint32_t> head{ 0 }; // next slot to write, owned by the producer
+		std::atomic<uint32_t> tail{ 0 }; // next slot to read, owned by the consumer
+		uint32_t cachedTail = 0;         // producer side copy of tail, refreshed only when the ring looks full
+		uint32_t threadId = 0;
+		std::string threadName;
+		bool nameWritten = false;
+		uint64_t dropped = 0;
+		uint64_t previousStart = 0;      // delta base of the binary format
+
+		void push(const char* name, uint64_t start, uint64_t end) {
+			uint32_t h = head.load(std::memory_order_relaxed);
+			if (h - cachedTail == CAPACITY) {
+				cachedTail = tail.load(std::memory_order_acquire);
+				if (h - cachedTail == CAPACITY) {
+					++dropped;
+					return;
+				}
+			}
+			Zone& zone = zones[h & (CAPACITY - 1)];
+			zone.name = name;
+			zone.start = start;
+			zone.end = end;
+			head.store(h + 1, std::memory_order_release);
+		}
+	};
+
+	static Profiler& instance() {
+		static Profiler profiler;
+		return profiler;
+	}
+
+	// Zones are only recorded between start() and stop()
+	static bool isActive() {
+		return activeFlag().load(std::memory_order_relaxed);
+	}
+
+	// Raw timestamp, converted to microseconds only when the zones are written out
+	static uint64_t now() {
+#ifdef PROFILER_USE_TSC
+		return __rdtsc();
+#else
+		return (uint64_t)std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+	}
+
+	// The calling thread's buffer, created and registered on first use
+	static ThreadBuffer* threadBuffer() {
+		static thread_local ThreadBuffer* buffer = nullptr;
+		if (buffer == nullptr) {
+			buffer = instance().registerThread();
+		}
+		return buffer;
+	}
+
+	// Value of a counter track (memory in use, queue lengths...) at this moment
+	static void counter(const char* name, uint64_t value) {
+		if (isActive()) {
+			threadBuffer()->push(name, now() | COUNTER_FLAG, value);
+		}
+	}
+
+	void setThreadName(const char* name) {
+		ThreadBuffer* buffer = threadBuffer();
+		std::lock_guard<std::mutex> lock(mutex);
+		buffer->threadName = name;
+		buffer->nameWritten = false;
+	}
+
+	// Starts the background flush thread, either path may be null
+	bool start(const char* jsonPath, const char* binaryPath) {
+		if (running) {
+			return true;
+		}
+		if (jsonPath) {
+			json = fopen(jsonPath, "wb");
+			if (!json) {
+				std::cout << "ERROR::PROFILER::FILE_NOT_SUCCESFULLY_OPENED " << jsonPath << std::endl;
+				return false;
+			}
+			fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", json);
+			firstJsonEvent = true;
+		}
+		if (binaryPath) {
+			binary = fopen(binaryPath, "wb");
+			if (!binary) {
+				std::cout << "ERROR::PROFILER::FILE_NOT_SUCCESFULLY_OPENED " << binaryPath << std::endl;
+				return false;
+			}
+		}
+		calibrate();
+		if (binary) {
+			// Header: magic, version, ticks per microsecond
+			fwrite("CPUPROF", 1, 8, binary);
+			uint32_t version = 2;
+			fwrite(&version, sizeof(version), 1, binary);
+			fwrite(&ticksPerMicrosecond, sizeof(ticksPerMicrosecond), 1, binary);
+		}
+		running = true;
+		flusher = std::thread(&Profiler::flushLoop, this);
+		activeFlag().store(true, std::memory_order_relaxed);
+		return true;
+	}
+
+	// Drains the remaining zones and closes the files
+	void stop() {
+		if (!running) {
+			return;
+		}
+		activeFlag().store(false, std::memory_order_relaxed);
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			running = false;
+		}
+		wake.notify_one();
+		flusher.join();
+		flush();
+		uint64_t dropped = 0;
+		for (auto& buffer : buffers) {
+			dropped += buffer->dropped;
+		}
+		if (dropped > 0) {
+			std::cout << "WARNING::PROFILER::ZONES_DROPPED " << dropped << std::endl;
+		}
+		if (json) {
+			fputs("\n]}\n", json);
+			fclose(json);
+			json = nullptr;
+		}
+		if (binary) {
+			fclose(binary);
+			binary = nullptr;
+		}
+	}
+
+private:
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::thread flusher;
+	bool running = false;
+	std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+	std::vector<ThreadBuffer*> flushSnapshot; // kept between flushes, only the flush thread uses it
+	std::unordered_map<const char*, uint32_t> nameIds; // binary format string table
+	FILE* json = nullptr;
+	FILE* binary = nullptr;
+	bool firstJsonEvent = true;
+	uint64_t originTicks = 0;
+	double ticksPerMicrosecond = 1.0;
+
+	static std::atomic<bool>& activeFlag() {
+		static std::atomic<bool> active{ false };
+		return active;
+	}
+
+	Profiler() = default;
+	~Profiler() {
+		stop();
+	}
+
+	ThreadBuffer* registerThread() {
+		std::lock_guard<std::mutex> lock(mutex);
+		buffers.emplace_back(new ThreadBuffer());
+		ThreadBuffer* buffer = buffers.back().get();
+		buffer->threadId = (uint32_t)buffers.size();
+		buffer->threadName = "thread " + std::to_string(buffer->threadId);
+		return buffer;
+	}
+
+	void calibrate() {
+		using namespace std::chrono;
+#ifdef PROFILER_USE_TSC
+		steady_clock::time_point wallStart = steady_clock::now();
+		uint64_t tscStart = now();
+		std::this_thread::sleep_for(milliseconds(20));
+		steady_clock::time_point wallEnd = steady_clock::now();
+		uint64_t tscEnd = now();
+		ticksPerMicrosecond = (tscEnd - tscStart) / (double)duration_cast<nanoseconds>(wallEnd - wallStart).count() * 1000.0;
+#else
+		ticksPerMicrosecond = steady_clock::period::den / (double)steady_clock::period::num / 1.0e6;
+#endif
+		originTicks = now();
+	}
+
+	void flushLoop() {
+		std::unique_lock<std::mutex> lock(mutex);
+		while (running) {
+			wake.wait_for(lock, std::chrono::milliseconds(50));
+			lock.unlock();
+			flush();
+			lock.lock();
+		}
+	}
+
+	// Copies the buffers list so that threads may register while the zones are written
+	void flush() {
+		std::vector<ThreadBuffer*>& snapshot = flushSnapshot;
+		snapshot.clear();
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (snapshot.capacity() < buffers.size()) {
+				// Grows only when threads register
+				AllocationExemption exemption;
+				snapshot.reserve(buffers.size() * 2);
+			}
+			for (auto& buffer : buffers) {
+				snapshot.push_back(buffer.get());
+				if (!buffer->nameWritten) {
+					writeThreadName(*buffer);
+					buffer->nameWritten = true;
+				}
+			}
+		}
+		for (ThreadBuffer* buffer : snapshot) {
+			uint32_t t = buffer->tail.load(std::memory_order_relaxed);
+			uint32_t h = buffer->head.load(std::memory_order_acquire);
+			for (; t != h; ++t) {
+				const Zone& zone = buffer->zones[t & (ThreadBuffer::CAPACITY - 1)];
+				writeZone(*buffer, zone);
+			}
+			buffer->tail.store(t, std::memory_order_release);
+		}
+		if (json) {
+			fflush(json);
+		}
+		if (binary) {
+			fflush(binary);
+		}
+	}
+
+	double toMicroseconds(uint64_t ticks) const {
+		return (int64_t)(ticks - originTicks) / ticksPerMicrosecond;
+	}
+
+	static void writeJsonString(FILE* file, const char* text) {
+		fputc('"', file);
+		for (; *text; ++text) {
+			if (*text == '"' || *text == '\\') {
+				fputc('\\', file);
+			}
+			fputc((unsigned char)*text < 0x20 ? ' ' : *text, file);
+		}
+		fputc('"', file);
+	}
+
+	// LEB128 variable length integer
+	void writeVarint(uint64_t value) {
+		unsigned char bytes[10];
+		int n = 0;
+		do {
+			bytes[n] = value & 0x7F;
+			value >>= 7;
+			if (value) {
+				bytes[n] |= 0x80;
+			}
+			++n;
+		} while (value);
+		fwrite(bytes, 1, n, binary);
+	}
+
+	// Binary record: 'N' id length bytes
+	void writeName(uint32_t id, const char* name, size_t length) {
+		fputc('N', binary);
+		writeVarint(id);
+		writeVarint(length);
+		fwrite(name, 1, length, binary);
+	}
+
+	void writeThreadName(const ThreadBuffer& buffer) {
+		if (json) {
+			fprintf(json, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":",
+					firstJsonEvent ? "" : ",\n", buffer.threadId);
+			writeJsonString(json, buffer.threadName.c_str());
+			fputs("}}", json);
+			firstJsonEvent = false;
+		}
+		if (binary) {
+			// Thread names share the string table, 'T' thread nameId
+			uint32_t id = (uint32_t)nameIds.size() + 1;
+			AllocationExemption exemption;
+			nameIds[buffer.threadName.c_str()] = id;
+			writeName(id, buffer.threadName.c_str(), buffer.threadName.size());
+			fputc('T', binary);
+			writeVarint(buffer.threadId);
+			writeVarint(id);
+		}
+	}
+
+	void writeZone(ThreadBuffer& buffer, const Zone& zone) {
+		bool counter = (zone.start & COUNTER_FLAG) != 0;
+		uint64_t start = zone.start & ~COUNTER_FLAG;
+		if (json) {
+			fprintf(json, "%s{\"name\":", firstJsonEvent ? "" : ",\n");
+			writeJsonString(json, zone.name);
+			if (counter) {
+				fprintf(json, ",\"ph\":\"C\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"args\":{\"value\":%llu}}",
+						buffer.threadId, toMicroseconds(start), (unsigned long long)zone.end);
+			}
+			else {
+				fprintf(json, ",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+						buffer.threadId, toMicroseconds(start), (zone.end - start) / ticksPerMicrosecond);
+			}
+			firstJsonEvent = false;
+		}
+		if (binary) {
+			// 'Z' thread nameId startDelta duration, start is relative to the previous zone of the same thread.
+			// Counters are 'C' thread nameId startDelta value.
+			auto found = nameIds.find(zone.name);
+			uint32_t id;
+			if (found == nameIds.end()) {
+				// Once per zone name, whenever it first turns up; not a steady-state allocation
+				AllocationExemption exemption;
+				id = (uint32_t)nameIds.size() + 1;
+				nameIds[zone.name] = id;
+				writeName(id, zone.name, strlen(zone.name));
+			}
+			else {
+				id = found->second;
+			}
+			uint64_t base = buffer.previousStart ? buffer.previousStart : originTicks;
+			fputc(counter ? 'C' : 'Z', binary);
+			writeVarint(buffer.threadId);
+			writeVarint(id);
+			// Zones are recorded when they end, so a nested zone may start before its predecessor
+			int64_t delta = (int64_t)(start - base);
+			writeVarint(((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63));
+			writeVarint(counter ? zone.end : zone.end - start);
+			buffer.previousStart = start;
+		}
+	}
+};
+
+// Measures the enclosing scope, see PROFILE_ZONE
+class ProfileScope {
+public:
+	explicit ProfileScope(const char* name) : name(Profiler::isActive() ? name : nullptr), start(Profiler::now()) {}
+	~ProfileScope() {
+		if (name) {
+			Profiler::threadBuffer()->push(name, start, Profiler::now());
+		}
+	}
+	ProfileScope(const ProfileScope&) = delete;
+	ProfileScope& operator=(const ProfileScope&) = delete;
+private:
+	const char* name;
+	uint64_t start;
+};
+
+#define PROFILER_CONCAT_IMPL(a, b) a##b
+#define PROFILER_CONCAT(a, b) PROFILER_CONCAT_IMPL(a, b)
+// `name` has to be a string literal (or live as long as the profiler)
+#define PROFILE_ZONE(name) ProfileScope PROFILER_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_FUNCTION() PROFILE_ZONE(__func__)
+#define PROFILE_THREAD_NAME(name) Profiler::instance().setThreadName(name)
+// Sample of a counter track, `name` has the same lifetime rule as for PROFILE_ZONE
+#define PROFILE_COUNTER(name, value) Profiler::counter(name, (uint64_t)(value))
+#define PROFILER_START(jsonPath, binaryPath) Profiler::instance().start(jsonPath, binaryPath)
+#define PROFILER_STOP() Profiler::instance().stop()
+
+#endif
+#endif
@@ -0,0 +1,367 @@
+#ifndef REGRESSION_H
+#define REGRESSION_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "allocation_counter.h"
+
+// Golden-image and frame-budget regression checks for offscreen runs (see glfw_headless.cpp).
+// Selected frames are read back and compared against stored PPM goldens with a per-channel
+// tolerance. CPU time (from one swap to the next) and GPU time (GL_TIMESTAMP queries over the same span)
+// of every frame can be compared against a stored baseline. Everything is reported as JSON.
+//
+// Run each demo headless, e.g. from "Triangular flower":
+//   export HEADLESS_FRAMES=60 REGRESS_DIR=goldens REGRESS_NAME=flower
+//   REGRESS_UPDATE=1 ./flower                      (records goldens and the timing baseline)
+//   REGRESS_REPORT=flower.json ./flower            (checks, exit code 1 on failure)
+// Goldens and baselines are machine specific (driver, CPU), so they are recorded on the machine that checks them.
+//
+// Images only match with the same colors and animation time every run: with REGRESS_DIR set the demos
+// use seed 1 unless --seed says otherwise, and HEADLESS_FIXED_DT defaults to 1/60 s.
+// Timings are only compared with REGRESS_TIMING set, frame times of shared or busy machines vary far more
+// than any useful margin. GPU time is left out on software renderers (llvmpipe, softpipe, swrast), where
+// it would only measure the CPU a second time.
+//
+// Environment:
+//   REGRESS_DIR        directory of the goldens and the baseline, enables the checks
+//   REGRESS_NAME       prefix of the stored files
+//   REGRESS_FRAMES     comma separated frame numbers to compare (default: the last frame)
+//   REGRESS_TOLERANCE  allowed difference per color channel (default 2)
+//   REGRESS_BAD_PIXELS fraction of pixels allowed to exceed the tolerance (default 0)
+//   REGRESS_TIMING     compare the timings against the baseline too (off by default)
+//   REGRESS_MARGIN     allowed slowdown over the baseline, 0.5 = 50% (default 0.5)
+//   REGRESS_SLACK_MS   absolute slowdown always allowed, keeps microsecond frames out of the noise (default 0.5)
+//   REGRESS_WARMUP     frames excluded from the timings (default 5)
+//   REGRESS_UPDATE     record goldens and baseline instead of checking them
+//   REGRESS_REPORT     JSON report path (default: standard output)
+class RegressionHarness {
+public:
+	bool configureFromEnvironment(long long lastFrame) {
+		const char* dir = getenv("REGRESS_DIR");
+		if (dir == nullptr) {
+			return false;
+		}
+		directory = dir;
+		if (const char* value = getenv("REGRESS_NAME")) {
+			name = value;
+		}
+		if (const char* value = getenv("REGRESS_FRAMES")) {
+			for (const char* p = value; *p;) {
+				char* end;
+				long long frame = strtoll(p, &end, 10);
+				if (end == p) {
+					break;
+				}
+				checkedFrames.push_back(frame);
+				p = *end == ',' ? end + 1 : end;
+			}
+		}
+		if (checkedFrames.empty()) {
+			checkedFrames.push_back(lastFrame);
+		}
+		if (const char* value = getenv("REGRESS_TOLERANCE")) {
+			tolerance = atoi(value);
+		}
+		if (const char* value = getenv("REGRESS_BAD_PIXELS")) {
+			badPixelFraction = atof(value);
+		}
+		if (const char* value = getenv("REGRESS_MARGIN")) {
+			margin = atof(value);
+		}
+		if (const char* value = getenv("REGRESS_SLACK_MS")) {
+			slackMs = atof(value);
+		}
+		if (const char* value = getenv("REGRESS_WARMUP")) {
+			warmup = atoll(value);
+		}
+		update = getenv("REGRESS_UPDATE") != nullptr;
+		compareTiming = getenv("REGRESS_TIMING") != nullptr;
+		// Per-frame records are reserved up front, the measured frames do not allocate
+		if (lastFrame > 0) {
+			cpuTimes.reserve((size_t)lastFrame + 1);
+			gpuQueries.reserve(2 * ((size_t)lastFrame + 1));
+		}
+		if (const char* value = getenv("REGRESS_REPORT")) {
+			reportPath = value;
+		}
+		enabled = true;
+		return true;
+	}
+
+	bool isEnabled() const {
+		return enabled;
+	}
+
+	// Starts measuring the next frame, call after swapping (and once before the first frame, with the context current)
+	void beginFrame() {
+		if (!enabled) {
+			return;
+		}
+		if (cpuTimes.empty() && gpuQueries.empty()) {
+			const char* renderer = (const char*)glGetString(GL_RENDERER);
+			measureGpu = renderer == nullptr || !(strstr(renderer, "llvmpipe") || strstr(renderer, "softpipe") || strstr(renderer, "swrast"));
+		}
+		if (measureGpu) {
+			// Timestamps instead of GL_TIME_ELAPSED, which cannot nest with the queries of GpuTimer
+			unsigned int queries[2];
+			glGenQueries(2, queries);
+			glQueryCounter(queries[0], GL_TIMESTAMP);
+			gpuQueries.push_back(queries[0]);
+			gpuQueries.push_back(queries[1]);
+		}
+		frameStart = std::chrono::steady_clock::now();
+	}
+
+	// Ends the measurement of frame `frame` (1-based) and checks it if it is one of the selected frames
+	void endFrame(long long frame, int width, int height) {
+		if (!enabled) {
+			return;
+		}
+		cpuTimes.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count());
+		if (measureGpu) {
+			glQueryCounter(gpuQueries.back(), GL_TIMESTAMP);
+		}
+		if (std::find(checkedFrames.begin(), checkedFrames.end(), frame) != checkedFrames.end()) {
+			checkImage(frame, width, height);
+		}
+	}
+
+	// Reads the GPU timings, compares them and writes the report. Returns false if anything regressed.
+	bool finish() {
+		if (!enabled) {
+			return true;
+		}
+		enabled = false;
+		AllocationExemption exemption; // the report is written once, in the last frame
+		// The run is over, waiting for the results does not disturb anything anymore
+		std::vector<double> gpuTimes;
+		for (size_t i = 0; i < gpuQueries.size() / 2 && i < cpuTimes.size(); ++i) {
+			GLuint64 start = 0, end = 0;
+			glGetQueryObjectui64v(gpuQueries[2 * i], GL_QUERY_RESULT, &start);
+			glGetQueryObjectui64v(gpuQueries[2 * i + 1], GL_QUERY_RESULT, &end);
+			gpuTimes.push_back(end > start ? (end - start) / 1.0e6 : 0.0);
+		}
+		glDeleteQueries((GLsizei)gpuQueries.size(), gpuQueries.data());
+		gpuQueries.clear();
+
+		Timing cpu = summarize(cpuTimes), gpu = summarize(gpuTimes);
+		std::string baselinePath = directory + "/" + name + "_baseline.json";
+		double baselineCpu = 0.0, baselineGpu = 0.0;
+		bool timingPassed = true;
+		if (update) {
+			std::ofstream baseline(baselinePath);
+			baseline << "{\"cpu_ms\": " << cpu.median << ", \"gpu_ms\": " << gpu.median << "}\n";
+			baselineCpu = cpu.median;
+			baselineGpu = gpu.median;
+		}
+		else if (compareTiming) {
+			if (readBaseline(baselinePath, baselineCpu, baselineGpu)) {
+				timingPassed = cpu.median <= baselineCpu * (1.0 + margin) + slackMs;
+				if (measureGpu) {
+					timingPassed = timingPassed && gpu.median <= baselineGpu * (1.0 + margin) + slackMs;
+				}
+			}
+			else {
+				error("missing baseline " + baselinePath);
+				timingPassed = false;
+			}
+		}
+
+		bool imagesPassed = true;
+		for (const ImageResult& image : images) {
+			imagesPassed = imagesPassed && image.passed;
+		}
+		for (long long frame : checkedFrames) {
+			bool found = false;
+			for (const ImageResult& image : images) {
+				found = found || image.frame == frame;
+			}
+			if (!found) {
+				error("frame " + std::to_string(frame) + " was never rendered");
+				imagesPassed = false;
+			}
+		}
+		bool passed = timingPassed && imagesPassed && errors.empty();
+
+		std::ostringstream json;
+		json << "{\n  \"name\": \"" << name << "\",\n  \"mode\": \"" << (update ? "update" : "check") << "\",\n";
+		json << "  \"passed\": " << (passed ? "true" : "false") << ",\n  \"frames\": " << cpuTimes.size() << ",\n";
+		json << "  \"images\": [";
+		for (size_t i = 0; i < images.size(); ++i) {
+			const ImageResult& image = images[i];
+			json << (i ? "," : "") << "\n    {\"frame\": " << image.frame << ", \"golden\": \"" << image.golden
+				 << "\", \"max_difference\": " << image.maxDifference << ", \"bad_pixels\": " << image.badPixels
+				 << ", \"allowed_bad_pixels\": " << image.allowedBadPixels << ", \"passed\": " << (image.passed ? "true" : "false") << "}";
+		}
+		json << "\n  ],\n  \"timing\": {\n";
+		json << "    \"cpu_ms_median\": " << cpu.median << ", \"cpu_ms_p95\": " << cpu.p95 << ", \"cpu_ms_baseline\": " << baselineCpu << ",\n";
+		json << "    \"gpu_measured\": " << (measureGpu ? "true" : "false") << ", \"compared\": " << (compareTiming ? "true" : "false") << ",\n";
+		json << "    \"gpu_ms_median\": " << gpu.median << ", \"gpu_ms_p95\": " << gpu.p95 << ", \"gpu_ms_baseline\": " << baselineGpu << ",\n";
+		json << "    \"margin\": " << margin << ", \"slack_ms\": " << slackMs << ", \"passed\": " << (timingPassed ? "true" : "false") << "\n  },\n";
+		json << "  \"errors\": [";
+		for (size_t i = 0; i < errors.size(); ++i) {
+			json << (i ? ", " : "") << "\"" << errors[i] << "\"";
+		}
+		json << "]\n}\n";
+
+		if (reportPath.empty()) {
+			std::cout << json.str();
+		}
+		else {
+			std::ofstream report(reportPath);
+			report << json.str();
+		}
+		return passed;
+	}
+
+private:
+	struct ImageResult {
+		long long frame;
+		std::string golden;
+		int maxDifference = 0;
+		long long badPixels = 0, allowedBadPixels = 0;
+		bool passed = true;
+	};
+
+	struct Timing {
+		double median = 0.0, p95 = 0.0;
+	};
+
+	bool enabled = false;
+	bool update = false;
+	bool compareTiming = false;
+	bool measureGpu = true; // false on software renderers
+	std::string directory, name = "demo", reportPath;
+	std::vector<long long> checkedFrames;
+	int tolerance = 2;
+	double badPixelFraction = 0.0, margin = 0.5, slackMs = 0.5;
+	long long warmup = 5;
+	std::chrono::steady_clock::time_point frameStart;
+	std::vector<double> cpuTimes;
+	std::vector<unsigned int> gpuQueries;
+	std::vector<ImageResult> images;
+	std::vector<std::string> errors;
+
+	void error(const std::string& message) {
+		std::cout << "ERROR::REGRESSION::" << message << std::endl;
+		errors.push_back(message);
+	}
+
+	Timing summarize(std::vector<double> times) const {
+		Timing timing;
+		if ((long long)times.size() > warmup) {
+			times.erase(times.begin(), times.begin() + warmup);
+		}
+		if (times.empty()) {
+			return timing;
+		}
+		std::sort(times.begin(), times.end());
+		timing.median = times[times.size() / 2];
+		timing.p95 = times[(times.size() - 1) * 95 / 100];
+		return timing;
+	}
+
+	static bool readBaseline(const std::string& path, double& cpu, double& gpu) {
+		std::ifstream file(path);
+		if (!file) {
+			return false;
+		}
+		std::stringstream stream;
+		stream << file.rdbuf();
+		std::string text = stream.str();
+		size_t cpuKey = text.find("\"cpu_ms\""), gpuKey = text.find("\"gpu_ms\"");
+		if (cpuKey == std::string::npos || gpuKey == std::string::npos) {
+			return false;
+		}
+		cpu = atof(text.c_str() + text.find(':', cpuKey) + 1);
+		gpu = atof(text.c_str() + text.find(':', gpuKey) + 1);
+		return true;
+	}
+
+	// Rows are stored top to bottom, as in every image viewer
+	static bool writePpm(const std::string& path, const std::vector<unsigned char>& rgb, int width, int height) {
+		FILE* file = fopen(path.c_str(), "wb");
+		if (!file) {
+			return false;
+		}
+		fprintf(file, "P6\n%d %d\n255\n", width, height);
+		fwrite(rgb.data(), 1, rgb.size(), file);
+		fclose(file);
+		return true;
+	}
+
+	static bool readPpm(const std::string& path, std::vector<unsigned char>& rgb, int& width, int& height) {
+		FILE* file = fopen(path.c_str(), "rb");
+		if (!file) {
+			return false;
+		}
+		int maxValue = 0;
+		bool ok = fscanf(file, "P6 %d %d %d", &width, &height, &maxValue) == 3 && maxValue == 255 && fgetc(file) != EOF;
+		if (ok) {
+			rgb.resize((size_t)width * height * 3);
+			ok = fread(rgb.data(), 1, rgb.size(), file) == rgb.size();
+		}
+		fclose(file);
+		return ok;
+	}
+
+	void checkImage(long long frame, int width, int height) {
+		// Readback, goldens and the report entry allocate on purpose
+		AllocationExemption exemption;
+		std::vector<unsigned char> pixels((size_t)width * height * 3), rgb(pixels.size());
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+		for (int y = 0; y < height; ++y) {
+			memcpy(&rgb[(size_t)y * width * 3], &pixels[(size_t)(height - 1 - y) * width * 3], (size_t)width * 3);
+		}
+
+		ImageResult result;
+		result.frame = frame;
+		result.golden = directory + "/" + name + "_frame" + std::to_string(frame) + ".ppm";
+		if (update) {
+			result.passed = writePpm(result.golden, rgb, width, height);
+			if (!result.passed) {
+				error("cannot write " + result.golden);
+			}
+			images.push_back(result);
+			return;
+		}
+
+		std::vector<unsigned char> golden;
+		int goldenWidth, goldenHeight;
+		if (!readPpm(result.golden, golden, goldenWidth, goldenHeight) || goldenWidth != width || goldenHeight != height) {
+			error("missing or mismatched golden " + result.golden);
+			result.passed = false;
+			images.push_back(result);
+			return;
+		}
+		for (size_t i = 0; i < rgb.size(); i += 3) {
+			int difference = 0;
+			for (int c = 0; c < 3; ++c) {
+				difference = std::max(difference, std::abs((int)rgb[i + c] - (int)golden[i + c]));
+			}
+			result.maxDifference = std::max(result.maxDifference, difference);
+			if (difference > tolerance) {
+				++result.badPixels;
+			}
+		}
+		result.allowedBadPixels = (long long)(badPixelFraction * width * height);
+		result.passed = result.badPixels <= result.allowedBadPixels;
+		if (!result.passed) {
+			// Keep the failing frame next to the golden for inspection
+			writePpm(directory + "/" + name + "_frame" + std::to_string(frame) + "_actual.ppm", rgb, width, height);
+		}
+		images.push_back(result);
+	}
+};
+#endif
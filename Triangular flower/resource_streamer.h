@@ -0,0 +1,345 @@
+#ifndef RESOURCE_STREAMER_H
+#define RESOURCE_STREAMER_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "compressed_texture.h"
+#include "image_file.h"
+#include "mipmap.h"
+#include "allocation_counter.h"
+#include "profiler.h"
+
+// Creates and fills buffers and textures on a loader thread with its own GL context, shared with the
+// render context, so loading while the loop runs costs the render thread nothing but a fence check.
+// The loader uploads a resource whole, inserts a fence after it and hands the object over with the fence.
+// update(), called once per frame on the render thread, polls the fences without waiting: a resource is
+// ready, and only then returned by object(), once the GPU has finished the loader's commands for it.
+// As GL requires for changes made in another context, bind the object again after it becomes ready.
+class ResourceStreamer {
+public:
+	// Writes the buffer's contents on the loader thread, straight into the mapped buffer
+	typedef std::function<void(unsigned char* data, size_t bytes)> FillFunction;
+
+	ResourceStreamer() = default;
+	~ResourceStreamer() {
+		stopLoader();
+	}
+
+	ResourceStreamer(const ResourceStreamer&) = delete;
+	ResourceStreamer& operator=(const ResourceStreamer&) = delete;
+
+	// On the main thread, as GLFW creates windows there: the loader's context lives in a hidden window
+	// sharing objects with shareWith's context. The window hints of shareWith must still be set.
+	bool init(GLFWwindow* shareWith) {
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+		loaderWindow = glfwCreateWindow(1, 1, "Resource loader", NULL, shareWith);
+		glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+		if (loaderWindow == NULL) {
+			std::cout << "ERROR::RESOURCE_STREAMER::SHARED_CONTEXT_NOT_CREATED" << std::endl;
+			return false;
+		}
+		resources.reserve(64);
+		pending.reserve(64);
+		received.reserve(64);
+		finished.reserve(64);
+		stopping = false;
+		loader = std::thread(&ResourceStreamer::loaderLoop, this);
+		initialized = true;
+		return true;
+	}
+
+	// On the main thread with the render context current. Drops what has not been loaded yet.
+	void destroy() {
+		if (!initialized) {
+			return;
+		}
+		stopLoader();
+		received.swap(finished);
+		pending.insert(pending.end(), received.begin(), received.end());
+		for (Result& result : pending) {
+			glDeleteSync(result.fence);
+			resources[result.resource].name = result.name;
+		}
+		pending.clear();
+		received.clear();
+		for (Resource& resource : resources) {
+			if (resource.name == 0) {
+				continue;
+			}
+			if (resource.kind == Kind::Buffer) {
+				glDeleteBuffers(1, &resource.name);
+			}
+			else {
+				glDeleteTextures(1, &resource.name);
+			}
+			resource.name = 0;
+		}
+		glfwDestroyWindow(loaderWindow);
+		loaderWindow = NULL;
+		initialized = false;
+	}
+
+	// Queues a buffer of this many bytes and returns its id right away
+	uint32_t loadBuffer(size_t bytes, FillFunction fill) {
+		uint32_t id = queue(Kind::Buffer, bytes);
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			jobs.push_back({ id, Kind::Buffer, bytes, std::move(fill), std::string() });
+		}
+		wake.notify_one();
+		return id;
+	}
+
+	// Queues a texture file (PPM, PGM, TGA or KTX2) and returns its id right away
+	uint32_t loadTexture(const char* path) {
+		uint32_t id = queue(Kind::Texture, 0);
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			jobs.push_back({ id, Kind::Texture, 0, FillFunction(), path });
+		}
+		wake.notify_one();
+		return id;
+	}
+
+	// Call once per frame on the render thread
+	void update() {
+		if (!initialized) {
+			return;
+		}
+		PROFILE_ZONE("resourceHandoff");
+		if (finishedCount.load(std::memory_order_acquire) != 0) {
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				received.swap(finished);
+				finishedCount.store(0, std::memory_order_relaxed);
+			}
+			pending.insert(pending.end(), received.begin(), received.end());
+			received.clear();
+		}
+		size_t kept = 0;
+		for (size_t i = 0; i < pending.size(); ++i) {
+			Result& result = pending[i];
+			Resource& resource = resources[result.resource];
+			if (result.fence) {
+				if (glClientWaitSync(result.fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+					// The loader's commands are still on their way, look again next frame
+					pending[kept++] = result;
+					continue;
+				}
+				glDeleteSync(result.fence);
+			}
+			resource.name = result.name;
+			resource.bytes = result.bytes;
+			resource.state = result.name ? State::Ready : State::Failed;
+			readyBytes += result.name ? result.bytes : 0;
+		}
+		pending.resize(kept);
+	}
+
+	// The buffer or texture object, 0 until it is ready
+	unsigned int object(uint32_t id) const {
+		const Resource& resource = resources[id];
+		return resource.state == State::Ready ? resource.name : 0;
+	}
+	bool isReady(uint32_t id) const {
+		return resources[id].state == State::Ready;
+	}
+	bool hasFailed(uint32_t id) const {
+		return resources[id].state == State::Failed;
+	}
+	// Resources neither ready nor failed
+	unsigned int pendingCount() const {
+		unsigned int count = 0;
+		for (const Resource& resource : resources) {
+			count += resource.state == State::Loading;
+		}
+		return count;
+	}
+	// Bytes of the ready resources; of the queued buffers, textures count once they are ready
+	uint64_t loadedBytes() const {
+		return readyBytes;
+	}
+	uint64_t queuedBytes() const {
+		return requestedBytes;
+	}
+
+	void writeReport(std::ostream& out) const {
+		unsigned int ready = 0, failed = 0;
+		for (const Resource& resource : resources) {
+			ready += resource.state == State::Ready;
+			failed += resource.state == State::Failed;
+		}
+		out << "Streamed resources: " << ready << " ready (" << readyBytes << " bytes), " << failed << " failed, "
+			<< pendingCount() << " loading" << std::endl;
+	}
+
+private:
+	enum class Kind {
+		Buffer,
+		Texture,
+	};
+	enum class State {
+		Loading,
+		Ready,
+		Failed,
+	};
+	struct Resource {
+		Kind kind;
+		State state = State::Loading;
+		unsigned int name = 0;
+		size_t bytes = 0;
+	};
+	struct Job {
+		uint32_t resource;
+		Kind kind;
+		size_t bytes;
+		FillFunction fill;
+		std::string path;
+	};
+	struct Result {
+		uint32_t resource;
+		unsigned int name; // 0 when loading failed
+		size_t bytes;
+		GLsync fence;
+	};
+
+	bool initialized = false;
+	GLFWwindow* loaderWindow = NULL;
+	std::vector<Resource> resources;
+	std::vector<Result> pending; // handed over, waiting for their fences
+	uint64_t readyBytes = 0, requestedBytes = 0;
+
+	// Shared with the loader
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::deque<Job> jobs;
+	std::vector<Result> finished;
+	std::atomic<unsigned int> finishedCount{ 0 };
+	bool stopping = false;
+	std::thread loader;
+	std::vector<Result> received; // render thread side of finished
+
+	uint32_t queue(Kind kind, size_t bytes) {
+		uint32_t id = (uint32_t)resources.size();
+		resources.push_back(Resource());
+		resources.back().kind = kind;
+		requestedBytes += bytes;
+		return id;
+	}
+
+	void stopLoader() {
+		if (!loader.joinable()) {
+			return;
+		}
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		wake.notify_all();
+		loader.join();
+	}
+
+	void loaderLoop() {
+		// Loading allocates, but it is not the render loop's work
+		allocation_counter::exemptCurrentThread();
+		PROFILE_THREAD_NAME("resource loader");
+		glfwMakeContextCurrent(loaderWindow);
+		for (;;) {
+			Job job;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				wake.wait(lock, [this] { return stopping || !jobs.empty(); });
+				if (stopping) {
+					break;
+				}
+				job = std::move(jobs.front());
+				jobs.pop_front();
+			}
+			Result result = { job.resource, 0, job.bytes, 0 };
+			result.name = job.kind == Kind::Buffer ? createBuffer(job) : createTexture(job.path.c_str(), result.bytes);
+			if (result.name) {
+				result.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+				// Another context waits for the fence, it has to reach the GPU without this one's help
+				glFlush();
+			}
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				finished.push_back(result);
+			}
+			finishedCount.fetch_add(1, std::memory_order_release);
+		}
+		glfwMakeContextCurrent(NULL);
+	}
+
+	// Through the copy target, the loader's context has no vertex array to hold an element array binding
+	static unsigned int createBuffer(Job& job) {
+		PROFILE_ZONE("streamBuffer");
+		unsigned int buffer = 0;
+		glGenBuffers(1, &buffer);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+		glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)job.bytes, nullptr, GL_STATIC_DRAW);
+		unsigned char* mapped = (unsigned char*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, (GLsizeiptr)job.bytes,
+			GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+		bool written = mapped != nullptr;
+		if (mapped) {
+			job.fill(mapped, job.bytes);
+			// The contents can be lost while mapped, unmapping tells
+			written = glUnmapBuffer(GL_COPY_WRITE_BUFFER) == GL_TRUE;
+		}
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		if (!written) {
+			std::cout << "ERROR::RESOURCE_STREAMER::BUFFER_NOT_WRITTEN" << std::endl;
+			glDeleteBuffers(1, &buffer);
+			return 0;
+		}
+		return buffer;
+	}
+
+	static unsigned int createTexture(const char* path, size_t& bytes) {
+		PROFILE_ZONE("streamTexture");
+		size_t length = strlen(path);
+		if (length > 5 && strcmp(path + length - 5, ".ktx2") == 0) {
+			return loadCompressedTexture(path, &bytes);
+		}
+		std::vector<unsigned char> file;
+		if (!readFileBytes(path, file)) {
+			std::cout << "ERROR::RESOURCE_STREAMER::FILE_NOT_SUCCESFULLY_READ " << path << std::endl;
+			return 0;
+		}
+		Image image;
+		const char* error = nullptr;
+		if (!decodeImage(file.data(), file.size(), image, error)) {
+			std::cout << "ERROR::RESOURCE_STREAMER::DECODE_FAILED " << path << ": " << error << std::endl;
+			return 0;
+		}
+		MipChain mips;
+		buildMipChain(image, mips);
+		unsigned int texture = 0;
+		glGenTextures(1, &texture);
+		glBindTexture(GL_TEXTURE_2D, texture);
+		for (int level = 0; level < mips.levels; ++level) {
+			glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, mips.width[level], mips.height[level], 0, GL_RGBA, GL_UNSIGNED_BYTE, mips.level(level));
+		}
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, mips.levels - 1);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		bytes = mips.pixels.size();
+		return texture;
+	}
+};
+#endif
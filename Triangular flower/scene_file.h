@@ -0,0 +1,705 @@
+#ifndef SCENE_FILE_H
+#define SCENE_FILE_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "flower_geometry.h"
+#include "mapped_file.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define SCENE_USE_SSE2
+#endif
+
+// Scene description of the flower demo, a text of whitespace separated tokens:
+//   # a comment, to the end of the line
+//   shader <name> <vertex shader path> <fragment shader path>
+//   mesh <name> <shader name> <vertex count> <triangle count>
+//       then x y z r g b for every vertex and a b c for every triangle
+//   flower <x> <y> <z> <scale> <phase>
+//   animate <sway|pulse|spin> <amplitude> <speed>
+// Names and paths cannot contain whitespace, line breaks are only for the reader. A shader is declared
+// before the meshes that use it.
+//
+// The parsed scene is a handful of flat arrays. Their binary copy, written next to the file and keyed by
+// a hash of its bytes, lets the next start skip the parsing.
+
+struct SceneShader {
+	uint32_t name, vertexPath, fragmentPath; // offsets into SceneDescription::strings
+};
+
+struct SceneMesh {
+	uint32_t name;
+	uint32_t shader; // index into SceneDescription::shaders
+	uint32_t firstVertex, vertexCount; // in vertices of SceneDescription::vertices
+	uint32_t firstIndex, indexCount; // in SceneDescription::indices, which count from the mesh's first vertex
+};
+
+struct SceneFlower {
+	float x, y, z, scale;
+	float phase; // puts the flower's animations out of step with the others, in radians
+};
+
+// Every flower moves the same way, shifted by its phase:
+//   Sway  turns the flower by amplitude * sin(speed * time + phase)
+//   Pulse scales the circle by 1 + amplitude * sin(speed * time + phase)
+//   Spin  turns the triangle by amplitude * (speed * time + phase)
+enum class SceneAnimationKind : uint32_t { Sway, Pulse, Spin };
+
+struct SceneAnimation {
+	SceneAnimationKind kind;
+	float amplitude, speed;
+};
+
+struct SceneDescription {
+	std::vector<char> strings; // nul-terminated names and paths
+	std::vector<SceneShader> shaders;
+	std::vector<SceneMesh> meshes;
+	std::vector<float> vertices; // FLOWER_VERTEX_FLOATS per vertex
+	std::vector<unsigned int> indices;
+	std::vector<SceneFlower> flowers;
+	std::vector<SceneAnimation> animations;
+
+	const char* string(uint32_t offset) const {
+		return strings.data() + offset;
+	}
+
+	// nullptr when there is no mesh of that name
+	const SceneMesh* findMesh(const char* name) const {
+		for (const SceneMesh& mesh : meshes) {
+			if (strcmp(string(mesh.name), name) == 0) {
+				return &mesh;
+			}
+		}
+		return nullptr;
+	}
+
+	void clear() {
+		strings.clear();
+		shaders.clear();
+		meshes.clear();
+		vertices.clear();
+		indices.clear();
+		flowers.clear();
+		animations.clear();
+	}
+};
+
+namespace scene_text {
+	inline int lowestBit(uint64_t x) {
+#if defined(_MSC_VER) && defined(_M_X64)
+		unsigned long index;
+		_BitScanForward64(&index, x);
+		return (int)index;
+#elif defined(_MSC_VER)
+		unsigned long index;
+		if (_BitScanForward(&index, (unsigned long)x)) {
+			return (int)index;
+		}
+		_BitScanForward(&index, (unsigned long)(x >> 32));
+		return (int)index + 32;
+#else
+		return __builtin_ctzll(x);
+#endif
+	}
+
+	// Bit i is set where byte i of the 64 is whitespace or a control character
+	inline uint64_t separatorBits(const unsigned char* block) {
+#ifdef SCENE_USE_SSE2
+		const __m128i space = _mm_set1_epi8(' ');
+		uint64_t bits = 0;
+		for (int i = 0; i < 4; ++i) {
+			__m128i bytes = _mm_loadu_si128((const __m128i*)(block + 16 * i));
+			// Unsigned bytes up to ' ' are the ones whose maximum with ' ' is ' '
+			__m128i separators = _mm_cmpeq_epi8(_mm_max_epu8(bytes, space), space);
+			bits |= (uint64_t)(uint32_t)_mm_movemask_epi8(separators) << (16 * i);
+		}
+		return bits;
+#else
+		uint64_t bits = 0;
+		for (int i = 0; i < 64; ++i) {
+			bits |= (uint64_t)(block[i] <= ' ') << i;
+		}
+		return bits;
+#endif
+	}
+
+	// Finds the tokens of a text 64 bytes at a time: the separators of a block make one bit mask, and a
+	// token starts wherever a separator is followed by anything else. Walking the starts is then a bit
+	// scan per token, with no branch per character.
+	class Tokenizer {
+	public:
+		Tokenizer(const unsigned char* text, size_t size) : text(text), size(size) {
+			seek(0);
+		}
+
+		// Offset of the next token, false at the end of the text
+		bool next(size_t& start) {
+			while (starts == 0) {
+				if (blockBase + 64 >= size) {
+					return false;
+				}
+				loadBlock(blockBase + 64);
+			}
+			start = blockBase + lowestBit(starts);
+			starts &= starts - 1;
+			return true;
+		}
+
+		// Continues with the first token that starts at or after offset
+		void seek(size_t offset) {
+			loadBlock(offset & ~(size_t)63);
+			starts &= ~(uint64_t)0 << (offset & 63);
+		}
+
+	private:
+		void loadBlock(size_t base) {
+			blockBase = base;
+			uint64_t separators;
+			if (base + 64 <= size) {
+				separators = separatorBits(text + base);
+			}
+			else {
+				// The last block reads from a copy padded with spaces, the file may end at a page boundary
+				unsigned char tail[64];
+				memset(tail, ' ', sizeof(tail));
+				if (base < size) {
+					memcpy(tail, text + base, size - base);
+				}
+				separators = separatorBits(tail);
+			}
+			uint64_t before = base == 0 || text[base - 1] <= ' ' ? 1 : 0;
+			starts = ~separators & (separators << 1 | before);
+		}
+
+		const unsigned char* text;
+		size_t size;
+		size_t blockBase = 0;
+		uint64_t starts = 0;
+	};
+
+	// Value of eight digits 0 to 9 in the bytes of a little-endian word, the first byte the most
+	// significant: pairs, then fours, then all eight combined with multiplies
+	inline uint32_t eightDigits(uint64_t values) {
+		const uint64_t MASK = 0x000000FF000000FFull;
+		const uint64_t MUL1 = 100 + (1000000ull << 32);
+		const uint64_t MUL2 = 1 + (10000ull << 32);
+		values = values * 10 + (values >> 8);
+		return (uint32_t)((((values & MASK) * MUL1) + (((values >> 16) & MASK) * MUL2)) >> 32);
+	}
+
+	// Appends the digits at p to mantissa while it has room, 19 digits always fit in 64 bits. The digits
+	// past those are counted in dropped. Returns the end of the digits.
+	//
+	// Eight bytes are read as one word. The first non-digit is the lowest byte that is not 0 to 9 after
+	// taking '0' away, and shifting the digits before it to the top leaves zeros in front of them; one
+	// combine gives the value however many digits there are, with no branch per digit.
+	inline const unsigned char* appendDigits(const unsigned char* p, const unsigned char* end, uint64_t& mantissa, int& digits, int& dropped) {
+		static const uint64_t POWERS[] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000 };
+		while (end - p >= 8) {
+			uint64_t chunk;
+			memcpy(&chunk, p, 8);
+			uint64_t values = chunk ^ 0x3030303030303030ull;
+			// A byte is 10 or more when adding 0x76 or the byte itself sets its top bit. Carries only
+			// reach the bytes after a non-digit, which are not used.
+			uint64_t nonDigits = ((values + 0x7676767676767676ull) | values) & 0x8080808080808080ull;
+			int count = nonDigits ? lowestBit(nonDigits) >> 3 : 8;
+			if (count == 0 || digits + count > 19) {
+				break;
+			}
+			mantissa = mantissa * POWERS[count] + eightDigits(values << (8 * (8 - count)));
+			digits += count;
+			p += count;
+			if (count < 8) {
+				return p;
+			}
+		}
+		for (; p < end && (unsigned)(*p - '0') < 10; ++p) {
+			if (digits < 19) {
+				mantissa = mantissa * 10 + (*p - '0');
+				++digits;
+			}
+			else {
+				++dropped;
+			}
+		}
+		return p;
+	}
+
+	inline bool isSeparator(const unsigned char* p, const unsigned char* end) {
+		return p == end || *p <= ' ';
+	}
+
+	// A decimal number with an optional sign, fraction and exponent, the whole token. The digits become
+	// an integer and a power of ten, which double arithmetic combines exactly while both fit its 53 bits;
+	// anything longer goes through strtod with the first 19 significant digits, more than a float needs.
+	inline bool parseFloat(const unsigned char* p, const unsigned char* end, float& value) {
+		static const double POWERS[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+										 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+')) {
+			negative = *p == '-';
+			++p;
+		}
+		uint64_t mantissa = 0;
+		int digits = 0, dropped = 0;
+		const unsigned char* integer = p;
+		// Leading zeros would only use up the mantissa's digits
+		while (p < end && *p == '0') {
+			++p;
+		}
+		p = appendDigits(p, end, mantissa, digits, dropped);
+		int exponent = dropped;
+		bool any = p != integer;
+		if (p < end && *p == '.') {
+			const unsigned char* fraction = ++p;
+			// Still counted in the exponent below
+			while (digits == 0 && p < end && *p == '0') {
+				++p;
+			}
+			dropped = 0;
+			p = appendDigits(p, end, mantissa, digits, dropped);
+			exponent -= (int)(p - fraction) - dropped;
+			any = any || p != fraction;
+		}
+		if (!any) {
+			return false;
+		}
+		if (p < end && (*p == 'e' || *p == 'E')) {
+			++p;
+			bool negativeExponent = false;
+			if (p < end && (*p == '-' || *p == '+')) {
+				negativeExponent = *p == '-';
+				++p;
+			}
+			const unsigned char* first = p;
+			int e = 0;
+			for (; p < end && (unsigned)(*p - '0') < 10; ++p) {
+				e = std::min(e * 10 + (*p - '0'), 100000);
+			}
+			if (p == first) {
+				return false;
+			}
+			exponent += negativeExponent ? -e : e;
+		}
+		if (!isSeparator(p, end)) {
+			return false;
+		}
+		double result;
+		if (mantissa <= (1ull << 53) && exponent >= -22 && exponent <= 22) {
+			result = exponent < 0 ? (double)mantissa / POWERS[-exponent] : (double)mantissa * POWERS[exponent];
+		}
+		else {
+			char copy[48];
+			snprintf(copy, sizeof(copy), "%llue%d", (unsigned long long)mantissa, exponent);
+			result = strtod(copy, nullptr);
+		}
+		value = (float)(negative ? -result : result);
+		return true;
+	}
+
+	inline bool parseUint(const unsigned char* p, const unsigned char* end, uint32_t& value) {
+		uint64_t result = 0;
+		const unsigned char* first = p;
+		for (; p < end && (unsigned)(*p - '0') < 10; ++p) {
+			result = result * 10 + (*p - '0');
+			if (result > 0xFFFFFFFFull) {
+				return false;
+			}
+		}
+		value = (uint32_t)result;
+		return p != first && isSeparator(p, end);
+	}
+
+	// Builds a SceneDescription from the tokens, the grammar is at the top of the file
+	class Parser {
+	public:
+		Parser(const char* text, size_t size, SceneDescription& scene)
+			: text((const unsigned char*)text), end((const unsigned char*)text + size), size(size), tokens(this->text, size), scene(scene) {
+		}
+
+		bool parse(std::string& error) {
+			size_t start;
+			while (nextToken(start)) {
+				bool ok;
+				if (tokenIs(start, "flower")) {
+					ok = parseFlower(start);
+				}
+				else if (tokenIs(start, "mesh")) {
+					ok = parseMesh(start);
+				}
+				else if (tokenIs(start, "shader")) {
+					ok = parseShader(start);
+				}
+				else if (tokenIs(start, "animate")) {
+					ok = parseAnimation(start);
+				}
+				else {
+					ok = fail(start, "unknown keyword");
+				}
+				if (!ok) {
+					error = message;
+					return false;
+				}
+			}
+			return true;
+		}
+
+	private:
+		// Skips comments, they run to the end of the line
+		bool nextToken(size_t& start) {
+			while (tokens.next(start)) {
+				if (text[start] != '#') {
+					return true;
+				}
+				const void* newline = memchr(text + start, '\n', size - start);
+				tokens.seek(newline ? (const unsigned char*)newline - text : size);
+			}
+			return false;
+		}
+
+		size_t tokenLength(size_t start) const {
+			const unsigned char* p = text + start;
+			while (!isSeparator(p, end)) {
+				++p;
+			}
+			return p - (text + start);
+		}
+
+		bool tokenIs(size_t start, const char* word) const {
+			size_t length = strlen(word);
+			return (size_t)(end - (text + start)) >= length && memcmp(text + start, word, length) == 0 &&
+				   isSeparator(text + start + length, end);
+		}
+
+		bool fail(size_t offset, const char* what) {
+			size_t line = 1 + std::count(text, text + std::min(offset, size), '\n');
+			message = std::string(what) + " at line " + std::to_string(line);
+			return false;
+		}
+
+		bool expectFloat(size_t after, float& value) {
+			size_t start;
+			if (!nextToken(start)) {
+				return fail(after, "missing number");
+			}
+			return parseFloat(text + start, end, value) || fail(start, "not a number");
+		}
+
+		bool expectUint(size_t after, uint32_t& value) {
+			size_t start;
+			if (!nextToken(start)) {
+				return fail(after, "missing count or index");
+			}
+			return parseUint(text + start, end, value) || fail(start, "not a count or index");
+		}
+
+		// Token start and length of a name
+		bool expectName(size_t after, size_t& start, size_t& length) {
+			if (!nextToken(start)) {
+				return fail(after, "missing name");
+			}
+			length = tokenLength(start);
+			return true;
+		}
+
+		uint32_t addString(size_t start, size_t length) {
+			uint32_t offset = (uint32_t)scene.strings.size();
+			scene.strings.insert(scene.strings.end(), text + start, text + start + length);
+			scene.strings.push_back('\0');
+			return offset;
+		}
+
+		bool parseShader(size_t keyword) {
+			size_t start[3] = {}, length[3] = {};
+			for (int i = 0; i < 3; ++i) {
+				if (!expectName(keyword, start[i], length[i])) {
+					return false;
+				}
+			}
+			scene.shaders.push_back({ addString(start[0], length[0]), addString(start[1], length[1]), addString(start[2], length[2]) });
+			return true;
+		}
+
+		bool parseMesh(size_t keyword) {
+			size_t nameStart = 0, nameLength = 0, shaderStart = 0, shaderLength = 0;
+			if (!expectName(keyword, nameStart, nameLength) || !expectName(keyword, shaderStart, shaderLength)) {
+				return false;
+			}
+			uint32_t shader = 0;
+			while (shader < scene.shaders.size() && !(strlen(scene.string(scene.shaders[shader].name)) == shaderLength &&
+				   memcmp(scene.string(scene.shaders[shader].name), text + shaderStart, shaderLength) == 0)) {
+				++shader;
+			}
+			if (shader == scene.shaders.size()) {
+				return fail(shaderStart, "undeclared shader");
+			}
+			uint32_t vertexCount = 0, triangleCount = 0;
+			if (!expectUint(keyword, vertexCount) || !expectUint(keyword, triangleCount)) {
+				return false;
+			}
+			// Every number takes two bytes at least, larger counts cannot be in the file and would only
+			// make the arrays below huge
+			if ((uint64_t)vertexCount * FLOWER_VERTEX_FLOATS * 2 + (uint64_t)triangleCount * 3 * 2 > size - keyword) {
+				return fail(keyword, "mesh counts larger than the file");
+			}
+			SceneMesh mesh = { addString(nameStart, nameLength), shader, (uint32_t)(scene.vertices.size() / FLOWER_VERTEX_FLOATS),
+							   vertexCount, (uint32_t)scene.indices.size(), 3 * triangleCount };
+			scene.vertices.resize(scene.vertices.size() + (size_t)vertexCount * FLOWER_VERTEX_FLOATS);
+			float* vertex = scene.vertices.data() + (size_t)mesh.firstVertex * FLOWER_VERTEX_FLOATS;
+			for (size_t i = 0; i < (size_t)vertexCount * FLOWER_VERTEX_FLOATS; ++i) {
+				if (!expectFloat(keyword, vertex[i])) {
+					return false;
+				}
+			}
+			scene.indices.resize(scene.indices.size() + mesh.indexCount);
+			unsigned int* index = scene.indices.data() + mesh.firstIndex;
+			for (uint32_t i = 0; i < mesh.indexCount; ++i) {
+				uint32_t value = 0;
+				if (!expectUint(keyword, value)) {
+					return false;
+				}
+				if (value >= vertexCount) {
+					return fail(keyword, "index past the mesh's vertices");
+				}
+				index[i] = value;
+			}
+			scene.meshes.push_back(mesh);
+			return true;
+		}
+
+		bool parseFlower(size_t keyword) {
+			SceneFlower flower;
+			if (!expectFloat(keyword, flower.x) || !expectFloat(keyword, flower.y) || !expectFloat(keyword, flower.z) ||
+				!expectFloat(keyword, flower.scale) || !expectFloat(keyword, flower.phase)) {
+				return false;
+			}
+			scene.flowers.push_back(flower);
+			return true;
+		}
+
+		bool parseAnimation(size_t keyword) {
+			size_t start = 0, length = 0;
+			if (!expectName(keyword, start, length)) {
+				return false;
+			}
+			SceneAnimation animation;
+			if (tokenIs(start, "sway")) {
+				animation.kind = SceneAnimationKind::Sway;
+			}
+			else if (tokenIs(start, "pulse")) {
+				animation.kind = SceneAnimationKind::Pulse;
+			}
+			else if (tokenIs(start, "spin")) {
+				animation.kind = SceneAnimationKind::Spin;
+			}
+			else {
+				return fail(start, "unknown animation");
+			}
+			if (!expectFloat(keyword, animation.amplitude) || !expectFloat(keyword, animation.speed)) {
+				return false;
+			}
+			scene.animations.push_back(animation);
+			return true;
+		}
+
+		const unsigned char* text;
+		const unsigned char* end;
+		size_t size;
+		Tokenizer tokens;
+		SceneDescription& scene;
+		std::string message;
+	};
+}
+
+// Replaces the scene with the one in the text. On failure error says what and on which line.
+inline bool parseSceneText(const char* text, size_t size, SceneDescription& scene, std::string& error) {
+	scene.clear();
+	return scene_text::Parser(text, size, scene).parse(error);
+}
+
+// xxHash64 with seed 0, four lanes over 32 bytes at a time
+inline uint64_t hashSceneBytes(const unsigned char* data, size_t size) {
+	const uint64_t P1 = 11400714785074694791ull, P2 = 14029467366897019727ull, P3 = 1609587929392839161ull;
+	const uint64_t P4 = 9650029242287828579ull, P5 = 2870177450012600261ull;
+	auto rotl = [](uint64_t x, int r) {
+		return (x << r) | (x >> (64 - r));
+	};
+	auto round = [&](uint64_t acc, uint64_t input) {
+		return rotl(acc + input * P2, 31) * P1;
+	};
+	auto read64 = [](const unsigned char* p) {
+		uint64_t v;
+		memcpy(&v, p, 8);
+		return v;
+	};
+	const unsigned char* p = data;
+	const unsigned char* end = data + size;
+	uint64_t h;
+	if (size >= 32) {
+		uint64_t v1 = P1 + P2, v2 = P2, v3 = 0, v4 = 0 - P1;
+		for (; end - p >= 32; p += 32) {
+			v1 = round(v1, read64(p));
+			v2 = round(v2, read64(p + 8));
+			v3 = round(v3, read64(p + 16));
+			v4 = round(v4, read64(p + 24));
+		}
+		h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+		for (uint64_t v : { v1, v2, v3, v4 }) {
+			h = (h ^ round(0, v)) * P1 + P4;
+		}
+	}
+	else {
+		h = P5;
+	}
+	h += size;
+	for (; end - p >= 8; p += 8) {
+		h = rotl(h ^ round(0, read64(p)), 27) * P1 + P4;
+	}
+	if (end - p >= 4) {
+		uint32_t v;
+		memcpy(&v, p, 4);
+		h = rotl(h ^ (uint64_t)v * P1, 23) * P2 + P3;
+		p += 4;
+	}
+	for (; p < end; ++p) {
+		h = rotl(h ^ *p * P5, 11) * P1;
+	}
+	h ^= h >> 33;
+	h *= P2;
+	h ^= h >> 29;
+	h *= P3;
+	h ^= h >> 32;
+	return h;
+}
+
+// The cache is a header and the arrays one after the other, as they are in memory. Only the machine that
+// wrote it reads it back, so it keeps the native byte order; the header size and version catch a
+// different layout.
+struct SceneCacheHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t headerBytes;
+	uint64_t sourceHash, sourceSize;
+	uint64_t counts[7]; // strings, shaders, meshes, vertices, indices, flowers, animations
+};
+
+namespace scene_cache {
+	const char MAGIC[8] = { 'F', 'L', 'S', 'C', 'E', 'N', 'E', '\0' };
+	const uint32_t VERSION = 1;
+
+	// SceneDescription's arrays in the cache's order, const or not
+	template <typename Scene, typename Function>
+	void forEachArray(Scene& scene, Function function) {
+		function(scene.strings);
+		function(scene.shaders);
+		function(scene.meshes);
+		function(scene.vertices);
+		function(scene.indices);
+		function(scene.flowers);
+		function(scene.animations);
+	}
+}
+
+inline bool writeSceneCache(const char* path, const SceneDescription& scene, uint64_t sourceHash, uint64_t sourceSize) {
+	SceneCacheHeader header = {};
+	memcpy(header.magic, scene_cache::MAGIC, sizeof(header.magic));
+	header.version = scene_cache::VERSION;
+	header.headerBytes = sizeof(SceneCacheHeader);
+	header.sourceHash = sourceHash;
+	header.sourceSize = sourceSize;
+	int count = 0;
+	scene_cache::forEachArray(scene, [&](const auto& array) {
+		header.counts[count++] = array.size();
+	});
+	FILE* file = fopen(path, "wb");
+	if (!file) {
+		return false;
+	}
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+	scene_cache::forEachArray(scene, [&](const auto& array) {
+		ok = ok && (array.empty() || fwrite(array.data(), sizeof(array[0]), array.size(), file) == array.size());
+	});
+	ok = fclose(file) == 0 && ok;
+	if (!ok) {
+		remove(path);
+	}
+	return ok;
+}
+
+// False when there is no cache or it was written for other bytes, the scene is left alone then
+inline bool readSceneCache(const char* path, uint64_t sourceHash, uint64_t sourceSize, SceneDescription& scene) {
+	MappedFile file;
+	if (!file.open(path) || file.size() < sizeof(SceneCacheHeader)) {
+		return false;
+	}
+	SceneCacheHeader header;
+	memcpy(&header, file.data(), sizeof(header));
+	if (memcmp(header.magic, scene_cache::MAGIC, sizeof(header.magic)) != 0 || header.version != scene_cache::VERSION ||
+		header.headerBytes != sizeof(SceneCacheHeader) || header.sourceHash != sourceHash || header.sourceSize != sourceSize) {
+		return false;
+	}
+	// The counts must add up to the file, a cache cut short is ignored
+	uint64_t expected = sizeof(header);
+	int count = 0;
+	scene_cache::forEachArray(scene, [&](auto& array) {
+		uint64_t elements = header.counts[count++];
+		expected += elements <= file.size() ? elements * sizeof(array[0]) : file.size() + 1;
+	});
+	if (expected != file.size()) {
+		return false;
+	}
+	const unsigned char* p = file.data() + sizeof(header);
+	count = 0;
+	scene_cache::forEachArray(scene, [&](auto& array) {
+		size_t elements = (size_t)header.counts[count++];
+		array.resize(elements);
+		if (elements > 0) {
+			memcpy(array.data(), p, elements * sizeof(array[0]));
+		}
+		p += elements * sizeof(array[0]);
+	});
+	return true;
+}
+
+// Loads a scene file, from the cache at cachePath when it was written for the same bytes. Otherwise the
+// text is parsed and the cache written for the next start. No cachePath always parses.
+inline bool loadSceneFile(const char* path, const char* cachePath, SceneDescription& scene, bool* fromCache = nullptr) {
+	MappedFile file;
+	if (!file.open(path)) {
+		std::cout << "ERROR::SCENE::FILE_NOT_SUCCESFULLY_READ " << path << std::endl;
+		return false;
+	}
+	uint64_t hash = cachePath ? hashSceneBytes(file.data(), file.size()) : 0;
+	if (fromCache) {
+		*fromCache = false;
+	}
+	if (cachePath && readSceneCache(cachePath, hash, file.size(), scene)) {
+		if (fromCache) {
+			*fromCache = true;
+		}
+		return true;
+	}
+	std::string error;
+	if (!parseSceneText((const char*)file.data(), file.size(), scene, error)) {
+		std::cout << "ERROR::SCENE::PARSE_FAILED " << path << ": " << error << std::endl;
+		return false;
+	}
+	if (cachePath && !writeSceneCache(cachePath, scene, hash, file.size())) {
+		std::cout << "WARNING::SCENE::CACHE_NOT_WRITTEN " << cachePath << std::endl;
+	}
+	return true;
+}
+#endif
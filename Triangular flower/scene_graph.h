@@ -0,0 +1,276 @@
+#ifndef SCENE_GRAPH_H
+#define SCENE_GRAPH_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <vector>
+#include "thread_pool.h"
+#include "vector_math.h"
+
+// Transform hierarchy kept as parallel arrays (parent, translation, rotation, scale, world matrix, dirty
+// flag) sorted by depth, so every parent comes before its children and one front-to-back pass computes
+// world = parent world * local. Setting a local transform marks the node dirty; the pass hands the flag
+// down to the children and recomputes dirty nodes only, a still subtree costs one byte read per node.
+// The nodes of one depth do not depend on each other, large levels are split across the thread pool.
+// Node ids stay valid when new nodes make the arrays re-sort.
+class SceneGraph {
+public:
+	typedef uint32_t NodeId;
+	static const NodeId INVALID = 0xFFFFFFFFu;
+	// Nodes per parallel task, a level shorter than two tasks runs on the calling thread
+	static const uint32_t TASK_NODES = 4096;
+
+	SceneGraph() : task([this](unsigned int taskIndex, unsigned int) {
+		uint32_t first = levelBegin + taskIndex * TASK_NODES;
+		uint32_t updated = updateRange(first, std::min(first + TASK_NODES, levelEnd));
+		parallelUpdated.fetch_add(updated, std::memory_order_relaxed);
+	}) {}
+
+	SceneGraph(const SceneGraph&) = delete;
+	SceneGraph& operator=(const SceneGraph&) = delete;
+
+	void reserve(size_t nodes) {
+		indexOf.reserve(nodes);
+		ids.reserve(nodes);
+		parents.reserve(nodes);
+		depths.reserve(nodes);
+		translations.reserve(nodes);
+		rotations.reserve(nodes);
+		scales.reserve(nodes);
+		worlds.reserve(nodes);
+		dirty.reserve(nodes);
+	}
+
+	// The parent must exist already, INVALID makes a root. The world matrix is valid after the next update().
+	NodeId create(NodeId parent = INVALID, const Vec3& translation = Vec3(), const Quat& rotation = Quat(),
+				  const Vec3& scale = Vec3(1.0f, 1.0f, 1.0f)) {
+		uint32_t parentIndex = parent == INVALID ? INVALID : indexOf[parent];
+		uint32_t depth = parent == INVALID ? 0 : depths[parentIndex] + 1;
+		// Appending keeps the order as long as nothing shallower comes after something deeper
+		if (!depths.empty() && depth < depths.back()) {
+			sorted = false;
+		}
+		NodeId id = (NodeId)indexOf.size();
+		indexOf.push_back((uint32_t)ids.size());
+		ids.push_back(id);
+		parents.push_back(parentIndex);
+		depths.push_back(depth);
+		translations.push_back(translation);
+		rotations.push_back(rotation);
+		scales.push_back(scale);
+		worlds.push_back(Mat4());
+		dirty.push_back(1);
+		levelsValid = false;
+		anyDirty = true;
+		return id;
+	}
+
+	void clear() {
+		indexOf.clear();
+		ids.clear();
+		parents.clear();
+		depths.clear();
+		translations.clear();
+		rotations.clear();
+		scales.clear();
+		worlds.clear();
+		dirty.clear();
+		levelStarts.clear();
+		sorted = true;
+		levelsValid = true;
+		anyDirty = false;
+	}
+
+	void setTranslation(NodeId id, const Vec3& translation) {
+		uint32_t i = indexOf[id];
+		translations[i] = translation;
+		markDirty(i);
+	}
+	void setRotation(NodeId id, const Quat& rotation) {
+		uint32_t i = indexOf[id];
+		rotations[i] = rotation;
+		markDirty(i);
+	}
+	void setScale(NodeId id, const Vec3& scale) {
+		uint32_t i = indexOf[id];
+		scales[i] = scale;
+		markDirty(i);
+	}
+	void setLocal(NodeId id, const Vec3& translation, const Quat& rotation, const Vec3& scale) {
+		uint32_t i = indexOf[id];
+		translations[i] = translation;
+		rotations[i] = rotation;
+		scales[i] = scale;
+		markDirty(i);
+	}
+
+	const Vec3& translation(NodeId id) const {
+		return translations[indexOf[id]];
+	}
+	const Quat& rotation(NodeId id) const {
+		return rotations[indexOf[id]];
+	}
+	const Vec3& scale(NodeId id) const {
+		return scales[indexOf[id]];
+	}
+	// As of the last update()
+	const Mat4& world(NodeId id) const {
+		return worlds[indexOf[id]];
+	}
+	NodeId parent(NodeId id) const {
+		uint32_t p = parents[indexOf[id]];
+		return p == INVALID ? INVALID : ids[p];
+	}
+
+	// Recomputes the world matrices of the dirty nodes and their descendants, then clears the flags
+	void update(ThreadPool* pool = nullptr) {
+		updatedCount = 0;
+		if (!anyDirty) {
+			return;
+		}
+		if (!levelsValid) {
+			buildLevels();
+		}
+		for (size_t level = 0; level + 1 < levelStarts.size(); ++level) {
+			uint32_t begin = levelStarts[level], end = levelStarts[level + 1];
+			uint32_t tasks = (end - begin + TASK_NODES - 1) / TASK_NODES;
+			if (!pool || pool->threadCount() < 2 || tasks < 2) {
+				updatedCount += updateRange(begin, end);
+				continue;
+			}
+			levelBegin = begin;
+			levelEnd = end;
+			parallelUpdated.store(0, std::memory_order_relaxed);
+			pool->parallelFor(tasks, task);
+			updatedCount += parallelUpdated.load(std::memory_order_relaxed);
+		}
+		if (!dirty.empty()) {
+			memset(dirty.data(), 0, dirty.size());
+		}
+		anyDirty = false;
+	}
+
+	size_t size() const {
+		return ids.size();
+	}
+	// Levels of the hierarchy, as of the last update()
+	size_t depthCount() const {
+		return levelStarts.empty() ? 0 : levelStarts.size() - 1;
+	}
+	// World matrices the last update() recomputed
+	size_t lastUpdatedCount() const {
+		return updatedCount;
+	}
+
+private:
+	// By node id: the node's place in the sorted arrays
+	std::vector<uint32_t> indexOf;
+	// By place, depth-sorted
+	std::vector<NodeId> ids;
+	std::vector<uint32_t> parents; // places, INVALID for roots
+	std::vector<uint32_t> depths;
+	std::vector<Vec3> translations;
+	std::vector<Quat> rotations;
+	std::vector<Vec3> scales;
+	std::vector<Mat4> worlds;
+	std::vector<uint8_t> dirty;
+	// First place of every depth, plus the end
+	std::vector<uint32_t> levelStarts;
+	bool sorted = true, levelsValid = true, anyDirty = false;
+	size_t updatedCount = 0;
+
+	// The level the pool works on
+	uint32_t levelBegin = 0, levelEnd = 0;
+	std::atomic<uint32_t> parallelUpdated{ 0 };
+	// Built once, so handing a level to the pool does not allocate
+	std::function<void(unsigned int, unsigned int)> task;
+
+	void markDirty(uint32_t i) {
+		dirty[i] = 1;
+		anyDirty = true;
+	}
+
+	// Parents are one level up and already final, so the nodes of [begin, end) can go in any order
+	uint32_t updateRange(uint32_t begin, uint32_t end) {
+		const uint32_t* parent = parents.data();
+		uint8_t* flags = dirty.data();
+		Mat4* world = worlds.data();
+		uint32_t updated = 0;
+		for (uint32_t i = begin; i < end; ++i) {
+			uint32_t p = parent[i];
+			if (p != INVALID) {
+				flags[i] |= flags[p];
+			}
+			if (!flags[i]) {
+				continue;
+			}
+			Mat4 local = localMatrix(translations[i], rotations[i], scales[i]);
+			world[i] = p == INVALID ? local : world[p] * local;
+			++updated;
+		}
+		return updated;
+	}
+
+	// Mat4::compose with the rotation written out from the quaternion, it is most of the update's work
+	static Mat4 localMatrix(const Vec3& t, const Quat& q, const Vec3& s) {
+		float xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+		float xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+		float wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+		return Mat4(Vec4((1.0f - 2.0f * (yy + zz)) * s.x, 2.0f * (xy + wz) * s.x, 2.0f * (xz - wy) * s.x, 0.0f),
+					Vec4(2.0f * (xy - wz) * s.y, (1.0f - 2.0f * (xx + zz)) * s.y, 2.0f * (yz + wx) * s.y, 0.0f),
+					Vec4(2.0f * (xz + wy) * s.z, 2.0f * (yz - wx) * s.z, (1.0f - 2.0f * (xx + yy)) * s.z, 0.0f),
+					Vec4(t, 1.0f));
+	}
+
+	// Stable counting sort by depth when appends broke the order, then the level boundaries
+	void buildLevels() {
+		uint32_t maxDepth = 0;
+		for (uint32_t depth : depths) {
+			maxDepth = std::max(maxDepth, depth);
+		}
+		levelStarts.assign(maxDepth + 2, 0);
+		for (uint32_t depth : depths) {
+			++levelStarts[depth + 1];
+		}
+		for (size_t level = 1; level < levelStarts.size(); ++level) {
+			levelStarts[level] += levelStarts[level - 1];
+		}
+		if (!sorted) {
+			std::vector<uint32_t> next(levelStarts.begin(), levelStarts.end() - 1);
+			std::vector<uint32_t> to(depths.size());
+			for (size_t i = 0; i < depths.size(); ++i) {
+				to[i] = next[depths[i]]++;
+			}
+			std::vector<uint32_t> newParents(parents.size());
+			for (size_t i = 0; i < parents.size(); ++i) {
+				newParents[to[i]] = parents[i] == INVALID ? INVALID : to[parents[i]];
+			}
+			parents.swap(newParents);
+			permute(ids, to);
+			permute(depths, to);
+			permute(translations, to);
+			permute(rotations, to);
+			permute(scales, to);
+			permute(worlds, to);
+			permute(dirty, to);
+			for (size_t i = 0; i < ids.size(); ++i) {
+				indexOf[ids[i]] = (uint32_t)i;
+			}
+			sorted = true;
+		}
+		levelsValid = true;
+	}
+
+	template <typename T>
+	static void permute(std::vector<T>& values, const std::vector<uint32_t>& to) {
+		std::vector<T> moved(values.size());
+		for (size_t i = 0; i < values.size(); ++i) {
+			moved[to[i]] = values[i];
+		}
+		values.swap(moved);
+	}
+};
+#endif
@@ -0,0 +1,189 @@
+#ifndef SDF_FONT_H
+#define SDF_FONT_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "sprite_quads.h"
+
+// A signed distance field atlas of a 5x7 pixel font (printable ASCII), built at startup so no font file
+// is needed. Every font pixel becomes SCALE x SCALE texels and the distance to the glyph's edge is
+// stored around it, 0.5 on the edge and more inside, so the text stays sharp at any size and can get an
+// outline from the same texture.
+const int SDF_FONT_FIRST = 32, SDF_FONT_LAST = 126;
+const int SDF_FONT_GLYPH_WIDTH = 5, SDF_FONT_GLYPH_HEIGHT = 7;
+const int SDF_FONT_ADVANCE = 6, SDF_FONT_LINE_HEIGHT = 9; // in font pixels
+
+// Five columns per glyph, bit 0 is the top row
+inline const uint8_t* sdfFontColumns() {
+	static const uint8_t columns[(SDF_FONT_LAST - SDF_FONT_FIRST + 1) * 5] = {
+		0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x5F, 0x00, 0x00, 0x00, 0x07, 0x00, 0x07, 0x00, 0x14, 0x7F, 0x14, 0x7F, 0x14, //  !"#
+		0x24, 0x2A, 0x7F, 0x2A, 0x12, 0x23, 0x13, 0x08, 0x64, 0x62, 0x36, 0x49, 0x55, 0x22, 0x50, 0x00, 0x05, 0x03, 0x00, 0x00, // $%&'
+		0x00, 0x1C, 0x22, 0x41, 0x00, 0x00, 0x41, 0x22, 0x1C, 0x00, 0x08, 0x2A, 0x1C, 0x2A, 0x08, 0x08, 0x08, 0x3E, 0x08, 0x08, // ()*+
+		0x00, 0x50, 0x30, 0x00, 0x00, 0x08, 0x08, 0x08, 0x08, 0x08, 0x00, 0x60, 0x60, 0x00, 0x00, 0x20, 0x10, 0x08, 0x04, 0x02, // ,-./
+		0x3E, 0x51, 0x49, 0x45, 0x3E, 0x00, 0x42, 0x7F, 0x40, 0x00, 0x42, 0x61, 0x51, 0x49, 0x46, 0x21, 0x41, 0x45, 0x4B, 0x31, // 0123
+		0x18, 0x14, 0x12, 0x7F, 0x10, 0x27, 0x45, 0x45, 0x45, 0x39, 0x3C, 0x4A, 0x49, 0x49, 0x30, 0x01, 0x71, 0x09, 0x05, 0x03, // 4567
+		0x36, 0x49, 0x49, 0x49, 0x36, 0x06, 0x49, 0x49, 0x29, 0x1E, 0x00, 0x36, 0x36, 0x00, 0x00, 0x00, 0x56, 0x36, 0x00, 0x00, // 89:;
+		0x08, 0x14, 0x22, 0x41, 0x00, 0x14, 0x14, 0x14, 0x14, 0x14, 0x00, 0x41, 0x22, 0x14, 0x08, 0x02, 0x01, 0x51, 0x09, 0x06, // <=>?
+		0x32, 0x49, 0x79, 0x41, 0x3E, 0x7E, 0x11, 0x11, 0x11, 0x7E, 0x7F, 0x49, 0x49, 0x49, 0x36, 0x3E, 0x41, 0x41, 0x41, 0x22, // @ABC
+		0x7F, 0x41, 0x41, 0x22, 0x1C, 0x7F, 0x49, 0x49, 0x49, 0x41, 0x7F, 0x09, 0x09, 0x01, 0x01, 0x3E, 0x41, 0x41, 0x51, 0x32, // DEFG
+		0x7F, 0x08, 0x08, 0x08, 0x7F, 0x00, 0x41, 0x7F, 0x41, 0x00, 0x20, 0x40, 0x41, 0x3F, 0x01, 0x7F, 0x08, 0x14, 0x22, 0x41, // HIJK
+		0x7F, 0x40, 0x40, 0x40, 0x40, 0x7F, 0x02, 0x04, 0x02, 0x7F, 0x7F, 0x04, 0x08, 0x10, 0x7F, 0x3E, 0x41, 0x41, 0x41, 0x3E, // LMNO
+		0x7F, 0x09, 0x09, 0x09, 0x06, 0x3E, 0x41, 0x51, 0x21, 0x5E, 0x7F, 0x09, 0x19, 0x29, 0x46, 0x46, 0x49, 0x49, 0x49, 0x31, // PQRS
+		0x01, 0x01, 0x7F, 0x01, 0x01, 0x3F, 0x40, 0x40, 0x40, 0x3F, 0x1F, 0x20, 0x40, 0x20, 0x1F, 0x7F, 0x20, 0x18, 0x20, 0x7F, // TUVW
+		0x63, 0x14, 0x08, 0x14, 0x63, 0x03, 0x04, 0x78, 0x04, 0x03, 0x61, 0x51, 0x49, 0x45, 0x43, 0x00, 0x7F, 0x41, 0x41, 0x00, // XYZ[
+		0x02, 0x04, 0x08, 0x10, 0x20, 0x00, 0x41, 0x41, 0x7F, 0x00, 0x04, 0x02, 0x01, 0x02, 0x04, 0x40, 0x40, 0x40, 0x40, 0x40, // \]^_
+		0x00, 0x01, 0x02, 0x04, 0x00, 0x20, 0x54, 0x54, 0x54, 0x78, 0x7F, 0x48, 0x44, 0x44, 0x38, 0x38, 0x44, 0x44, 0x44, 0x20, // `abc
+		0x38, 0x44, 0x44, 0x48, 0x7F, 0x38, 0x54, 0x54, 0x54, 0x18, 0x08, 0x7E, 0x09, 0x01, 0x02, 0x08, 0x14, 0x54, 0x54, 0x3C, // defg
+		0x7F, 0x08, 0x04, 0x04, 0x78, 0x00, 0x44, 0x7D, 0x40, 0x00, 0x20, 0x40, 0x44, 0x3D, 0x00, 0x7F, 0x10, 0x28, 0x44, 0x00, // hijk
+		0x00, 0x41, 0x7F, 0x40, 0x00, 0x7C, 0x04, 0x18, 0x04, 0x78, 0x7C, 0x08, 0x04, 0x04, 0x78, 0x38, 0x44, 0x44, 0x44, 0x38, // lmno
+		0x7C, 0x14, 0x14, 0x14, 0x08, 0x08, 0x14, 0x14, 0x18, 0x7C, 0x7C, 0x08, 0x04, 0x04, 0x08, 0x48, 0x54, 0x54, 0x54, 0x20, // pqrs
+		0x04, 0x3F, 0x44, 0x40, 0x20, 0x3C, 0x40, 0x40, 0x20, 0x7C, 0x1C, 0x20, 0x40, 0x20, 0x1C, 0x3C, 0x40, 0x30, 0x40, 0x3C, // tuvw
+		0x44, 0x28, 0x10, 0x28, 0x44, 0x0C, 0x50, 0x50, 0x50, 0x3C, 0x44, 0x64, 0x54, 0x4C, 0x44, 0x00, 0x08, 0x36, 0x41, 0x00, // xyz{
+		0x00, 0x00, 0x7F, 0x00, 0x00, 0x00, 0x41, 0x36, 0x08, 0x00, 0x02, 0x01, 0x02, 0x04, 0x02,                               // |}~
+	};
+	return columns;
+}
+
+struct SdfFontAtlas {
+	static const int SCALE = 4;  // texels per font pixel
+	static const int SPREAD = 4; // texels of distance either side of the edge, also the padding of a cell
+	static const int CELL_WIDTH = SDF_FONT_GLYPH_WIDTH * SCALE + 2 * SPREAD;
+	static const int CELL_HEIGHT = SDF_FONT_GLYPH_HEIGHT * SCALE + 2 * SPREAD;
+	static const int COLUMNS = 16;
+
+	int width = 0, height = 0;
+	std::vector<uint8_t> texels; // one channel, top row first
+
+	// Top left texel of a glyph's cell
+	static void cell(int glyph, int& x, int& y) {
+		x = (glyph % COLUMNS) * CELL_WIDTH;
+		y = (glyph / COLUMNS) * CELL_HEIGHT;
+	}
+};
+
+// Squared distance from every sample to the nearest zero of f (0 for sources, a large value elsewhere),
+// along one line. Felzenszwalb and Huttenlocher's lower envelope of parabolas, linear in n.
+inline void squaredDistance1D(const float* f, float* d, int n, int* v, float* z) {
+	int k = 0;
+	v[0] = 0;
+	z[0] = -1e20f;
+	z[1] = 1e20f;
+	for (int q = 1; q < n; ++q) {
+		float s = ((f[q] + (float)q * q) - (f[v[k]] + (float)v[k] * v[k])) / (2.0f * (q - v[k]));
+		while (s <= z[k]) {
+			--k;
+			s = ((f[q] + (float)q * q) - (f[v[k]] + (float)v[k] * v[k])) / (2.0f * (q - v[k]));
+		}
+		++k;
+		v[k] = q;
+		z[k] = s;
+		z[k + 1] = 1e20f;
+	}
+	k = 0;
+	for (int q = 0; q < n; ++q) {
+		while (z[k + 1] < q) {
+			++k;
+		}
+		float dq = (float)(q - v[k]);
+		d[q] = dq * dq + f[v[k]];
+	}
+}
+
+// Squared distance of every texel to the nearest texel where source is set, rows then columns
+inline void squaredDistance2D(const std::vector<uint8_t>& source, bool sourceValue, int width, int height, std::vector<float>& out) {
+	const float FAR = 1e20f;
+	int n = std::max(width, height);
+	std::vector<float> f(n), d(n), z(n + 1);
+	std::vector<int> v(n);
+	out.resize((size_t)width * height);
+	for (int y = 0; y < height; ++y) {
+		for (int x = 0; x < width; ++x) {
+			f[x] = (source[(size_t)y * width + x] != 0) == sourceValue ? 0.0f : FAR;
+		}
+		squaredDistance1D(f.data(), d.data(), width, v.data(), z.data());
+		std::copy(d.begin(), d.begin() + width, out.begin() + (size_t)y * width);
+	}
+	for (int x = 0; x < width; ++x) {
+		for (int y = 0; y < height; ++y) {
+			f[y] = out[(size_t)y * width + x];
+		}
+		squaredDistance1D(f.data(), d.data(), height, v.data(), z.data());
+		for (int y = 0; y < height; ++y) {
+			out[(size_t)y * width + x] = d[y];
+		}
+	}
+}
+
+inline void buildSdfFontAtlas(SdfFontAtlas& atlas) {
+	const int glyphs = SDF_FONT_LAST - SDF_FONT_FIRST + 1;
+	const int rows = (glyphs + SdfFontAtlas::COLUMNS - 1) / SdfFontAtlas::COLUMNS;
+	atlas.width = SdfFontAtlas::COLUMNS * SdfFontAtlas::CELL_WIDTH;
+	atlas.height = rows * SdfFontAtlas::CELL_HEIGHT;
+	std::vector<uint8_t> ink((size_t)atlas.width * atlas.height, 0);
+	const uint8_t* columns = sdfFontColumns();
+	for (int glyph = 0; glyph < glyphs; ++glyph) {
+		int cellX, cellY;
+		SdfFontAtlas::cell(glyph, cellX, cellY);
+		for (int column = 0; column < SDF_FONT_GLYPH_WIDTH; ++column) {
+			for (int row = 0; row < SDF_FONT_GLYPH_HEIGHT; ++row) {
+				if (!(columns[5 * glyph + column] >> row & 1)) {
+					continue;
+				}
+				for (int ty = 0; ty < SdfFontAtlas::SCALE; ++ty) {
+					int y = cellY + SdfFontAtlas::SPREAD + row * SdfFontAtlas::SCALE + ty;
+					int x = cellX + SdfFontAtlas::SPREAD + column * SdfFontAtlas::SCALE;
+					std::fill_n(ink.begin() + (size_t)y * atlas.width + x, SdfFontAtlas::SCALE, (uint8_t)1);
+				}
+			}
+		}
+	}
+	// The edge runs half a texel from the centers on either side of it
+	std::vector<float> toInk, toEmpty;
+	squaredDistance2D(ink, true, atlas.width, atlas.height, toInk);
+	squaredDistance2D(ink, false, atlas.width, atlas.height, toEmpty);
+	atlas.texels.resize(ink.size());
+	for (size_t i = 0; i < ink.size(); ++i) {
+		float distance = ink[i] ? -(std::sqrt(toEmpty[i]) - 0.5f) : std::sqrt(toInk[i]) - 0.5f;
+		float value = 0.5f - distance / (2.0f * SdfFontAtlas::SPREAD);
+		atlas.texels[i] = (uint8_t)(std::min(std::max(value, 0.0f), 1.0f) * 255.0f + 0.5f);
+	}
+}
+
+// Writes a quad per visible character of text, at most maxQuads. x, y: top left corner of the first line,
+// in pixels with y up; pixelHeight: height of a capital letter. '\n' starts a new line. Returns the quads
+// written.
+inline unsigned int layoutSdfText(SpriteVertex* out, unsigned int maxQuads, const SdfFontAtlas& atlas, float x, float y,
+								  float pixelHeight, uint32_t color, const char* text) {
+	const float texel = pixelHeight / (SDF_FONT_GLYPH_HEIGHT * SdfFontAtlas::SCALE);
+	const float advance = SDF_FONT_ADVANCE * SdfFontAtlas::SCALE * texel;
+	const float lineHeight = SDF_FONT_LINE_HEIGHT * SdfFontAtlas::SCALE * texel;
+	const float quadWidth = SdfFontAtlas::CELL_WIDTH * texel, quadHeight = SdfFontAtlas::CELL_HEIGHT * texel;
+	const float padding = SdfFontAtlas::SPREAD * texel;
+	const float du = 1.0f / atlas.width, dv = 1.0f / atlas.height;
+	unsigned int quads = 0;
+	float penX = x;
+	for (const char* c = text; *c && quads < maxQuads; ++c) {
+		if (*c == '\n') {
+			penX = x;
+			y -= lineHeight;
+			continue;
+		}
+		int code = (unsigned char)*c;
+		if (code < SDF_FONT_FIRST || code > SDF_FONT_LAST) {
+			code = '?';
+		}
+		if (code != ' ') {
+			int cellX, cellY;
+			SdfFontAtlas::cell(code - SDF_FONT_FIRST, cellX, cellY);
+			// The atlas's top row is v = 0, the quad's bottom edge takes the cell's bottom row
+			writeSpriteQuad(out + 4 * quads, penX - padding, y + padding - quadHeight, quadWidth, quadHeight, color,
+							cellX * du, (cellY + SdfFontAtlas::CELL_HEIGHT) * dv, (cellX + SdfFontAtlas::CELL_WIDTH) * du, cellY * dv);
+			++quads;
+		}
+		penX += advance;
+	}
+	return quads;
+}
+#endif
@@ -0,0 +1,174 @@
+#ifndef SHADER_LANES_H
+#define SHADER_LANES_H
+
+#include <cmath>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define SHADER_LANES_USE_SSE2
+#endif
+
+// One float of 8 shader invocations, the register type of the kernels generated from the GLSL shaders.
+// Streams are structure of arrays: invocation i of component c lives at stream[c][i].
+const int SHADER_LANES = 8;
+
+#ifdef SHADER_LANES_USE_SSE2
+struct ShaderLanes {
+	__m128 lo, hi;
+
+	ShaderLanes() {
+	}
+	ShaderLanes(__m128 lo, __m128 hi) : lo(lo), hi(hi) {
+	}
+	explicit ShaderLanes(float value) : lo(_mm_set1_ps(value)), hi(_mm_set1_ps(value)) {
+	}
+
+	static ShaderLanes load(const float* source) {
+		return ShaderLanes(_mm_loadu_ps(source), _mm_loadu_ps(source + 4));
+	}
+	void store(float* target) const {
+		_mm_storeu_ps(target, lo);
+		_mm_storeu_ps(target + 4, hi);
+	}
+};
+
+inline ShaderLanes operator+(const ShaderLanes& a, const ShaderLanes& b) {
+	return ShaderLanes(_mm_add_ps(a.lo, b.lo), _mm_add_ps(a.hi, b.hi));
+}
+inline ShaderLanes operator-(const ShaderLanes& a, const ShaderLanes& b) {
+	return ShaderLanes(_mm_sub_ps(a.lo, b.lo), _mm_sub_ps(a.hi, b.hi));
+}
+inline ShaderLanes operator*(const ShaderLanes& a, const ShaderLanes& b) {
+	return ShaderLanes(_mm_mul_ps(a.lo, b.lo), _mm_mul_ps(a.hi, b.hi));
+}
+inline ShaderLanes operator/(const ShaderLanes& a, const ShaderLanes& b) {
+	return ShaderLanes(_mm_div_ps(a.lo, b.lo), _mm_div_ps(a.hi, b.hi));
+}
+inline ShaderLanes operator-(const ShaderLanes& a) {
+	const __m128 sign = _mm_set1_ps(-0.0f);
+	return ShaderLanes(_mm_xor_ps(a.lo, sign), _mm_xor_ps(a.hi, sign));
+}
+
+namespace lanes {
+	inline ShaderLanes min(const ShaderLanes& a, const ShaderLanes& b) {
+		return ShaderLanes(_mm_min_ps(a.lo, b.lo), _mm_min_ps(a.hi, b.hi));
+	}
+	inline ShaderLanes max(const ShaderLanes& a, const ShaderLanes& b) {
+		return ShaderLanes(_mm_max_ps(a.lo, b.lo), _mm_max_ps(a.hi, b.hi));
+	}
+	inline ShaderLanes abs(const ShaderLanes& a) {
+		const __m128 sign = _mm_set1_ps(-0.0f);
+		return ShaderLanes(_mm_andnot_ps(sign, a.lo), _mm_andnot_ps(sign, a.hi));
+	}
+	inline ShaderLanes sqrt(const ShaderLanes& a) {
+		return ShaderLanes(_mm_sqrt_ps(a.lo), _mm_sqrt_ps(a.hi));
+	}
+	// Truncation corrected for negative values, exact below 2^31
+	inline __m128 floor4(__m128 a) {
+		__m128 truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(a));
+		return _mm_sub_ps(truncated, _mm_and_ps(_mm_cmpgt_ps(truncated, a), _mm_set1_ps(1.0f)));
+	}
+	inline ShaderLanes floor(const ShaderLanes& a) {
+		return ShaderLanes(floor4(a.lo), floor4(a.hi));
+	}
+	// step(edge, x): 0 below the edge, 1 from the edge on
+	inline ShaderLanes step(const ShaderLanes& edge, const ShaderLanes& x) {
+		const __m128 one = _mm_set1_ps(1.0f);
+		return ShaderLanes(_mm_and_ps(_mm_cmpge_ps(x.lo, edge.lo), one), _mm_and_ps(_mm_cmpge_ps(x.hi, edge.hi), one));
+	}
+}
+#else
+struct ShaderLanes {
+	float v[SHADER_LANES];
+
+	ShaderLanes() {
+	}
+	explicit ShaderLanes(float value) {
+		for (int i = 0; i < SHADER_LANES; ++i) {
+			v[i] = value;
+		}
+	}
+
+	static ShaderLanes load(const float* source) {
+		ShaderLanes result;
+		for (int i = 0; i < SHADER_LANES; ++i) {
+			result.v[i] = source[i];
+		}
+		return result;
+	}
+	void store(float* target) const {
+		for (int i = 0; i < SHADER_LANES; ++i) {
+			target[i] = v[i];
+		}
+	}
+};
+
+#define SHADER_LANES_BINARY(expression) \
+	ShaderLanes result; \
+	for (int i = 0; i < SHADER_LANES; ++i) { \
+		result.v[i] = expression; \
+	} \
+	return result;
+
+inline ShaderLanes operator+(const ShaderLanes& a, const ShaderLanes& b) {
+	SHADER_LANES_BINARY(a.v[i] + b.v[i])
+}
+inline ShaderLanes operator-(const ShaderLanes& a, const ShaderLanes& b) {
+	SHADER_LANES_BINARY(a.v[i] - b.v[i])
+}
+inline ShaderLanes operator*(const ShaderLanes& a, const ShaderLanes& b) {
+	SHADER_LANES_BINARY(a.v[i] * b.v[i])
+}
+inline ShaderLanes operator/(const ShaderLanes& a, const ShaderLanes& b) {
+	SHADER_LANES_BINARY(a.v[i] / b.v[i])
+}
+inline ShaderLanes operator-(const ShaderLanes& a) {
+	SHADER_LANES_BINARY(-a.v[i])
+}
+
+namespace lanes {
+	inline ShaderLanes min(const ShaderLanes& a, const ShaderLanes& b) {
+		SHADER_LANES_BINARY(b.v[i] < a.v[i] ? b.v[i] : a.v[i])
+	}
+	inline ShaderLanes max(const ShaderLanes& a, const ShaderLanes& b) {
+		SHADER_LANES_BINARY(b.v[i] > a.v[i] ? b.v[i] : a.v[i])
+	}
+	inline ShaderLanes abs(const ShaderLanes& a) {
+		SHADER_LANES_BINARY(std::fabs(a.v[i]))
+	}
+	inline ShaderLanes sqrt(const ShaderLanes& a) {
+		SHADER_LANES_BINARY(std::sqrt(a.v[i]))
+	}
+	inline ShaderLanes floor(const ShaderLanes& a) {
+		SHADER_LANES_BINARY(std::floor(a.v[i]))
+	}
+	inline ShaderLanes step(const ShaderLanes& edge, const ShaderLanes& x) {
+		SHADER_LANES_BINARY(x.v[i] >= edge.v[i] ? 1.0f : 0.0f)
+	}
+}
+#undef SHADER_LANES_BINARY
+#endif
+
+// Transcendentals have no SSE2 instruction, they go through the C library one lane at a time
+namespace lanes {
+	template <typename Function>
+	inline ShaderLanes perLane(const ShaderLanes& a, const ShaderLanes& b, Function function) {
+		float x[SHADER_LANES], y[SHADER_LANES];
+		a.store(x);
+		b.store(y);
+		for (int i = 0; i < SHADER_LANES; ++i) {
+			x[i] = function(x[i], y[i]);
+		}
+		return ShaderLanes::load(x);
+	}
+	inline ShaderLanes sin(const ShaderLanes& a) {
+		return perLane(a, a, [](float x, float) { return std::sin(x); });
+	}
+	inline ShaderLanes cos(const ShaderLanes& a) {
+		return perLane(a, a, [](float x, float) { return std::cos(x); });
+	}
+	inline ShaderLanes pow(const ShaderLanes& a, const ShaderLanes& b) {
+		return perLane(a, b, [](float x, float y) { return std::pow(x, y); });
+	}
+}
+#endif
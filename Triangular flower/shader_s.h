@@ -4,9 +4,8 @@
 #include <glad/glad.h> // include glad to get all the required openGL headers
 
 #include <string>
-#include <fstream>
-#include <sstream>
 #include <iostream>
+#include "shader_source.h"
 
 class Shader
 {
@@ -19,28 +18,7 @@ public:
 		// 1. Retieve the vertex/fragment source code from filePath
 		std::string vertexCode;
 		std::string fragmentCode;
-		std::ifstream vShaderFile;
-		std::ifstream fShaderFile;
-		// Ensure ifstream object can throw exeptions
-		vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-		fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-		try {
-			// Open file
-			vShaderFile.open(vertexPath);
-			fShaderFile.open(fragmentPath);
-			std::stringstream vShaderStream, fShaderStream;
-			// Read file buffer content into streams
-			vShaderStream << vShaderFile.rdbuf();
-			fShaderStream << fShaderFile.rdbuf();
-			// Close file handles
-			vShaderFile.close();
-			fShaderFile.close();
-			// Convert streams into strings
-			vertexCode   = vShaderStream.str();
-			fragmentCode = fShaderStream.str();
-
-		}
-		catch(std::ifstream::failure& e) {
+		if (!readShaderSource(vertexPath, vertexCode) || !readShaderSource(fragmentPath, fragmentCode)) {
 			std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
 		}
 		const char* vShaderCode = vertexCode.c_str();
@@ -95,25 +73,46 @@ public:
 	void deleteProgram() {
 		glDeleteProgram(ID);
 	}
-	// Utility uniform functions
+	// Utility uniform functions. They take the name as const char* so string literals do not
+	// construct a std::string every call, the std::string overloads forward to them.
+	void setBool(const char* name, bool value) const {
+		glUniform1i(glGetUniformLocation(ID, name), (int)value);
+	}
+
+	void setInt(const char* name, int value) const {
+		glUniform1i(glGetUniformLocation(ID, name), value);
+	}
+
+	void setFloat(const char* name, float value) const {
+		glUniform1f(glGetUniformLocation(ID, name), value);
+	}
+	
+	void setFloat3(const char* name, float value1, float value2, float value3) const {
+		glUniform3f(glGetUniformLocation(ID, name), value1, value2, value3);
+	}
+
+	void setFloatVector3(const char* name, float* value) const {
+		glUniform3fv(glGetUniformLocation(ID, name), 1, value);
+	}
+
 	void setBool(const std::string& name, bool value) const {
-		glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+		setBool(name.c_str(), value);
 	}
 
 	void setInt(const std::string& name, int value) const {
-		glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+		setInt(name.c_str(), value);
 	}
 
 	void setFloat(const std::string& name, float value) const {
-		glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+		setFloat(name.c_str(), value);
 	}
-	
+
 	void setFloat3(const std::string& name, float value1, float value2, float value3) const {
-		glUniform3f(glGetUniformLocation(ID, name.c_str()), value1, value2, value3);
+		setFloat3(name.c_str(), value1, value2, value3);
 	}
 
 	void setFloatVector3(const std::string& name, float* value) const {
-		glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, value);
+		setFloatVector3(name.c_str(), value);
 	}
 };
 #endif
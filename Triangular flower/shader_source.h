@@ -0,0 +1,26 @@
+#ifndef SHADER_SOURCE_H
+#define SHADER_SOURCE_H
+
+#include <fstream>
+#include <sstream>
+#include <string>
+
+// Reads a whole shader file: an ifstream that throws on failure, copied through a stringstream
+inline bool readShaderSource(const char* path, std::string& code) {
+	std::ifstream file;
+	// Ensure ifstream object can throw exeptions
+	file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+	try {
+		file.open(path);
+		std::stringstream stream;
+		// Read file buffer content into the stream
+		stream << file.rdbuf();
+		file.close();
+		code = stream.str();
+		return true;
+	}
+	catch (std::ifstream::failure&) {
+		return false;
+	}
+}
+#endif
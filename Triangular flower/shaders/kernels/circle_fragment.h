@@ -0,0 +1,64 @@
+// Generated from shaders/3.3.shader_circle.txt by "Benchmarks compile-shader", do not edit.
+#ifndef CIRCLEFRAGMENTKERNEL_H
+#define CIRCLEFRAGMENTKERNEL_H
+
+#include <cstddef>
+#include "../../shader_lanes.h"
+
+// Streams: inputs   vertColor.xyz (0-2)
+//          uniforms colorGradient.xyz (0-2)
+//          outputs  FragColor.xyzw (0-3)
+struct CircleFragmentKernel {
+	static const int INPUTS = 3;
+	static const int UNIFORMS = 3;
+	static const int OUTPUTS = 4;
+
+	// SHADER_LANES invocations starting at index i
+	static void batch(const float* const* inputs, const float* uniforms, float* const* outputs, size_t i) {
+		const ShaderLanes r0 = ShaderLanes::load(inputs[0] + i);
+		const ShaderLanes r1 = ShaderLanes::load(inputs[1] + i);
+		const ShaderLanes r2 = ShaderLanes::load(inputs[2] + i);
+		const ShaderLanes r3(uniforms[0]);
+		const ShaderLanes r4(uniforms[1]);
+		const ShaderLanes r5(uniforms[2]);
+		const ShaderLanes r6 = r0 + r3;
+		const ShaderLanes r7 = r1 + r4;
+		const ShaderLanes r8 = r2 + r5;
+		const ShaderLanes r9(1.0f);
+		r6.store(outputs[0] + i);
+		r7.store(outputs[1] + i);
+		r8.store(outputs[2] + i);
+		r9.store(outputs[3] + i);
+	}
+
+	// count invocations, stream c holds count floats of component c
+	static void run(const float* const* inputs, const float* uniforms, float* const* outputs, size_t count) {
+		size_t i = 0;
+		for (; i + SHADER_LANES <= count; i += SHADER_LANES) {
+			batch(inputs, uniforms, outputs, i);
+		}
+		if (i == count) {
+			return;
+		}
+		// The last partial batch goes through padded copies of the streams
+		float in[INPUTS + 1][SHADER_LANES] = {}, out[OUTPUTS + 1][SHADER_LANES];
+		const float* inPointers[INPUTS + 1];
+		float* outPointers[OUTPUTS + 1];
+		for (int c = 0; c < INPUTS; ++c) {
+			for (size_t k = i; k < count; ++k) {
+				in[c][k - i] = inputs[c][k];
+			}
+			inPointers[c] = in[c];
+		}
+		for (int c = 0; c < OUTPUTS; ++c) {
+			outPointers[c] = out[c];
+		}
+		batch(inPointers, uniforms, outPointers, 0);
+		for (int c = 0; c < OUTPUTS; ++c) {
+			for (size_t k = i; k < count; ++k) {
+				outputs[c][k] = out[c][k - i];
+			}
+		}
+	}
+};
+#endif
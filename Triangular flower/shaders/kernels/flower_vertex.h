@@ -0,0 +1,103 @@
+// Generated from shaders/3.3.shader.txt by "Benchmarks compile-shader", do not edit.
+#ifndef FLOWERVERTEXKERNEL_H
+#define FLOWERVERTEXKERNEL_H
+
+#include <cstddef>
+#include "../../shader_lanes.h"
+
+// Streams: inputs   aPos.xyz (0-2), aColor.xyz (3-5)
+//          uniforms model[0-3].xyzw (0-15)
+//          outputs  gl_Position.xyzw (0-3), vertColor.xyz (4-6)
+struct FlowerVertexKernel {
+	static const int INPUTS = 6;
+	static const int UNIFORMS = 16;
+	static const int OUTPUTS = 7;
+
+	// SHADER_LANES invocations starting at index i
+	static void batch(const float* const* inputs, const float* uniforms, float* const* outputs, size_t i) {
+		const ShaderLanes r0 = ShaderLanes::load(inputs[0] + i);
+		const ShaderLanes r1 = ShaderLanes::load(inputs[1] + i);
+		const ShaderLanes r2 = ShaderLanes::load(inputs[2] + i);
+		const ShaderLanes r3 = ShaderLanes::load(inputs[3] + i);
+		const ShaderLanes r4 = ShaderLanes::load(inputs[4] + i);
+		const ShaderLanes r5 = ShaderLanes::load(inputs[5] + i);
+		const ShaderLanes r6(uniforms[0]);
+		const ShaderLanes r7(uniforms[1]);
+		const ShaderLanes r8(uniforms[2]);
+		const ShaderLanes r9(uniforms[3]);
+		const ShaderLanes r10(uniforms[4]);
+		const ShaderLanes r11(uniforms[5]);
+		const ShaderLanes r12(uniforms[6]);
+		const ShaderLanes r13(uniforms[7]);
+		const ShaderLanes r14(uniforms[8]);
+		const ShaderLanes r15(uniforms[9]);
+		const ShaderLanes r16(uniforms[10]);
+		const ShaderLanes r17(uniforms[11]);
+		const ShaderLanes r18(uniforms[12]);
+		const ShaderLanes r19(uniforms[13]);
+		const ShaderLanes r20(uniforms[14]);
+		const ShaderLanes r21(uniforms[15]);
+		const ShaderLanes r22 = r6 * r0;
+		const ShaderLanes r23 = r7 * r0;
+		const ShaderLanes r24 = r8 * r0;
+		const ShaderLanes r25 = r9 * r0;
+		const ShaderLanes r26 = r10 * r1;
+		const ShaderLanes r27 = r11 * r1;
+		const ShaderLanes r28 = r12 * r1;
+		const ShaderLanes r29 = r13 * r1;
+		const ShaderLanes r30 = r22 + r26;
+		const ShaderLanes r31 = r23 + r27;
+		const ShaderLanes r32 = r24 + r28;
+		const ShaderLanes r33 = r25 + r29;
+		const ShaderLanes r34 = r14 * r2;
+		const ShaderLanes r35 = r15 * r2;
+		const ShaderLanes r36 = r16 * r2;
+		const ShaderLanes r37 = r17 * r2;
+		const ShaderLanes r38 = r30 + r34;
+		const ShaderLanes r39 = r31 + r35;
+		const ShaderLanes r40 = r32 + r36;
+		const ShaderLanes r41 = r33 + r37;
+		const ShaderLanes r42 = r38 + r18;
+		const ShaderLanes r43 = r39 + r19;
+		const ShaderLanes r44 = r40 + r20;
+		const ShaderLanes r45 = r41 + r21;
+		r42.store(outputs[0] + i);
+		r43.store(outputs[1] + i);
+		r44.store(outputs[2] + i);
+		r45.store(outputs[3] + i);
+		r3.store(outputs[4] + i);
+		r4.store(outputs[5] + i);
+		r5.store(outputs[6] + i);
+	}
+
+	// count invocations, stream c holds count floats of component c
+	static void run(const float* const* inputs, const float* uniforms, float* const* outputs, size_t count) {
+		size_t i = 0;
+		for (; i + SHADER_LANES <= count; i += SHADER_LANES) {
+			batch(inputs, uniforms, outputs, i);
+		}
+		if (i == count) {
+			return;
+		}
+		// The last partial batch goes through padded copies of the streams
+		float in[INPUTS + 1][SHADER_LANES] = {}, out[OUTPUTS + 1][SHADER_LANES];
+		const float* inPointers[INPUTS + 1];
+		float* outPointers[OUTPUTS + 1];
+		for (int c = 0; c < INPUTS; ++c) {
+			for (size_t k = i; k < count; ++k) {
+				in[c][k - i] = inputs[c][k];
+			}
+			inPointers[c] = in[c];
+		}
+		for (int c = 0; c < OUTPUTS; ++c) {
+			outPointers[c] = out[c];
+		}
+		batch(inPointers, uniforms, outPointers, 0);
+		for (int c = 0; c < OUTPUTS; ++c) {
+			for (size_t k = i; k < count; ++k) {
+				outputs[c][k] = out[c][k - i];
+			}
+		}
+	}
+};
+#endif
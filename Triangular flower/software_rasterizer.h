@@ -0,0 +1,508 @@
+#ifndef SOFTWARE_RASTERIZER_H
+#define SOFTWARE_RASTERIZER_H
+
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define RASTER_USE_SSE2
+#endif
+
+// CPU rasterizer for the flower's draw calls, for machines without GL and as a reference for driver output.
+// It consumes what configureVAOsAndVBOs uploads: indexed triangles over interleaved position + color vertices.
+// The vertex stage is shaders/3.3.shader.txt with the identity model matrix of the single, still flower
+// (gl_Position = vec4(aPos, 1.0)), the fragment stage is vertColor + colorGradient with alpha 1. There is
+// no depth test and no face culling, like the demo. With w always 1 the colors interpolate linearly in
+// screen space, as the driver's perspective-correct interpolation does then.
+//
+// A frame is recorded with clear() and draw(), then finish() runs it in two parallel passes:
+//   1. setup and binning: triangles are snapped to 1/16 pixel, turned into integer edge functions and
+//      appended to the bins of the 64x64 tiles they touch, keeping submission order
+//   2. tile shading: every tile walks its bins in 4x2 pixel blocks, 8 edge tests and 8 color
+//      interpolations per step, so no two threads ever write the same pixel
+// The color buffer is RGBA8 with rows bottom to top, the same layout glReadPixels returns. Against a driver it
+// differs by at most 1 per channel, except for pixel centers within 1/16 pixel of an edge, where drivers with
+// finer subpixel precision may decide coverage the other way.
+class SoftwareRasterizer {
+public:
+	static const int TILE_SIZE = 64;
+	static const int SUBPIXEL_BITS = 4;
+	// Edge functions of triangles inside the viewport fit into 32 bits up to this size
+	static const int MAX_SIZE = 4096;
+
+	struct Stats {
+		uint64_t triangles = 0; // submitted
+		uint64_t rasterized = 0; // survived setup, at least one tile
+		uint64_t culled = 0; // degenerate or outside the viewport
+		uint64_t guardBand = 0; // too large for the 32 bit edge functions, dropped
+		uint64_t pixels = 0; // shaded
+	};
+
+	explicit SoftwareRasterizer(ThreadPool& pool) : pool(pool) {
+	}
+
+	void resize(int width, int height) {
+		width = std::max(1, std::min(width, (int)MAX_SIZE));
+		height = std::max(1, std::min(height, (int)MAX_SIZE));
+		if (width == viewportWidth && height == viewportHeight) {
+			return;
+		}
+		viewportWidth = width;
+		viewportHeight = height;
+		tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+		tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+		// Padded to whole tiles so 4x2 blocks never need a bounds check
+		stride = tilesX * TILE_SIZE;
+		colorBuffer.assign((size_t)stride * tilesY * TILE_SIZE, 0);
+		bins.clear();
+	}
+
+	// Clears the color buffer before the draws of this frame
+	void clear(float r, float g, float b, float a) {
+		clearRequested = true;
+		clearColor = packColor(r, g, b, a);
+	}
+
+	// Queues a draw of triangleCount triangles. vertices and indices are read in finish(), they must stay alive until then.
+	void draw(const float* vertices, unsigned int vertexCount, const unsigned int* indices, unsigned int triangleCount,
+			  float gradientR, float gradientG, float gradientB) {
+		DrawCall call;
+		call.vertices = vertices;
+		call.vertexCount = vertexCount;
+		call.indices = indices;
+		call.triangleCount = triangleCount;
+		call.firstTriangle = queuedTriangles;
+		call.gradient[0] = gradientR * 255.0f;
+		call.gradient[1] = gradientG * 255.0f;
+		call.gradient[2] = gradientB * 255.0f;
+		draws.push_back(call);
+		queuedTriangles += triangleCount;
+	}
+
+	// Renders the queued draws and the pending clear
+	void finish() {
+		if (viewportWidth == 0) {
+			std::cout << "ERROR::RASTERIZER::NO_VIEWPORT" << std::endl;
+			return;
+		}
+		unsigned int threads = pool.threadCount();
+		unsigned int tileCount = (unsigned int)(tilesX * tilesY);
+		// A few chunks per thread balance the setup, each chunk owns one bin per tile
+		chunkCount = std::max(1u, std::min(threads * 4, (queuedTriangles + 255) / 256));
+		if (bins.size() < (size_t)chunkCount * tileCount) {
+			bins.resize((size_t)chunkCount * tileCount);
+		}
+		for (size_t i = 0; i < (size_t)chunkCount * tileCount; ++i) {
+			bins[i].clear();
+		}
+		triangles.resize(queuedTriangles);
+		threadStats.assign(threads, ThreadStats());
+
+		pool.parallelFor(chunkCount, [this, tileCount](unsigned int chunk, unsigned int thread) {
+			setupChunk(chunk, tileCount, threadStats[thread]);
+		});
+		pool.parallelFor(tileCount, [this, tileCount](unsigned int tile, unsigned int thread) {
+			shadeTile(tile, tileCount, threadStats[thread]);
+		});
+
+		stats.triangles += queuedTriangles;
+		for (const ThreadStats& local : threadStats) {
+			stats.rasterized += local.rasterized;
+			stats.culled += local.culled;
+			stats.guardBand += local.guardBand;
+			stats.pixels += local.pixels;
+		}
+		if (stats.guardBand != 0 && !guardBandReported) {
+			std::cout << "WARNING::RASTERIZER::GUARD_BAND triangles too large for the edge functions were dropped" << std::endl;
+			guardBandReported = true;
+		}
+		draws.clear();
+		queuedTriangles = 0;
+		clearRequested = false;
+	}
+
+	const Stats& statistics() const {
+		return stats;
+	}
+
+	void resetStatistics() {
+		stats = Stats();
+	}
+
+	int width() const {
+		return viewportWidth;
+	}
+
+	int height() const {
+		return viewportHeight;
+	}
+
+	// Copies the image as tightly packed RGBA8 rows, bottom to top like glReadPixels
+	void readPixels(unsigned char* rgba) const {
+		for (int y = 0; y < viewportHeight; ++y) {
+			const uint32_t* row = &colorBuffer[(size_t)y * stride];
+			for (int x = 0; x < viewportWidth; ++x) {
+				uint32_t pixel = row[x];
+				unsigned char* out = rgba + ((size_t)y * viewportWidth + x) * 4;
+				out[0] = (unsigned char)pixel;
+				out[1] = (unsigned char)(pixel >> 8);
+				out[2] = (unsigned char)(pixel >> 16);
+				out[3] = (unsigned char)(pixel >> 24);
+			}
+		}
+	}
+
+	// Binary PPM, top row first
+	bool writePpm(const char* path) const {
+		FILE* file = fopen(path, "wb");
+		if (!file) {
+			std::cout << "ERROR::RASTERIZER::CANNOT_WRITE " << path << std::endl;
+			return false;
+		}
+		fprintf(file, "P6\n%d %d\n255\n", viewportWidth, viewportHeight);
+		std::vector<unsigned char> rgb((size_t)viewportWidth * 3);
+		for (int y = viewportHeight - 1; y >= 0; --y) {
+			const uint32_t* row = &colorBuffer[(size_t)y * stride];
+			for (int x = 0; x < viewportWidth; ++x) {
+				rgb[x * 3 + 0] = (unsigned char)row[x];
+				rgb[x * 3 + 1] = (unsigned char)(row[x] >> 8);
+				rgb[x * 3 + 2] = (unsigned char)(row[x] >> 16);
+			}
+			fwrite(rgb.data(), 1, rgb.size(), file);
+		}
+		fclose(file);
+		return true;
+	}
+
+private:
+	struct DrawCall {
+		const float* vertices;
+		unsigned int vertexCount;
+		const unsigned int* indices;
+		unsigned int triangleCount;
+		unsigned int firstTriangle;
+		float gradient[3]; // scaled to 0..255
+	};
+
+	// Edge functions and attribute planes of one triangle, counter-clockwise after setup
+	struct Triangle {
+		int minX, minY, maxX, maxY; // covered pixels, minX is a multiple of 4 and minY of 2
+		int edge[3]; // edge functions at the center of pixel (minX, minY), top-left rule bias included
+		int stepX[3], stepY[3]; // change per pixel
+		// Screen-space planes value + dx * x + dy * y starting at pixel (minX, minY):
+		// red, green and blue scaled to 0..255
+		float plane[3][3];
+		const float* gradient;
+	};
+
+	// Counters of one thread, padded so threads never share a cache line
+	struct ThreadStats {
+		uint64_t rasterized = 0, culled = 0, guardBand = 0, pixels = 0;
+		char padding[32];
+	};
+
+	struct ClipVertex {
+		long long x, y; // window position in 1/16 pixels
+		float color[3];
+	};
+
+	ThreadPool& pool;
+	int viewportWidth = 0, viewportHeight = 0;
+	int tilesX = 0, tilesY = 0, stride = 0;
+	std::vector<uint32_t> colorBuffer;
+	bool clearRequested = false;
+	uint32_t clearColor = 0;
+	std::vector<DrawCall> draws;
+	unsigned int queuedTriangles = 0;
+	std::vector<Triangle> triangles;
+	unsigned int chunkCount = 1;
+	std::vector<std::vector<unsigned int> > bins; // [chunk * tileCount + tile] -> triangle indices
+	std::vector<ThreadStats> threadStats;
+	Stats stats;
+	bool guardBandReported = false;
+
+	static uint32_t packColor(float r, float g, float b, float a) {
+		return (uint32_t)toUnorm8(r) | ((uint32_t)toUnorm8(g) << 8) | ((uint32_t)toUnorm8(b) << 16) | ((uint32_t)toUnorm8(a) << 24);
+	}
+
+	static unsigned int toUnorm8(float value) {
+		value = std::min(std::max(value, 0.0f), 1.0f);
+		return (unsigned int)(value * 255.0f + 0.5f);
+	}
+
+	// The vertex shader with an identity model matrix: gl_Position = vec4(aPos, 1.0); vertColor = aColor;
+	// followed by the viewport transform
+	bool shadeVertex(const float* vertex, ClipVertex& out) const {
+		double windowX = (vertex[0] * 0.5 + 0.5) * viewportWidth;
+		double windowY = (vertex[1] * 0.5 + 0.5) * viewportHeight;
+		// Keeps the fixed point conversion defined, anything this far out is rejected by the range check
+		const double limit = (double)MAX_SIZE * 64;
+		if (!(std::fabs(windowX) < limit && std::fabs(windowY) < limit)) {
+			return false;
+		}
+		out.x = (long long)std::floor(windowX * (1 << SUBPIXEL_BITS) + 0.5);
+		out.y = (long long)std::floor(windowY * (1 << SUBPIXEL_BITS) + 0.5);
+		for (int i = 0; i < 3; ++i) {
+			out.color[i] = vertex[3 + i];
+		}
+		return true;
+	}
+
+	void setupChunk(unsigned int chunk, unsigned int tileCount, ThreadStats& local) {
+		unsigned int begin = (unsigned int)((unsigned long long)queuedTriangles * chunk / chunkCount);
+		unsigned int end = (unsigned int)((unsigned long long)queuedTriangles * (chunk + 1) / chunkCount);
+		std::vector<unsigned int>* chunkBins = &bins[(size_t)chunk * tileCount];
+		for (const DrawCall& call : draws) {
+			unsigned int first = std::max(begin, call.firstTriangle);
+			unsigned int last = std::min(end, call.firstTriangle + call.triangleCount);
+			for (unsigned int index = first; index < last; ++index) {
+				const unsigned int* corners = call.indices + (size_t)(index - call.firstTriangle) * 3;
+				if (setupTriangle(call, corners, triangles[index], local)) {
+					binTriangle(index, chunkBins, local);
+				}
+			}
+		}
+	}
+
+	bool setupTriangle(const DrawCall& call, const unsigned int* corners, Triangle& triangle, ThreadStats& local) const {
+		ClipVertex v[3];
+		for (int i = 0; i < 3; ++i) {
+			if (corners[i] >= call.vertexCount || !shadeVertex(call.vertices + (size_t)corners[i] * 6, v[i])) {
+				++local.culled;
+				return false;
+			}
+		}
+		long long area = (v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[1].y - v[0].y) * (v[2].x - v[0].x);
+		if (area == 0) {
+			++local.culled;
+			return false;
+		}
+		// Both windings are drawn, clockwise triangles are flipped
+		if (area < 0) {
+			std::swap(v[1], v[2]);
+			area = -area;
+		}
+
+		// Pixel (px, py) is covered when its center (px + 0.5, py + 0.5) is inside
+		const long long one = 1 << SUBPIXEL_BITS, half = one / 2;
+		long long minX = std::min(v[0].x, std::min(v[1].x, v[2].x)), maxX = std::max(v[0].x, std::max(v[1].x, v[2].x));
+		long long minY = std::min(v[0].y, std::min(v[1].y, v[2].y)), maxY = std::max(v[0].y, std::max(v[1].y, v[2].y));
+		long long pixelMinX = std::max(0LL, floorDiv(minX - half + one - 1, one));
+		long long pixelMinY = std::max(0LL, floorDiv(minY - half + one - 1, one));
+		long long pixelMaxX = std::min((long long)viewportWidth - 1, floorDiv(maxX - half, one));
+		long long pixelMaxY = std::min((long long)viewportHeight - 1, floorDiv(maxY - half, one));
+		if (pixelMinX > pixelMaxX || pixelMinY > pixelMaxY) {
+			++local.culled;
+			return false;
+		}
+		pixelMinX &= ~3LL;
+		pixelMinY &= ~1LL;
+
+		// Edge i is opposite to vertex i and positive inside
+		const long long originX = pixelMinX * one + half, originY = pixelMinY * one + half;
+		long long blockMaxX = pixelMaxX | 3, blockMaxY = pixelMaxY | 1;
+		for (int i = 0; i < 3; ++i) {
+			const ClipVertex& a = v[(i + 1) % 3];
+			const ClipVertex& b = v[(i + 2) % 3];
+			long long dx = b.x - a.x, dy = b.y - a.y;
+			long long stepX = -dy * one, stepY = dx * one;
+			// Pixel centers on an edge belong to the triangle only on its top and left edges
+			bool topLeft = dy < 0 || (dy == 0 && dx < 0);
+			long long edge = dx * (originY - a.y) - dy * (originX - a.x) - (topLeft ? 0 : 1);
+			// Every value the shading pass computes lies between the corners of the block-aligned box
+			long long width = blockMaxX - pixelMinX, height = blockMaxY - pixelMinY;
+			long long corners[4] = { edge, edge + stepX * width, edge + stepY * height, edge + stepX * width + stepY * height };
+			for (long long value : corners) {
+				if (value >= (1LL << 30) || value <= -(1LL << 30)) {
+					++local.guardBand;
+					return false;
+				}
+			}
+			triangle.edge[i] = (int)edge;
+			triangle.stepX[i] = (int)stepX;
+			triangle.stepY[i] = (int)stepY;
+		}
+		triangle.minX = (int)pixelMinX;
+		triangle.minY = (int)pixelMinY;
+		triangle.maxX = (int)pixelMaxX;
+		triangle.maxY = (int)pixelMaxY;
+		// Barycentrics of vertex 1 and 2 at the start pixel and their change per pixel
+		double invArea = 1.0 / (double)area;
+		double l1 = triangle.edge[1] * invArea, l2 = triangle.edge[2] * invArea;
+		double l1dx = triangle.stepX[1] * invArea, l2dx = triangle.stepX[2] * invArea;
+		double l1dy = triangle.stepY[1] * invArea, l2dy = triangle.stepY[2] * invArea;
+		for (int p = 0; p < 3; ++p) {
+			double a0 = v[0].color[p] * 255.0;
+			double a1 = v[1].color[p] * 255.0 - a0;
+			double a2 = v[2].color[p] * 255.0 - a0;
+			triangle.plane[p][0] = (float)(a0 + a1 * l1 + a2 * l2);
+			triangle.plane[p][1] = (float)(a1 * l1dx + a2 * l2dx);
+			triangle.plane[p][2] = (float)(a1 * l1dy + a2 * l2dy);
+		}
+		triangle.gradient = call.gradient;
+		return true;
+	}
+
+	static long long floorDiv(long long value, long long divisor) {
+		long long quotient = value / divisor;
+		return quotient * divisor > value ? quotient - 1 : quotient;
+	}
+
+	// Appends the triangle to every tile its box touches, unless one edge rejects the whole tile
+	void binTriangle(unsigned int index, std::vector<unsigned int>* chunkBins, ThreadStats& local) const {
+		const Triangle& triangle = triangles[index];
+		int tileX0 = triangle.minX / TILE_SIZE, tileX1 = triangle.maxX / TILE_SIZE;
+		int tileY0 = triangle.minY / TILE_SIZE, tileY1 = triangle.maxY / TILE_SIZE;
+		bool binned = false;
+		for (int tileY = tileY0; tileY <= tileY1; ++tileY) {
+			for (int tileX = tileX0; tileX <= tileX1; ++tileX) {
+				if (tileX0 != tileX1 || tileY0 != tileY1) {
+					int x0 = std::max(tileX * TILE_SIZE, triangle.minX) - triangle.minX;
+					int y0 = std::max(tileY * TILE_SIZE, triangle.minY) - triangle.minY;
+					int x1 = std::min(tileX * TILE_SIZE + TILE_SIZE - 1, triangle.maxX) - triangle.minX;
+					int y1 = std::min(tileY * TILE_SIZE + TILE_SIZE - 1, triangle.maxY) - triangle.minY;
+					bool outside = false;
+					for (int i = 0; i < 3 && !outside; ++i) {
+						// The corner furthest inside the edge
+						int x = triangle.stepX[i] > 0 ? x1 : x0;
+						int y = triangle.stepY[i] > 0 ? y1 : y0;
+						outside = triangle.edge[i] + triangle.stepX[i] * x + triangle.stepY[i] * y < 0;
+					}
+					if (outside) {
+						continue;
+					}
+				}
+				chunkBins[tileY * tilesX + tileX].push_back(index);
+				binned = true;
+			}
+		}
+		if (binned) {
+			++local.rasterized;
+		}
+		else {
+			++local.culled;
+		}
+	}
+
+	void shadeTile(unsigned int tile, unsigned int tileCount, ThreadStats& local) {
+		int tileX = (int)(tile % tilesX) * TILE_SIZE;
+		int tileY = (int)(tile / tilesX) * TILE_SIZE;
+		if (clearRequested) {
+			for (int y = tileY; y < tileY + TILE_SIZE; ++y) {
+				std::fill_n(&colorBuffer[(size_t)y * stride + tileX], TILE_SIZE, clearColor);
+			}
+		}
+		for (unsigned int chunk = 0; chunk < chunkCount; ++chunk) {
+			for (unsigned int index : bins[(size_t)chunk * tileCount + tile]) {
+				local.pixels += shadeTriangle(triangles[index], tileX, tileY);
+			}
+		}
+	}
+
+	// Shades the part of the triangle inside the tile, returns the number of covered pixels
+	uint64_t shadeTriangle(const Triangle& triangle, int tileX, int tileY) {
+		int x0 = std::max(triangle.minX, tileX), x1 = std::min(triangle.maxX, tileX + TILE_SIZE - 1);
+		int y0 = std::max(triangle.minY, tileY), y1 = std::min(triangle.maxY, tileY + TILE_SIZE - 1);
+		int rowEdge[3];
+		for (int i = 0; i < 3; ++i) {
+			rowEdge[i] = triangle.edge[i] + triangle.stepX[i] * (x0 - triangle.minX) + triangle.stepY[i] * (y0 - triangle.minY);
+		}
+		uint64_t covered = 0;
+#ifdef RASTER_USE_SSE2
+		// Lane i of a block is pixel (i % 4, i / 4), one register per row
+		__m128i edgeOffset[3], edgeRowStep[3], edgeBlockStep[3];
+		for (int i = 0; i < 3; ++i) {
+			edgeOffset[i] = _mm_setr_epi32(0, triangle.stepX[i], 2 * triangle.stepX[i], 3 * triangle.stepX[i]);
+			edgeRowStep[i] = _mm_set1_epi32(triangle.stepY[i]);
+			edgeBlockStep[i] = _mm_set1_epi32(4 * triangle.stepX[i]);
+		}
+		__m128 planeOffset[3], planeRowStep[3], planeBlockStep[3];
+		for (int p = 0; p < 3; ++p) {
+			float dx = triangle.plane[p][1];
+			planeOffset[p] = _mm_setr_ps(0.0f, dx, 2.0f * dx, 3.0f * dx);
+			planeRowStep[p] = _mm_set1_ps(triangle.plane[p][2]);
+			planeBlockStep[p] = _mm_set1_ps(4.0f * dx);
+		}
+		const __m128 gradient[3] = { _mm_set1_ps(triangle.gradient[0]), _mm_set1_ps(triangle.gradient[1]), _mm_set1_ps(triangle.gradient[2]) };
+		const __m128 zero = _mm_setzero_ps(), maximum = _mm_set1_ps(255.0f);
+		const __m128i alpha = _mm_set1_epi32((int)0xff000000);
+		static const int insideCount[16] = { 4, 3, 3, 2, 3, 2, 2, 1, 3, 2, 2, 1, 2, 1, 1, 0 };
+
+		for (int y = y0; y <= y1; y += 2) {
+			__m128i edge[3][2];
+			for (int i = 0; i < 3; ++i) {
+				edge[i][0] = _mm_add_epi32(_mm_set1_epi32(rowEdge[i] + triangle.stepY[i] * (y - y0)), edgeOffset[i]);
+				edge[i][1] = _mm_add_epi32(edge[i][0], edgeRowStep[i]);
+			}
+			__m128 plane[3][2];
+			for (int p = 0; p < 3; ++p) {
+				float start = triangle.plane[p][0] + triangle.plane[p][1] * (x0 - triangle.minX) + triangle.plane[p][2] * (y - triangle.minY);
+				plane[p][0] = _mm_add_ps(_mm_set1_ps(start), planeOffset[p]);
+				plane[p][1] = _mm_add_ps(plane[p][0], planeRowStep[p]);
+			}
+			uint32_t* rows[2] = { &colorBuffer[(size_t)y * stride], &colorBuffer[(size_t)(y + 1) * stride] };
+			for (int x = x0; x <= x1; x += 4) {
+				for (int r = 0; r < 2; ++r) {
+					__m128i outside = _mm_srai_epi32(_mm_or_si128(_mm_or_si128(edge[0][r], edge[1][r]), edge[2][r]), 31);
+					int outsideBits = _mm_movemask_ps(_mm_castsi128_ps(outside));
+					if (outsideBits == 0xf) {
+						continue;
+					}
+					covered += insideCount[outsideBits];
+					__m128i color = alpha;
+					for (int c = 0; c < 3; ++c) {
+						__m128 value = _mm_add_ps(plane[c][r], gradient[c]);
+						value = _mm_min_ps(_mm_max_ps(value, zero), maximum);
+						color = _mm_or_si128(color, _mm_slli_epi32(_mm_cvtps_epi32(value), 8 * c));
+					}
+					__m128i* target = (__m128i*)(rows[r] + x);
+					__m128i old = _mm_loadu_si128(target);
+					_mm_storeu_si128(target, _mm_or_si128(_mm_and_si128(outside, old), _mm_andnot_si128(outside, color)));
+				}
+				for (int i = 0; i < 3; ++i) {
+					edge[i][0] = _mm_add_epi32(edge[i][0], edgeBlockStep[i]);
+					edge[i][1] = _mm_add_epi32(edge[i][1], edgeBlockStep[i]);
+				}
+				for (int p = 0; p < 3; ++p) {
+					plane[p][0] = _mm_add_ps(plane[p][0], planeBlockStep[p]);
+					plane[p][1] = _mm_add_ps(plane[p][1], planeBlockStep[p]);
+				}
+			}
+		}
+#else
+		for (int y = y0; y <= y1; y += 2) {
+			for (int x = x0; x <= x1; x += 4) {
+				for (int lane = 0; lane < 8; ++lane) {
+					int dx = x - x0 + (lane & 3), dy = y - y0 + (lane >> 2);
+					int edge[3];
+					for (int i = 0; i < 3; ++i) {
+						edge[i] = rowEdge[i] + triangle.stepX[i] * dx + triangle.stepY[i] * dy;
+					}
+					if ((edge[0] | edge[1] | edge[2]) < 0) {
+						continue;
+					}
+					++covered;
+					float value[3];
+					for (int p = 0; p < 3; ++p) {
+						value[p] = triangle.plane[p][0] + triangle.plane[p][1] * (x + (lane & 3) - triangle.minX) + triangle.plane[p][2] * (y + (lane >> 2) - triangle.minY);
+					}
+					float rgb[3];
+					for (int c = 0; c < 3; ++c) {
+						rgb[c] = (value[c] + triangle.gradient[c]) / 255.0f;
+					}
+					colorBuffer[(size_t)(y + (lane >> 2)) * stride + x + (lane & 3)] = packColor(rgb[0], rgb[1], rgb[2], 1.0f);
+				}
+			}
+		}
+#endif
+		return covered;
+	}
+};
+#endif
@@ -0,0 +1,179 @@
+#ifndef SPRITE_BATCH_H
+#define SPRITE_BATCH_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+#include "sprite_quads.h"
+#include "profiler.h"
+
+// Draws many textured, colored quads with few draw calls.
+// draw() writes the quad's vertices straight into a mapped range of one streaming vertex buffer, and every
+// draw call shares a static index pattern, picking its quads with the base vertex. The pending quads are
+// drawn only when the program or texture changes, a draw call's worth of indices is used up or end() is
+// called. The buffer is filled front to back with unsynchronized maps and orphaned when full, so the CPU
+// never waits for the GPU to finish with earlier quads.
+// Vertex attributes: 0 vec2 position (pixels), 1 vec2 texture coordinates, 2 vec4 color.
+class SpriteBatch {
+public:
+	// The most quads 16-bit indices can address
+	static const unsigned int MAX_QUADS_PER_DRAW = 16384;
+
+	explicit SpriteBatch(unsigned int bufferQuads = 4 * MAX_QUADS_PER_DRAW)
+		: bufferQuads(std::max(bufferQuads, 1u)) {}
+
+	SpriteBatch(const SpriteBatch&) = delete;
+	SpriteBatch& operator=(const SpriteBatch&) = delete;
+
+	// Needs a current GL context
+	void init() {
+		std::vector<uint16_t> indices(MAX_QUADS_PER_DRAW * 6);
+		buildQuadIndices(indices.data(), MAX_QUADS_PER_DRAW);
+
+		glGenVertexArrays(1, &vertexArray);
+		glGenBuffers(1, &vertexBuffer);
+		glGenBuffers(1, &indexBuffer);
+		glBindVertexArray(vertexArray);
+		glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+		glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)bufferQuads * QUAD_BYTES, nullptr, GL_STREAM_DRAW);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)(indices.size() * sizeof(uint16_t)), indices.data(), GL_STATIC_DRAW);
+		glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(SpriteVertex), (void*)offsetof(SpriteVertex, x));
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(SpriteVertex), (void*)offsetof(SpriteVertex, u));
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(SpriteVertex), (void*)offsetof(SpriteVertex, color));
+		glEnableVertexAttribArray(2);
+		glBindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	void destroy() {
+		if (mapped) {
+			glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+			glUnmapBuffer(GL_ARRAY_BUFFER);
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+			mapped = nullptr;
+		}
+		glDeleteVertexArrays(1, &vertexArray);
+		glDeleteBuffers(1, &vertexBuffer);
+		glDeleteBuffers(1, &indexBuffer);
+		vertexArray = vertexBuffer = indexBuffer = 0;
+	}
+
+	// Starts a frame's quads, the per-frame statistics restart here
+	void begin(unsigned int program, unsigned int texture) {
+		currentProgram = program;
+		currentTexture = texture;
+		frameDrawCalls = 0;
+		frameQuads = 0;
+	}
+
+	void setProgram(unsigned int program) {
+		if (program != currentProgram) {
+			flush();
+			currentProgram = program;
+		}
+	}
+
+	// Texture unit 0
+	void setTexture(unsigned int texture) {
+		if (texture != currentTexture) {
+			flush();
+			currentTexture = texture;
+		}
+	}
+
+	void draw(float x, float y, float width, float height, uint32_t color,
+			  float u0 = 0.0f, float v0 = 0.0f, float u1 = 1.0f, float v1 = 1.0f) {
+		if (pendingQuads == mappedQuads) {
+			flush();
+			map();
+			if (!mapped) {
+				return;
+			}
+		}
+		writeSpriteQuad(mapped + 4 * pendingQuads, x, y, width, height, color, u0, v0, u1, v1);
+		++pendingQuads;
+	}
+
+	// Draws whatever is pending
+	void end() {
+		flush();
+	}
+
+	unsigned int drawCalls() const {
+		return frameDrawCalls;
+	}
+	uint64_t quads() const {
+		return frameQuads;
+	}
+	// Times the vertex buffer was full and replaced with fresh storage
+	uint64_t orphans() const {
+		return orphanCount;
+	}
+
+private:
+	static const size_t QUAD_BYTES = 4 * sizeof(SpriteVertex);
+
+	unsigned int bufferQuads;
+	unsigned int vertexArray = 0, vertexBuffer = 0, indexBuffer = 0;
+	unsigned int currentProgram = 0, currentTexture = 0;
+	SpriteVertex* mapped = nullptr;
+	unsigned int mappedQuads = 0;  // room in the mapped range
+	unsigned int pendingQuads = 0; // written to it so far
+	unsigned int cursor = 0;       // first quad of the mapped range in the buffer
+	unsigned int frameDrawCalls = 0;
+	uint64_t frameQuads = 0, orphanCount = 0;
+
+	void map() {
+		glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+		if (cursor == bufferQuads) {
+			// Earlier draws may still read the old storage, the driver keeps it alive until they are done
+			glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)bufferQuads * QUAD_BYTES, nullptr, GL_STREAM_DRAW);
+			cursor = 0;
+			++orphanCount;
+		}
+		// Nothing has been drawn from the rest of the buffer since it was orphaned, so no sync is needed
+		mappedQuads = std::min(MAX_QUADS_PER_DRAW, bufferQuads - cursor);
+		mapped = (SpriteVertex*)glMapBufferRange(GL_ARRAY_BUFFER, (GLintptr)cursor * QUAD_BYTES, (GLsizeiptr)mappedQuads * QUAD_BYTES,
+			GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_FLUSH_EXPLICIT_BIT);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		if (!mapped) {
+			std::cout << "ERROR::SPRITES::VERTEX_BUFFER_NOT_MAPPED" << std::endl;
+			mappedQuads = 0;
+		}
+	}
+
+	void flush() {
+		if (!mapped) {
+			return;
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+		if (pendingQuads > 0) {
+			glFlushMappedBufferRange(GL_ARRAY_BUFFER, 0, (GLsizeiptr)pendingQuads * QUAD_BYTES);
+		}
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		mapped = nullptr;
+		if (pendingQuads > 0) {
+			PROFILE_ZONE("spriteFlush");
+			glUseProgram(currentProgram);
+			glActiveTexture(GL_TEXTURE0);
+			glBindTexture(GL_TEXTURE_2D, currentTexture);
+			glBindVertexArray(vertexArray);
+			glDrawElementsBaseVertex(GL_TRIANGLES, (GLsizei)pendingQuads * 6, GL_UNSIGNED_SHORT, 0, (GLint)(cursor * 4));
+			glBindVertexArray(0);
+			++frameDrawCalls;
+			frameQuads += pendingQuads;
+		}
+		cursor += pendingQuads;
+		pendingQuads = 0;
+		mappedQuads = 0;
+	}
+};
+#endif
@@ -0,0 +1,41 @@
+#ifndef SPRITE_QUADS_H
+#define SPRITE_QUADS_H
+
+#include <cstdint>
+
+// One corner of a sprite quad: position in pixels, texture coordinates and an RGBA8 color
+struct SpriteVertex {
+	float x, y;
+	float u, v;
+	uint32_t color;
+};
+
+// Bytes r, g, b, a in memory order, read by the shader as a normalized vec4
+inline uint32_t packSpriteColor(float r, float g, float b, float a) {
+	return (uint32_t)(r * 255.0f + 0.5f) | (uint32_t)(g * 255.0f + 0.5f) << 8 |
+		(uint32_t)(b * 255.0f + 0.5f) << 16 | (uint32_t)(a * 255.0f + 0.5f) << 24;
+}
+
+// Corners counter-clockwise from the bottom left, (u0, v0) at the bottom left
+inline void writeSpriteQuad(SpriteVertex* out, float x, float y, float width, float height, uint32_t color,
+							float u0, float v0, float u1, float v1) {
+	float x1 = x + width, y1 = y + height;
+	out[0] = { x, y, u0, v0, color };
+	out[1] = { x1, y, u1, v0, color };
+	out[2] = { x1, y1, u1, v1, color };
+	out[3] = { x, y1, u0, v1, color };
+}
+
+// Two triangles per quad, the same pattern for every batch: a draw selects its quads with the base vertex
+inline void buildQuadIndices(uint16_t* out, unsigned int quads) {
+	for (unsigned int q = 0; q < quads; ++q) {
+		uint16_t first = (uint16_t)(4 * q);
+		out[6 * q + 0] = first;
+		out[6 * q + 1] = (uint16_t)(first + 1);
+		out[6 * q + 2] = (uint16_t)(first + 2);
+		out[6 * q + 3] = (uint16_t)(first + 2);
+		out[6 * q + 4] = (uint16_t)(first + 3);
+		out[6 * q + 5] = first;
+	}
+}
+#endif
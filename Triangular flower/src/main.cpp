@@ -1,38 +1,127 @@
 #define _USE_MATH_DEFINES
+#define ALLOCATION_COUNTER_IMPLEMENTATION
 
+#include <algorithm>
+#include <atomic>
 #include <iostream>
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <cmath>
+#include <cstdio>
+#include <memory>
 #include <random>
-#include "../../Two triangles/shader_s.h"
+#include <string>
+#include <thread>
+#include <vector>
+#include "../shader_s.h"
+#include "../input_events.h"
+#include "../options.h"
+#include "../gpu_timer.h"
+#include "../gpu_buffer_allocator.h"
+#include "../texture_loader.h"
+#include "../resource_streamer.h"
+#include "../profiler.h"
+#include "../frame_capture.h"
+#include "../flower_geometry.h"
+#include "../frame_arena.h"
+#include "../allocation_counter.h"
+#include "../scene_graph.h"
+#include "../ecs.h"
+#include "../bvh_culling.h"
+#include "../circle_lod.h"
+#include "../gpu_culling.h"
+#include "../stats_hud.h"
+#include "../scene_file.h"
+#include "../thread_pool.h"
 
 // Set program to use discrete videocard
+#ifdef _WIN32
 typedef unsigned long DWORD;
 extern "C" {
 	_declspec(dllexport) DWORD NvOptimusEnablement = 1;
 	_declspec(dllexport) int AmdPowerXpressRequestHighPerformance = 1;
 }
+#endif
 
 void framebufferSizeCallback(GLFWwindow* window, int width, int height);
-void processInput(GLFWwindow* window, Shader* shaderProgram);
-void configureVAOsAndVBOs(unsigned int* VAO, unsigned int* VBO, unsigned int* EBO, float** vertices, unsigned int** indices,
-						  const unsigned int* Nv, const unsigned int* Ni);
+void processInput(GLFWwindow* window, EventQueue& events, FrameScheduler& scheduler, Shader* shaderProgram);
+void configureVAOsAndVBOs(unsigned int* VAO, GpuBufferAllocator& buffers, uint32_t* vertexRanges, uint32_t* indexRanges,
+						  float** vertices, unsigned int** indices, const unsigned int* Nv, const unsigned int* Ni);
+void bindVertexArrays(unsigned int* VAO, const GpuBufferAllocator& buffers, const uint32_t* vertexRanges, const uint32_t* indexRanges);
+
+// A flower's nodes: the root places it, the shapes (circle, triangle as in shaderPrograms) hang below
+struct FlowerNodes {
+	SceneGraph::NodeId root;
+	SceneGraph::NodeId shapes[2];
+	float phase;
+};
+
+// Components of the renderable entities
+struct MeshComponent {
+	unsigned int vertexArray;
+	uint32_t indexRange; // in the GPU buffer allocator, defragmentation moves it
+	unsigned int firstIndex; // within the range
+	unsigned int indexCount;
+	uint32_t command; // the indirect command that draws this range
+	Aabb bounds; // of the vertices, before the transform
+};
+struct MaterialComponent {
+	Shader* shader;
+	const char* name;
+};
+struct TransformComponent {
+	SceneGraph::NodeId node;
+};
+// Circles with a level of detail pick their index range from CircleLodMeshes every frame
+struct LodComponent {
+	int level;
+};
+
+std::vector<SceneFlower> flowerGrid(unsigned int count);
+std::vector<SceneAnimation> defaultFlowerAnimations();
+void createFlowers(SceneGraph& scene, std::vector<FlowerNodes>& flowers, const std::vector<SceneFlower>& placements);
+void animateFlowers(SceneGraph& scene, const std::vector<FlowerNodes>& flowers, const std::vector<SceneAnimation>& animations, float time);
+
+// One draw of the frame's draw list
+struct DrawCommand {
+	Shader* shader;
+	unsigned int vertexArray;
+	unsigned int indexCount;
+	GLintptr indexOffset;
+	const char* name;
+	const Mat4* model;
+};
 
 const unsigned int SCR_WIDTH = 600;
 const unsigned int SCR_HEIGHT = 600;
+// Bytes the GPU buffer allocator may move per frame while defragmenting
+const uint64_t DEFRAGMENT_BUDGET = 256 * 1024;
 int N_ATTRIBUTES;
 bool MOUSE_BUTTON_LEFT_PRESSED = false;
+bool SHOW_HUD = false;
+// Framebuffer size in pixels, kept by the thread that draws from the resize events
+int FRAMEBUFFER_WIDTH = SCR_WIDTH;
+int FRAMEBUFFER_HEIGHT = SCR_HEIGHT;
 
 // Generating random double in range
 std::random_device rd; // obtain a random number from hardware
 std::mt19937 gen(rd()); // seed the generator
 std::uniform_real_distribution<> distr(0, 1); // define the range
 
-int main() {
+int main(int argc, char** argv) {
+	Options options = parseOptions(argc, argv);
+	if (options.seed != 0) {
+		gen.seed(options.seed);
+	}
+	if (options.tracePath || options.traceBinaryPath) {
+		PROFILER_START(options.tracePath, options.traceBinaryPath);
+		PROFILE_THREAD_NAME("main");
+	}
+
 	glfwInit();
 
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	// Culling in a compute shader needs 4.3, it falls back to the CPU on a 3.3 context
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, options.gpuCulling ? 4 : 3);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
@@ -41,6 +130,11 @@ int main() {
 #endif
 
 	GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Learn OpenGL", NULL, NULL);
+	if (window == NULL && options.gpuCulling) {
+		std::cout << "WARNING::GPU_CULLING::NO_GL_4_3_CONTEXT" << std::endl;
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+		window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Learn OpenGL", NULL, NULL);
+	}
 	if (window == NULL) {
 		std::cout << "Failed to create GLFW window!" << std::endl;
 		glfwTerminate();
@@ -54,80 +148,220 @@ int main() {
 		return -2;
 	}
 
+	EventQueue events;
+	events.attach(window);
 	glfwSetFramebufferSizeCallback(window, framebufferSizeCallback);
-
+	glfwGetFramebufferSize(window, &FRAMEBUFFER_WIDTH, &FRAMEBUFFER_HEIGHT);
+	FrameScheduler scheduler(options.onDemand, options.idleTimeout);
+	// The color gradient changes over time, Space pauses it
+	scheduler.setAnimating(true);
 
 	// CREATING SHADERS
 	glGetIntegerv(GL_MAX_VERTEX_ATTRIBS, &N_ATTRIBUTES);
 	std::cout << "Maximum number of vertex attributes supported: " << N_ATTRIBUTES << std::endl;
 
-	Shader triangle("shaders/3.3.shader.txt", "shaders/3.3.shader_triangle.txt");
-	Shader   circle("shaders/3.3.shader.txt", "shaders/3.3.shader_circle.txt");
+	// A scene file brings its own shapes, shaders and flowers. It needs a circle and a triangle mesh, the
+	// shapes the rest of the demo is built around.
+	SceneDescription sceneFile;
+	const SceneMesh* sceneMeshes[2] = {};
+	bool fromScene = false;
+	if (options.scenePath) {
+		double start = glfwGetTime();
+		bool fromCache = false;
+		fromScene = loadSceneFile(options.scenePath, (std::string(options.scenePath) + ".cache").c_str(), sceneFile, &fromCache);
+		sceneMeshes[0] = sceneFile.findMesh("circle");
+		sceneMeshes[1] = sceneFile.findMesh("triangle");
+		if (fromScene && !(sceneMeshes[0] && sceneMeshes[1])) {
+			std::cout << "ERROR::SCENE::NO_CIRCLE_OR_TRIANGLE_MESH " << options.scenePath << std::endl;
+			fromScene = false;
+		}
+		if (fromScene) {
+			std::cout << "Scene " << options.scenePath << (fromCache ? " read from its cache" : " parsed") << " in "
+					  << 1000.0 * (glfwGetTime() - start) << " ms" << std::endl;
+		}
+	}
+	const char* shaderPaths[2][2] = { { "shaders/3.3.shader.txt", "shaders/3.3.shader_circle.txt" },
+									  { "shaders/3.3.shader.txt", "shaders/3.3.shader_triangle.txt" } };
+	if (fromScene) {
+		for (int i = 0; i < 2; ++i) {
+			const SceneShader& shader = sceneFile.shaders[sceneMeshes[i]->shader];
+			shaderPaths[i][0] = sceneFile.string(shader.vertexPath);
+			shaderPaths[i][1] = sceneFile.string(shader.fragmentPath);
+		}
+	}
+	Shader triangle(shaderPaths[1][0], shaderPaths[1][1]);
+	Shader   circle(shaderPaths[0][0], shaderPaths[0][1]);
 	Shader shaderPrograms[] = { circle, triangle };
+	const char* shapeNames[] = { "circle", "triangle" };
+	// Looked up once, a draw then sets its world matrix with a single call
+	const int modelLocations[] = { glGetUniformLocation(circle.ID, "model"), glGetUniformLocation(triangle.ID, "model") };
 
+	GpuTimer gpuTimer;
+	if (options.gpuTimingsPath || options.gpuTimerCheck) {
+		gpuTimer.init();
+	}
 
-	// DRAWING AN OBJECT
-	float triangleVertices[] = {
-		 0.0,  0.0, 0.0, distr(gen), distr(gen), distr(gen),
-
-		 0.5,  1.0, 0.0, distr(gen), distr(gen), distr(gen),
-		 1.0,  0.5, 0.0, distr(gen), distr(gen), distr(gen),
-
-		 1.0, -0.5, 0.0, distr(gen), distr(gen), distr(gen),
-		 0.5, -1.0, 0.0, distr(gen), distr(gen), distr(gen),
-
-		-0.5, -1.0, 0.0, distr(gen), distr(gen), distr(gen),
-		-1.0, -0.5, 0.0, distr(gen), distr(gen), distr(gen),
-
-		-1.0,  0.5, 0.0, distr(gen), distr(gen), distr(gen),
-		-0.5,  1.0, 0.0, distr(gen), distr(gen), distr(gen),
-	};
-
-	unsigned int triangleIndices[] = {
-		0, 1, 2,
-		0, 3, 4,
-		0, 5, 6,
-		0, 7, 8,
-	};
-
-	float circleVertices[] = {
-		 0.0,            0.0,           0.0, distr(gen), distr(gen), distr(gen),
-
-		 0.0,            1.0,           0.0, distr(gen), distr(gen), distr(gen),
-		 cos(M_PI / 4),  sin(M_PI / 4), 0.0, distr(gen), distr(gen), distr(gen),
-
-		 1.0,            0.0,           0.0, distr(gen), distr(gen), distr(gen),
-		 cos(M_PI / 4), -sin(M_PI / 4), 0.0, distr(gen), distr(gen), distr(gen),
-
-		 0.0,           -1.0,           0.0, distr(gen), distr(gen), distr(gen),
-		-cos(M_PI / 4), -sin(M_PI / 4), 0.0, distr(gen), distr(gen), distr(gen),
+	// Frames are read back through a ring of pixel pack buffers, a few frames late
+	FrameCapture capture;
+	if (options.capturePath) {
+		int width, height;
+		glfwGetFramebufferSize(window, &width, &height);
+		capture.open(options.capturePath, options.capturePipe, width, height, options.captureFps,
+					 options.captureRgb ? CaptureFormat::RGB : CaptureFormat::Y4M);
+	}
 
-		-1.0,            0.0,           0.0, distr(gen), distr(gen), distr(gen),
-		-cos(M_PI / 4),  sin(M_PI / 4), 0.0, distr(gen), distr(gen), distr(gen),
-	};
+	// Decoded on worker threads and uploaded a bit every frame, the loop does not wait for it
+	TextureLoader textureLoader;
+	if (options.texturePath) {
+		textureLoader.init();
+		textureLoader.load(options.texturePath);
+	}
 
-	unsigned int circleIndices[] = {
-		0, 1, 2,
-		0, 2, 3,
-		0, 3, 4,
-		0, 4, 5,
-		0, 5, 6,
-		0, 6, 7,
-		0, 7, 8,
-		0, 8, 1,
-	};
+	// Buffers filled on a loader thread with its own context while the loop runs. They are not drawn, they
+	// show that the frame time stays flat while hundreds of megabytes go to the GPU.
+	ResourceStreamer streamer;
+	double streamStart = glfwGetTime();
+	bool streaming = options.streamMegabytes > 0 && streamer.init(window);
+	if (streaming) {
+		const size_t CHUNK_BYTES = 16 << 20;
+		size_t total = (size_t)options.streamMegabytes << 20;
+		for (size_t offset = 0; offset < total; offset += CHUNK_BYTES) {
+			uint32_t chunk = (uint32_t)(offset / CHUNK_BYTES);
+			streamer.loadBuffer(std::min(CHUNK_BYTES, total - offset), [chunk](unsigned char* data, size_t bytes) {
+				uint32_t* words = (uint32_t*)data;
+				for (size_t i = 0; i < bytes / 4; ++i) {
+					words[i] = chunk * 0x9E3779B9u ^ (uint32_t)i;
+				}
+			});
+		}
+	}
 
-	float* vertices[] = { circleVertices, triangleVertices };
-	unsigned int* indices[] = { circleIndices, triangleIndices };
-	const unsigned int Nv[] = { sizeof(circleVertices) / sizeof(float) / 3, sizeof(triangleVertices) / sizeof(float) / 3 };
-	const unsigned int Ni[] = { sizeof(circleIndices) / sizeof(unsigned int) / 3, sizeof(triangleIndices) / sizeof(unsigned int) / 3 };
-	unsigned int VAO[2], VBO[2], EBO[2];
+	// DRAWING AN OBJECT
+	FlowerGeometry geometry;
+	generateFlowerGeometry(geometry, gen, distr);
+
+	float* vertices[] = { geometry.circleVertices, geometry.triangleVertices };
+	unsigned int* indices[] = { geometry.circleIndices, geometry.triangleIndices };
+	unsigned int Nv[] = { sizeof(geometry.circleVertices) / sizeof(float) / 3, sizeof(geometry.triangleVertices) / sizeof(float) / 3 };
+	unsigned int Ni[] = { sizeof(geometry.circleIndices) / sizeof(unsigned int) / 3, sizeof(geometry.triangleIndices) / sizeof(unsigned int) / 3 };
+	if (fromScene) {
+		for (int i = 0; i < 2; ++i) {
+			vertices[i] = sceneFile.vertices.data() + (size_t)sceneMeshes[i]->firstVertex * FLOWER_VERTEX_FLOATS;
+			indices[i] = sceneFile.indices.data() + sceneMeshes[i]->firstIndex;
+			Nv[i] = sceneMeshes[i]->vertexCount * FLOWER_VERTEX_FLOATS / 3;
+			Ni[i] = sceneMeshes[i]->indexCount / 3;
+		}
+	}
+	// With a tolerance the circle's buffers hold all of its levels instead. The levels are made from the
+	// generated circle's layout, a center and eight rim vertices.
+	const bool circleLod = options.circleTolerance > 0.0f && (!fromScene || sceneMeshes[0]->vertexCount == 9);
+	if (options.circleTolerance > 0.0f && !circleLod) {
+		std::cout << "WARNING::CIRCLE_LOD::SCENE_CIRCLE_IS_NOT_9_VERTICES" << std::endl;
+	}
+	CircleLodMeshes circleLods;
+	CircleLodSelector lodSelector(options.circleTolerance);
+	if (circleLod) {
+		generateCircleLods(vertices[0], circleLods);
+		vertices[0] = circleLods.vertices.data();
+		indices[0] = circleLods.indices.data();
+		Nv[0] = (unsigned int)(circleLods.vertices.size() / 3);
+		Ni[0] = (unsigned int)(circleLods.indices.size() / 3);
+	}
+	unsigned int VAO[2];
+	uint32_t vertexRanges[2], indexRanges[2];
 
 	glGenVertexArrays(2, VAO);
-	glGenBuffers(2, VBO);
-	glGenBuffers(2, EBO);
 
-	configureVAOsAndVBOs(VAO, VBO, EBO, vertices, indices, Nv, Ni);
+	// Vertices and indices are ranges of the allocator's shared buffers
+	GpuBufferAllocator bufferAllocator(64 * 1024);
+	bufferAllocator.init();
+	// Filler ranges take the first page, the meshes land on a second one. Freeing every other filler leaves
+	// holes too small for the meshes: the page is compacted, then the meshes move into it.
+	std::vector<uint32_t> fillers;
+	for (int i = 0; options.defragmentCheck && i < 32; ++i) {
+		fillers.push_back(bufferAllocator.allocate(GpuBufferCategory::Geometry, 2048));
+	}
+	configureVAOsAndVBOs(VAO, bufferAllocator, vertexRanges, indexRanges, vertices, indices, Nv, Ni);
+	for (size_t i = 1; i < fillers.size(); i += 2) {
+		bufferAllocator.free(fillers[i]);
+	}
+	// The flowers' shapes as instanced draws of the culled instance buffer
+	IndirectCuller indirectCuller;
+	std::vector<Shader> instancedPrograms;
+	if (options.gpuCulling) {
+		indirectCuller.init((GLADloadproc)glfwGetProcAddress, "shaders/4.3.shader_cull.txt");
+		instancedPrograms.reserve(2);
+		instancedPrograms.emplace_back("shaders/3.3.shader_instanced.txt", shaderPaths[0][1]);
+		instancedPrograms.emplace_back("shaders/3.3.shader_instanced.txt", shaderPaths[1][1]);
+		for (int i = 0; i < 2; ++i) {
+			indirectCuller.bindInstanceAttributes(VAO[i]);
+		}
+	}
+	// Defragmentation moves ranges, the vertex arrays point at the old offsets until they are bound again
+	bufferAllocator.setRelocationCallback([&](uint32_t, const GpuRange&) {
+		bindVertexArrays(VAO, bufferAllocator, vertexRanges, indexRanges);
+		for (int i = 0; i < (int)instancedPrograms.size(); ++i) {
+			indirectCuller.bindInstanceAttributes(VAO[i]);
+		}
+	});
+
+	// The shapes are placed by their world matrices, a large field updates them on every core
+	SceneGraph scene;
+	std::vector<FlowerNodes> flowers;
+	std::vector<SceneFlower> grid;
+	if (!fromScene) {
+		grid = flowerGrid(options.flowerCount);
+	}
+	createFlowers(scene, flowers, fromScene ? sceneFile.flowers : grid);
+	// The one still flower of the default scene does not move
+	const std::vector<SceneAnimation> animations = fromScene ? sceneFile.animations : defaultFlowerAnimations();
+	const bool animated = !animations.empty() && (fromScene || options.flowerCount > 0);
+	// Every shape of every flower is an entity, the draw list is a query over them. The shapes are created
+	// one after the other, so the draws of one program come out together.
+	World entities;
+	Aabb meshBounds[2];
+	for (int i = 0; i < 2; ++i) {
+		Aabb bounds = { Vec3(vertices[i][0], vertices[i][1], vertices[i][2]), Vec3(vertices[i][0], vertices[i][1], vertices[i][2]) };
+		// Nv counts floats in threes, the positions are the first three of every vertex
+		for (unsigned int v = 1; v < 3 * Nv[i] / FLOWER_VERTEX_FLOATS; ++v) {
+			const float* p = vertices[i] + FLOWER_VERTEX_FLOATS * v;
+			bounds.min = Vec3(std::min(bounds.min.x, p[0]), std::min(bounds.min.y, p[1]), std::min(bounds.min.z, p[2]));
+			bounds.max = Vec3(std::max(bounds.max.x, p[0]), std::max(bounds.max.y, p[1]), std::max(bounds.max.z, p[2]));
+		}
+		meshBounds[i] = bounds;
+		// The circle's levels are the first commands, one for each
+		MeshComponent mesh = { VAO[i], indexRanges[i], 0, 3 * Ni[i], (uint32_t)(i == 0 ? 0 : circleLod ? CircleLodMeshes::LEVELS : 1), bounds };
+		MaterialComponent material = { &shaderPrograms[i], shapeNames[i] };
+		for (const FlowerNodes& flower : flowers) {
+			if (circleLod && i == 0) {
+				entities.create(mesh, material, TransformComponent{ flower.shapes[i] }, LodComponent{ 0 });
+			}
+			else {
+				entities.create(mesh, material, TransformComponent{ flower.shapes[i] });
+			}
+		}
+	}
+	std::unique_ptr<ThreadPool> scenePool;
+	if (scene.size() >= 2 * SceneGraph::TASK_NODES) {
+		scenePool.reset(new ThreadPool());
+	}
+	// Shapes off the screen are culled against a tree over their bounds. The bounds and the visible list
+	// keep their storage from frame to frame.
+	InstanceBvh cullingTree;
+	std::vector<Aabb> instanceBounds;
+	std::vector<uint32_t> visibleInstances;
+	// Indirect commands: one per circle level (or just the circle), then the triangle. Their index ranges
+	// are filled in every frame, defragmentation moves them.
+	std::vector<IndirectCommand> indirectCommands;
+	std::vector<Aabb> commandBounds;
+	std::vector<CullInstance> cullInstances;
+	const uint32_t circleCommands = circleLod ? CircleLodMeshes::LEVELS : 1;
+	if (options.gpuCulling) {
+		indirectCommands.resize(circleCommands + 1);
+		commandBounds.assign(circleCommands, meshBounds[0]);
+		commandBounds.push_back(meshBounds[1]);
+		cullInstances.reserve(entities.size());
+	}
 
 	// RENDER LOOP
 	//glPolygonMode(GL_FRONT_AND_BACK, GL_LINE); // Wireframe mode
@@ -135,78 +369,449 @@ int main() {
 	
 	int colorGradientLocation;
 	float r, g, b, time;
-	while (!glfwWindowShouldClose(window)) {
-		glClearColor(0.07f, 0.07f, 0.07f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT);
-		processInput(window, shaderPrograms);
-		for (int i = 0; i < 2; ++i) {
-			shaderPrograms[i].use();
-			time = glfwGetTime();
-			r =  sin(time) / 4; 
-			g =  cos(time) / 4;
-			b = -sin(time) / 4;
-			shaderPrograms[i].setFloat3("colorGradient", r, g, b);
+	// Animation clock, it stands still while the animation is paused
+	double animationTime = 0.0, lastFrameTime = glfwGetTime();
+	// The HUD shows the frame's counts and the frame times, smoothed so they can be read
+	StatsHud hud;
+	hud.init("shaders/3.3.shader_hud.txt", "shaders/3.3.shader_hud_text.txt");
+	SHOW_HUD = options.hud;
+	double frameMs = 0.0, cpuMs = 0.0, lastFrameStart = glfwGetTime();
+	double longestStreamingFrameMs = 0.0;
+	bool gpuTimerChecked = false;
+	unsigned int streamingFrames = 0;
+	// Per-frame data lives in the arena, steady-state frames must not touch the heap
+	FrameArena frameArena;
+	FrameAllocationCheck allocationCheck;
+	// The frames are drawn on a render thread that owns the GL context. The main thread only pumps the
+	// window's events into the queue: a slow frame does not hold up the input, and moving or resizing the
+	// window, which blocks inside the event pump on some systems, does not hold up the frames.
+	auto renderFrames = [&] {
+		while (!glfwWindowShouldClose(window)) {
+			{
+				PROFILE_ZONE("waitEvents");
+				if (options.renderThread) {
+					scheduler.waitEvents(events);
+				}
+				else {
+					scheduler.waitEvents();
+				}
+			}
+			processInput(window, events, scheduler, shaderPrograms);
+
+			double now = glfwGetTime();
+			if (scheduler.isAnimating()) {
+				animationTime += now - lastFrameTime;
+			}
+			lastFrameTime = now;
+			if (!scheduler.needsFrame()) {
+				continue;
+			}
+
+			PROFILE_ZONE("frame");
+			double frameStart = glfwGetTime();
+			frameMs += (1000.0 * (frameStart - lastFrameStart) - frameMs) * 0.1;
+			if (streaming) {
+				longestStreamingFrameMs = std::max(longestStreamingFrameMs, 1000.0 * (frameStart - lastFrameStart));
+				++streamingFrames;
+			}
+			lastFrameStart = frameStart;
+			unsigned int frameDrawCalls = 0, frameUniformUpdates = 0;
+			if (animated && scheduler.isAnimating()) {
+				PROFILE_ZONE("animateFlowers");
+				animateFlowers(scene, flowers, animations, (float)animationTime);
+			}
+			{
+				PROFILE_ZONE("sceneUpdate");
+				scene.update(scenePool.get());
+			}
+			if (circleLod) {
+				PROFILE_ZONE("selectLod");
+				float halfWidth = 0.5f * FRAMEBUFFER_WIDTH, halfHeight = 0.5f * FRAMEBUFFER_HEIGHT;
+				uint64_t circleTriangles = 0;
+				entities.each<MeshComponent, LodComponent, TransformComponent>(
+					[&](size_t count, MeshComponent* meshes, LodComponent* lods, const TransformComponent* transforms) {
+					for (size_t e = 0; e < count; ++e) {
+						float radius = circleLods.radius * projectedCircleRadius(scene.world(transforms[e].node), halfWidth, halfHeight);
+						int level = lodSelector.select(radius, lods[e].level);
+						lods[e].level = level;
+						meshes[e].firstIndex = circleLods.firstIndex[level];
+						meshes[e].indexCount = circleLods.indexCount[level];
+						meshes[e].command = (uint32_t)level;
+						circleTriangles += CircleLodMeshes::segments(level);
+					}
+				});
+				PROFILE_COUNTER("circle triangles", circleTriangles);
+			}
+			gpuTimer.beginFrame();
+			if (options.gpuTimerCheck && !gpuTimerChecked) {
+				// The zone past the limit is counted and closed without a query slot
+				for (unsigned int z = 0; z <= GpuTimer::MAX_ZONES; ++z) {
+					gpuTimer.beginZone("nesting check");
+				}
+				unsigned int open = gpuTimer.openZoneCount();
+				for (unsigned int z = 0; z <= GpuTimer::MAX_ZONES; ++z) {
+					gpuTimer.endZone();
+				}
+				if (open != GpuTimer::MAX_ZONES + 1 || gpuTimer.openZoneCount() != 0 || gpuTimer.overflowCount() != 1) {
+					std::cout << "ERROR::GPU_TIMER::NESTING_CHECK_FAILED " << open << " open, " << gpuTimer.openZoneCount()
+							  << " left, " << gpuTimer.overflowCount() << " over the limit" << std::endl;
+				}
+				gpuTimerChecked = true;
+			}
+			glClearColor(0.07f, 0.07f, 0.07f, 1.0f);
+			gpuTimer.beginZone("clear");
+			glClear(GL_COLOR_BUFFER_BIT);
+			gpuTimer.endZone();
+			if (options.gpuCulling) {
+				{
+					PROFILE_ZONE("gpuCull");
+					for (uint32_t c = 0; c < indirectCommands.size(); ++c) {
+						int shape = c < circleCommands ? 0 : 1;
+						uint32_t first = circleLod && shape == 0 ? circleLods.firstIndex[c] : 0;
+						uint32_t count = circleLod && shape == 0 ? circleLods.indexCount[c] : 3 * Ni[shape];
+						indirectCommands[c] = { count, 0, (uint32_t)(bufferAllocator.range(indexRanges[shape]).offset / sizeof(unsigned int)) + first, 0, 0 };
+					}
+					cullInstances.clear();
+					entities.each<MeshComponent, TransformComponent>([&](size_t count, const MeshComponent* meshes, const TransformComponent* transforms) {
+						for (size_t e = 0; e < count; ++e) {
+							cullInstances.push_back({ scene.world(transforms[e].node), meshes[e].command, { 0, 0, 0 } });
+						}
+					});
+					CullVolume viewport = CullVolume::rectangle(-1.0f, -1.0f, 1.0f, 1.0f);
+					indirectCuller.cull(cullInstances.data(), (uint32_t)cullInstances.size(), indirectCommands.data(), commandBounds.data(),
+										(uint32_t)indirectCommands.size(), viewport);
+					if (options.gpuCullingCheck) {
+						indirectCuller.verify(cullInstances.data(), commandBounds.data(), viewport);
+					}
+				}
+				// One multi-draw per shape, over its commands
+				for (int shape = 0; shape < 2; ++shape) {
+					GpuZone zone(gpuTimer, shapeNames[shape]);
+					{
+						PROFILE_ZONE("uniforms");
+						instancedPrograms[shape].use();
+						time = animationTime;
+						computeColorGradient(time, r, g, b);
+						instancedPrograms[shape].setFloat3("colorGradient", r, g, b);
+						++frameUniformUpdates;
+					}
+					PROFILE_ZONE("draw");
+					glBindVertexArray(VAO[shape]);
+					frameDrawCalls += indirectCuller.draw(shape == 0 ? 0 : circleCommands, shape == 0 ? circleCommands : 1);
+				}
+				glBindVertexArray(0);
+			}
+			else {
+				FrameVector<DrawCommand> draws{ FrameAllocator<DrawCommand>(frameArena) };
+				draws.reserve(entities.size());
+				instanceBounds.clear();
+				entities.each<MeshComponent, MaterialComponent, TransformComponent>(
+					[&](size_t count, const MeshComponent* meshes, const MaterialComponent* materials, const TransformComponent* transforms) {
+					for (size_t e = 0; e < count; ++e) {
+						const Mat4& model = scene.world(transforms[e].node);
+						draws.push_back({ materials[e].shader, meshes[e].vertexArray, meshes[e].indexCount,
+										  (GLintptr)(bufferAllocator.range(meshes[e].indexRange).offset + meshes[e].firstIndex * sizeof(unsigned int)),
+										  materials[e].name, &model });
+						instanceBounds.push_back(transformAabb(model, meshes[e].bounds));
+					}
+				});
+				{
+					PROFILE_ZONE("cull");
+					if (cullingTree.size() != instanceBounds.size()) {
+						cullingTree.build(instanceBounds.data(), (uint32_t)instanceBounds.size());
+						visibleInstances.resize(instanceBounds.size());
+					}
+					else {
+						cullingTree.refit(instanceBounds.data(), InstanceBvh::DEFAULT_REBUILD_BUDGET, scenePool.get());
+					}
+					// The vertices are in clip space already, the viewport is the [-1, 1] square
+					uint32_t visibleCount = cullingTree.cull(CullVolume::rectangle(-1.0f, -1.0f, 1.0f, 1.0f), visibleInstances.data(), scenePool.get());
+					FrameVector<uint8_t> visible(draws.size(), 0, FrameAllocator<uint8_t>(frameArena));
+					for (uint32_t v = 0; v < visibleCount; ++v) {
+						visible[visibleInstances[v]] = 1;
+					}
+					// Keeps the query's order, so the draws of one program stay together
+					size_t kept = 0;
+					for (size_t d = 0; d < draws.size(); ++d) {
+						if (visible[d]) {
+							draws[kept++] = draws[d];
+						}
+					}
+					draws.resize(kept);
+				}
+				// The draws of one shape share the program, the gradient and the GPU zone
+				for (size_t first = 0, end = 0; first < draws.size(); first = end) {
+					const DrawCommand& draw = draws[first];
+					GpuZone zone(gpuTimer, draw.name);
+					const int modelLocation = modelLocations[draw.shader - shaderPrograms];
+					{
+						PROFILE_ZONE("uniforms");
+						draw.shader->use();
+						time = animationTime;
+						computeColorGradient(time, r, g, b);
+						draw.shader->setFloat3("colorGradient", r, g, b);
+						++frameUniformUpdates;
+					}
+
+					PROFILE_ZONE("draw");
+					glBindVertexArray(draw.vertexArray);
+					for (end = first; end < draws.size() && draws[end].shader == draw.shader; ++end) {
+						glUniformMatrix4fv(modelLocation, 1, GL_FALSE, draws[end].model->data());
+						glDrawElements(GL_TRIANGLES, draws[end].indexCount, GL_UNSIGNED_INT, (void*)draws[end].indexOffset);
+					}
+					frameDrawCalls += (unsigned int)(end - first);
+					frameUniformUpdates += (unsigned int)(end - first);
+				}
+			}
+			if (SHOW_HUD) {
+				PROFILE_ZONE("hud");
+				GpuZone zone(gpuTimer, "hud");
+				// The CPU time covers the frame up to here, the HUD itself and the swap are left out
+				cpuMs += (1000.0 * (glfwGetTime() - frameStart) - cpuMs) * 0.1;
+				char line[96];
+				hud.begin(FRAMEBUFFER_WIDTH, FRAMEBUFFER_HEIGHT);
+				snprintf(line, sizeof(line), "FRAME %.2f MS  CPU %.2f MS", frameMs, cpuMs);
+				hud.text(8.0f, 8.0f, 14.0f, 0xffffffffu, line);
+				snprintf(line, sizeof(line), "DRAWS %u  UNIFORMS %u", frameDrawCalls, frameUniformUpdates);
+				hud.text(8.0f, 26.0f, 14.0f, 0xffffffffu, line);
+				snprintf(line, sizeof(line), "GPU MEMORY %.1f / %.1f KB", bufferAllocator.usedBytes() / 1024.0, bufferAllocator.reservedBytes() / 1024.0);
+				hud.text(8.0f, 44.0f, 14.0f, 0xffffffffu, line);
+				if (streamer.queuedBytes() > 0) {
+					snprintf(line, sizeof(line), "STREAMED %.0f / %.0f MB", streamer.loadedBytes() / 1048576.0, streamer.queuedBytes() / 1048576.0);
+					hud.text(8.0f, 62.0f, 14.0f, 0xffffffffu, line);
+				}
+				hud.end();
+			}
+			gpuTimer.endFrame();
+
+			{
+				PROFILE_ZONE("capture");
+				capture.captureFrame();
+			}
+			{
+				PROFILE_ZONE("glfwSwapBuffers");
+				glfwSwapBuffers(window);
+			}
+			textureLoader.update();
+			if (streaming) {
+				streamer.update();
+				if (streamer.pendingCount() == 0) {
+					streaming = false;
+					std::cout << "Streamed " << streamer.loadedBytes() / 1048576.0 << " MB in " << glfwGetTime() - streamStart
+							  << " s, " << streamingFrames << " frames meanwhile, the longest " << longestStreamingFrameMs << " ms" << std::endl;
+				}
+			}
+			{
+				PROFILE_ZONE("defragment");
+				bufferAllocator.defragment(DEFRAGMENT_BUDGET);
+				bufferAllocator.publishCounters();
+			}
+			frameArena.reset();
+			allocationCheck.frameBoundary();
+			scheduler.frameRendered();
+		}
+	};
+	if (options.renderThread) {
+		std::atomic<bool> rendering(true);
+		glfwMakeContextCurrent(NULL);
+		std::thread renderThread([&] {
+			PROFILE_THREAD_NAME("render");
+			glfwMakeContextCurrent(window);
+			renderFrames();
+			glfwMakeContextCurrent(NULL);
+			rendering = false;
+			glfwPostEmptyEvent();
+		});
+		{
+			// Whatever the platform's event handling allocates is not frame work
+			AllocationExemption exemption;
+			while (rendering) {
+				glfwWaitEvents();
+			}
+		}
+		renderThread.join();
+		glfwMakeContextCurrent(window);
+	}
+	else {
+		renderFrames();
+	}
 
-			glBindVertexArray(VAO[i]);
-			glDrawElements(GL_TRIANGLES, 3 * Ni[i], GL_UNSIGNED_INT, 0);
+	capture.close();
+	if (gpuTimer.isEnabled()) {
+		gpuTimer.writeReport(std::cout);
+		if (options.gpuTimingsPath) {
+			gpuTimer.writeCsv(options.gpuTimingsPath);
 		}
+		gpuTimer.destroy();
+	}
+
+	if (options.gpuMemoryReport) {
+		bufferAllocator.writeReport(std::cout);
+	}
+	if (options.defragmentCheck && (bufferAllocator.relocations() == 0 || bufferAllocator.pageCount() != 1)) {
+		std::cout << "ERROR::GPU_BUFFER_ALLOCATOR::DEFRAGMENT_CHECK_FAILED " << bufferAllocator.relocations() << " relocations, "
+				  << bufferAllocator.pageCount() << " pages" << std::endl;
+	}
 
-		glfwSwapBuffers(window);
-		glfwPollEvents();
+	if (options.texturePath) {
+		textureLoader.writeReport(std::cout);
+		textureLoader.destroy();
+	}
+	if (options.streamMegabytes > 0) {
+		streamer.writeReport(std::cout);
+		streamer.destroy();
 	}
 
 	glDeleteVertexArrays(2, VAO);
-	glDeleteBuffers(2, VBO);
-	glDeleteBuffers(2, EBO);
+	bufferAllocator.destroy();
+	indirectCuller.destroy();
+	hud.destroy();
+	for (Shader& program : instancedPrograms) {
+		program.deleteProgram();
+	}
 	shaderPrograms[0].deleteProgram();
 	shaderPrograms[1].deleteProgram();
 
+	PROFILER_STOP();
 	glfwTerminate();
 	return 0;
 }
 
-void configureVAOsAndVBOs(unsigned int* VAO, unsigned int* VBO, unsigned int* EBO, float** vertices, unsigned int** indices,
-	const unsigned int* Nv, const unsigned int* Ni) {
+void configureVAOsAndVBOs(unsigned int* VAO, GpuBufferAllocator& buffers, uint32_t* vertexRanges, uint32_t* indexRanges,
+	float** vertices, unsigned int** indices, const unsigned int* Nv, const unsigned int* Ni) {
 	for (int i = 0; i < 2; ++i) {
-		glBindVertexArray(VAO[i]);
+		vertexRanges[i] = buffers.allocate(GpuBufferCategory::Geometry, 3 * Nv[i] * sizeof(float), vertices[i]);
+		indexRanges[i] = buffers.allocate(GpuBufferCategory::Index, 3 * Ni[i] * sizeof(unsigned int), indices[i]);
+	}
+	bindVertexArrays(VAO, buffers, vertexRanges, indexRanges);
+}
 
-		glBindBuffer(GL_ARRAY_BUFFER, VBO[i]);
-		glBufferData(GL_ARRAY_BUFFER, 3 * Nv[i] * sizeof(float), vertices[i], GL_STATIC_DRAW);
+void bindVertexArrays(unsigned int* VAO, const GpuBufferAllocator& buffers, const uint32_t* vertexRanges, const uint32_t* indexRanges) {
+	for (int i = 0; i < 2; ++i) {
+		GpuRange vertexRange = buffers.range(vertexRanges[i]);
+		glBindVertexArray(VAO[i]);
 
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO[i]);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, 3 * Ni[i] * sizeof(unsigned int), indices[i], GL_STATIC_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, vertexRange.buffer);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers.range(indexRanges[i]).buffer);
 
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(0));
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(vertexRange.offset));
 		glEnableVertexAttribArray(0);
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(vertexRange.offset + 3 * sizeof(float)));
 		glEnableVertexAttribArray(1);
 	}
+	glBindVertexArray(0);
 }
 
+// Flowers on a square grid, each fits its cell. No count keeps the single flower at the identity.
+std::vector<SceneFlower> flowerGrid(unsigned int count) {
+	unsigned int total = std::max(count, 1u);
+	unsigned int columns = (unsigned int)std::ceil(std::sqrt((double)total));
+	float cell = 2.0f / columns;
+	std::vector<SceneFlower> grid(total);
+	if (count == 0) {
+		grid[0] = { 0.0f, 0.0f, 0.0f, 1.0f, 0.0f };
+		return grid;
+	}
+	for (unsigned int i = 0; i < total; ++i) {
+		grid[i] = { -1.0f + cell * (i % columns + 0.5f), 1.0f - cell * (i / columns + 0.5f), 0.0f, 0.45f * cell, 0.7f * (float)i };
+	}
+	return grid;
+}
 
-void framebufferSizeCallback(GLFWwindow* window, int width, int height) {
-	glViewport(0, 0, width, height);
+// The flowers sway, their petals turn and their centers pulse
+std::vector<SceneAnimation> defaultFlowerAnimations() {
+	return { { SceneAnimationKind::Sway, 0.15f, 1.0f }, { SceneAnimationKind::Pulse, 0.1f, 2.0f }, { SceneAnimationKind::Spin, 1.0f, 0.5f } };
 }
 
-void processInput(GLFWwindow* window, Shader* shaderPrograms) {
-	if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS) {
-		glfwSetWindowShouldClose(window, true);
+void createFlowers(SceneGraph& scene, std::vector<FlowerNodes>& flowers, const std::vector<SceneFlower>& placements) {
+	scene.reserve(3 * placements.size());
+	flowers.reserve(placements.size());
+	for (const SceneFlower& placement : placements) {
+		FlowerNodes flower;
+		flower.root = scene.create(SceneGraph::INVALID, Vec3(placement.x, placement.y, placement.z), Quat(),
+								   Vec3(placement.scale, placement.scale, 1.0f));
+		flower.shapes[0] = scene.create(flower.root);
+		flower.shapes[1] = scene.create(flower.root);
+		flower.phase = placement.phase;
+		flowers.push_back(flower);
 	}
+}
 
-	if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS) {
-		MOUSE_BUTTON_LEFT_PRESSED = true;
+// Each flower a bit out of step with the others, by its phase
+void animateFlowers(SceneGraph& scene, const std::vector<FlowerNodes>& flowers, const std::vector<SceneAnimation>& animations, float time) {
+	const Vec3 axis(0.0f, 0.0f, 1.0f);
+	for (const FlowerNodes& flower : flowers) {
+		float sway = 0.0f, pulse = 1.0f, spin = 0.0f;
+		for (const SceneAnimation& animation : animations) {
+			float t = animation.speed * time + flower.phase;
+			switch (animation.kind) {
+			case SceneAnimationKind::Sway:
+				sway += animation.amplitude * sin(t);
+				break;
+			case SceneAnimationKind::Pulse:
+				pulse += animation.amplitude * sin(t);
+				break;
+			case SceneAnimationKind::Spin:
+				spin += animation.amplitude * t;
+				break;
+			}
+		}
+		scene.setRotation(flower.root, Quat::axisAngle(axis, sway));
+		scene.setScale(flower.shapes[0], Vec3(pulse, pulse, 1.0f));
+		scene.setRotation(flower.shapes[1], Quat::axisAngle(axis, spin));
 	}
+}
 
-	if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_RELEASE && MOUSE_BUTTON_LEFT_PRESSED) {
-		//int randomColorLocation;
-		//glUseProgram(shaderPrograms[0]);
-		//randomColorLocation = glGetUniformLocation(shaderPrograms[0], "randomColor");
-		//glUniform3fv(randomColorLocation, 1, true, randomColors);
+// Called on the main thread, which may not own the GL context. The thread that draws sets the viewport
+// when the event reaches it.
+void framebufferSizeCallback(GLFWwindow* window, int width, int height) {
+	EventQueue::fromWindow(window)->push(InputEventType::Resize, 0, 0, 0, width, height);
+}
+
+void processInput(GLFWwindow* window, EventQueue& events, FrameScheduler& scheduler, Shader* shaderPrograms) {
+	PROFILE_FUNCTION();
+	InputEvent event;
+	while (events.poll(event)) {
+		if (event.type == InputEventType::Key && event.action == GLFW_PRESS) {
+			if (event.code == GLFW_KEY_ESCAPE) {
+				glfwSetWindowShouldClose(window, true);
+			}
+			if (event.code == GLFW_KEY_H) {
+				SHOW_HUD = !SHOW_HUD;
+				scheduler.invalidate();
+			}
+			if (event.code == GLFW_KEY_SPACE) {
+				scheduler.setAnimating(!scheduler.isAnimating());
+				scheduler.invalidate();
+			}
+		}
+
+		if (event.type == InputEventType::MouseButton && event.code == GLFW_MOUSE_BUTTON_LEFT) {
+			if (event.action == GLFW_PRESS) {
+				MOUSE_BUTTON_LEFT_PRESSED = true;
+			}
 
-		//glUseProgram(shaderPrograms[1]);
-		//randomColorLocation = glGetUniformLocation(shaderPrograms[1], "randomColor");
-		//glUniform3fv(randomColorLocation, 1, true, randomColors);
+			if (event.action == GLFW_RELEASE && MOUSE_BUTTON_LEFT_PRESSED) {
+				//int randomColorLocation;
+				//glUseProgram(shaderPrograms[0]);
+				//randomColorLocation = glGetUniformLocation(shaderPrograms[0], "randomColor");
+				//glUniform3fv(randomColorLocation, 1, true, randomColors);
 
-		MOUSE_BUTTON_LEFT_PRESSED = false;
+				//glUseProgram(shaderPrograms[1]);
+				//randomColorLocation = glGetUniformLocation(shaderPrograms[1], "randomColor");
+				//glUniform3fv(randomColorLocation, 1, true, randomColors);
+
+				MOUSE_BUTTON_LEFT_PRESSED = false;
+			}
+		}
+
+		if (event.type == InputEventType::Resize) {
+			FRAMEBUFFER_WIDTH = (int)event.x;
+			FRAMEBUFFER_HEIGHT = (int)event.y;
+			glViewport(0, 0, FRAMEBUFFER_WIDTH, FRAMEBUFFER_HEIGHT);
+		}
+		if (event.type == InputEventType::Resize || event.type == InputEventType::Refresh) {
+			scheduler.invalidate();
+		}
 	}
 }
\ No newline at end of file
@@ -0,0 +1,142 @@
+#ifndef STATS_HUD_H
+#define STATS_HUD_H
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+#include "sdf_font.h"
+#include "shader_s.h"
+#include "sprite_quads.h"
+
+// On-screen text for diagnostics. Lines are laid out on the CPU into one vertex array during the frame
+// and drawn at the end with a single draw call: one buffer upload, one program, the SDF font atlas.
+// The atlas is built once in init(); nothing allocates per frame once the vertex array has grown to the
+// longest text.
+class StatsHud {
+public:
+	// The most quads 16-bit indices can address
+	static const unsigned int MAX_QUADS = 16384;
+
+	StatsHud() = default;
+	StatsHud(const StatsHud&) = delete;
+	StatsHud& operator=(const StatsHud&) = delete;
+
+	// Needs a current GL context
+	void init(const char* vertexPath, const char* fragmentPath) {
+		SdfFontAtlas atlas;
+		buildSdfFontAtlas(atlas);
+		font = atlas;
+		font.texels.clear();
+		font.texels.shrink_to_fit();
+
+		glGenTextures(1, &atlasTexture);
+		glBindTexture(GL_TEXTURE_2D, atlasTexture);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, atlas.width, atlas.height, 0, GL_RED, GL_UNSIGNED_BYTE, atlas.texels.data());
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		std::vector<uint16_t> indices(MAX_QUADS * 6);
+		buildQuadIndices(indices.data(), MAX_QUADS);
+		glGenVertexArrays(1, &vertexArray);
+		glGenBuffers(1, &vertexBuffer);
+		glGenBuffers(1, &indexBuffer);
+		glBindVertexArray(vertexArray);
+		glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)(indices.size() * sizeof(uint16_t)), indices.data(), GL_STATIC_DRAW);
+		glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(SpriteVertex), (void*)offsetof(SpriteVertex, x));
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(SpriteVertex), (void*)offsetof(SpriteVertex, u));
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(SpriteVertex), (void*)offsetof(SpriteVertex, color));
+		glEnableVertexAttribArray(2);
+		glBindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+		shader.reset(new Shader(vertexPath, fragmentPath));
+		shader->use();
+		shader->setInt("glyphAtlas", 0);
+		screenSizeLocation = glGetUniformLocation(shader->ID, "screenSize");
+		glUseProgram(0);
+	}
+
+	void destroy() {
+		if (!shader) {
+			return;
+		}
+		glDeleteTextures(1, &atlasTexture);
+		glDeleteVertexArrays(1, &vertexArray);
+		glDeleteBuffers(1, &vertexBuffer);
+		glDeleteBuffers(1, &indexBuffer);
+		shader->deleteProgram();
+		shader.reset();
+	}
+
+	// Starts a frame's text, the screen size places it
+	void begin(int width, int height) {
+		screenWidth = (float)width;
+		screenHeight = (float)height;
+		quads = 0;
+	}
+
+	// x, y: top left corner in pixels from the top left of the screen; pixelHeight: capital letter height
+	void text(float x, float y, float pixelHeight, uint32_t color, const char* line) {
+		size_t needed = 4 * (size_t)(quads + (unsigned int)strlen(line));
+		if (vertices.size() < needed) {
+			vertices.resize(needed);
+		}
+		quads += layoutSdfText(vertices.data() + 4 * quads, MAX_QUADS - quads, font, x, screenHeight - y, pixelHeight, color, line);
+	}
+
+	// The frame's text in one draw, over whatever is on screen
+	void end() {
+		if (quads == 0) {
+			return;
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+		size_t bytes = 4 * (size_t)quads * sizeof(SpriteVertex);
+		// The last frame's draw may still read the old storage, orphaning it lets the driver keep both
+		if (bytes > bufferBytes) {
+			bufferBytes = bytes;
+		}
+		glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)bufferBytes, nullptr, GL_STREAM_DRAW);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, (GLsizeiptr)bytes, vertices.data());
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+		shader->use();
+		glUniform2f(screenSizeLocation, screenWidth, screenHeight);
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, atlasTexture);
+		glEnable(GL_BLEND);
+		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		glBindVertexArray(vertexArray);
+		glDrawElements(GL_TRIANGLES, (GLsizei)quads * 6, GL_UNSIGNED_SHORT, 0);
+		glBindVertexArray(0);
+		glDisable(GL_BLEND);
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+
+	unsigned int quadCount() const {
+		return quads;
+	}
+
+private:
+	SdfFontAtlas font; // the layout, the texels are on the GPU
+	std::unique_ptr<Shader> shader;
+	int screenSizeLocation = -1;
+	unsigned int atlasTexture = 0, vertexArray = 0, vertexBuffer = 0, indexBuffer = 0;
+	std::vector<SpriteVertex> vertices;
+	unsigned int quads = 0;
+	size_t bufferBytes = 0;
+	float screenWidth = 0.0f, screenHeight = 0.0f;
+};
+#endif
@@ -0,0 +1,819 @@
+#ifndef TEXTURE_COMPRESSION_H
+#define TEXTURE_COMPRESSION_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include "thread_pool.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define TEXTURE_COMPRESSION_USE_SSE2
+#endif
+
+// Block compressed formats written by the offline compressor. Every format stores 4x4 pixel blocks.
+enum class BlockFormat {
+	BC1,  // RGB, 8 bytes per block
+	BC3,  // RGBA, BC1 color plus an 8 byte alpha block
+	BC7,  // RGBA, 16 bytes per block, encoded with mode 6 only
+	ETC2  // RGB, 8 bytes per block, encoded with the ETC1 compatible modes only
+};
+
+struct BlockFormatInfo {
+	const char* name;
+	unsigned int blockBytes;
+	bool alpha;
+};
+
+inline const BlockFormatInfo& blockFormatInfo(BlockFormat format) {
+	static const BlockFormatInfo infos[] = {
+		{ "bc1", 8, false },
+		{ "bc3", 16, true },
+		{ "bc7", 16, true },
+		{ "etc2", 8, false },
+	};
+	return infos[(int)format];
+}
+
+inline bool parseBlockFormat(const char* name, BlockFormat& format) {
+	for (int i = 0; i < 4; ++i) {
+		if (strcmp(name, blockFormatInfo((BlockFormat)i).name) == 0) {
+			format = (BlockFormat)i;
+			return true;
+		}
+	}
+	return false;
+}
+
+inline size_t compressedSize(BlockFormat format, int width, int height) {
+	return (size_t)((width + 3) / 4) * ((height + 3) / 4) * blockFormatInfo(format).blockBytes;
+}
+
+namespace texture_compression {
+	// One block as floats, a channel per array so four pixels load into one register
+	struct alignas(16) BlockPixels {
+		float r[16], g[16], b[16], a[16];
+	};
+
+	// Pixels past the right or top edge repeat the last column or row
+	inline void loadBlock(const unsigned char* rgba, int width, int height, int blockX, int blockY, BlockPixels& block) {
+		for (int y = 0; y < 4; ++y) {
+			int sy = std::min(blockY * 4 + y, height - 1);
+			for (int x = 0; x < 4; ++x) {
+				int sx = std::min(blockX * 4 + x, width - 1);
+				const unsigned char* p = rgba + ((size_t)sy * width + sx) * 4;
+				int i = y * 4 + x;
+				block.r[i] = p[0];
+				block.g[i] = p[1];
+				block.b[i] = p[2];
+				block.a[i] = p[3];
+			}
+		}
+	}
+
+	inline void storeBlock(const unsigned char (*pixels)[4], int width, int height, int blockX, int blockY, unsigned char* rgba) {
+		for (int y = 0; y < 4 && blockY * 4 + y < height; ++y) {
+			for (int x = 0; x < 4 && blockX * 4 + x < width; ++x) {
+				memcpy(rgba + ((size_t)(blockY * 4 + y) * width + blockX * 4 + x) * 4, pixels[y * 4 + x], 4);
+			}
+		}
+	}
+
+	inline int clampByte(int v) {
+		return v < 0 ? 0 : v > 255 ? 255 : v;
+	}
+
+	inline float clampFloat(float v, float lo, float hi) {
+		return v < lo ? lo : v > hi ? hi : v;
+	}
+
+	// Picks the nearest palette entry for each of count pixels (a multiple of 4, 16 byte aligned channels) and
+	// returns the summed squared error. Alpha only counts when useAlpha is set. Ties go to the lower index.
+	inline float nearestIndices(const float* red, const float* green, const float* blue, const float* alpha, int count,
+								const float (*palette)[4], int paletteSize, bool useAlpha, uint8_t* indices) {
+		float total = 0.0f;
+#ifdef TEXTURE_COMPRESSION_USE_SSE2
+		for (int i = 0; i < count; i += 4) {
+			__m128 r = _mm_load_ps(red + i), g = _mm_load_ps(green + i), b = _mm_load_ps(blue + i), a = _mm_load_ps(alpha + i);
+			__m128 best = _mm_set1_ps(1e30f);
+			__m128i bestIndex = _mm_setzero_si128();
+			for (int p = 0; p < paletteSize; ++p) {
+				__m128 dr = _mm_sub_ps(r, _mm_set1_ps(palette[p][0]));
+				__m128 dg = _mm_sub_ps(g, _mm_set1_ps(palette[p][1]));
+				__m128 db = _mm_sub_ps(b, _mm_set1_ps(palette[p][2]));
+				__m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dr, dr), _mm_mul_ps(dg, dg)), _mm_mul_ps(db, db));
+				if (useAlpha) {
+					__m128 da = _mm_sub_ps(a, _mm_set1_ps(palette[p][3]));
+					d = _mm_add_ps(d, _mm_mul_ps(da, da));
+				}
+				__m128i closer = _mm_castps_si128(_mm_cmplt_ps(d, best));
+				best = _mm_min_ps(d, best);
+				bestIndex = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32(p)), _mm_andnot_si128(closer, bestIndex));
+			}
+			alignas(16) float errors[4];
+			alignas(16) int32_t chosen[4];
+			_mm_store_ps(errors, best);
+			_mm_store_si128((__m128i*)chosen, bestIndex);
+			for (int j = 0; j < 4; ++j) {
+				indices[i + j] = (uint8_t)chosen[j];
+				total += errors[j];
+			}
+		}
+#else
+		for (int i = 0; i < count; ++i) {
+			float best = 1e30f;
+			int bestIndex = 0;
+			for (int p = 0; p < paletteSize; ++p) {
+				float dr = red[i] - palette[p][0], dg = green[i] - palette[p][1], db = blue[i] - palette[p][2];
+				float d = dr * dr + dg * dg + db * db;
+				if (useAlpha) {
+					float da = alpha[i] - palette[p][3];
+					d += da * da;
+				}
+				if (d < best) {
+					best = d;
+					bestIndex = p;
+				}
+			}
+			indices[i] = (uint8_t)bestIndex;
+			total += best;
+		}
+#endif
+		return total;
+	}
+
+	inline float selectIndices(const BlockPixels& block, const float (*palette)[4], int paletteSize, bool useAlpha, uint8_t* indices) {
+		return nearestIndices(block.r, block.g, block.b, block.a, 16, palette, paletteSize, useAlpha, indices);
+	}
+
+	// Endpoints of the line through the block's colors: the principal axis of the covariance, clipped to the
+	// projections of the outermost pixels. Returns false when every pixel has the same color.
+	inline bool principalEndpoints(const BlockPixels& block, int channels, float* low, float* high) {
+		const float* data[4] = { block.r, block.g, block.b, block.a };
+		float mean[4] = { 0, 0, 0, 0 };
+		for (int c = 0; c < channels; ++c) {
+			for (int i = 0; i < 16; ++i) {
+				mean[c] += data[c][i];
+			}
+			mean[c] /= 16.0f;
+		}
+		float covariance[4][4] = {};
+		for (int i = 0; i < 16; ++i) {
+			for (int c = 0; c < channels; ++c) {
+				for (int d = c; d < channels; ++d) {
+					covariance[c][d] += (data[c][i] - mean[c]) * (data[d][i] - mean[d]);
+				}
+			}
+		}
+		for (int c = 0; c < channels; ++c) {
+			for (int d = 0; d < c; ++d) {
+				covariance[c][d] = covariance[d][c];
+			}
+		}
+		// Power iteration from the channel with the largest variance
+		float axis[4] = { 0, 0, 0, 0 };
+		int start = 0;
+		for (int c = 1; c < channels; ++c) {
+			if (covariance[c][c] > covariance[start][start]) {
+				start = c;
+			}
+		}
+		if (covariance[start][start] < 1e-3f) {
+			for (int c = 0; c < channels; ++c) {
+				low[c] = high[c] = mean[c];
+			}
+			return false;
+		}
+		for (int c = 0; c < channels; ++c) {
+			axis[c] = covariance[start][c];
+		}
+		for (int iteration = 0; iteration < 8; ++iteration) {
+			float next[4] = { 0, 0, 0, 0 }, length = 0.0f;
+			for (int c = 0; c < channels; ++c) {
+				for (int d = 0; d < channels; ++d) {
+					next[c] += covariance[c][d] * axis[d];
+				}
+				length += next[c] * next[c];
+			}
+			if (length < 1e-12f) {
+				break;
+			}
+			length = 1.0f / std::sqrt(length);
+			for (int c = 0; c < channels; ++c) {
+				axis[c] = next[c] * length;
+			}
+		}
+		float minT = 1e30f, maxT = -1e30f;
+		for (int i = 0; i < 16; ++i) {
+			float t = 0.0f;
+			for (int c = 0; c < channels; ++c) {
+				t += (data[c][i] - mean[c]) * axis[c];
+			}
+			minT = std::min(minT, t);
+			maxT = std::max(maxT, t);
+		}
+		for (int c = 0; c < channels; ++c) {
+			low[c] = clampFloat(mean[c] + minT * axis[c], 0.0f, 255.0f);
+			high[c] = clampFloat(mean[c] + maxT * axis[c], 0.0f, 255.0f);
+		}
+		return true;
+	}
+
+	// Least squares endpoints for fixed indices: pixel i is weights[indices[i]] * e0 + (1 - weights[indices[i]]) * e1.
+	// Returns false when the indices do not pin down two endpoints.
+	inline bool refineEndpoints(const BlockPixels& block, int channels, const uint8_t* indices, const float* weights, float* e0, float* e1) {
+		const float* data[4] = { block.r, block.g, block.b, block.a };
+		float aa = 0, bb = 0, ab = 0, ax[4] = { 0, 0, 0, 0 }, bx[4] = { 0, 0, 0, 0 };
+		for (int i = 0; i < 16; ++i) {
+			float w = weights[indices[i]], v = 1.0f - w;
+			aa += w * w;
+			bb += v * v;
+			ab += w * v;
+			for (int c = 0; c < channels; ++c) {
+				ax[c] += w * data[c][i];
+				bx[c] += v * data[c][i];
+			}
+		}
+		float determinant = aa * bb - ab * ab;
+		if (std::fabs(determinant) < 1e-6f) {
+			return false;
+		}
+		float inverse = 1.0f / determinant;
+		for (int c = 0; c < channels; ++c) {
+			e0[c] = clampFloat((ax[c] * bb - bx[c] * ab) * inverse, 0.0f, 255.0f);
+			e1[c] = clampFloat((bx[c] * aa - ax[c] * ab) * inverse, 0.0f, 255.0f);
+		}
+		return true;
+	}
+
+	// BC1 ------------------------------------------------------------------------------------------------
+
+	inline uint16_t packRgb565(const float* color) {
+		int r = (int)(color[0] * 31.0f / 255.0f + 0.5f), g = (int)(color[1] * 63.0f / 255.0f + 0.5f), b = (int)(color[2] * 31.0f / 255.0f + 0.5f);
+		return (uint16_t)(r << 11 | g << 5 | b);
+	}
+
+	inline void unpackRgb565(uint16_t c, int* color) {
+		int r = c >> 11 & 31, g = c >> 5 & 63, b = c & 31;
+		color[0] = r << 3 | r >> 2;
+		color[1] = g << 2 | g >> 4;
+		color[2] = b << 3 | b >> 2;
+	}
+
+	// The four colors of a block. With c0 <= c1 the third is the midpoint and the fourth transparent black,
+	// unless opaque is set: the color half of BC3 always interpolates four colors.
+	inline void bc1Palette(uint16_t c0, uint16_t c1, bool opaque, int (*palette)[4]) {
+		unpackRgb565(c0, palette[0]);
+		unpackRgb565(c1, palette[1]);
+		palette[0][3] = palette[1][3] = 255;
+		for (int c = 0; c < 3; ++c) {
+			if (c0 > c1 || opaque) {
+				palette[2][c] = (2 * palette[0][c] + palette[1][c] + 1) / 3;
+				palette[3][c] = (palette[0][c] + 2 * palette[1][c] + 1) / 3;
+			}
+			else {
+				palette[2][c] = (palette[0][c] + palette[1][c] + 1) / 2;
+				palette[3][c] = 0;
+			}
+		}
+		palette[2][3] = 255;
+		palette[3][3] = c0 > c1 || opaque ? 255 : 0;
+	}
+
+	// Always uses the four color mode, so the block decodes the same as the color half of BC3
+	inline void encodeBlockBC1(const BlockPixels& block, uint8_t* out) {
+		static const float WEIGHTS[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+		float e0[4], e1[4];
+		uint16_t bestC0 = 0, bestC1 = 0;
+		uint8_t bestIndices[16] = {};
+		if (!principalEndpoints(block, 3, e1, e0)) {
+			// A solid block: both endpoints the same color, every index 0
+			bestC0 = bestC1 = packRgb565(e0);
+		}
+		else {
+			float bestError = 1e30f;
+			for (int iteration = 0; iteration < 3; ++iteration) {
+				uint16_t c0 = packRgb565(e0), c1 = packRgb565(e1);
+				if (c0 < c1) {
+					std::swap(c0, c1);
+				}
+				uint8_t indices[16] = {};
+				float error;
+				if (c0 == c1) {
+					int color[4];
+					unpackRgb565(c0, color);
+					float palette[1][4] = { { (float)color[0], (float)color[1], (float)color[2], 255.0f } };
+					error = selectIndices(block, palette, 1, false, indices);
+				}
+				else {
+					int integerPalette[4][4];
+					bc1Palette(c0, c1, true, integerPalette);
+					float palette[4][4];
+					for (int p = 0; p < 4; ++p) {
+						for (int c = 0; c < 4; ++c) {
+							palette[p][c] = (float)integerPalette[p][c];
+						}
+					}
+					error = selectIndices(block, palette, 4, false, indices);
+				}
+				if (error < bestError) {
+					bestError = error;
+					bestC0 = c0;
+					bestC1 = c1;
+					memcpy(bestIndices, indices, 16);
+				}
+				if (c0 == c1 || !refineEndpoints(block, 3, indices, WEIGHTS, e0, e1)) {
+					break;
+				}
+			}
+		}
+		out[0] = (uint8_t)bestC0;
+		out[1] = (uint8_t)(bestC0 >> 8);
+		out[2] = (uint8_t)bestC1;
+		out[3] = (uint8_t)(bestC1 >> 8);
+		uint32_t bits = 0;
+		for (int i = 0; i < 16; ++i) {
+			bits |= (uint32_t)bestIndices[i] << (2 * i);
+		}
+		for (int i = 0; i < 4; ++i) {
+			out[4 + i] = (uint8_t)(bits >> (8 * i));
+		}
+	}
+
+	inline void decodeBlockBC1(const uint8_t* in, bool opaque, unsigned char (*pixels)[4]) {
+		uint16_t c0 = (uint16_t)(in[0] | in[1] << 8), c1 = (uint16_t)(in[2] | in[3] << 8);
+		int palette[4][4];
+		bc1Palette(c0, c1, opaque, palette);
+		uint32_t bits = (uint32_t)in[4] | (uint32_t)in[5] << 8 | (uint32_t)in[6] << 16 | (uint32_t)in[7] << 24;
+		for (int i = 0; i < 16; ++i) {
+			const int* color = palette[bits >> (2 * i) & 3];
+			for (int c = 0; c < 4; ++c) {
+				pixels[i][c] = (unsigned char)color[c];
+			}
+		}
+	}
+
+	// BC3 ------------------------------------------------------------------------------------------------
+
+	inline void bc4Palette(int a0, int a1, int* palette) {
+		palette[0] = a0;
+		palette[1] = a1;
+		if (a0 > a1) {
+			for (int i = 1; i < 7; ++i) {
+				palette[1 + i] = ((7 - i) * a0 + i * a1 + 3) / 7;
+			}
+		}
+		else {
+			for (int i = 1; i < 5; ++i) {
+				palette[1 + i] = ((5 - i) * a0 + i * a1 + 2) / 5;
+			}
+			palette[6] = 0;
+			palette[7] = 255;
+		}
+	}
+
+	// The alpha block: the extremes as endpoints and eight interpolated values in between
+	inline void encodeBlockAlpha(const BlockPixels& block, uint8_t* out) {
+		int low = 255, high = 0;
+		for (int i = 0; i < 16; ++i) {
+			low = std::min(low, (int)block.a[i]);
+			high = std::max(high, (int)block.a[i]);
+		}
+		out[0] = (uint8_t)high;
+		out[1] = (uint8_t)low;
+		uint64_t bits = 0;
+		if (high != low) {
+			int palette[8];
+			bc4Palette(high, low, palette);
+			for (int i = 0; i < 16; ++i) {
+				int best = 0, bestError = 1 << 30;
+				for (int p = 0; p < 8; ++p) {
+					int error = std::abs((int)block.a[i] - palette[p]);
+					if (error < bestError) {
+						bestError = error;
+						best = p;
+					}
+				}
+				bits |= (uint64_t)best << (3 * i);
+			}
+		}
+		for (int i = 0; i < 6; ++i) {
+			out[2 + i] = (uint8_t)(bits >> (8 * i));
+		}
+	}
+
+	inline void decodeBlockAlpha(const uint8_t* in, unsigned char (*pixels)[4]) {
+		int palette[8];
+		bc4Palette(in[0], in[1], palette);
+		uint64_t bits = 0;
+		for (int i = 0; i < 6; ++i) {
+			bits |= (uint64_t)in[2 + i] << (8 * i);
+		}
+		for (int i = 0; i < 16; ++i) {
+			pixels[i][3] = (unsigned char)palette[bits >> (3 * i) & 7];
+		}
+	}
+
+	inline void encodeBlockBC3(const BlockPixels& block, uint8_t* out) {
+		encodeBlockAlpha(block, out);
+		encodeBlockBC1(block, out + 8);
+	}
+
+	inline void decodeBlockBC3(const uint8_t* in, unsigned char (*pixels)[4]) {
+		decodeBlockBC1(in + 8, true, pixels);
+		decodeBlockAlpha(in, pixels);
+	}
+
+	// BC7 mode 6 -----------------------------------------------------------------------------------------
+
+	const int BC7_WEIGHTS4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	inline void bc7Palette(const int* e0, const int* e1, int (*palette)[4]) {
+		for (int i = 0; i < 16; ++i) {
+			for (int c = 0; c < 4; ++c) {
+				palette[i][c] = ((64 - BC7_WEIGHTS4[i]) * e0[c] + BC7_WEIGHTS4[i] * e1[c] + 32) >> 6;
+			}
+		}
+	}
+
+	// Appends bits least significant first, the order BC7 blocks are laid out in
+	struct BitWriter {
+		uint8_t* out;
+		int position = 0;
+
+		explicit BitWriter(uint8_t* out) : out(out) {
+			memset(out, 0, 16);
+		}
+
+		void write(uint32_t value, int count) {
+			for (int i = 0; i < count; ++i, ++position) {
+				out[position >> 3] |= (uint8_t)((value >> i & 1) << (position & 7));
+			}
+		}
+	};
+
+	struct BitReader {
+		const uint8_t* in;
+		int position = 0;
+
+		explicit BitReader(const uint8_t* in) : in(in) {}
+
+		uint32_t read(int count) {
+			uint32_t value = 0;
+			for (int i = 0; i < count; ++i, ++position) {
+				value |= (uint32_t)(in[position >> 3] >> (position & 7) & 1) << i;
+			}
+			return value;
+		}
+	};
+
+	// Mode 6: one subset, 7 bit RGBA endpoints with a p-bit each, 4 bit indices.
+	// Every p-bit pair is tried on the principal axis endpoints and again after a least squares refit.
+	inline void encodeBlockBC7(const BlockPixels& block, uint8_t* out) {
+		float weights[16];
+		for (int i = 0; i < 16; ++i) {
+			weights[i] = 1.0f - BC7_WEIGHTS4[i] / 64.0f;
+		}
+		float low[4], high[4];
+		bool spread = principalEndpoints(block, 4, low, high);
+		int bestE0[4] = {}, bestE1[4] = {}, bestP[2] = {};
+		uint8_t bestIndices[16] = {};
+		float bestError = 1e30f;
+		for (int pass = 0; pass < (spread ? 2 : 1); ++pass) {
+			for (int p = 0; p < 4; ++p) {
+				int p0 = p & 1, p1 = p >> 1, e0[4], e1[4];
+				for (int c = 0; c < 4; ++c) {
+					int q0 = std::min(127, std::max(0, (int)((low[c] - p0) * 0.5f + 0.5f)));
+					int q1 = std::min(127, std::max(0, (int)((high[c] - p1) * 0.5f + 0.5f)));
+					e0[c] = q0 << 1 | p0;
+					e1[c] = q1 << 1 | p1;
+				}
+				int integerPalette[16][4];
+				bc7Palette(e0, e1, integerPalette);
+				float palette[16][4];
+				for (int i = 0; i < 16; ++i) {
+					for (int c = 0; c < 4; ++c) {
+						palette[i][c] = (float)integerPalette[i][c];
+					}
+				}
+				uint8_t indices[16];
+				float error = selectIndices(block, palette, 16, true, indices);
+				if (error < bestError) {
+					bestError = error;
+					memcpy(bestE0, e0, sizeof(e0));
+					memcpy(bestE1, e1, sizeof(e1));
+					bestP[0] = p0;
+					bestP[1] = p1;
+					memcpy(bestIndices, indices, 16);
+				}
+			}
+			if (pass == 0 && spread && !refineEndpoints(block, 4, bestIndices, weights, low, high)) {
+				break;
+			}
+		}
+		// The first index has an implied zero top bit: mirror the indices by swapping the endpoints
+		if (bestIndices[0] & 8) {
+			std::swap(bestE0, bestE1);
+			std::swap(bestP[0], bestP[1]);
+			for (uint8_t& index : bestIndices) {
+				index = (uint8_t)(15 - index);
+			}
+		}
+		BitWriter writer(out);
+		writer.write(1 << 6, 7);
+		for (int c = 0; c < 4; ++c) {
+			writer.write((uint32_t)bestE0[c] >> 1, 7);
+			writer.write((uint32_t)bestE1[c] >> 1, 7);
+		}
+		writer.write((uint32_t)bestP[0], 1);
+		writer.write((uint32_t)bestP[1], 1);
+		writer.write(bestIndices[0], 3);
+		for (int i = 1; i < 16; ++i) {
+			writer.write(bestIndices[i], 4);
+		}
+	}
+
+	// Decodes mode 6 blocks only; returns false for the other modes
+	inline bool decodeBlockBC7(const uint8_t* in, unsigned char (*pixels)[4]) {
+		BitReader reader(in);
+		if (reader.read(7) != 1 << 6) {
+			return false;
+		}
+		int e0[4], e1[4];
+		for (int c = 0; c < 4; ++c) {
+			e0[c] = (int)reader.read(7) << 1;
+			e1[c] = (int)reader.read(7) << 1;
+		}
+		int p0 = (int)reader.read(1), p1 = (int)reader.read(1);
+		for (int c = 0; c < 4; ++c) {
+			e0[c] |= p0;
+			e1[c] |= p1;
+		}
+		int palette[16][4];
+		bc7Palette(e0, e1, palette);
+		for (int i = 0; i < 16; ++i) {
+			const int* color = palette[reader.read(i == 0 ? 3 : 4)];
+			for (int c = 0; c < 4; ++c) {
+				pixels[i][c] = (unsigned char)color[c];
+			}
+		}
+		return true;
+	}
+
+	// ETC2 RGB -------------------------------------------------------------------------------------------
+
+	const int ETC_MODIFIERS[8][2] = { { 2, 8 }, { 5, 17 }, { 9, 29 }, { 13, 42 }, { 18, 60 }, { 24, 80 }, { 33, 106 }, { 47, 183 } };
+
+	// Pixel index bits select +small, +large, -small, -large
+	inline int etcModifier(int table, int index) {
+		int magnitude = ETC_MODIFIERS[table][index & 1];
+		return index & 2 ? -magnitude : magnitude;
+	}
+
+	// Pixel i (row-major) of the block is in the second half when split into columns (flip 0) or rows (flip 1)
+	inline int etcHalf(int i, int flip) {
+		return flip ? (i >> 3) : ((i & 3) >> 1);
+	}
+
+	// The eight pixels of one half and where they sit in the block
+	struct alignas(16) HalfPixels {
+		float r[8], g[8], b[8], a[8];
+		int position[8];
+	};
+
+	inline void splitHalves(const BlockPixels& block, int flip, HalfPixels* halves) {
+		int count[2] = { 0, 0 };
+		for (int i = 0; i < 16; ++i) {
+			HalfPixels& half = halves[etcHalf(i, flip)];
+			int n = count[etcHalf(i, flip)]++;
+			half.r[n] = block.r[i];
+			half.g[n] = block.g[i];
+			half.b[n] = block.b[i];
+			half.a[n] = block.a[i];
+			half.position[n] = i;
+		}
+	}
+
+	// Best table and per-pixel indices for one half around a base color; returns the squared error
+	inline float etcFitHalf(const HalfPixels& half, const int* base, int& bestTable, uint8_t* indices) {
+		float bestError = 1e30f;
+		for (int table = 0; table < 8; ++table) {
+			float palette[4][4] = {};
+			for (int index = 0; index < 4; ++index) {
+				for (int c = 0; c < 3; ++c) {
+					palette[index][c] = (float)clampByte(base[c] + etcModifier(table, index));
+				}
+			}
+			uint8_t chosen[8];
+			float error = nearestIndices(half.r, half.g, half.b, half.a, 8, palette, 4, false, chosen);
+			if (error < bestError) {
+				bestError = error;
+				bestTable = table;
+				memcpy(indices, chosen, 8);
+			}
+		}
+		return bestError;
+	}
+
+	// Individual (two RGB444 bases) and differential (RGB555 plus a 3 bit delta) modes for both flips.
+	// Each half tries its average color, then the average of its pixels minus their chosen modifiers.
+	// The differential delta always stays in range, so the block never selects the ETC2-only T, H or planar modes.
+	inline void encodeBlockETC2(const BlockPixels& block, uint8_t* out) {
+		const int CANDIDATES = 2;
+		uint64_t best = 0;
+		float bestError = 1e30f;
+		for (int flip = 0; flip < 2; ++flip) {
+			HalfPixels halves[2];
+			splitHalves(block, flip, halves);
+			for (int differential = 0; differential < 2; ++differential) {
+				int maximum = differential ? 31 : 15;
+				int quantized[2][CANDIDATES][3], tables[2][CANDIDATES];
+				uint8_t indices[2][CANDIDATES][8];
+				float errors[2][CANDIDATES];
+				for (int h = 0; h < 2; ++h) {
+					float average[3] = {};
+					for (int i = 0; i < 8; ++i) {
+						average[0] += halves[h].r[i] / 8.0f;
+						average[1] += halves[h].g[i] / 8.0f;
+						average[2] += halves[h].b[i] / 8.0f;
+					}
+					for (int k = 0; k < CANDIDATES; ++k) {
+						if (k > 0) {
+							float shift = 0.0f;
+							for (int i = 0; i < 8; ++i) {
+								shift += etcModifier(tables[h][0], indices[h][0][i]) / 8.0f;
+							}
+							for (int c = 0; c < 3; ++c) {
+								average[c] -= shift;
+							}
+						}
+						int base[3];
+						for (int c = 0; c < 3; ++c) {
+							int q = (int)(average[c] * maximum / 255.0f + 0.5f);
+							quantized[h][k][c] = q < 0 ? 0 : q > maximum ? maximum : q;
+							base[c] = differential ? quantized[h][k][c] << 3 | quantized[h][k][c] >> 2 : quantized[h][k][c] * 17;
+						}
+						errors[h][k] = etcFitHalf(halves[h], base, tables[h][k], indices[h][k]);
+					}
+				}
+				// The individual mode pairs any two candidates, the differential one only those within the delta range
+				for (int k0 = 0; k0 < CANDIDATES; ++k0) {
+					for (int k1 = 0; k1 < CANDIDATES; ++k1) {
+						float error = errors[0][k0] + errors[1][k1];
+						if (error >= bestError) {
+							continue;
+						}
+						bool valid = true;
+						for (int c = 0; c < 3 && differential; ++c) {
+							int delta = quantized[1][k1][c] - quantized[0][k0][c];
+							valid = valid && delta >= -4 && delta <= 3;
+						}
+						if (!valid) {
+							continue;
+						}
+						bestError = error;
+						uint64_t bits = 0;
+						for (int c = 0; c < 3; ++c) {
+							int shift = 56 - 8 * c;
+							if (differential) {
+								bits |= (uint64_t)quantized[0][k0][c] << (shift + 3);
+								bits |= (uint64_t)((quantized[1][k1][c] - quantized[0][k0][c]) & 7) << shift;
+							}
+							else {
+								bits |= (uint64_t)quantized[0][k0][c] << (shift + 4);
+								bits |= (uint64_t)quantized[1][k1][c] << shift;
+							}
+						}
+						bits |= (uint64_t)tables[0][k0] << 37 | (uint64_t)tables[1][k1] << 34 | (uint64_t)differential << 33 | (uint64_t)flip << 32;
+						// Index bits are stored column by column, most significant bits in the upper half
+						for (int h = 0; h < 2; ++h) {
+							const uint8_t* chosen = indices[h][h ? k1 : k0];
+							for (int n = 0; n < 8; ++n) {
+								int i = halves[h].position[n], bit = (i & 3) * 4 + (i >> 2);
+								bits |= (uint64_t)(chosen[n] >> 1) << (16 + bit) | (uint64_t)(chosen[n] & 1) << bit;
+							}
+						}
+						best = bits;
+					}
+				}
+			}
+		}
+		for (int i = 0; i < 8; ++i) {
+			out[i] = (uint8_t)(best >> (56 - 8 * i));
+		}
+	}
+
+	// Decodes the ETC1 compatible modes; returns false for T, H and planar blocks
+	inline bool decodeBlockETC2(const uint8_t* in, unsigned char (*pixels)[4]) {
+		uint64_t bits = 0;
+		for (int i = 0; i < 8; ++i) {
+			bits = bits << 8 | in[i];
+		}
+		int differential = (int)(bits >> 33 & 1), flip = (int)(bits >> 32 & 1);
+		int tables[2] = { (int)(bits >> 37 & 7), (int)(bits >> 34 & 7) };
+		int base[2][3];
+		for (int c = 0; c < 3; ++c) {
+			int shift = 56 - 8 * c;
+			if (differential) {
+				int first = (int)(bits >> (shift + 3) & 31), delta = (int)(bits >> shift & 7);
+				int second = first + (delta >= 4 ? delta - 8 : delta);
+				if (second < 0 || second > 31) {
+					return false;
+				}
+				base[0][c] = first << 3 | first >> 2;
+				base[1][c] = second << 3 | second >> 2;
+			}
+			else {
+				base[0][c] = (int)(bits >> (shift + 4) & 15) * 17;
+				base[1][c] = (int)(bits >> shift & 15) * 17;
+			}
+		}
+		for (int i = 0; i < 16; ++i) {
+			int bit = (i & 3) * 4 + (i >> 2), half = etcHalf(i, flip);
+			int index = (int)(bits >> (16 + bit) & 1) << 1 | (int)(bits >> bit & 1);
+			for (int c = 0; c < 3; ++c) {
+				pixels[i][c] = (unsigned char)clampByte(base[half][c] + etcModifier(tables[half], index));
+			}
+			pixels[i][3] = 255;
+		}
+		return true;
+	}
+
+	inline void encodeBlock(BlockFormat format, const BlockPixels& block, uint8_t* out) {
+		switch (format) {
+		case BlockFormat::BC1: encodeBlockBC1(block, out); break;
+		case BlockFormat::BC3: encodeBlockBC3(block, out); break;
+		case BlockFormat::BC7: encodeBlockBC7(block, out); break;
+		case BlockFormat::ETC2: encodeBlockETC2(block, out); break;
+		}
+	}
+
+	inline bool decodeBlock(BlockFormat format, const uint8_t* in, unsigned char (*pixels)[4]) {
+		switch (format) {
+		case BlockFormat::BC1: decodeBlockBC1(in, false, pixels); return true;
+		case BlockFormat::BC3: decodeBlockBC3(in, pixels); return true;
+		case BlockFormat::BC7: return decodeBlockBC7(in, pixels);
+		case BlockFormat::ETC2: return decodeBlockETC2(in, pixels);
+		}
+		return false;
+	}
+}
+
+// Compresses an RGBA8 image into compressedSize(format, width, height) bytes of blocks, a row of blocks per task
+inline void compressImage(const unsigned char* rgba, int width, int height, BlockFormat format, unsigned char* out, ThreadPool* pool = nullptr) {
+	int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+	size_t rowBytes = (size_t)blocksX * blockFormatInfo(format).blockBytes;
+	auto encodeRow = [&](unsigned int blockY, unsigned int) {
+		texture_compression::BlockPixels block;
+		unsigned char* row = out + blockY * rowBytes;
+		for (int blockX = 0; blockX < blocksX; ++blockX) {
+			texture_compression::loadBlock(rgba, width, height, blockX, (int)blockY, block);
+			texture_compression::encodeBlock(format, block, row + blockX * blockFormatInfo(format).blockBytes);
+		}
+	};
+	if (pool) {
+		pool->parallelFor((unsigned int)blocksY, encodeRow);
+	}
+	else {
+		for (int blockY = 0; blockY < blocksY; ++blockY) {
+			encodeRow((unsigned int)blockY, 0);
+		}
+	}
+}
+
+// Decodes blocks back to RGBA8. Returns false if a block uses a mode the encoder never writes (those decode black).
+inline bool decompressImage(const unsigned char* blocks, int width, int height, BlockFormat format, unsigned char* rgba) {
+	int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+	unsigned int blockBytes = blockFormatInfo(format).blockBytes;
+	bool ok = true;
+	for (int blockY = 0; blockY < blocksY; ++blockY) {
+		for (int blockX = 0; blockX < blocksX; ++blockX) {
+			unsigned char pixels[16][4];
+			if (!texture_compression::decodeBlock(format, blocks + ((size_t)blockY * blocksX + blockX) * blockBytes, pixels)) {
+				memset(pixels, 0, sizeof(pixels));
+				ok = false;
+			}
+			texture_compression::storeBlock(pixels, width, height, blockX, blockY, rgba);
+		}
+	}
+	return ok;
+}
+
+// Peak signal to noise ratio in dB over the first channels of every RGBA8 pixel, infinite for identical images
+inline double psnr(const unsigned char* a, const unsigned char* b, size_t pixels, int channels) {
+	double squared = 0.0;
+	for (size_t i = 0; i < pixels; ++i) {
+		for (int c = 0; c < channels; ++c) {
+			double d = (double)a[4 * i + c] - b[4 * i + c];
+			squared += d * d;
+		}
+	}
+	if (squared == 0.0) {
+		return INFINITY;
+	}
+	double mse = squared / ((double)pixels * channels);
+	return 10.0 * std::log10(255.0 * 255.0 / mse);
+}
+#endif
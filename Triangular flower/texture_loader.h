@@ -0,0 +1,409 @@
+#ifndef TEXTURE_LOADER_H
+#define TEXTURE_LOADER_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "compressed_texture.h"
+#include "image_file.h"
+#include "mipmap.h"
+#include "allocation_counter.h"
+#include "profiler.h"
+
+// Loads textures without stalling the render loop.
+// load() only queues the file. Worker threads read and decode it and build the mip chain, update(),
+// called once per frame on the GL thread, then copies at most uploadBudget bytes into one of a ring of
+// pixel unpack buffers and issues glTexSubImage2D from it, so the driver copies asynchronously.
+// A staging buffer is reused only after the fence of its last upload has passed; if it has not,
+// the frame uploads nothing instead of waiting. Levels are uploaded from the smallest one up and
+// GL_TEXTURE_BASE_LEVEL follows them, so a texture shows up blurry first and sharpens over a few frames.
+// Until its smallest level is in, texture() returns a 1x1 white placeholder.
+// KTX2 files are already compressed with all their levels and skip the workers, see loadCompressedTexture.
+class TextureLoader {
+public:
+	static const uint32_t INVALID = 0xFFFFFFFFu;
+	static const int STAGING_BUFFERS = 3;
+
+	explicit TextureLoader(unsigned int threadCount = 2, size_t uploadBudget = 1 << 20)
+		: threadCount(threadCount == 0 ? 1 : threadCount), uploadBudget(uploadBudget) {}
+
+	~TextureLoader() {
+		stopWorkers();
+	}
+
+	TextureLoader(const TextureLoader&) = delete;
+	TextureLoader& operator=(const TextureLoader&) = delete;
+
+	// Needs a current GL context, starts the worker threads
+	void init() {
+		for (StagingBuffer& staging : stagingBuffers) {
+			glGenBuffers(1, &staging.buffer);
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, staging.buffer);
+			glBufferData(GL_PIXEL_UNPACK_BUFFER, (GLsizeiptr)uploadBudget, nullptr, GL_STREAM_DRAW);
+		}
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+		const unsigned char white[4] = { 255, 255, 255, 255 };
+		glGenTextures(1, &placeholder);
+		glBindTexture(GL_TEXTURE_2D, placeholder);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, white);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		textures.reserve(64);
+		uploadQueue.reserve(64);
+		received.reserve(64);
+		finished.reserve(64);
+		stopping = false;
+		for (unsigned int i = 0; i < threadCount; ++i) {
+			workers.emplace_back(&TextureLoader::workerLoop, this);
+		}
+		initialized = true;
+	}
+
+	void destroy() {
+		if (!initialized) {
+			return;
+		}
+		stopWorkers();
+		for (StagingBuffer& staging : stagingBuffers) {
+			if (staging.fence) {
+				glDeleteSync(staging.fence);
+				staging.fence = 0;
+			}
+			glDeleteBuffers(1, &staging.buffer);
+			staging.buffer = 0;
+		}
+		for (TextureRecord& texture : textures) {
+			if (texture.name) {
+				glDeleteTextures(1, &texture.name);
+				texture.name = 0;
+			}
+		}
+		glDeleteTextures(1, &placeholder);
+		placeholder = 0;
+		initialized = false;
+	}
+
+	// Queues a file (PPM, PGM or TGA) and returns its id right away.
+	// A .ktx2 file is uploaded on the spot from its mapping, so this must be called on the GL thread.
+	uint32_t load(const char* path) {
+		uint32_t id = (uint32_t)textures.size();
+		textures.push_back(TextureRecord());
+		TextureRecord& texture = textures.back();
+		texture.path = path;
+		size_t length = texture.path.size();
+		if (length > 5 && texture.path.compare(length - 5, 5, ".ktx2") == 0) {
+			size_t bytes = 0;
+			texture.name = loadCompressedTexture(path, &bytes);
+			totalBytes += bytes;
+			texture.state = texture.name ? TextureState::Resident : TextureState::Failed;
+			texture.baseLevel = texture.name ? 0 : -1;
+			return id;
+		}
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			jobs.push_back({ id, path });
+		}
+		wake.notify_one();
+		return id;
+	}
+
+	// Call once per frame on the GL thread
+	void update() {
+		if (!initialized) {
+			return;
+		}
+		PROFILE_ZONE("textureUpload");
+		lastFrameBytes = 0;
+		receiveDecoded();
+		if (uploadHead == uploadQueue.size()) {
+			uploadQueue.clear();
+			uploadHead = 0;
+			return;
+		}
+
+		StagingBuffer& staging = stagingBuffers[nextStaging];
+		if (staging.fence) {
+			if (glClientWaitSync(staging.fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+				// The GPU still reads this buffer, try again next frame rather than wait
+				++stalledFrames;
+				return;
+			}
+			glDeleteSync(staging.fence);
+			staging.fence = 0;
+		}
+
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, staging.buffer);
+		// The fence has passed, so nothing reads the buffer anymore
+		unsigned char* mapped = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, (GLsizeiptr)uploadBudget,
+			GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+		if (!mapped) {
+			std::cout << "ERROR::TEXTURE::STAGING_BUFFER_NOT_MAPPED" << std::endl;
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+			return;
+		}
+		int regionCount = 0;
+		size_t used = 0;
+		for (size_t q = uploadHead; q < uploadQueue.size() && regionCount < MAX_REGIONS; ) {
+			TextureRecord& texture = textures[uploadQueue[q]];
+			const MipChain& mips = *texture.mips;
+			int level = texture.level;
+			size_t rowBytes = (size_t)mips.width[level] * 4;
+			int rows = (int)std::min<size_t>((uploadBudget - used) / rowBytes, (size_t)(mips.height[level] - texture.row));
+			if (rows == 0) {
+				break;
+			}
+			memcpy(mapped + used, mips.level(level) + texture.row * rowBytes, rows * rowBytes);
+			regions[regionCount++] = { uploadQueue[q], level, texture.row, rows, used };
+			used += rows * rowBytes;
+			texture.row += rows;
+			if (texture.row == mips.height[level]) {
+				texture.row = 0;
+				if (--texture.level < 0) {
+					++q;
+				}
+			}
+		}
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+		for (int i = 0; i < regionCount; ++i) {
+			const Region& region = regions[i];
+			TextureRecord& texture = textures[region.texture];
+			const MipChain& mips = *texture.mips;
+			glBindTexture(GL_TEXTURE_2D, texture.name);
+			glTexSubImage2D(GL_TEXTURE_2D, region.level, 0, region.y, mips.width[region.level], region.rows,
+							GL_RGBA, GL_UNSIGNED_BYTE, (const void*)region.offset);
+			if (region.y + region.rows == mips.height[region.level]) {
+				// Level complete, sampling may use it from now on
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, region.level);
+				texture.baseLevel = region.level;
+				if (region.level == 0) {
+					texture.state = TextureState::Resident;
+					texture.mips.reset();
+				}
+			}
+		}
+		glBindTexture(GL_TEXTURE_2D, 0);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		staging.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		nextStaging = (nextStaging + 1) % STAGING_BUFFERS;
+		lastFrameBytes = used;
+		totalBytes += used;
+		while (uploadHead < uploadQueue.size() && textures[uploadQueue[uploadHead]].state == TextureState::Resident) {
+			++uploadHead;
+		}
+	}
+
+	// The texture object, or the placeholder while not even the smallest level is uploaded
+	unsigned int texture(uint32_t id) const {
+		const TextureRecord& texture = textures[id];
+		return texture.baseLevel >= 0 ? texture.name : placeholder;
+	}
+
+	void bind(uint32_t id, unsigned int unit) const {
+		glActiveTexture(GL_TEXTURE0 + unit);
+		glBindTexture(GL_TEXTURE_2D, texture(id));
+	}
+
+	// All levels are uploaded
+	bool isResident(uint32_t id) const {
+		return textures[id].state == TextureState::Resident;
+	}
+	bool hasFailed(uint32_t id) const {
+		return textures[id].state == TextureState::Failed;
+	}
+	// Textures neither resident nor failed
+	unsigned int pendingCount() const {
+		unsigned int pending = 0;
+		for (const TextureRecord& texture : textures) {
+			pending += texture.state != TextureState::Resident && texture.state != TextureState::Failed;
+		}
+		return pending;
+	}
+	uint64_t uploadedBytes() const {
+		return totalBytes;
+	}
+	uint64_t lastFrameUploadedBytes() const {
+		return lastFrameBytes;
+	}
+	// Frames that skipped their upload because the staging buffer was still in use
+	uint64_t stalls() const {
+		return stalledFrames;
+	}
+
+	void writeReport(std::ostream& out) const {
+		const char* states[] = { "queued", "uploading", "resident", "failed" };
+		out << "Textures (" << totalBytes << " bytes uploaded, " << stalledFrames << " stalled frames)" << std::endl;
+		for (const TextureRecord& texture : textures) {
+			out << "  " << texture.path << ": " << states[(int)texture.state] << std::endl;
+		}
+	}
+
+private:
+	static const int MAX_REGIONS = 64; // glTexSubImage2D calls per frame
+
+	enum class TextureState {
+		Queued,
+		Uploading,
+		Resident,
+		Failed,
+	};
+	struct TextureRecord {
+		std::string path;
+		TextureState state = TextureState::Queued;
+		unsigned int name = 0;
+		std::unique_ptr<MipChain> mips; // until the upload is done
+		int level = 0, row = 0;         // next rows to upload
+		int baseLevel = -1;             // smallest uploaded level, -1 while none
+	};
+	struct Job {
+		uint32_t texture;
+		std::string path;
+	};
+	struct Result {
+		uint32_t texture;
+		std::unique_ptr<MipChain> mips; // null when the file could not be loaded
+	};
+	struct Region {
+		uint32_t texture;
+		int level, y, rows;
+		size_t offset; // in the staging buffer
+	};
+	struct StagingBuffer {
+		unsigned int buffer = 0;
+		GLsync fence = 0;
+	};
+
+	unsigned int threadCount;
+	size_t uploadBudget;
+	bool initialized = false;
+	unsigned int placeholder = 0;
+	StagingBuffer stagingBuffers[STAGING_BUFFERS];
+	int nextStaging = 0;
+	Region regions[MAX_REGIONS];
+	std::vector<TextureRecord> textures;
+	std::vector<uint32_t> uploadQueue;
+	size_t uploadHead = 0;
+	uint64_t totalBytes = 0, lastFrameBytes = 0, stalledFrames = 0;
+
+	// Shared with the workers
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::deque<Job> jobs;
+	std::vector<Result> finished;
+	std::atomic<unsigned int> finishedCount{ 0 };
+	bool stopping = false;
+	std::vector<std::thread> workers;
+	std::vector<Result> received; // render thread side of finished
+
+	void stopWorkers() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		wake.notify_all();
+		for (std::thread& worker : workers) {
+			worker.join();
+		}
+		workers.clear();
+	}
+
+	void workerLoop() {
+		// Decoding allocates, but it is not the render loop's work
+		allocation_counter::exemptCurrentThread();
+		PROFILE_THREAD_NAME("texture loader");
+		for (;;) {
+			Job job;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				wake.wait(lock, [this] { return stopping || !jobs.empty(); });
+				if (stopping) {
+					return;
+				}
+				job = std::move(jobs.front());
+				jobs.pop_front();
+			}
+			Result result = { job.texture, decode(job.path.c_str()) };
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				finished.push_back(std::move(result));
+			}
+			finishedCount.fetch_add(1, std::memory_order_release);
+		}
+	}
+
+	static std::unique_ptr<MipChain> decode(const char* path) {
+		PROFILE_ZONE("decodeTexture");
+		std::vector<unsigned char> bytes;
+		if (!readFileBytes(path, bytes)) {
+			std::cout << "ERROR::TEXTURE::FILE_NOT_SUCCESFULLY_READ " << path << std::endl;
+			return nullptr;
+		}
+		Image image;
+		const char* error = nullptr;
+		if (!decodeImage(bytes.data(), bytes.size(), image, error)) {
+			std::cout << "ERROR::TEXTURE::DECODE_FAILED " << path << ": " << error << std::endl;
+			return nullptr;
+		}
+		std::unique_ptr<MipChain> mips(new MipChain());
+		buildMipChain(image, *mips);
+		return mips;
+	}
+
+	// Takes the workers' results and creates the texture storage for them (before a staging buffer is bound)
+	void receiveDecoded() {
+		if (finishedCount.load(std::memory_order_acquire) == 0) {
+			return;
+		}
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			received.swap(finished);
+			finishedCount.store(0, std::memory_order_relaxed);
+		}
+		for (Result& result : received) {
+			TextureRecord& texture = textures[result.texture];
+			if (!result.mips) {
+				texture.state = TextureState::Failed;
+				continue;
+			}
+			texture.mips = std::move(result.mips);
+			const MipChain& mips = *texture.mips;
+			glGenTextures(1, &texture.name);
+			glBindTexture(GL_TEXTURE_2D, texture.name);
+			for (int level = 0; level < mips.levels; ++level) {
+				glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, mips.width[level], mips.height[level], 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+			}
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, mips.levels - 1);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, mips.levels - 1);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+			texture.state = TextureState::Uploading;
+			texture.level = mips.levels - 1;
+			texture.row = 0;
+			if ((size_t)mips.width[0] * 4 > uploadBudget) {
+				std::cout << "ERROR::TEXTURE::ROW_LARGER_THAN_UPLOAD_BUDGET " << texture.path << std::endl;
+				texture.state = TextureState::Failed;
+				texture.mips.reset();
+				continue;
+			}
+			uploadQueue.push_back(result.texture);
+		}
+		glBindTexture(GL_TEXTURE_2D, 0);
+		received.clear();
+	}
+};
+#endif
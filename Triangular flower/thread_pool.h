@@ -0,0 +1,115 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads that run one parallel job at a time.
+// The calling thread takes part in every job, so a pool of N threads starts N - 1 workers.
+class ThreadPool {
+public:
+	// 0 threads means one per hardware thread
+	explicit ThreadPool(unsigned int threadCount = 0) {
+		if (threadCount == 0) {
+			threadCount = std::thread::hardware_concurrency();
+		}
+		if (threadCount == 0) {
+			threadCount = 1;
+		}
+		for (unsigned int i = 1; i < threadCount; ++i) {
+			workers.emplace_back(&ThreadPool::workerLoop, this, i);
+		}
+	}
+
+	~ThreadPool() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		wake.notify_all();
+		for (std::thread& worker : workers) {
+			worker.join();
+		}
+	}
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	unsigned int threadCount() const {
+		return (unsigned int)workers.size() + 1;
+	}
+
+	// Calls task(taskIndex, threadIndex) for every taskIndex in [0, taskCount) and returns when all are done.
+	// Tasks are handed out one at a time, threadIndex is in [0, threadCount()) and 0 is the calling thread.
+	void parallelFor(unsigned int taskCount, const std::function<void(unsigned int, unsigned int)>& task) {
+		if (taskCount == 0) {
+			return;
+		}
+		if (workers.empty() || taskCount == 1) {
+			for (unsigned int i = 0; i < taskCount; ++i) {
+				task(i, 0);
+			}
+			return;
+		}
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			job = &task;
+			jobTaskCount = taskCount;
+			nextTask.store(0, std::memory_order_relaxed);
+			busyWorkers = (unsigned int)workers.size();
+			++generation;
+		}
+		wake.notify_all();
+		runTasks(0);
+
+		std::unique_lock<std::mutex> lock(mutex);
+		done.wait(lock, [this] { return busyWorkers == 0; });
+		job = nullptr;
+	}
+
+private:
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable wake, done;
+	const std::function<void(unsigned int, unsigned int)>* job = nullptr;
+	unsigned int jobTaskCount = 0;
+	std::atomic<unsigned int> nextTask{ 0 };
+	unsigned int busyWorkers = 0;
+	unsigned long long generation = 0;
+	bool stopping = false;
+
+	void runTasks(unsigned int thread) {
+		for (;;) {
+			unsigned int task = nextTask.fetch_add(1, std::memory_order_relaxed);
+			if (task >= jobTaskCount) {
+				return;
+			}
+			(*job)(task, thread);
+		}
+	}
+
+	void workerLoop(unsigned int thread) {
+		unsigned long long seen = 0;
+		for (;;) {
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				wake.wait(lock, [this, seen] { return stopping || generation != seen; });
+				if (stopping) {
+					return;
+				}
+				seen = generation;
+			}
+			runTasks(thread);
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				--busyWorkers;
+			}
+			done.notify_one();
+		}
+	}
+};
+#endif
@@ -0,0 +1,392 @@
+#ifndef TLSF_ALLOCATOR_H
+#define TLSF_ALLOCATOR_H
+
+#include <cstdint>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Two-level segregated fit allocator for ranges of a buffer it does not own (it never touches the memory).
+// Free blocks sit in lists indexed by the top bit of their size (first level) and the next four bits
+// (second level), two bitmaps find a list that is large enough in constant time, and freeing merges the
+// neighbours right away. Offsets and sizes are multiples of the granularity. Block records are recycled,
+// so after the first allocations neither allocate() nor free() touch the heap.
+//
+// compactStep() slides the first allocation that follows free space down into it, one block per call, so
+// the free space collects at the end. The caller copies the data, see GpuBufferAllocator::defragment().
+class TlsfAllocator {
+public:
+	static const uint32_t INVALID = 0xFFFFFFFFu;
+
+	// A block moved by compactStep(), the caller copies size bytes from `from` to `to`
+	struct Move {
+		uint32_t block;
+		uint32_t tag;
+		uint64_t from, to, size;
+	};
+
+	// granularity must be a power of two
+	explicit TlsfAllocator(uint64_t capacity = 0, uint64_t granularity = 16) {
+		reset(capacity, granularity);
+	}
+
+	// Forgets every allocation, the whole capacity becomes one free block
+	void reset(uint64_t capacity, uint64_t granularity = 16) {
+		this->granularity = granularity;
+		this->capacity = capacity - capacity % granularity;
+		used = 0;
+		allocationCount = 0;
+		flBitmap = 0;
+		for (int fl = 0; fl < FL_COUNT; ++fl) {
+			slBitmap[fl] = 0;
+			for (int sl = 0; sl < SL_COUNT; ++sl) {
+				heads[fl][sl] = INVALID;
+			}
+		}
+		blocks.clear();
+		unusedRecords.clear();
+		blocks.reserve(64);
+		unusedRecords.reserve(64);
+		firstBlock = INVALID;
+		if (this->capacity > 0) {
+			firstBlock = newRecord();
+			Block& block = blocks[firstBlock];
+			block.offset = 0;
+			block.size = this->capacity;
+			insertFree(firstBlock);
+		}
+	}
+
+	// Returns the block id, or INVALID when no free block is large enough. The tag is handed back in Move.
+	uint32_t allocate(uint64_t size, uint32_t tag = 0) {
+		size = roundUp(size == 0 ? 1 : size);
+		int fl, sl;
+		uint32_t id = findFree(size, fl, sl);
+		if (id == INVALID) {
+			return INVALID;
+		}
+		removeFree(id, fl, sl);
+		if (blocks[id].size - size >= granularity) {
+			// The remainder goes back to the free lists
+			uint32_t rest = newRecord();
+			Block& block = blocks[id];
+			Block& remainder = blocks[rest];
+			remainder.offset = block.offset + size;
+			remainder.size = block.size - size;
+			remainder.prevPhysical = id;
+			remainder.nextPhysical = block.nextPhysical;
+			if (block.nextPhysical != INVALID) {
+				blocks[block.nextPhysical].prevPhysical = rest;
+			}
+			block.nextPhysical = rest;
+			block.size = size;
+			insertFree(rest);
+		}
+		Block& block = blocks[id];
+		block.free = false;
+		block.tag = tag;
+		used += block.size;
+		++allocationCount;
+		return id;
+	}
+
+	void free(uint32_t id) {
+		Block& block = blocks[id];
+		used -= block.size;
+		--allocationCount;
+		block.free = true;
+		id = mergeWithNeighbours(id);
+		insertFree(id);
+	}
+
+	uint64_t offset(uint32_t id) const {
+		return blocks[id].offset;
+	}
+	// Size rounded up to the granularity
+	uint64_t size(uint32_t id) const {
+		return blocks[id].size;
+	}
+
+	// Moves the first allocation that has free space right before it to the start of that space.
+	// Returns false when the allocations are already packed at the start.
+	bool compactStep(Move& move) {
+		uint32_t hole = firstHole();
+		if (hole == INVALID) {
+			return false;
+		}
+		// A free block is never followed by another free block, so the next one is allocated
+		uint32_t id = blocks[hole].nextPhysical;
+		describeMove(hole, move);
+		removeFree(hole);
+		Block& space = blocks[hole];
+		Block& block = blocks[id];
+
+		// Swap the two in the physical list: [space][block] becomes [block][space]
+		uint32_t before = space.prevPhysical, after = block.nextPhysical;
+		block.offset = space.offset;
+		space.offset = block.offset + block.size;
+		block.prevPhysical = before;
+		block.nextPhysical = hole;
+		space.prevPhysical = id;
+		space.nextPhysical = after;
+		if (before != INVALID) {
+			blocks[before].nextPhysical = id;
+		}
+		else {
+			firstBlock = id;
+		}
+		if (after != INVALID) {
+			blocks[after].prevPhysical = hole;
+		}
+		insertFree(mergeWithNeighbours(hole));
+		return true;
+	}
+
+	// The move the next compactStep() would make, without making it
+	bool nextCompaction(Move& move) const {
+		uint32_t hole = firstHole();
+		if (hole == INVALID) {
+			return false;
+		}
+		describeMove(hole, move);
+		return true;
+	}
+
+	uint64_t capacityBytes() const {
+		return capacity;
+	}
+	uint64_t usedBytes() const {
+		return used;
+	}
+	uint64_t freeBytes() const {
+		return capacity - used;
+	}
+	uint32_t allocations() const {
+		return allocationCount;
+	}
+	bool isEmpty() const {
+		return allocationCount == 0;
+	}
+
+	uint64_t largestFreeBlock() const {
+		if (flBitmap == 0) {
+			return 0;
+		}
+		int fl = highestBit(flBitmap);
+		int sl = highestBit(slBitmap[fl]);
+		// Sizes within one list differ, look at all of them
+		uint64_t largest = 0;
+		for (uint32_t id = heads[fl][sl]; id != INVALID; id = blocks[id].nextFree) {
+			if (blocks[id].size > largest) {
+				largest = blocks[id].size;
+			}
+		}
+		return largest;
+	}
+
+	// 0 when all free space is one block, towards 1 as it is scattered into small pieces
+	double fragmentation() const {
+		uint64_t total = freeBytes();
+		return total == 0 ? 0.0 : 1.0 - (double)largestFreeBlock() / (double)total;
+	}
+
+private:
+	static const int SL_LOG2 = 4;
+	static const int SL_COUNT = 1 << SL_LOG2;
+	static const int FL_COUNT = 48;
+
+	struct Block {
+		uint64_t offset = 0, size = 0;
+		uint32_t prevPhysical = INVALID, nextPhysical = INVALID;
+		uint32_t prevFree = INVALID, nextFree = INVALID;
+		uint32_t tag = 0;
+		bool free = true;
+	};
+
+	uint64_t capacity = 0, granularity = 16, used = 0;
+	uint32_t allocationCount = 0;
+	uint64_t flBitmap = 0;
+	uint32_t slBitmap[FL_COUNT];
+	uint32_t heads[FL_COUNT][SL_COUNT];
+	std::vector<Block> blocks;
+	std::vector<uint32_t> unusedRecords;
+	uint32_t firstBlock = INVALID;
+
+	// x must not be 0
+	static int highestBit(uint64_t x) {
+#if defined(_MSC_VER) && defined(_M_X64)
+		unsigned long index;
+		_BitScanReverse64(&index, x);
+		return (int)index;
+#elif defined(_MSC_VER)
+		unsigned long index;
+		if (_BitScanReverse(&index, (unsigned long)(x >> 32))) {
+			return (int)index + 32;
+		}
+		_BitScanReverse(&index, (unsigned long)x);
+		return (int)index;
+#else
+		return 63 - __builtin_clzll(x);
+#endif
+	}
+	static int lowestBit(uint64_t x) {
+#if defined(_MSC_VER) && defined(_M_X64)
+		unsigned long index;
+		_BitScanForward64(&index, x);
+		return (int)index;
+#elif defined(_MSC_VER)
+		unsigned long index;
+		if (_BitScanForward(&index, (unsigned long)x)) {
+			return (int)index;
+		}
+		_BitScanForward(&index, (unsigned long)(x >> 32));
+		return (int)index + 32;
+#else
+		return __builtin_ctzll(x);
+#endif
+	}
+
+	uint32_t firstHole() const {
+		uint32_t hole = firstBlock;
+		while (hole != INVALID && !(blocks[hole].free && blocks[hole].nextPhysical != INVALID)) {
+			hole = blocks[hole].nextPhysical;
+		}
+		return hole;
+	}
+
+	void describeMove(uint32_t hole, Move& move) const {
+		const Block& block = blocks[blocks[hole].nextPhysical];
+		move.block = blocks[hole].nextPhysical;
+		move.tag = block.tag;
+		move.from = block.offset;
+		move.to = blocks[hole].offset;
+		move.size = block.size;
+	}
+
+	uint64_t roundUp(uint64_t size) const {
+		return (size + granularity - 1) & ~(granularity - 1);
+	}
+
+	// List of a block size in granularity units: sizes below SL_COUNT units get a list each,
+	// larger ones share SL_COUNT lists per power of two
+	static void mapping(uint64_t units, int& fl, int& sl) {
+		if (units < (uint64_t)SL_COUNT) {
+			fl = 0;
+			sl = (int)units;
+		}
+		else {
+			int top = highestBit(units);
+			fl = top - SL_LOG2 + 1;
+			sl = (int)(units >> (top - SL_LOG2)) ^ SL_COUNT;
+		}
+	}
+
+	// First list whose blocks are all at least size, then the first block in it
+	uint32_t findFree(uint64_t size, int& fl, int& sl) const {
+		uint64_t units = size / granularity;
+		if (units >= (uint64_t)SL_COUNT) {
+			units += (1ull << (highestBit(units) - SL_LOG2)) - 1;
+		}
+		mapping(units, fl, sl);
+		if (fl >= FL_COUNT) {
+			return INVALID;
+		}
+		uint32_t slMap = slBitmap[fl] & (~0u << sl);
+		if (slMap == 0) {
+			uint64_t flMap = fl + 1 < 64 ? flBitmap & (~0ull << (fl + 1)) : 0;
+			if (flMap == 0) {
+				return INVALID;
+			}
+			fl = lowestBit(flMap);
+			slMap = slBitmap[fl];
+		}
+		sl = lowestBit(slMap);
+		return heads[fl][sl];
+	}
+
+	void insertFree(uint32_t id) {
+		Block& block = blocks[id];
+		block.free = true;
+		int fl, sl;
+		mapping(block.size / granularity, fl, sl);
+		block.prevFree = INVALID;
+		block.nextFree = heads[fl][sl];
+		if (block.nextFree != INVALID) {
+			blocks[block.nextFree].prevFree = id;
+		}
+		heads[fl][sl] = id;
+		flBitmap |= 1ull << fl;
+		slBitmap[fl] |= 1u << sl;
+	}
+
+	void removeFree(uint32_t id) {
+		int fl, sl;
+		mapping(blocks[id].size / granularity, fl, sl);
+		removeFree(id, fl, sl);
+	}
+
+	void removeFree(uint32_t id, int fl, int sl) {
+		Block& block = blocks[id];
+		if (block.prevFree != INVALID) {
+			blocks[block.prevFree].nextFree = block.nextFree;
+		}
+		else {
+			heads[fl][sl] = block.nextFree;
+			if (heads[fl][sl] == INVALID) {
+				slBitmap[fl] &= ~(1u << sl);
+				if (slBitmap[fl] == 0) {
+					flBitmap &= ~(1ull << fl);
+				}
+			}
+		}
+		if (block.nextFree != INVALID) {
+			blocks[block.nextFree].prevFree = block.prevFree;
+		}
+		block.prevFree = block.nextFree = INVALID;
+	}
+
+	// Joins a free block (not in the lists) with free physical neighbours, returns the surviving block
+	uint32_t mergeWithNeighbours(uint32_t id) {
+		uint32_t next = blocks[id].nextPhysical;
+		if (next != INVALID && blocks[next].free) {
+			removeFree(next);
+			absorbNext(id);
+		}
+		uint32_t previous = blocks[id].prevPhysical;
+		if (previous != INVALID && blocks[previous].free) {
+			removeFree(previous);
+			absorbNext(previous);
+			id = previous;
+		}
+		return id;
+	}
+
+	void absorbNext(uint32_t id) {
+		Block& block = blocks[id];
+		uint32_t next = block.nextPhysical;
+		block.size += blocks[next].size;
+		block.nextPhysical = blocks[next].nextPhysical;
+		if (block.nextPhysical != INVALID) {
+			blocks[block.nextPhysical].prevPhysical = id;
+		}
+		unusedRecords.push_back(next);
+	}
+
+	uint32_t newRecord() {
+		if (!unusedRecords.empty()) {
+			uint32_t id = unusedRecords.back();
+			unusedRecords.pop_back();
+			blocks[id] = Block();
+			return id;
+		}
+		blocks.push_back(Block());
+		// Every record may end up unused, so merging never has to grow this list
+		if (unusedRecords.capacity() < blocks.capacity()) {
+			unusedRecords.reserve(blocks.capacity());
+		}
+		return (uint32_t)blocks.size() - 1;
+	}
+};
+#endif
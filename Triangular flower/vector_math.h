@@ -0,0 +1,456 @@
+#ifndef VECTOR_MATH_H
+#define VECTOR_MATH_H
+
+#include <cmath>
+#include <cstddef>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define VECTOR_MATH_USE_SSE2
+#endif
+// AVX2 kernels need the compiler to target it (/arch:AVX2 or -mavx2 -mfma), there is no runtime dispatch
+#if defined(__AVX2__) && (defined(__FMA__) || defined(_MSC_VER))
+#include <immintrin.h>
+#define VECTOR_MATH_USE_AVX2
+#endif
+
+// Float vector, matrix and quaternion types in the GL conventions: matrices are column-major so
+// Mat4::data() goes to glUniformMatrix4fv unchanged, transforms act on column vectors (m * v),
+// rotations are counterclockwise in radians and the projections map depth to [-1, 1].
+
+struct Vec2 {
+	float x, y;
+
+	Vec2() : x(0.0f), y(0.0f) {
+	}
+	Vec2(float x, float y) : x(x), y(y) {
+	}
+};
+
+inline Vec2 operator+(const Vec2& a, const Vec2& b) {
+	return Vec2(a.x + b.x, a.y + b.y);
+}
+inline Vec2 operator-(const Vec2& a, const Vec2& b) {
+	return Vec2(a.x - b.x, a.y - b.y);
+}
+inline Vec2 operator*(const Vec2& a, float s) {
+	return Vec2(a.x * s, a.y * s);
+}
+inline float dot(const Vec2& a, const Vec2& b) {
+	return a.x * b.x + a.y * b.y;
+}
+inline float length(const Vec2& a) {
+	return std::sqrt(dot(a, a));
+}
+
+struct Vec3 {
+	float x, y, z;
+
+	Vec3() : x(0.0f), y(0.0f), z(0.0f) {
+	}
+	Vec3(float x, float y, float z) : x(x), y(y), z(z) {
+	}
+};
+
+inline Vec3 operator+(const Vec3& a, const Vec3& b) {
+	return Vec3(a.x + b.x, a.y + b.y, a.z + b.z);
+}
+inline Vec3 operator-(const Vec3& a, const Vec3& b) {
+	return Vec3(a.x - b.x, a.y - b.y, a.z - b.z);
+}
+inline Vec3 operator-(const Vec3& a) {
+	return Vec3(-a.x, -a.y, -a.z);
+}
+inline Vec3 operator*(const Vec3& a, float s) {
+	return Vec3(a.x * s, a.y * s, a.z * s);
+}
+inline Vec3 operator*(const Vec3& a, const Vec3& b) {
+	return Vec3(a.x * b.x, a.y * b.y, a.z * b.z);
+}
+inline float dot(const Vec3& a, const Vec3& b) {
+	return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+inline Vec3 cross(const Vec3& a, const Vec3& b) {
+	return Vec3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+}
+inline float length(const Vec3& a) {
+	return std::sqrt(dot(a, a));
+}
+inline Vec3 normalize(const Vec3& a) {
+	float l = length(a);
+	return l > 0.0f ? a * (1.0f / l) : a;
+}
+
+// Four floats in one SSE register's layout
+struct alignas(16) Vec4 {
+	float x, y, z, w;
+
+	Vec4() : x(0.0f), y(0.0f), z(0.0f), w(0.0f) {
+	}
+	Vec4(float x, float y, float z, float w) : x(x), y(y), z(z), w(w) {
+	}
+	Vec4(const Vec3& v, float w) : x(v.x), y(v.y), z(v.z), w(w) {
+	}
+
+	Vec3 xyz() const {
+		return Vec3(x, y, z);
+	}
+#ifdef VECTOR_MATH_USE_SSE2
+	explicit Vec4(__m128 v) {
+		_mm_storeu_ps(&x, v);
+	}
+	__m128 load() const {
+		return _mm_loadu_ps(&x);
+	}
+#endif
+};
+
+#ifdef VECTOR_MATH_USE_SSE2
+inline Vec4 operator+(const Vec4& a, const Vec4& b) {
+	return Vec4(_mm_add_ps(a.load(), b.load()));
+}
+inline Vec4 operator-(const Vec4& a, const Vec4& b) {
+	return Vec4(_mm_sub_ps(a.load(), b.load()));
+}
+inline Vec4 operator*(const Vec4& a, float s) {
+	return Vec4(_mm_mul_ps(a.load(), _mm_set1_ps(s)));
+}
+inline Vec4 operator*(const Vec4& a, const Vec4& b) {
+	return Vec4(_mm_mul_ps(a.load(), b.load()));
+}
+inline float dot(const Vec4& a, const Vec4& b) {
+	__m128 p = _mm_mul_ps(a.load(), b.load());
+	p = _mm_add_ps(p, _mm_shuffle_ps(p, p, _MM_SHUFFLE(2, 3, 0, 1)));
+	p = _mm_add_ps(p, _mm_shuffle_ps(p, p, _MM_SHUFFLE(1, 0, 3, 2)));
+	return _mm_cvtss_f32(p);
+}
+#else
+inline Vec4 operator+(const Vec4& a, const Vec4& b) {
+	return Vec4(a.x + b.x, a.y + b.y, a.z + b.z, a.w + b.w);
+}
+inline Vec4 operator-(const Vec4& a, const Vec4& b) {
+	return Vec4(a.x - b.x, a.y - b.y, a.z - b.z, a.w - b.w);
+}
+inline Vec4 operator*(const Vec4& a, float s) {
+	return Vec4(a.x * s, a.y * s, a.z * s, a.w * s);
+}
+inline Vec4 operator*(const Vec4& a, const Vec4& b) {
+	return Vec4(a.x * b.x, a.y * b.y, a.z * b.z, a.w * b.w);
+}
+inline float dot(const Vec4& a, const Vec4& b) {
+	return a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+}
+#endif
+inline float length(const Vec4& a) {
+	return std::sqrt(dot(a, a));
+}
+
+// Unit quaternions for rotations, w is the real part
+struct Quat {
+	float x, y, z, w;
+
+	Quat() : x(0.0f), y(0.0f), z(0.0f), w(1.0f) {
+	}
+	Quat(float x, float y, float z, float w) : x(x), y(y), z(z), w(w) {
+	}
+
+	static Quat axisAngle(const Vec3& axis, float radians) {
+		Vec3 a = normalize(axis) * std::sin(0.5f * radians);
+		return Quat(a.x, a.y, a.z, std::cos(0.5f * radians));
+	}
+};
+
+// a * b rotates by b first, then by a
+inline Quat operator*(const Quat& a, const Quat& b) {
+	return Quat(a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+				a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x,
+				a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w,
+				a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z);
+}
+inline float dot(const Quat& a, const Quat& b) {
+	return a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+}
+inline Quat normalize(const Quat& q) {
+	float l = std::sqrt(dot(q, q));
+	return l > 0.0f ? Quat(q.x / l, q.y / l, q.z / l, q.w / l) : Quat();
+}
+inline Quat conjugate(const Quat& q) {
+	return Quat(-q.x, -q.y, -q.z, q.w);
+}
+inline Vec3 rotate(const Quat& q, const Vec3& v) {
+	// v + 2w (u x v) + 2 u x (u x v) with u the vector part
+	Vec3 u(q.x, q.y, q.z);
+	Vec3 t = cross(u, v) * 2.0f;
+	return v + t * q.w + cross(u, t);
+}
+// Shortest-arc spherical interpolation, falls back to a normalized lerp for nearly equal rotations
+inline Quat slerp(const Quat& a, const Quat& b, float t) {
+	float cosine = dot(a, b);
+	Quat target = b;
+	if (cosine < 0.0f) {
+		cosine = -cosine;
+		target = Quat(-b.x, -b.y, -b.z, -b.w);
+	}
+	float wa = 1.0f - t, wb = t;
+	if (cosine < 0.9995f) {
+		float angle = std::acos(cosine), s = 1.0f / std::sin(angle);
+		wa = std::sin(wa * angle) * s;
+		wb = std::sin(wb * angle) * s;
+	}
+	Quat q(a.x * wa + target.x * wb, a.y * wa + target.y * wb, a.z * wa + target.z * wb, a.w * wa + target.w * wb);
+	return normalize(q);
+}
+
+struct Mat3 {
+	Vec3 columns[3];
+
+	Mat3() {
+		columns[0] = Vec3(1.0f, 0.0f, 0.0f);
+		columns[1] = Vec3(0.0f, 1.0f, 0.0f);
+		columns[2] = Vec3(0.0f, 0.0f, 1.0f);
+	}
+	Mat3(const Vec3& c0, const Vec3& c1, const Vec3& c2) {
+		columns[0] = c0;
+		columns[1] = c1;
+		columns[2] = c2;
+	}
+
+	const float* data() const {
+		return &columns[0].x;
+	}
+	static Mat3 rotation(const Quat& q) {
+		return Mat3(rotate(q, Vec3(1.0f, 0.0f, 0.0f)), rotate(q, Vec3(0.0f, 1.0f, 0.0f)), rotate(q, Vec3(0.0f, 0.0f, 1.0f)));
+	}
+};
+
+inline Vec3 operator*(const Mat3& m, const Vec3& v) {
+	return m.columns[0] * v.x + m.columns[1] * v.y + m.columns[2] * v.z;
+}
+inline Mat3 operator*(const Mat3& a, const Mat3& b) {
+	return Mat3(a * b.columns[0], a * b.columns[1], a * b.columns[2]);
+}
+inline Mat3 transpose(const Mat3& m) {
+	const Vec3* c = m.columns;
+	return Mat3(Vec3(c[0].x, c[1].x, c[2].x), Vec3(c[0].y, c[1].y, c[2].y), Vec3(c[0].z, c[1].z, c[2].z));
+}
+inline float determinant(const Mat3& m) {
+	return dot(m.columns[0], cross(m.columns[1], m.columns[2]));
+}
+// false and the matrix unchanged when it is singular
+inline bool invert(const Mat3& m, Mat3& result) {
+	float d = determinant(m);
+	if (d == 0.0f) {
+		return false;
+	}
+	const Vec3* c = m.columns;
+	// Rows of the inverse are the cross products of the columns
+	result = transpose(Mat3(cross(c[1], c[2]) * (1.0f / d), cross(c[2], c[0]) * (1.0f / d), cross(c[0], c[1]) * (1.0f / d)));
+	return true;
+}
+
+struct Mat4 {
+	Vec4 columns[4];
+
+	Mat4() {
+		columns[0] = Vec4(1.0f, 0.0f, 0.0f, 0.0f);
+		columns[1] = Vec4(0.0f, 1.0f, 0.0f, 0.0f);
+		columns[2] = Vec4(0.0f, 0.0f, 1.0f, 0.0f);
+		columns[3] = Vec4(0.0f, 0.0f, 0.0f, 1.0f);
+	}
+	Mat4(const Vec4& c0, const Vec4& c1, const Vec4& c2, const Vec4& c3) {
+		columns[0] = c0;
+		columns[1] = c1;
+		columns[2] = c2;
+		columns[3] = c3;
+	}
+
+	const float* data() const {
+		return &columns[0].x;
+	}
+	// Element at row r, column c
+	float at(int r, int c) const {
+		return (&columns[c].x)[r];
+	}
+	Mat3 upperLeft() const {
+		return Mat3(columns[0].xyz(), columns[1].xyz(), columns[2].xyz());
+	}
+
+	static Mat4 translation(const Vec3& t) {
+		Mat4 m;
+		m.columns[3] = Vec4(t, 1.0f);
+		return m;
+	}
+	static Mat4 scale(const Vec3& s) {
+		Mat4 m;
+		m.columns[0].x = s.x;
+		m.columns[1].y = s.y;
+		m.columns[2].z = s.z;
+		return m;
+	}
+	static Mat4 rotation(const Quat& q) {
+		Mat3 r = Mat3::rotation(q);
+		return Mat4(Vec4(r.columns[0], 0.0f), Vec4(r.columns[1], 0.0f), Vec4(r.columns[2], 0.0f), Vec4(0.0f, 0.0f, 0.0f, 1.0f));
+	}
+	// Translation * rotation * scale, the usual instance transform
+	static Mat4 compose(const Vec3& t, const Quat& q, const Vec3& s) {
+		Mat3 r = Mat3::rotation(q);
+		return Mat4(Vec4(r.columns[0] * s.x, 0.0f), Vec4(r.columns[1] * s.y, 0.0f), Vec4(r.columns[2] * s.z, 0.0f), Vec4(t, 1.0f));
+	}
+	static Mat4 perspective(float fovY, float aspect, float zNear, float zFar) {
+		float f = 1.0f / std::tan(0.5f * fovY);
+		Mat4 m(Vec4(f / aspect, 0.0f, 0.0f, 0.0f), Vec4(0.0f, f, 0.0f, 0.0f),
+			   Vec4(0.0f, 0.0f, (zFar + zNear) / (zNear - zFar), -1.0f), Vec4(0.0f, 0.0f, 2.0f * zFar * zNear / (zNear - zFar), 0.0f));
+		return m;
+	}
+	static Mat4 orthographic(float left, float right, float bottom, float top, float zNear, float zFar) {
+		Mat4 m;
+		m.columns[0].x = 2.0f / (right - left);
+		m.columns[1].y = 2.0f / (top - bottom);
+		m.columns[2].z = -2.0f / (zFar - zNear);
+		m.columns[3] = Vec4(-(right + left) / (right - left), -(top + bottom) / (top - bottom), -(zFar + zNear) / (zFar - zNear), 1.0f);
+		return m;
+	}
+	static Mat4 lookAt(const Vec3& eye, const Vec3& target, const Vec3& up) {
+		Vec3 f = normalize(target - eye), s = normalize(cross(f, up)), u = cross(s, f);
+		return Mat4(Vec4(s.x, u.x, -f.x, 0.0f), Vec4(s.y, u.y, -f.y, 0.0f), Vec4(s.z, u.z, -f.z, 0.0f),
+					Vec4(-dot(s, eye), -dot(u, eye), dot(f, eye), 1.0f));
+	}
+};
+
+#ifdef VECTOR_MATH_USE_SSE2
+inline __m128 transform4(const Mat4& m, __m128 v) {
+	__m128 r = _mm_mul_ps(m.columns[0].load(), _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0)));
+	r = _mm_add_ps(r, _mm_mul_ps(m.columns[1].load(), _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1))));
+	r = _mm_add_ps(r, _mm_mul_ps(m.columns[2].load(), _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2))));
+	return _mm_add_ps(r, _mm_mul_ps(m.columns[3].load(), _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3))));
+}
+inline Vec4 operator*(const Mat4& m, const Vec4& v) {
+	return Vec4(transform4(m, v.load()));
+}
+inline Mat4 operator*(const Mat4& a, const Mat4& b) {
+	return Mat4(Vec4(transform4(a, b.columns[0].load())), Vec4(transform4(a, b.columns[1].load())),
+				Vec4(transform4(a, b.columns[2].load())), Vec4(transform4(a, b.columns[3].load())));
+}
+inline Mat4 transpose(const Mat4& m) {
+	__m128 c0 = m.columns[0].load(), c1 = m.columns[1].load(), c2 = m.columns[2].load(), c3 = m.columns[3].load();
+	_MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+	return Mat4(Vec4(c0), Vec4(c1), Vec4(c2), Vec4(c3));
+}
+#else
+inline Vec4 operator*(const Mat4& m, const Vec4& v) {
+	return m.columns[0] * v.x + m.columns[1] * v.y + m.columns[2] * v.z + m.columns[3] * v.w;
+}
+inline Mat4 operator*(const Mat4& a, const Mat4& b) {
+	return Mat4(a * b.columns[0], a * b.columns[1], a * b.columns[2], a * b.columns[3]);
+}
+inline Mat4 transpose(const Mat4& m) {
+	Mat4 t;
+	for (int c = 0; c < 4; ++c) {
+		(&t.columns[c].x)[0] = m.at(c, 0);
+		(&t.columns[c].x)[1] = m.at(c, 1);
+		(&t.columns[c].x)[2] = m.at(c, 2);
+		(&t.columns[c].x)[3] = m.at(c, 3);
+	}
+	return t;
+}
+#endif
+
+// General inverse by cofactors, false and the result unchanged when the matrix is singular
+inline bool invert(const Mat4& matrix, Mat4& result) {
+	const float* m = matrix.data();
+	float inv[16];
+	inv[0] = m[5] * m[10] * m[15] - m[5] * m[11] * m[14] - m[9] * m[6] * m[15] + m[9] * m[7] * m[14] + m[13] * m[6] * m[11] - m[13] * m[7] * m[10];
+	inv[4] = -m[4] * m[10] * m[15] + m[4] * m[11] * m[14] + m[8] * m[6] * m[15] - m[8] * m[7] * m[14] - m[12] * m[6] * m[11] + m[12] * m[7] * m[10];
+	inv[8] = m[4] * m[9] * m[15] - m[4] * m[11] * m[13] - m[8] * m[5] * m[15] + m[8] * m[7] * m[13] + m[12] * m[5] * m[11] - m[12] * m[7] * m[9];
+	inv[12] = -m[4] * m[9] * m[14] + m[4] * m[10] * m[13] + m[8] * m[5] * m[14] - m[8] * m[6] * m[13] - m[12] * m[5] * m[10] + m[12] * m[6] * m[9];
+	inv[1] = -m[1] * m[10] * m[15] + m[1] * m[11] * m[14] + m[9] * m[2] * m[15] - m[9] * m[3] * m[14] - m[13] * m[2] * m[11] + m[13] * m[3] * m[10];
+	inv[5] = m[0] * m[10] * m[15] - m[0] * m[11] * m[14] - m[8] * m[2] * m[15] + m[8] * m[3] * m[14] + m[12] * m[2] * m[11] - m[12] * m[3] * m[10];
+	inv[9] = -m[0] * m[9] * m[15] + m[0] * m[11] * m[13] + m[8] * m[1] * m[15] - m[8] * m[3] * m[13] - m[12] * m[1] * m[11] + m[12] * m[3] * m[9];
+	inv[13] = m[0] * m[9] * m[14] - m[0] * m[10] * m[13] - m[8] * m[1] * m[14] + m[8] * m[2] * m[13] + m[12] * m[1] * m[10] - m[12] * m[2] * m[9];
+	inv[2] = m[1] * m[6] * m[15] - m[1] * m[7] * m[14] - m[5] * m[2] * m[15] + m[5] * m[3] * m[14] + m[13] * m[2] * m[7] - m[13] * m[3] * m[6];
+	inv[6] = -m[0] * m[6] * m[15] + m[0] * m[7] * m[14] + m[4] * m[2] * m[15] - m[4] * m[3] * m[14] - m[12] * m[2] * m[7] + m[12] * m[3] * m[6];
+	inv[10] = m[0] * m[5] * m[15] - m[0] * m[7] * m[13] - m[4] * m[1] * m[15] + m[4] * m[3] * m[13] + m[12] * m[1] * m[7] - m[12] * m[3] * m[5];
+	inv[14] = -m[0] * m[5] * m[14] + m[0] * m[6] * m[13] + m[4] * m[1] * m[14] - m[4] * m[2] * m[13] - m[12] * m[1] * m[6] + m[12] * m[2] * m[5];
+	inv[3] = -m[1] * m[6] * m[11] + m[1] * m[7] * m[10] + m[5] * m[2] * m[11] - m[5] * m[3] * m[10] - m[9] * m[2] * m[7] + m[9] * m[3] * m[6];
+	inv[7] = m[0] * m[6] * m[11] - m[0] * m[7] * m[10] - m[4] * m[2] * m[11] + m[4] * m[3] * m[10] + m[8] * m[2] * m[7] - m[8] * m[3] * m[6];
+	inv[11] = -m[0] * m[5] * m[11] + m[0] * m[7] * m[9] + m[4] * m[1] * m[11] - m[4] * m[3] * m[9] - m[8] * m[1] * m[7] + m[8] * m[3] * m[5];
+	inv[15] = m[0] * m[5] * m[10] - m[0] * m[6] * m[9] - m[4] * m[1] * m[10] + m[4] * m[2] * m[9] + m[8] * m[1] * m[6] - m[8] * m[2] * m[5];
+
+	float d = m[0] * inv[0] + m[1] * inv[4] + m[2] * inv[8] + m[3] * inv[12];
+	if (d == 0.0f) {
+		return false;
+	}
+	d = 1.0f / d;
+	for (int c = 0; c < 4; ++c) {
+		result.columns[c] = Vec4(inv[4 * c] * d, inv[4 * c + 1] * d, inv[4 * c + 2] * d, inv[4 * c + 3] * d);
+	}
+	return true;
+}
+
+// Batch transforms of points (w = 1) into clip space, the input of CPU culling.
+// AoS reads x, y, z at points + i * stride, so an interleaved vertex buffer works as it is.
+// SoA reads separate x, y and z arrays and writes separate x, y, z and w arrays; it is the layout
+// the kernels vectorize across points, 4 per SSE step and 8 per AVX2 step.
+inline void transformPointsAoS(const Mat4& m, const float* points, size_t stride, size_t count, Vec4* out) {
+#ifdef VECTOR_MATH_USE_SSE2
+	__m128 c0 = m.columns[0].load(), c1 = m.columns[1].load(), c2 = m.columns[2].load(), c3 = m.columns[3].load();
+	for (size_t i = 0; i < count; ++i, points += stride) {
+		__m128 r = _mm_add_ps(c3, _mm_mul_ps(c0, _mm_set1_ps(points[0])));
+		r = _mm_add_ps(r, _mm_mul_ps(c1, _mm_set1_ps(points[1])));
+		r = _mm_add_ps(r, _mm_mul_ps(c2, _mm_set1_ps(points[2])));
+		_mm_storeu_ps(&out[i].x, r);
+	}
+#else
+	for (size_t i = 0; i < count; ++i, points += stride) {
+		out[i] = m.columns[3] + m.columns[0] * points[0] + m.columns[1] * points[1] + m.columns[2] * points[2];
+	}
+#endif
+}
+
+inline void transformPointsSoA(const Mat4& m, const float* x, const float* y, const float* z, size_t count,
+							   float* outX, float* outY, float* outZ, float* outW) {
+	size_t i = 0;
+#if defined(VECTOR_MATH_USE_AVX2)
+	float* out[4] = { outX, outY, outZ, outW };
+	__m256 rows[4][4];
+	for (int r = 0; r < 4; ++r) {
+		for (int c = 0; c < 4; ++c) {
+			rows[r][c] = _mm256_set1_ps(m.at(r, c));
+		}
+	}
+	for (size_t end = count - count % 8; i < end; i += 8) {
+		__m256 px = _mm256_loadu_ps(x + i), py = _mm256_loadu_ps(y + i), pz = _mm256_loadu_ps(z + i);
+		for (int r = 0; r < 4; ++r) {
+			__m256 v = _mm256_fmadd_ps(rows[r][0], px, rows[r][3]);
+			v = _mm256_fmadd_ps(rows[r][1], py, v);
+			v = _mm256_fmadd_ps(rows[r][2], pz, v);
+			_mm256_storeu_ps(out[r] + i, v);
+		}
+	}
+#elif defined(VECTOR_MATH_USE_SSE2)
+	float* out[4] = { outX, outY, outZ, outW };
+	__m128 rows[4][4];
+	for (int r = 0; r < 4; ++r) {
+		for (int c = 0; c < 4; ++c) {
+			rows[r][c] = _mm_set1_ps(m.at(r, c));
+		}
+	}
+	for (size_t end = count - count % 4; i < end; i += 4) {
+		__m128 px = _mm_loadu_ps(x + i), py = _mm_loadu_ps(y + i), pz = _mm_loadu_ps(z + i);
+		for (int r = 0; r < 4; ++r) {
+			__m128 v = _mm_add_ps(_mm_mul_ps(rows[r][0], px), rows[r][3]);
+			v = _mm_add_ps(v, _mm_mul_ps(rows[r][1], py));
+			v = _mm_add_ps(v, _mm_mul_ps(rows[r][2], pz));
+			_mm_storeu_ps(out[r] + i, v);
+		}
+	}
+#endif
+	for (; i < count; ++i) {
+		Vec4 p = m.columns[3] + m.columns[0] * x[i] + m.columns[1] * y[i] + m.columns[2] * z[i];
+		outX[i] = p.x;
+		outY[i] = p.y;
+		outZ[i] = p.z;
+		outW[i] = p.w;
+	}
+}
+#endif